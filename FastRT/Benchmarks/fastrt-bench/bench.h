@@ -0,0 +1,41 @@
+/************************************************************************/
+/* bench.h                                                              */
+/*                                                                      */
+/* fastrt-bench: benchmarks of the FastRT library.                      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __bench_h
+#define __bench_h
+
+#include <stdio.h>
+
+
+/* one benchmark, run as fastrt-bench <name> [options] */
+typedef struct {
+  const char *name;
+  const char *description;
+  int (*run) (int argc, char **argv);
+} BENCH;
+
+
+/* prototypes */
+
+double bench_now (void);
+int    bench_set_resources (const char *path);
+long   bench_allocations (void);   /* heap allocations so far, -1 if unknown */
+
+int    bench_grid (int argc, char **argv);
+int    bench_climatology (int argc, char **argv);
+int    bench_pool (int argc, char **argv);
+int    bench_scenarios (int argc, char **argv);
+int    bench_trace (int argc, char **argv);
+int    bench_metrics (int argc, char **argv);
+int    bench_arena (int argc, char **argv);
+int    bench_accuracy (int argc, char **argv);
+int    bench_daemon (int argc, char **argv);
+int    bench_preload (int argc, char **argv);
+int    bench_faults (int argc, char **argv);
+int    bench_embed (int argc, char **argv);
+
+#endif
@@ -0,0 +1,469 @@
+/************************************************************************/
+/* bench_accuracy.c                                                     */
+/*                                                                      */
+/* Differential accuracy of a fast path against the legacy pipeline.    */
+/*                                                                      */
+/* Every case is run through run_fastrt_(), the reference, and through  */
+/* a candidate path with the same options. The cases sweep sza, ozone   */
+/* and altitude on a grid given by -a, -o and -z; every grid point is   */
+/* combined with -r draws of the other options, each taken from its     */
+/* list by a hash of the case: clear sky or one of the cloud levels,    */
+/* with and without the broken cloud flag, aerosol beta or visibility,  */
+/* surface albedo or albedo type 0-17, and the slit function FWHM. The  */
+/* draws depend on -S only, so that two runs sweep the same cases.      */
+/*                                                                      */
+/* The relative error of a wavelength is |candidate - reference| over   */
+/* |reference|, where the reference is taken as at least               */
+/* ACCURACY_FLOOR times the largest value of its spectrum, so that the  */
+/* near zero values below 295 nm do not dominate. The maximum and mean  */
+/* per wavelength and the speedup are written as JSON, to stdout or to  */
+/* -O.                                                                  */
+/*                                                                      */
+/* Exits with 1 if a relative error exceeds -t, if the two paths return */
+/* a different status, or if no case could be compared, so that it can  */
+/* gate every change of a fast path.                                    */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FastRT.h"
+#include "reduced.h"
+#include "bench.h"
+
+
+#define ACCURACY_MAX_ARGS    40
+#define ACCURACY_FLOOR       1e-6     /* smallest reference, of the spectrum maximum */
+#define ACCURACY_TOLERANCE   1e-9     /* default of -t                               */
+
+
+/* a path computing the doserates of fastrt options */
+typedef struct {
+  const char *name;
+  const char *description;
+  int  (*run) (void *state, int argc, char **argv, double *doserates);
+  void *(*create) (void);
+  void (*release) (void *state);
+} ACCURACY_PATH;
+
+
+static int run_engine (void *state, int argc, char **argv, double *doserates)
+{
+  return fastrt_engine_run ((FASTRT_ENGINE *) state, argc, argv, doserates);
+}
+
+
+static void *create_engine (void)
+{
+  return fastrt_engine_create ();
+}
+
+
+static void release_engine (void *state)
+{
+  fastrt_engine_free ((FASTRT_ENGINE *) state);
+}
+
+
+/* the pack of -P, for the candidate pack */
+static const char *pack_path = "fastrt.pack";
+
+static void *create_pack (void)
+{
+  FASTRT_ENGINE *engine=NULL;
+
+  if ((engine = fastrt_engine_create ()) != NULL && fastrt_engine_open_pack (engine, pack_path) != 0)  {
+    fprintf (stderr, "Error, cannot open the pack %s\n", pack_path);
+    fastrt_engine_free (engine);
+    engine = NULL;
+  }
+  return engine;
+}
+
+
+/* the table of the case reduced to its sza, stored and read back */
+static int run_reduced (void *state, int argc, char **argv, double *doserates)
+{
+  FASTRT_REQUEST req;
+  REDUCED_TABLE built, table;
+  FILE *f=NULL;
+  int status=0;
+
+  fastrt_request_init (&req);
+  memset (&table, 0, sizeof(REDUCED_TABLE));
+
+  if ((status = fastrt_parse_request (argc, argv, &req)) == 0 &&
+      (status = fastrt_reduce ((FASTRT_ENGINE *) state, &req, &built)) == 0)  {
+    if ((f = tmpfile ()) == NULL || reduced_write (&built, f) != 0 || fseek (f, 0, SEEK_SET) != 0 ||
+	reduced_read (f, &table) != 0)  {
+      fprintf (stderr, "Error, cannot store the reduced table\n");
+      status = -1;
+    }
+    else
+      status = reduced_eval (&table, req.sza, doserates);
+    if (f != NULL)
+      fclose (f);
+    reduced_free (&built);
+    reduced_free (&table);
+  }
+
+  fastrt_request_free (&req);
+  return status;
+}
+
+
+static const ACCURACY_PATH candidates[] = {
+  { "engine", "tables cached by an engine shared by all cases",
+    run_engine, create_engine, release_engine },
+  { "pack", "an engine reading the compressed pack of -P",
+    run_engine, create_pack, release_engine },
+  { "reduced", "the tables of an engine reduced to the sza of the case, stored and read",
+    run_reduced, create_engine, release_engine },
+  { NULL, NULL, NULL, NULL, NULL }
+};
+
+
+/* the options drawn for every grid point */
+static const char *skies[] = {
+  "",
+  "-u 10",   "-u 25",   "-u 50",   "-u 145",  "-u 300",
+  "-u 545",  "-u 1085", "-u 2300", "-u 4000",
+  "-c -u 10",   "-c -u 25",   "-c -u 50",   "-c -u 145",  "-c -u 300",
+  "-c -u 545",  "-c -u 1085", "-c -u 2300", "-c -u 4000",
+  "-t 5",    "-t 50",
+  NULL
+};
+
+static const char *aerosols[] = {
+  "",
+  "-b 0",  "-b 0.05", "-b 0.1", "-b 0.2", "-b 0.4",
+  "-v 5",  "-v 20",   "-v 50",  "-v 350",
+  NULL
+};
+
+static const char *albedos[] = {
+  "",
+  "-q 0",  "-q 1",  "-q 2",  "-q 3",  "-q 4",  "-q 5",  "-q 6",  "-q 7",  "-q 8",
+  "-q 9",  "-q 10", "-q 11", "-q 12", "-q 13", "-q 14", "-q 15", "-q 16", "-q 17",
+  "-p 0",  "-p 0.05", "-p 0.3", "-p 0.8",
+  NULL
+};
+
+static const char *fwhms[] = {
+  "-f 0.05", "-f 0.6", "-f 1", "-f 2.5", "-f 5",
+  NULL
+};
+
+static const char **axes[] = { skies, aerosols, albedos, fwhms };
+
+#define ACCURACY_AXES  ((int) (sizeof(axes) / sizeof(axes[0])))
+
+
+/* errors per wavelength and totals */
+typedef struct {
+  int     n_lambda;
+  double *max_rel;
+  double *sum_rel;
+  long   *worst;             /* case of max_rel                    */
+  long    cases;
+  long    compared;          /* both paths o.k.                    */
+  long    failed;            /* both paths failed, same status     */
+  long    mismatched;        /* different status                   */
+  long    invalid;           /* NaN in one path only               */
+  double  seconds_reference;
+  double  seconds_candidate;
+  long   *hits[ACCURACY_AXES];
+} ACCURACY;
+
+
+static uint64_t mix (uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+
+static int length (const char **list)
+{
+  int n=0;
+  while (list[n] != NULL)
+    n++;
+  return n;
+}
+
+
+static int split_args (const char *args, char *buffer, size_t size, char **argv)
+{
+  char *t=NULL;
+  int argc=0;
+
+  argv[argc++] = "fastrt";
+  snprintf (buffer, size, "%s", args);
+  for (t=strtok (buffer, " "); t!=NULL && argc<ACCURACY_MAX_ARGS-1; t=strtok (NULL, " "))
+    argv[argc++] = t;
+  argv[argc] = NULL;
+  return argc;
+}
+
+
+/* the options of case k; the draws of the other axes are recorded in pick */
+static void make_case (long k, uint64_t seed, double sza, double o3, double alt,
+		       const char *lambda, char *args, size_t size, int *pick)
+{
+  int a=0, n=0;
+
+  n = snprintf (args, size, "-a %g -o %g -z %g %s", sza, o3, alt, lambda);
+  for (a=0; a<ACCURACY_AXES; a++)  {
+    pick[a] = (int) (mix (seed ^ mix ((uint64_t) k * ACCURACY_AXES + a)) % length (axes[a]));
+    n += snprintf (args + n, size - n, " %s", axes[a][pick[a]]);
+  }
+}
+
+
+static int invalid (double x)
+{
+  return (isnan (x) || x == NaN);
+}
+
+
+/* add the errors of case k; returns the largest */
+static double compare (ACCURACY *acc, long k, const double *reference, const double *candidate)
+{
+  double peak=0.0, floor=0.0, rel=0.0, largest=0.0;
+  int i=0;
+
+  for (i=0; i<acc->n_lambda; i++)
+    if (!invalid (reference[i]) && fabs (reference[i]) > peak)
+      peak = fabs (reference[i]);
+  floor = ACCURACY_FLOOR * peak;
+
+  for (i=0; i<acc->n_lambda; i++)  {
+    if (invalid (reference[i]) || invalid (candidate[i]))  {
+      if (invalid (reference[i]) != invalid (candidate[i]))  {
+	acc->invalid++;
+	rel = INFINITY;
+      }
+      else
+	rel = 0.0;
+    }
+    else if (candidate[i] == reference[i])
+      rel = 0.0;
+    else
+      rel = fabs (candidate[i] - reference[i]) / fmax (fabs (reference[i]), floor);
+
+    acc->sum_rel[i] += (isinf (rel) ? 0.0 : rel);
+    if (rel > acc->max_rel[i] || acc->worst[i] < 0)  {
+      acc->max_rel[i] = rel;
+      acc->worst[i]   = k;
+    }
+    if (rel > largest)
+      largest = rel;
+  }
+  return largest;
+}
+
+
+static void usage (void)
+{
+  int i=0;
+
+  fprintf (stderr, "Usage: fastrt-bench accuracy [-R resources] [-c candidate] [-P pack] [-a sza_step]\n");
+  fprintf (stderr, "         [-o o3_step] [-z alt_step] [-r draws] [-S seed] [-w first:last:step]\n");
+  fprintf (stderr, "         [-t tolerance] [-O output.json] [-v]\n");
+  fprintf (stderr, "  -t   largest relative error accepted, default %g\n", ACCURACY_TOLERANCE);
+  fprintf (stderr, "  -v   print every case that exceeds the tolerance\n");
+  fprintf (stderr, "Candidates:\n");
+  for (i=0; candidates[i].name != NULL; i++)
+    fprintf (stderr, "  %-10s %s\n", candidates[i].name, candidates[i].description);
+}
+
+
+int bench_accuracy (int argc, char **argv)
+{
+  const ACCURACY_PATH *path=NULL;
+  const char *name="engine", *output=NULL;
+  ACCURACY acc;
+  FILE *out=stdout;
+  void *state=NULL;
+  char lambda[128], args[512], worst[512]="", buffer[512], *cargv[ACCURACY_MAX_ARGS];
+  double *reference=NULL, *candidate=NULL, *lambdas=NULL;
+  double sza_step=10.0, o3_step=50.0, alt_step=1.5, tolerance=ACCURACY_TOLERANCE;
+  double first=290.0, last=400.0, step=1.0, sza=0.0, o3=0.0, alt=0.0, t0=0.0;
+  double max_rel=0.0, sum_rel=0.0, rel=0.0, speedup=0.0;
+  uint64_t seed=1;
+  long k=0;
+  int draws=1, verbose=0, pick[ACCURACY_AXES], cargc=0, c=0, a=0, d=0, i=0;
+  int s_ref=0, s_cand=0, exceeded=0, status=0;
+
+  while ((c = getopt (argc, argv, "R:c:P:a:o:z:r:S:w:t:O:vh")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg);               break;
+    case 'c': name = optarg;                              break;
+    case 'P': pack_path = optarg;                         break;
+    case 'a': sza_step = atof (optarg);                   break;
+    case 'o': o3_step = atof (optarg);                    break;
+    case 'z': alt_step = atof (optarg);                   break;
+    case 'r': draws = atoi (optarg);                      break;
+    case 'S': seed = strtoull (optarg, NULL, 0);          break;
+    case 't': tolerance = atof (optarg);                  break;
+    case 'O': output = optarg;                            break;
+    case 'v': verbose = 1;                                break;
+    case 'w':
+      if (sscanf (optarg, "%lf:%lf:%lf", &first, &last, &step) != 3)  {
+	usage ();
+	return 1;
+      }
+      break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  for (i=0; candidates[i].name != NULL; i++)
+    if (strcmp (candidates[i].name, name) == 0)
+      path = &candidates[i];
+
+  if (path == NULL || sza_step <= 0 || o3_step <= 0 || alt_step <= 0 || draws < 1 ||
+      step <= 0 || last < first)  {
+    usage ();
+    return 1;
+  }
+
+  memset (&acc, 0, sizeof(ACCURACY));
+  acc.n_lambda = (int) ((last - first) / step) + 1;
+  snprintf (lambda, sizeof(lambda), "-g %g -e %g -s %g", first, last, step);
+
+  reference     = (double *) calloc (acc.n_lambda, sizeof(double));
+  candidate     = (double *) calloc (acc.n_lambda, sizeof(double));
+  lambdas       = (double *) calloc (acc.n_lambda, sizeof(double));
+  acc.max_rel   = (double *) calloc (acc.n_lambda, sizeof(double));
+  acc.sum_rel   = (double *) calloc (acc.n_lambda, sizeof(double));
+  acc.worst     = (long *)   calloc (acc.n_lambda, sizeof(long));
+  for (a=0; a<ACCURACY_AXES; a++)
+    if ((acc.hits[a] = (long *) calloc (length (axes[a]), sizeof(long))) == NULL)
+      status = 1;
+
+  if (status != 0 || reference == NULL || candidate == NULL || lambdas == NULL ||
+      acc.max_rel == NULL || acc.sum_rel == NULL || acc.worst == NULL ||
+      (state = path->create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  for (i=0; i<acc.n_lambda; i++)  {
+    lambdas[i]   = first + i * step;
+    acc.worst[i] = -1;
+  }
+
+  for (sza=0.0; sza<=90.0+1e-9; sza+=sza_step)
+    for (o3=100.0; o3<=600.0+1e-9; o3+=o3_step)
+      for (alt=0.0; alt<=6.0+1e-9; alt+=alt_step)
+	for (d=0; d<draws; d++)  {
+	  k = acc.cases++;
+	  make_case (k, seed, sza, o3, alt, lambda, args, sizeof(args), pick);
+	  for (a=0; a<ACCURACY_AXES; a++)
+	    acc.hits[a][pick[a]]++;
+
+	  cargc = split_args (args, buffer, sizeof(buffer), cargv);
+	  t0 = bench_now ();
+	  s_ref = run_fastrt_ (cargc, cargv, reference);
+	  acc.seconds_reference += bench_now () - t0;
+
+	  cargc = split_args (args, buffer, sizeof(buffer), cargv);
+	  t0 = bench_now ();
+	  s_cand = path->run (state, cargc, cargv, candidate);
+	  acc.seconds_candidate += bench_now () - t0;
+
+	  if (s_ref != s_cand)  {
+	    acc.mismatched++;
+	    fprintf (stderr, "status %d, candidate %d: %s\n", s_ref, s_cand, args);
+	    continue;
+	  }
+	  if (s_ref < 0)  {
+	    acc.failed++;
+	    continue;
+	  }
+
+	  acc.compared++;
+	  rel = compare (&acc, k, reference, candidate);
+
+	  if (rel > max_rel || worst[0] == 0)  {
+	    max_rel = rel;
+	    snprintf (worst, sizeof(worst), "%s", args);
+	  }
+	  if (verbose && rel > tolerance)
+	    fprintf (stderr, "case %ld, relative error %.3e: %s\n", k, rel, args);
+	}
+
+  path->release (state);
+
+  for (i=0; i<acc.n_lambda; i++)  {
+    sum_rel += acc.sum_rel[i];
+    if (acc.max_rel[i] > tolerance)
+      exceeded++;
+  }
+  speedup = (acc.seconds_candidate > 0 ? acc.seconds_reference / acc.seconds_candidate : 0.0);
+
+  if (output != NULL && (out = fopen (output, "w")) == NULL)  {
+    fprintf (stderr, "Error, cannot open %s\n", output);
+    return 1;
+  }
+
+  fprintf (out, "{\n  \"benchmark\": \"accuracy\",\n  \"candidate\": \"%s\",\n", path->name);
+  fprintf (out, "  \"seed\": %llu,\n  \"tolerance\": %g,\n", (unsigned long long) seed,
+	   tolerance);
+  fprintf (out, "  \"cases\": %ld,\n  \"compared\": %ld,\n  \"failed_both\": %ld,\n",
+	   acc.cases, acc.compared, acc.failed);
+  fprintf (out, "  \"status_mismatches\": %ld,\n  \"nan_mismatches\": %ld,\n", acc.mismatched,
+	   acc.invalid);
+  fprintf (out, "  \"max_rel_error\": %.6e,\n  \"mean_rel_error\": %.6e,\n", max_rel,
+	   acc.compared > 0 ? sum_rel / acc.compared / acc.n_lambda : 0.0);
+  fprintf (out, "  \"reference_ms_per_case\": %.4f,\n  \"candidate_ms_per_case\": %.4f,\n",
+	   acc.seconds_reference / acc.cases * 1e3, acc.seconds_candidate / acc.cases * 1e3);
+  fprintf (out, "  \"worst_args\": \"%s\",\n", worst);
+  fprintf (out, "  \"speedup\": %.2f,\n", speedup);
+
+  fprintf (out, "  \"coverage\": [");
+  for (a=0; a<ACCURACY_AXES; a++)  {
+    fprintf (out, "%s\n    {", a == 0 ? "" : ",");
+    for (i=0; axes[a][i]!=NULL; i++)
+      fprintf (out, "%s \"%s\": %ld", i == 0 ? "" : ",", axes[a][i], acc.hits[a][i]);
+    fprintf (out, " }");
+  }
+  fprintf (out, "\n  ],\n");
+
+  fprintf (out, "  \"wavelengths\": [");
+  for (i=0; i<acc.n_lambda; i++)
+    fprintf (out, "%s\n    { \"lambda\": %g, \"max_rel\": %.6e, \"mean_rel\": %.6e, "
+	     "\"worst_case\": %ld }", i == 0 ? "" : ",", lambdas[i], acc.max_rel[i],
+	     acc.compared > 0 ? acc.sum_rel[i] / acc.compared : 0.0, acc.worst[i]);
+  fprintf (out, "\n  ]\n}\n");
+
+  if (out != stdout)
+    fclose (out);
+
+  fprintf (stderr, "%s: %ld cases, %ld compared, %ld failed in both, %ld status mismatches\n",
+	   path->name, acc.cases, acc.compared, acc.failed, acc.mismatched);
+  fprintf (stderr, "max relative error %.3e, %d wavelengths above %g, speedup %.2f\n",
+	   max_rel, exceeded, tolerance, speedup);
+
+  status = (acc.compared == 0 || acc.mismatched > 0 || acc.invalid > 0 || exceeded > 0);
+
+  for (a=0; a<ACCURACY_AXES; a++)
+    free (acc.hits[a]);
+  free (acc.max_rel);
+  free (acc.sum_rel);
+  free (acc.worst);
+  free (reference);
+  free (candidate);
+  free (lambdas);
+  return status;
+}
@@ -0,0 +1,89 @@
+/************************************************************************/
+/* bench_alloc.c                                                        */
+/*                                                                      */
+/* Count heap allocations of the whole process. With glibc, malloc(),   */
+/* calloc(), realloc() and posix_memalign() are replaced by wrappers    */
+/* around the glibc allocator, which glibc supports for the executable. */
+/* Elsewhere bench_allocations() returns -1.                            */
+/*                                                                      */
+/************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+
+#if defined (__GLIBC__)
+
+extern void *__libc_malloc   (size_t size);
+extern void *__libc_calloc   (size_t n, size_t size);
+extern void *__libc_realloc  (void *ptr, size_t size);
+extern void *__libc_memalign (size_t alignment, size_t size);
+extern void  __libc_free     (void *ptr);
+
+static long allocations = 0;
+
+
+static void count (void)
+{
+  __atomic_fetch_add (&allocations, 1, __ATOMIC_RELAXED);
+}
+
+
+void *malloc (size_t size)
+{
+  count ();
+  return __libc_malloc (size);
+}
+
+
+void *calloc (size_t n, size_t size)
+{
+  count ();
+  return __libc_calloc (n, size);
+}
+
+
+void *realloc (void *ptr, size_t size)
+{
+  count ();
+  return __libc_realloc (ptr, size);
+}
+
+
+int posix_memalign (void **ptr, size_t alignment, size_t size)
+{
+  void *p=NULL;
+
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+
+  count ();
+  if ((p = __libc_memalign (alignment, size)) == NULL)
+    return ENOMEM;
+
+  *ptr = p;
+  return 0;
+}
+
+
+void free (void *ptr)
+{
+  __libc_free (ptr);
+}
+
+
+long bench_allocations (void)
+{
+  return __atomic_load_n (&allocations, __ATOMIC_RELAXED);
+}
+
+#else
+
+long bench_allocations (void)
+{
+  return -1;
+}
+
+#endif
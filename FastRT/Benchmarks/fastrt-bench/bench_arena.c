@@ -0,0 +1,140 @@
+/************************************************************************/
+/* bench_arena.c                                                        */
+/*                                                                      */
+/* Check that warm requests do not touch the heap: every request is     */
+/* parsed once and computed with an engine until the tables and the     */
+/* arena of the thread are in place, then the heap calls of further     */
+/* fastrt_compute() calls are counted with the interposed allocator of  */
+/* bench_alloc.c and must be zero. The results must not change from     */
+/* call to call and must equal those of a call without engine.          */
+/*                                                                      */
+/* Exits with 1 if a check fails, so that it can run as a test.         */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FastRT.h"
+#include "bench.h"
+
+
+#define ARENA_MAX_LAMBDA  4096
+#define ARENA_WARMUP      2
+
+
+static const char *requests[] = {
+  "-a 45 -o 300 -w 310 -d 172",
+  "-a 45 -o 300 -g 290 -e 400 -s 1 -f 0.6 -d 172",
+  "-a 45 -o 300 -g 300 -e 320 -s 0.05 -f 0.05 -d 172",
+  "-a 32.5 -o 333 -z 1.7 -g 290 -e 400 -s 1",
+  "-a 45 -o 300 -u 10 -g 290 -e 400 -s 1",
+  "-a 45 -o 300 -c -u 90 -g 290 -e 400 -s 1",
+  "-a 45 -o 300 -p 0.3 -u 10 -g 290 -e 400 -s 1",
+  "-a 45 -o 300 -q 12 -g 290 -e 400 -s 1",
+  "-a 45 -o 300 -b 0.2 -g 290 -e 400 -s 1",
+  NULL
+};
+
+
+static int split_args (const char *args, char *buffer, size_t size, char **argv, int max)
+{
+  char *t=NULL;
+  int argc=0;
+
+  argv[argc++] = "fastrt";
+  snprintf (buffer, size, "%s", args);
+  for (t=strtok (buffer, " "); t!=NULL && argc<max-1; t=strtok (NULL, " "))
+    argv[argc++] = t;
+  argv[argc] = NULL;
+  return argc;
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench arena [-R resources] [-n calls]\n");
+}
+
+
+int bench_arena (int argc, char **argv)
+{
+  FASTRT_ENGINE *engine=NULL;
+  FASTRT_REQUEST req;
+  ARENA *arena=NULL;
+  char buffer[512], *args[32];
+  double *expected=NULL, *doserates=NULL;
+  long allocs0=0, allocs=0;
+  int calls=100, counted=0, failed=0, c=0, i=0, k=0, n=0, status=0;
+
+  while ((c = getopt (argc, argv, "R:n:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg); break;
+    case 'n': calls = atoi (optarg);        break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (calls < 1)  {
+    usage ();
+    return 1;
+  }
+
+  expected  = (double *) calloc (ARENA_MAX_LAMBDA, sizeof(double));
+  doserates = (double *) calloc (ARENA_MAX_LAMBDA, sizeof(double));
+  if (expected == NULL || doserates == NULL || (engine = fastrt_engine_create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  counted = (bench_allocations () >= 0);
+  if (!counted)
+    fprintf (stderr, "Heap calls are not counted on this platform, checking results only\n");
+
+  for (i=0; requests[i]!=NULL; i++)  {
+    fastrt_request_init (&req);
+    n = split_args (requests[i], buffer, sizeof(buffer), args, 32);
+
+    if ((status = fastrt_parse_request (n, args, &req)) != 0 ||
+        req.n_lambda > ARENA_MAX_LAMBDA ||
+        (status = fastrt_compute (NULL, &req, expected)) < 0)  {
+      fprintf (stderr, "Error %d in request %s\n", status, requests[i]);
+      fastrt_request_free (&req);
+      failed++;
+      continue;
+    }
+
+    for (k=0; k<ARENA_WARMUP; k++)
+      fastrt_compute (engine, &req, doserates);
+
+    allocs0 = bench_allocations ();
+    for (k=0; k<calls && status>=0; k++)  {
+      status = fastrt_compute (engine, &req, doserates);
+      if (memcmp (doserates, expected, req.n_lambda * sizeof(double)) != 0)
+        status = -1;
+    }
+    allocs = (counted ? bench_allocations () - allocs0 : 0);
+
+    arena = arena_thread ();
+    fprintf (stderr, "%-50s %s  %ld heap calls in %d calls, arena %zu bytes\n", requests[i],
+             (status < 0 || allocs != 0) ? "FAIL" : "ok  ", allocs, calls,
+             arena != NULL ? arena->peak : 0);
+
+    if (status < 0 || allocs != 0)
+      failed++;
+
+    fastrt_request_free (&req);
+  }
+
+  fprintf (stderr, "%d of %d requests failed\n", failed, i);
+
+  fastrt_engine_free (engine);
+  free (expected);
+  free (doserates);
+  return (failed > 0 ? 1 : 0);
+}
@@ -0,0 +1,155 @@
+/************************************************************************/
+/* bench_climatology.c                                                  */
+/*                                                                      */
+/* Scaling of climatology_run() with the number of threads: the same    */
+/* workload is run with 1, 2, 4, ... threads up to -t, all sharing one  */
+/* engine whose tables are read by a warm-up run before timing. The     */
+/* records go to -o, or to a temporary file in $TMPDIR (or /tmp) which  */
+/* is removed after the last run.                                       */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "climatology.h"
+#include "bench.h"
+
+
+/* a new temporary file for the records in path, -1 if none */
+static int temporary_output (char *path, size_t size)
+{
+  const char *dir = getenv ("TMPDIR");
+  int fd=0;
+
+  if (dir == NULL || dir[0] == '\0')
+    dir = "/tmp";
+  snprintf (path, size, "%s/fastrt-bench-climatology-XXXXXX", dir);
+  if ((fd = mkstemp (path)) < 0)
+    return -1;
+  close (fd);
+  return 0;
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench climatology [-R resources] [-n sites] [-f first_day]\n");
+  fprintf (stderr, "         [-l last_day] [-s sky_mask] [-t max_threads] [-o output]\n");
+}
+
+
+int bench_climatology (int argc, char **argv)
+{
+  CLIM_SPEC spec;
+  CLIM_STATS stats;
+  CLIM_SITE *sites=NULL;
+  FASTRT_ENGINE *engine=NULL;
+  const char *output=NULL;
+  char temporary[FILENAME_MAX]="";
+  double base=0.0;
+  int n_sites=8, max_threads=0, threads=0, c=0, i=0, status=0;
+
+  climatology_spec_init (&spec);
+  spec.first_day = 172;
+  spec.last_day  = 178;
+  spec.block     = 16;
+
+  while ((c = getopt (argc, argv, "R:n:f:l:s:t:o:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg);                   break;
+    case 'n': n_sites = atoi (optarg);                        break;
+    case 'f': spec.first_day = atoi (optarg);                 break;
+    case 'l': spec.last_day  = atoi (optarg);                 break;
+    case 's': spec.sky_mask  = (int) strtol (optarg, NULL, 0); break;
+    case 't': max_threads = atoi (optarg);                    break;
+    case 'o': output = optarg;                                break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (max_threads < 1)
+    max_threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  if (n_sites < 1 || max_threads < 1)  {
+    usage ();
+    return 1;
+  }
+  if (output == NULL)  {
+    if (temporary_output (temporary, sizeof(temporary)) != 0)  {
+      fprintf (stderr, "Error, cannot create a temporary file for the records\n");
+      return 1;
+    }
+    output = temporary;
+  }
+
+  /* sites from the tropics to the arctic, at up to 3 km */
+  if ((sites = (CLIM_SITE *) calloc (n_sites, sizeof(CLIM_SITE))) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    if (temporary[0] != '\0')
+      unlink (temporary);
+    return 1;
+  }
+  for (i=0; i<n_sites; i++)  {
+    sites[i].latitude  = -10.0 + 80.0 * i / n_sites;
+    sites[i].longitude = -120.0 + 37.0 * i;
+    sites[i].altitude  = 1.5 + 1.5 * sin (0.7 * i);
+  }
+
+  spec.sites   = sites;
+  spec.n_sites = n_sites;
+  spec.output  = output;
+
+  if ((engine = fastrt_engine_create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    free (sites);
+    if (temporary[0] != '\0')
+      unlink (temporary);
+    return 1;
+  }
+
+  /* warm-up, reads the tables */
+  spec.n_threads = max_threads;
+  spec.max_items = n_sites;
+  if ((status = climatology_run (engine, &spec, &stats)) != 0)  {
+    fprintf (stderr, "Error %d from climatology_run()\n", status);
+    fastrt_engine_free (engine);
+    free (sites);
+    if (temporary[0] != '\0')
+      unlink (temporary);
+    return 1;
+  }
+  spec.max_items = 0;
+
+  printf ("climatology %d sites x %d days, sky mask 0x%x, warm-up %.3f s\n", n_sites,
+	  spec.last_day - spec.first_day + 1, spec.sky_mask, stats.seconds);
+  printf ("%8s %10s %12s %8s %10s\n", "threads", "seconds", "records/s", "speedup", "efficiency");
+
+  for (threads=1; ; threads = (2*threads > max_threads && threads < max_threads ?
+			       max_threads : 2*threads))  {
+    spec.n_threads = threads;
+    if ((status = climatology_run (engine, &spec, &stats)) != 0)  {
+      fprintf (stderr, "Error %d from climatology_run()\n", status);
+      break;
+    }
+    if (threads == 1)
+      base = stats.seconds;
+
+    printf ("%8d %10.3f %12.1f %8.2f %9.0f%%\n", threads, stats.seconds,
+	    stats.records / stats.seconds, base / stats.seconds,
+	    100.0 * base / stats.seconds / threads);
+
+    if (threads >= max_threads)
+      break;
+  }
+
+  fastrt_engine_free (engine);
+  free (sites);
+  if (temporary[0] != '\0')
+    unlink (temporary);
+  return (status != 0 ? 1 : 0);
+}
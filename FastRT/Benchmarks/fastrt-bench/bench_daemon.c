@@ -0,0 +1,367 @@
+/************************************************************************/
+/* bench_daemon.c                                                       */
+/*                                                                      */
+/* Load generator for the dose query server of server.h. Every client   */
+/* is a thread with its own connection that keeps -d requests in        */
+/* flight; a request is timed from its send to its reply. Without -S a  */
+/* server is started in this process on a temporary socket, with -S    */
+/* the running fastrt-daemon at that socket is loaded.                  */
+/*                                                                      */
+/* The requests are drawn from a fixed sequence of locations, days and  */
+/* times, so that runs can be compared. The first replies of every      */
+/* client are checked against server_evaluate() in this process, and    */
+/* the replies must come back in the order of the requests. Throughput */
+/* and latency percentiles are written as JSON, to stdout or to -o.     */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FastRT.h"
+#include "dose.h"
+#include "server.h"
+#include "bench.h"
+
+
+#define DAEMON_CHECKED   8       /* replies per client checked against server_evaluate() */
+
+
+/* mixes of request kinds, in percent of SPECTRUM, DOSE, DAY, TIME_TO_DOSE */
+typedef struct {
+  const char *name;
+  int         percent[4];
+} DAEMON_MIX;
+
+static const DAEMON_MIX mixes[] = {
+  { "mixed",    { 20, 70, 3, 7 } },
+  { "spectrum", { 100, 0, 0, 0 } },
+  { "dose",     { 0, 100, 0, 0 } },
+  { "day",      { 0, 0, 100, 0 } },
+  { "ttd",      { 0, 0, 0, 100 } },
+  { NULL,       { 0, 0, 0, 0 } }
+};
+
+
+typedef struct {
+  const char       *path;
+  const DAEMON_MIX *mix;
+  FASTRT_ENGINE    *engine;      /* for the checks                  */
+  int               id;
+  int               n;           /* requests                        */
+  int               depth;       /* requests in flight              */
+  double           *latency;     /* n, seconds                      */
+  long              failed;      /* status < 0                      */
+  long              mismatched;  /* wrong order or values           */
+  int               status;      /* connection or protocol error    */
+  int               running;     /* thread started                  */
+} DAEMON_CLIENT;
+
+typedef struct {
+  SERVER_SPEC           spec;
+  SERVER_STATS          stats;
+  FASTRT_ENGINE        *engine;
+  volatile sig_atomic_t stop;
+  int                   status;
+} DAEMON_SERVER;
+
+
+static uint64_t mix64 (uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+
+/* request i of a client */
+static void make_request (const DAEMON_MIX *mix, int client, int i, SERVER_REQUEST *request)
+{
+  uint64_t h = mix64 ((uint64_t) client << 32 | (uint32_t) i);
+  int pick = (int) (h % 100), kind=0, sum=0;
+
+  for (kind=0; kind<3; kind++)  {
+    sum += mix->percent[kind];
+    if (pick < sum)
+      break;
+  }
+
+  memset (request, 0, sizeof(SERVER_REQUEST));
+  request->magic     = SERVER_MAGIC;
+  request->id        = (uint32_t) i;
+  request->kind      = SERVER_SPECTRUM + kind;
+  request->latitude  = (double) ((h >> 8) % 1201) / 10.0 - 60.0;
+  request->longitude = (double) ((h >> 20) % 3601) / 10.0 - 180.0;
+  request->altitude  = (double) ((h >> 32) % 31) / 10.0;
+  request->day       = 1 + (int) ((h >> 40) % 365);
+  request->sky       = (int) ((h >> 50) % 4);
+  request->seconds   = (int) ((h >> 12) % 86400);
+  request->action    = (int) ((h >> 54) % 2);
+  request->dose      = 50.0 + (double) ((h >> 56) % 200);
+  request->step      = SERVER_STEP;
+}
+
+
+static void *run_client (void *arg)
+{
+  DAEMON_CLIENT *client = (DAEMON_CLIENT *) arg;
+  SERVER_REQUEST request;
+  SERVER_REPLY reply, expected;
+  double *sent=NULL, *values=NULL, *local=NULL;
+  int fd=-1, next=0, received=0;
+
+  sent   = (double *) calloc (client->n, sizeof(double));
+  values = (double *) calloc (SERVER_MAX_VALUES, sizeof(double));
+  local  = (double *) calloc (SERVER_MAX_VALUES, sizeof(double));
+  if (sent == NULL || values == NULL || local == NULL ||
+      (fd = server_connect (client->path)) < 0)  {
+    client->status = -1;
+    goto done;
+  }
+
+  while (received < client->n)  {
+    /* keep the pipeline full */
+    while (next < client->n && next - received < client->depth)  {
+      make_request (client->mix, client->id, next, &request);
+      sent[next] = bench_now ();
+      if (server_send (fd, &request) != 0)  {
+	client->status = -1;
+	goto done;
+      }
+      next++;
+    }
+
+    if (server_receive (fd, &reply, values, SERVER_MAX_VALUES) != 0)  {
+      client->status = -1;
+      goto done;
+    }
+    if (reply.id != (uint32_t) received)  {
+      client->mismatched++;
+      client->status = -1;
+      goto done;
+    }
+    client->latency[received] = bench_now () - sent[received];
+    if (reply.status < 0)
+      client->failed++;
+
+    if (received < DAEMON_CHECKED)  {
+      make_request (client->mix, client->id, received, &request);
+      server_evaluate (client->engine, &request, &expected, local);
+      if (expected.status != reply.status || expected.n != reply.n ||
+	  memcmp (local, values, reply.n * sizeof(double)) != 0)
+	client->mismatched++;
+    }
+    received++;
+  }
+
+ done:
+  if (fd >= 0)
+    close (fd);
+  free (sent);
+  free (values);
+  free (local);
+  return NULL;
+}
+
+
+static void *run_server (void *arg)
+{
+  DAEMON_SERVER *server = (DAEMON_SERVER *) arg;
+
+  server->status = server_run (server->engine, &server->spec, &server->stats);
+  return NULL;
+}
+
+
+static int compare_doubles (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+
+/* nearest rank percentile of sorted values */
+static double percentile (const double *sorted, long n, double p)
+{
+  long k = (long) ceil (p / 100.0 * n) - 1;
+
+  if (k < 0)
+    k = 0;
+  if (k >= n)
+    k = n-1;
+  return sorted[k];
+}
+
+
+static void usage (void)
+{
+  int i=0;
+
+  fprintf (stderr, "Usage: fastrt-bench daemon [-R resources] [-S socket] [-c clients] [-d depth]\n");
+  fprintf (stderr, "         [-n requests] [-k mix] [-o output.json]\n");
+  fprintf (stderr, "  -S   load the fastrt-daemon at socket, else start a server here\n");
+  fprintf (stderr, "  -n   requests per client\n");
+  fprintf (stderr, "Mixes:");
+  for (i=0; mixes[i].name != NULL; i++)
+    fprintf (stderr, " %s", mixes[i].name);
+  fprintf (stderr, "\n");
+}
+
+
+int bench_daemon (int argc, char **argv)
+{
+  const DAEMON_MIX *mix=mixes;
+  DAEMON_SERVER server;
+  DAEMON_CLIENT *clients=NULL;
+  FASTRT_ENGINE *engine=NULL;
+  pthread_t *threads=NULL, server_thread;
+  FILE *out=stdout;
+  char path[108];
+  const char *address=NULL, *output=NULL, *kind=NULL;
+  double *latency=NULL, t0=0.0, seconds=0.0, sum=0.0;
+  long total=0, failed=0, mismatched=0, k=0;
+  int n_clients=4, depth=16, n=500, started=0, c=0, i=0, j=0, status=0;
+
+  while ((c = getopt (argc, argv, "R:S:c:d:n:k:o:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg); break;
+    case 'S': address = optarg;             break;
+    case 'c': n_clients = atoi (optarg);    break;
+    case 'd': depth = atoi (optarg);        break;
+    case 'n': n = atoi (optarg);            break;
+    case 'k': kind = optarg;                break;
+    case 'o': output = optarg;              break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (kind != NULL)
+    for (mix=mixes; mix->name!=NULL && strcmp (mix->name, kind) != 0; mix++)
+      ;
+
+  if (mix->name == NULL || n_clients < 1 || depth < 1 || n < 1)  {
+    usage ();
+    return 1;
+  }
+
+  signal (SIGPIPE, SIG_IGN);
+
+  clients = (DAEMON_CLIENT *) calloc (n_clients, sizeof(DAEMON_CLIENT));
+  threads = (pthread_t *) calloc (n_clients, sizeof(pthread_t));
+  latency = (double *) calloc ((size_t) n_clients * n, sizeof(double));
+  if (clients == NULL || threads == NULL || latency == NULL ||
+      (engine = fastrt_engine_create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  /* a server in this process */
+  memset (&server, 0, sizeof(DAEMON_SERVER));
+  if (address == NULL)  {
+    snprintf (path, sizeof(path), "/tmp/fastrt-bench-%d.sock", (int) getpid ());
+    address = path;
+
+    server_spec_init (&server.spec);
+    server.spec.path = path;
+    server.spec.stop = &server.stop;
+    server.spec.max_clients = n_clients;
+    if ((server.engine = fastrt_engine_create ()) == NULL ||
+	pthread_create (&server_thread, NULL, run_server, &server) != 0)  {
+      fprintf (stderr, "Error, cannot start the server\n");
+      return 1;
+    }
+    started = 1;
+
+    /* wait for the socket */
+    for (i=0; i<100 && access (path, F_OK) != 0; i++)
+      usleep (10000);
+  }
+
+  t0 = bench_now ();
+  for (i=0; i<n_clients; i++)  {
+    clients[i].path    = address;
+    clients[i].mix     = mix;
+    clients[i].engine  = engine;
+    clients[i].id      = i;
+    clients[i].n       = n;
+    clients[i].depth   = depth;
+    clients[i].latency = latency + (size_t) i * n;
+    if (pthread_create (&threads[i], NULL, run_client, &clients[i]) == 0)
+      clients[i].running = 1;
+    else
+      clients[i].status = -1;
+  }
+  for (i=0; i<n_clients; i++)
+    if (clients[i].running)
+      pthread_join (threads[i], NULL);
+  seconds = bench_now () - t0;
+
+  if (started)  {
+    __atomic_store_n (&server.stop, 1, __ATOMIC_RELAXED);
+    pthread_join (server_thread, NULL);
+  }
+
+  for (i=0; i<n_clients; i++)  {
+    if (clients[i].status != 0)  {
+      fprintf (stderr, "Error in client %d\n", i);
+      status = 1;
+    }
+    failed     += clients[i].failed;
+    mismatched += clients[i].mismatched;
+    for (j=0; j<n; j++)
+      if (clients[i].latency[j] > 0.0)  {
+	latency[k++] = clients[i].latency[j];
+	sum += clients[i].latency[j];
+      }
+  }
+  total = k;
+
+  if (total == 0)  {
+    fprintf (stderr, "Error, no replies from %s\n", address);
+    return 1;
+  }
+  qsort (latency, total, sizeof(double), compare_doubles);
+
+  if (output != NULL && (out = fopen (output, "w")) == NULL)  {
+    fprintf (stderr, "Error, cannot open %s\n", output);
+    return 1;
+  }
+
+  fprintf (out, "{\n  \"benchmark\": \"daemon\",\n  \"server\": \"%s\",\n  \"mix\": \"%s\",\n",
+	   started ? "in-process" : address, mix->name);
+  fprintf (out, "  \"clients\": %d,\n  \"depth\": %d,\n  \"requests\": %ld,\n", n_clients,
+	   depth, total);
+  fprintf (out, "  \"failed\": %ld,\n  \"mismatched\": %ld,\n", failed, mismatched);
+  fprintf (out, "  \"seconds\": %.3f,\n  \"requests_per_second\": %.1f,\n", seconds,
+	   total / seconds);
+  fprintf (out, "  \"latency_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, "
+	   "\"p999\": %.4f, \"max\": %.4f }\n}\n", sum / total * 1e3,
+	   percentile (latency, total, 50) * 1e3, percentile (latency, total, 90) * 1e3,
+	   percentile (latency, total, 99) * 1e3, percentile (latency, total, 99.9) * 1e3,
+	   latency[total-1] * 1e3);
+
+  if (out != stdout)
+    fclose (out);
+
+  if (mismatched > 0)  {
+    fprintf (stderr, "%ld replies differ from server_evaluate() or are out of order\n",
+	     mismatched);
+    status = 1;
+  }
+
+  fastrt_engine_free (engine);
+  fastrt_engine_free (server.engine);
+  free (clients);
+  free (threads);
+  free (latency);
+  return status;
+}
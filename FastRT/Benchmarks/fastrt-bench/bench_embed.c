@@ -0,0 +1,278 @@
+/************************************************************************/
+/* bench_embed.c                                                        */
+/*                                                                      */
+/* Time to the first result of a new engine on a pack: the engine is    */
+/* created, its pack opened and one request at noon of the day of the   */
+/* app is computed, n times, for                                        */
+/*                                                                      */
+/*   file      the pack file -P, pack_open(), after its pages have      */
+/*             been dropped from the page cache (cold) or not (warm),   */
+/*   memory    the same pack read into memory beforehand,               */
+/*             pack_open_memory(), as a loader of its own would,        */
+/*   embedded  the pack linked into the binary by FastRTEmbedded, if    */
+/*             any, see fastrt_embedded.h.                              */
+/*                                                                      */
+/* Without -P, the pack is built from the tables into a temporary file. */
+/* files counts the files opened per run, the pack included. The        */
+/* results must be the same for all of them; the embedded pack only    */
+/* if it is the same as -P. Exits with 1 if a check fails.              */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "FastRT.h"
+#include "ascii.h"
+#include "pack.h"
+#include "fastrt_embedded.h"
+#include "bench.h"
+
+
+#define EMBED_START   290
+#define EMBED_END     400
+#define EMBED_LAMBDA  (EMBED_END - EMBED_START + 1)
+#define EMBED_COLD    0
+#define EMBED_WARM    1
+#define EMBED_MEMORY  2
+#define EMBED_LINKED  3
+
+typedef struct {
+  const char *name;
+  double *times;        /* to the first result, per run [s] */
+  long    files;        /* opened by all runs               */
+  int     failed;
+  double  values[EMBED_LAMBDA];
+} EMBED_RUN;
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench embed [-R resources] [-P pack] [-n runs] [-d day]\n");
+  fprintf (stderr, "         [-a latitude] [-l longitude] [-z altitude]\n");
+}
+
+
+static int compare_doubles (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+
+/* drop the pages of a file from the page cache */
+static void drop_cache (const char *path)
+{
+  int fd=-1;
+
+  if ((fd = open (path, O_RDONLY)) < 0)
+    return;
+  fdatasync (fd);
+  posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+  close (fd);
+}
+
+
+/* the pack file in page aligned memory */
+static unsigned char *read_pack (const char *path, size_t *size)
+{
+  unsigned char *data=NULL;
+  FILE *f=NULL;
+  long n=0;
+
+  if ((f = fopen (path, "rb")) == NULL)
+    return NULL;
+  if (fseek (f, 0, SEEK_END) != 0 || (n = ftell (f)) <= 0 || fseek (f, 0, SEEK_SET) != 0 ||
+      posix_memalign ((void **) &data, 16384, (size_t) n) != 0)  {
+    fclose (f);
+    return NULL;
+  }
+  if (fread (data, 1, (size_t) n, f) != (size_t) n)  {
+    free (data);
+    data = NULL;
+  }
+  fclose (f);
+  *size = (size_t) n;
+  return data;
+}
+
+
+/* one engine from scratch to its first result */
+static double first_result (int kind, const char *pack, const unsigned char *data, size_t size,
+			    int day, double latitude, double longitude, double altitude,
+			    int time, EMBED_RUN *run)
+{
+  FASTRT_ENGINE *engine=NULL;
+  double t0=0.0, t=0.0;
+  long files0=0, files=0;
+  int status=0;
+
+  if (kind == EMBED_COLD)
+    drop_cache (pack);
+
+  ASCII_get_counters (&files0, NULL);
+  t0 = bench_now ();
+  if ((engine = fastrt_engine_create ()) == NULL)
+    return -1.0;
+  switch (kind)  {
+  case EMBED_COLD:
+  case EMBED_WARM:
+    status = fastrt_engine_open_pack (engine, pack);
+    run->files++;
+    break;
+  case EMBED_MEMORY:
+    status = fastrt_engine_open_pack_memory (engine, data, size);
+    break;
+  case EMBED_LINKED:
+    status = fastrt_engine_open_embedded_pack (engine);
+    break;
+  }
+  if (status == 0)
+    status = run_fastrt_with_engine (engine, run->values, EMBED_START, EMBED_END, 1.0, day,
+				     latitude, longitude, altitude, time, 0, true);
+  t = bench_now () - t0;
+  ASCII_get_counters (&files, NULL);
+
+  run->files += files - files0;
+  if (status < 0)
+    run->failed++;
+  fastrt_engine_free (engine);
+  return t;
+}
+
+
+int bench_embed (int argc, char **argv)
+{
+  PACK_SPEC spec;
+  EMBED_RUN runs[4];
+  DAYLIGHT_WINDOW window;
+  const char *resources=NULL, *pack=NULL;
+  char built[FILENAME_MAX];
+  unsigned char *data=NULL;
+  double latitude=47.0, longitude=11.0, altitude=0.6, *sorted=NULL;
+  int day=172, n=20, noon=0, n_kinds=4, c=0, k=0, i=0, fd=-1, failed=0;
+  size_t size=0;
+
+  resources = getenv ("FASTRT_RESOURCES");
+  built[0] = 0;
+  while ((c = getopt (argc, argv, "R:P:n:d:a:l:z:h")) != -1)  {
+    switch (c)  {
+    case 'R': resources = optarg;            break;
+    case 'P': pack = optarg;                 break;
+    case 'n': n = atoi (optarg);             break;
+    case 'd': day = atoi (optarg);           break;
+    case 'a': latitude = atof (optarg);      break;
+    case 'l': longitude = atof (optarg);     break;
+    case 'z': altitude = atof (optarg);      break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+  if (resources == NULL)
+    resources = ".";
+  bench_set_resources (resources);
+
+  if (n < 1 || daylight_window (day, latitude, -longitude, &window) != 0 ||
+      window.type == DAYLIGHT_POLAR_NIGHT)  {
+    usage ();
+    return 1;
+  }
+  noon = (window.type == DAYLIGHT_POLAR_DAY ? 43200 : (window.sunrise + window.sunset) / 2);
+
+  if (pack == NULL)  {
+    snprintf (built, sizeof(built), "/tmp/fastrt-embed-XXXXXX");
+    if ((fd = mkstemp (built)) < 0)  {
+      fprintf (stderr, "Error, cannot create a pack in /tmp\n");
+      return 1;
+    }
+    close (fd);
+    pack_spec_init (&spec);
+    spec.resources = resources;
+    spec.output    = built;
+    if (pack_run (&spec, NULL) != 0)  {
+      fprintf (stderr, "Error, cannot build a pack of %s\n", resources);
+      unlink (built);
+      return 1;
+    }
+    pack = built;
+  }
+
+  if ((data = read_pack (pack, &size)) == NULL)  {
+    fprintf (stderr, "Error, cannot read %s\n", pack);
+    if (built[0] != 0)
+      unlink (built);
+    return 1;
+  }
+
+  memset (runs, 0, sizeof(runs));
+  runs[EMBED_COLD].name   = "file, cold";
+  runs[EMBED_WARM].name   = "file, warm";
+  runs[EMBED_MEMORY].name = "memory";
+  runs[EMBED_LINKED].name = "embedded";
+  if (fastrt_pack_size == 0)
+    n_kinds = 3;
+
+  for (k=0; k<n_kinds; k++)
+    if ((runs[k].times = (double *) calloc (n, sizeof(double))) == NULL)  {
+      fprintf (stderr, "Error, out of memory\n");
+      return 1;
+    }
+  if ((sorted = (double *) calloc (n, sizeof(double))) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  /* the kinds in turn, so that all see the same state of the machine */
+  for (i=0; i<n; i++)
+    for (k=0; k<n_kinds; k++)
+      runs[k].times[i] = first_result (k, pack, data, size, day, latitude, longitude,
+				       altitude, noon, &runs[k]);
+
+  printf ("pack %s, %.2f MB; embedded pack %.2f MB\n", pack, size / 1048576.0,
+	  fastrt_pack_size / 1048576.0);
+  printf ("day %d at %.2f %.2f, %.1f km, noon: %d runs\n", day, latitude, longitude,
+	  altitude, n);
+  printf ("%-12s %12s %12s %12s %10s\n", "pack", "min [ms]", "median [ms]", "max [ms]", "files");
+  for (k=0; k<n_kinds; k++)  {
+    memcpy (sorted, runs[k].times, n * sizeof(double));
+    qsort (sorted, n, sizeof(double), compare_doubles);
+    printf ("%-12s %12.3f %12.3f %12.3f %10.1f\n", runs[k].name, sorted[0] * 1e3,
+	    sorted[n/2] * 1e3, sorted[n-1] * 1e3, (double) runs[k].files / n);
+  }
+  if (fastrt_pack_size == 0)
+    printf ("no pack embedded, see fastrt_embedded.h\n");
+
+  for (k=0; k<n_kinds; k++)
+    if (runs[k].failed > 0)  {
+      fprintf (stderr, "FAIL: %d requests failed on the %s pack\n", runs[k].failed,
+	       runs[k].name);
+      failed++;
+    }
+  for (k=1; k<3; k++)
+    if (memcmp (runs[0].values, runs[k].values, sizeof(runs[0].values)) != 0)  {
+      fprintf (stderr, "FAIL: the results of the %s pack differ\n", runs[k].name);
+      failed++;
+    }
+  if (n_kinds == 4 && fastrt_pack_size == size &&
+      memcmp (fastrt_pack_data, data, size) == 0 &&
+      memcmp (runs[0].values, runs[EMBED_LINKED].values, sizeof(runs[0].values)) != 0)  {
+    fprintf (stderr, "FAIL: the results of the embedded pack differ\n");
+    failed++;
+  }
+  if (runs[EMBED_MEMORY].files > 0 || (n_kinds == 4 && runs[EMBED_LINKED].files > 0))  {
+    fprintf (stderr, "FAIL: files opened without a pack file\n");
+    failed++;
+  }
+
+  for (k=0; k<n_kinds; k++)
+    free (runs[k].times);
+  free (sorted);
+  free (data);
+  if (built[0] != 0)
+    unlink (built);
+  return (failed > 0 ? 1 : 0);
+}
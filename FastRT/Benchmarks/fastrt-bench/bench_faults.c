@@ -0,0 +1,330 @@
+/************************************************************************/
+/* bench_faults.c                                                       */
+/*                                                                      */
+/* Page faults of a cold engine on its pack, per order of the pack and  */
+/* advice of fastrt_engine_advise_pack(): the day of the app, as in     */
+/* bench_preload.c, is computed once from the tables, with a trace of   */
+/* the tables read, and the tables are packed in every order of         */
+/* pack.h, the trace order from that trace. Then, for every pack and    */
+/* advice, the pack is dropped from the page cache and the day is       */
+/* computed by a new engine on it.                                      */
+/*                                                                      */
+/* faults counts the minor and major page faults of the process during  */
+/* the day, including those of the advice, per request; resident is    */
+/* the part of the pack in the page cache afterwards, which read ahead  */
+/* drives up. pages are the pages of the pack that the tables of the    */
+/* trace need, see pack_span(), which is what the order saves with any  */
+/* read ahead. The faults of the run on the tables are those of the     */
+/* heap of the engine alone. The packs are written to a new directory   */
+/* below -D, default /tmp, and removed.                                 */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "FastRT.h"
+#include "ascii.h"
+#include "pack.h"
+#include "bench.h"
+
+
+#define FAULTS_START   290
+#define FAULTS_END     400
+#define FAULTS_LAMBDA  (FAULTS_END - FAULTS_START + 1)
+
+typedef struct {
+  double seconds;       /* whole day, with the advice            */
+  double first;         /* first daylit request                  */
+  long   minor;         /* page faults                           */
+  long   major;
+  double resident;      /* part of the pack in memory afterwards */
+} FAULTS_RUN;
+
+static const char *order_names[]  = { "ozone", "sza", "morton", "trace" };
+static const char *advice_names[] = { "normal", "sequential", "random", "populate" };
+
+#define N_ORDERS  ((int) (sizeof(order_names) / sizeof(order_names[0])))
+#define N_ADVICE  ((int) (sizeof(advice_names) / sizeof(advice_names[0])))
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench faults [-R resources] [-d day] [-a latitude]\n");
+  fprintf (stderr, "         [-l longitude] [-z altitude] [-s step] [-D directory]\n");
+}
+
+
+static void faults (long *minor, long *major)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  *minor = usage.ru_minflt;
+  *major = usage.ru_majflt;
+}
+
+
+/* drop the pages of a file from the page cache; dirty pages stay, so the */
+/* pack just written is synced first                                       */
+static void drop_cache (const char *path)
+{
+  int fd=-1;
+
+  if ((fd = open (path, O_RDONLY)) < 0)
+    return;
+  fdatasync (fd);
+  posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+  close (fd);
+}
+
+
+/* the part of the pages of the pack in memory */
+static double resident (const TABLE_PACK *pack)
+{
+  unsigned char *vec=NULL;
+  size_t page=(size_t) sysconf (_SC_PAGESIZE), n=0, i=0, in=0;
+
+  if (pack == NULL)
+    return 0.0;
+  n = (pack->size + page - 1) / page;
+  if ((vec = (unsigned char *) calloc (n, 1)) == NULL ||
+      mincore ((void *) pack->base, pack->size, vec) != 0)  {
+    free (vec);
+    return -1.0;
+  }
+  for (i=0; i<n; i++)
+    in += (vec[i] & 1);
+  free (vec);
+  return (double) in / n;
+}
+
+
+/* the pages of a pack the tables of a trace need, -1 if error */
+static long trace_pages (const char *path, const char *trace)
+{
+  TABLE_PACK *pack=NULL;
+  FILE *f=NULL;
+  unsigned char *used=NULL;
+  char line[FILENAME_MAX+256];
+  uint64_t offset=0, length=0, page=(uint64_t) sysconf (_SC_PAGESIZE), p=0;
+  long n=0;
+  int entry=0;
+
+  if ((pack = pack_open (path)) == NULL)
+    return -1;
+  if ((f = fopen (trace, "r")) == NULL ||
+      (used = (unsigned char *) calloc (pack->size / page + 1, 1)) == NULL)  {
+    if (f != NULL)
+      fclose (f);
+    pack_close (pack);
+    return -1;
+  }
+
+  while (fgets (line, sizeof(line), f) != NULL)  {
+    line[strcspn (line, "\r\n")] = 0;
+    if ((entry = pack_find (pack, line)) < 0 || pack_span (pack, entry, &offset, &length) != 0)
+      continue;
+    for (p=offset/page; length > 0 && p<=(offset + length - 1)/page; p++)
+      if (!used[p])  {
+	used[p] = 1;
+	n++;
+      }
+  }
+
+  fclose (f);
+  free (used);
+  pack_close (pack);
+  return n;
+}
+
+
+/* the day from sunrise to sunset with a new engine, on pack unless NULL, */
+/* with advice; results into values, n_steps x 4 x FAULTS_LAMBDA          */
+static int run_day (const char *pack, int advice, FILE *trace, int day, double latitude,
+		    double longitude, double altitude, int sunrise, int n_steps, int step,
+		    double *values, FAULTS_RUN *run)
+{
+  FASTRT_ENGINE *engine=NULL;
+  double t0=0.0, t=0.0;
+  long minor0=0, major0=0;
+  int i=0, sky=0, status=0, failed=0;
+
+  if ((engine = fastrt_engine_create ()) == NULL)
+    return -1;
+  if (pack != NULL && fastrt_engine_open_pack (engine, pack) != 0)  {
+    fastrt_engine_free (engine);
+    return -1;
+  }
+  tablestore_set_trace (engine->store, trace);
+
+  faults (&minor0, &major0);
+  t0 = bench_now ();
+  if (pack != NULL && fastrt_engine_advise_pack (engine, advice) != 0)
+    failed++;
+  for (i=0; i<n_steps; i++)
+    for (sky=0; sky<4; sky++)  {
+      t = bench_now ();
+      status = run_fastrt_with_engine (engine, values + (i*4 + sky) * FAULTS_LAMBDA,
+				       FAULTS_START, FAULTS_END, 1.0, day, latitude,
+				       longitude, altitude, sunrise + i*step, sky, true);
+      /* before the sun is up, status 1, no table is read */
+      if (status == 0 && run->first == 0.0)
+	run->first = bench_now () - t;
+      if (status < 0)
+	failed++;
+    }
+  run->seconds = bench_now () - t0;
+  faults (&run->minor, &run->major);
+  run->minor -= minor0;
+  run->major -= major0;
+  run->resident = resident (engine->pack);
+
+  tablestore_set_trace (engine->store, NULL);
+  fastrt_engine_free (engine);
+  return failed;
+}
+
+
+/* largest relative difference of the doserates above 1e-10 */
+static double max_difference (const double *a, const double *b, size_t n)
+{
+  double d=0.0, max=0.0;
+  size_t i=0;
+
+  for (i=0; i<n; i++)
+    if (fabs (a[i]) > 1e-10 && (d = fabs (b[i] - a[i]) / fabs (a[i])) > max)
+      max = d;
+  return max;
+}
+
+
+int bench_faults (int argc, char **argv)
+{
+  PACK_SPEC spec;
+  FAULTS_RUN text, run;
+  DAYLIGHT_WINDOW window;
+  FILE *trace=NULL;
+  const char *resources=NULL, *base="/tmp";
+  char dir[FILENAME_MAX], trace_file[FILENAME_MAX+16], packs[N_ORDERS][FILENAME_MAX+16];
+  long pages=0;
+  double latitude=47.0, longitude=11.0, altitude=0.6, *reference=NULL, *values=NULL;
+  int day=172, step=600, n_steps=0, n_requests=0, c=0, o=0, a=0, failed=0;
+  size_t size=0;
+
+  resources = getenv ("FASTRT_RESOURCES");
+  while ((c = getopt (argc, argv, "R:d:a:l:z:s:D:h")) != -1)  {
+    switch (c)  {
+    case 'R': resources = optarg;            break;
+    case 'd': day = atoi (optarg);           break;
+    case 'a': latitude = atof (optarg);      break;
+    case 'l': longitude = atof (optarg);     break;
+    case 'z': altitude = atof (optarg);      break;
+    case 's': step = atoi (optarg);          break;
+    case 'D': base = optarg;                 break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+  if (resources == NULL)
+    resources = ".";
+  bench_set_resources (resources);
+
+  if (step < 1 || daylight_window (day, latitude, -longitude, &window) != 0)  {
+    usage ();
+    return 1;
+  }
+  if (window.type == DAYLIGHT_POLAR_NIGHT)  {
+    fprintf (stderr, "The sun does not rise on day %d\n", day);
+    return 1;
+  }
+  if (window.type == DAYLIGHT_POLAR_DAY)  {
+    window.sunrise = 0;
+    window.sunset  = 86400 - 1;
+  }
+  n_steps    = (window.sunset - window.sunrise) / step + 1;
+  n_requests = n_steps * 4;
+
+  size = (size_t) n_requests * FAULTS_LAMBDA;
+  if ((reference = (double *) calloc (size, sizeof(double))) == NULL ||
+      (values = (double *) calloc (size, sizeof(double))) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  snprintf (dir, sizeof(dir), "%s/fastrt-faults-XXXXXX", base);
+  if (mkdtemp (dir) == NULL)  {
+    fprintf (stderr, "Error, cannot create a directory in %s\n", base);
+    return 1;
+  }
+  snprintf (trace_file, sizeof(trace_file), "%s/trace", dir);
+
+  /* the day from the tables, with the trace */
+  if ((trace = fopen (trace_file, "w")) == NULL)  {
+    fprintf (stderr, "Error, cannot write %s\n", trace_file);
+    rmdir (dir);
+    return 1;
+  }
+  memset (&text, 0, sizeof(text));
+  failed += run_day (NULL, 0, trace, day, latitude, longitude, altitude, window.sunrise,
+		     n_steps, step, reference, &text);
+  fclose (trace);
+
+  for (o=0; o<N_ORDERS; o++)  {
+    snprintf (packs[o], sizeof(packs[o]), "%s/%s.pack", dir, order_names[o]);
+    pack_spec_init (&spec);
+    spec.resources = resources;
+    spec.output    = packs[o];
+    spec.order     = o;
+    spec.trace     = (o == PACK_ORDER_TRACE ? trace_file : NULL);
+    if (pack_run (&spec, NULL) != 0)  {
+      fprintf (stderr, "Error, cannot build the %s pack\n", order_names[o]);
+      failed++;
+      packs[o][0] = 0;
+    }
+  }
+
+  printf ("day %d at %.2f %.2f, %.1f km: %d steps x 4 skies\n",
+	  day, latitude, longitude, altitude, n_steps);
+  printf ("%-8s %-12s %10s %10s %10s %10s %10s %10s %10s\n", "order", "advice", "first [ms]",
+	  "day [ms]", "faults", "major", "resident", "pages", "max diff");
+  printf ("%-8s %-12s %10.3f %10.3f %10.1f %10ld %10s %10s %10s\n", "tables", "",
+	  text.first * 1e3, text.seconds * 1e3, (double) (text.minor + text.major) / n_requests,
+	  text.major, "", "", "");
+
+  for (o=0; o<N_ORDERS; o++)  {
+    if (packs[o][0] == 0)
+      continue;
+    pages = trace_pages (packs[o], trace_file);
+    for (a=0; a<N_ADVICE; a++)  {
+      memset (&run, 0, sizeof(run));
+      drop_cache (packs[o]);
+      if (run_day (packs[o], a, NULL, day, latitude, longitude, altitude, window.sunrise,
+		   n_steps, step, values, &run) != 0)  {
+	fprintf (stderr, "Error, the day on the %s pack failed\n", order_names[o]);
+	failed++;
+	continue;
+      }
+      printf ("%-8s %-12s %10.3f %10.3f %10.1f %10ld %9.1f%% %10ld %10.2e\n", order_names[o],
+	      advice_names[a], run.first * 1e3, run.seconds * 1e3,
+	      (double) (run.minor + run.major) / n_requests, run.major, 100.0 * run.resident,
+	      pages, max_difference (reference, values, size));
+    }
+  }
+
+  for (o=0; o<N_ORDERS; o++)
+    if (packs[o][0] != 0)
+      unlink (packs[o]);
+  unlink (trace_file);
+  rmdir (dir);
+  free (reference);
+  free (values);
+  return (failed > 0 ? 1 : 0);
+}
@@ -0,0 +1,138 @@
+/************************************************************************/
+/* bench_grid.c                                                         */
+/*                                                                      */
+/* Throughput of grid_run() in cells per second, for a synthetic map    */
+/* with a smooth altitude raster and, with -c, a cloud raster.          */
+/*                                                                      */
+/* The first run starts with an empty engine and includes reading the   */
+/* tables (cold); the following runs reuse them (warm).                 */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "grid.h"
+#include "bench.h"
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench grid [-R resources] [-n rows] [-m columns]\n");
+  fprintf (stderr, "         [-a lat_south] [-A lat_north] [-o lon_west] [-O lon_east]\n");
+  fprintf (stderr, "         [-d day] [-s seconds_utc] [-t threads] [-r runs] [-c] [-w raster]\n");
+}
+
+
+int bench_grid (int argc, char **argv)
+{
+  GRID_SPEC spec;
+  GRID_STATS stats;
+  FASTRT_ENGINE *engine=NULL;
+  FILE *out=NULL;
+  float *altitude=NULL, *cloud=NULL;
+  double lat_south=35.0, lat_north=71.0, lon_west=-10.0, lon_east=40.0;
+  double best=0.0;
+  int n_lat=64, n_lon=96, runs=3, clouds=0, c=0, i=0, j=0, status=0;
+  char *raster=NULL;
+
+  grid_spec_init (&spec);
+  spec.day     = 172;
+  spec.seconds = 43200;
+  spec.outputs = GRID_UV_INDEX | GRID_BURN_TIME;
+
+  while ((c = getopt (argc, argv, "R:n:m:a:A:o:O:d:s:t:r:cw:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg);  break;
+    case 'n': n_lat = atoi (optarg);         break;
+    case 'm': n_lon = atoi (optarg);         break;
+    case 'a': lat_south = atof (optarg);     break;
+    case 'A': lat_north = atof (optarg);     break;
+    case 'o': lon_west = atof (optarg);      break;
+    case 'O': lon_east = atof (optarg);      break;
+    case 'd': spec.day = atoi (optarg);      break;
+    case 's': spec.seconds = atoi (optarg);  break;
+    case 't': spec.n_threads = atoi (optarg); break;
+    case 'r': runs = atoi (optarg);          break;
+    case 'c': clouds = 1;                    break;
+    case 'w': raster = optarg;               break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (n_lat < 1 || n_lon < 1 || runs < 1)  {
+    usage ();
+    return 1;
+  }
+
+  spec.n_lat = n_lat;
+  spec.n_lon = n_lon;
+  spec.lat0  = lat_south;
+  spec.dlat  = (n_lat > 1 ? (lat_north - lat_south) / (n_lat - 1) : 0.0);
+  spec.lon0  = lon_west;
+  spec.dlon  = (n_lon > 1 ? (lon_east - lon_west) / (n_lon - 1) : 0.0);
+
+  altitude = (float *) calloc ((size_t) n_lat * n_lon, sizeof(float));
+  cloud    = (float *) calloc ((size_t) n_lat * n_lon, sizeof(float));
+  if (altitude == NULL || cloud == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  /* hills up to 3 km and, with -c, cloud bands up to 500 g m-2 */
+  for (i=0; i<n_lat; i++)
+    for (j=0; j<n_lon; j++)  {
+      altitude[i*n_lon+j] = (float) (1.5 + 1.5 * sin (0.21*i) * cos (0.17*j));
+      if (altitude[i*n_lon+j] < 0.0f)
+	altitude[i*n_lon+j] = 0.0f;
+      if (clouds)
+	cloud[i*n_lon+j] = (float) fmax (0.0, 500.0 * sin (0.11*i + 0.07*j));
+    }
+  spec.altitude = altitude;
+  spec.cloud    = (clouds ? cloud : NULL);
+
+  if ((engine = fastrt_engine_create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  printf ("grid %d x %d cells, day %d, %d s UTC, %s\n", n_lat, n_lon, spec.day, spec.seconds,
+	  clouds ? "clouds" : "clear sky");
+
+  for (i=0; i<runs; i++)  {
+    out = NULL;
+    if (raster != NULL && i == runs-1 && (out = fopen (raster, "wb")) == NULL)  {
+      fprintf (stderr, "Error, cannot open %s\n", raster);
+      status = 1;
+      break;
+    }
+
+    status = grid_run (engine, &spec, out, &stats);
+    if (out != NULL)
+      fclose (out);
+    if (status != 0)  {
+      fprintf (stderr, "Error %d from grid_run()\n", status);
+      break;
+    }
+
+    printf ("%-5s %8.3f s  %10.1f cells/s  (%ld daylit, %ld failed, %ld tables)\n",
+	    i == 0 ? "cold" : "warm", stats.seconds, stats.cells / stats.seconds,
+	    stats.day_cells, stats.failed, engine->store->n_nodes);
+
+    if (i > 0 && (best == 0.0 || stats.seconds < best))
+      best = stats.seconds;
+  }
+
+  if (status == 0 && best > 0.0)
+    printf ("best warm run: %.1f cells/s\n", (double) n_lat * n_lon / best);
+
+  fastrt_engine_free (engine);
+  free (altitude);
+  free (cloud);
+  return status;
+}
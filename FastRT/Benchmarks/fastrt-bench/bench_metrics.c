@@ -0,0 +1,108 @@
+/************************************************************************/
+/* bench_metrics.c                                                      */
+/*                                                                      */
+/* Runtime counters after a mixed workload: a cloudy and a clear map    */
+/* through grid_run() on several threads and single requests with      */
+/* albedo and aerosol, followed by the Prometheus text dump, as a host  */
+/* would serve it.                                                      */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "grid.h"
+#include "metrics.h"
+#include "bench.h"
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench metrics [-R resources] [-t threads] [-n rows] [-m columns]\n");
+}
+
+
+int bench_metrics (int argc, char **argv)
+{
+  static char *requests[][16] = {
+    { "fastrt", "-a", "40", "-o", "320", "-p", "0.3", "-g", "290", "-e", "400", "-s", "1", NULL },
+    { "fastrt", "-a", "40", "-o", "320", "-b", "0.2", "-g", "290", "-e", "400", "-s", "1", NULL },
+    { "fastrt", "-a", "40", "-o", "320", "-c", "-u", "450", "-w", "310", NULL },
+  };
+  GRID_SPEC spec;
+  GRID_STATS stats;
+  METRICS_SNAPSHOT snapshot;
+  FASTRT_ENGINE *engine=NULL;
+  float *cloud=NULL;
+  double doserates[128];
+  int n_lat=8, n_lon=16, c=0, i=0, n=0, status=0;
+
+  grid_spec_init (&spec);
+
+  while ((c = getopt (argc, argv, "R:t:n:m:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg);    break;
+    case 't': spec.n_threads = atoi (optarg);  break;
+    case 'n': n_lat = atoi (optarg);           break;
+    case 'm': n_lon = atoi (optarg);           break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (n_lat < 1 || n_lon < 1)  {
+    usage ();
+    return 1;
+  }
+
+  spec.n_lat   = n_lat;
+  spec.n_lon   = n_lon;
+  spec.lat0    = 30.0;
+  spec.dlat    = 1.0;
+  spec.lon0    = 0.0;
+  spec.dlon    = 1.0;
+  spec.day     = 172;
+  spec.seconds = 43200;
+
+  if ((cloud = (float *) calloc ((size_t) n_lat * n_lon, sizeof(float))) == NULL ||
+      (engine = fastrt_engine_create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    free (cloud);
+    return 1;
+  }
+  for (i=0; i<n_lat*n_lon; i++)
+    cloud[i] = (float) (200.0 * fabs (sin (0.37 * i)));
+
+  if ((status = grid_run (engine, &spec, NULL, &stats)) == 0)  {
+    spec.cloud = cloud;
+    status = grid_run (engine, &spec, NULL, &stats);
+  }
+
+  n = (int) (sizeof(requests) / sizeof(requests[0]));
+  for (i=0; i<n && status==0; i++)  {
+    int argc_i=0;
+    while (requests[i][argc_i] != NULL)
+      argc_i++;
+    if (fastrt_engine_run (engine, argc_i, requests[i], doserates) < 0)
+      status = -1;
+  }
+
+  if (status != 0)
+    fprintf (stderr, "Error %d in the workload\n", status);
+
+  metrics_snapshot (&snapshot);
+  fprintf (stderr, "%ld requests on %d threads, %.3f ms mean, %ld hits, %ld misses\n",
+	   snapshot.requests, snapshot.threads,
+	   snapshot.requests > 0 ? snapshot.latency_sum / snapshot.requests * 1e3 : 0.0,
+	   snapshot.cache_hits, snapshot.cache_misses);
+
+  metrics_write_prometheus (stdout);
+
+  fastrt_engine_free (engine);
+  free (cloud);
+  return (status != 0 ? 1 : 0);
+}
@@ -0,0 +1,200 @@
+/************************************************************************/
+/* bench_pool.c                                                         */
+/*                                                                      */
+/* Work stealing against fixed contiguous ranges on skewed workloads:   */
+/*                                                                      */
+/*  - synthetic: items of the first quarter cost -k times as much as     */
+/*    the others, as cloudy cells next to cheap night cells;            */
+/*  - grid: a map across the day/night terminator with a cloud band,    */
+/*    through grid_run();                                               */
+/*                                                                      */
+/* and the cost of short runs, as grid_run() has one per band, on      */
+/* threads started for each run against the threads of a TASKPOOL.      */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "grid.h"
+#include "taskpool.h"
+#include "bench.h"
+
+
+typedef struct {
+  long   n_items;
+  double cost;          /* seconds per cheap item */
+  double skew;          /* cost factor of the first quarter */
+} SYNTHETIC;
+
+
+static int synthetic_task (void *arg, TASKPOOL_WORKER *worker, long first, long n)
+{
+  SYNTHETIC *job = (SYNTHETIC *) arg;
+  double t=0.0, end=0.0;
+  long i=0;
+
+  (void) worker;
+  for (i=first; i<first+n; i++)  {
+    end = bench_now () + (i < job->n_items / 4 ? job->skew : 1.0) * job->cost;
+    do
+      t = bench_now ();
+    while (t < end);
+  }
+
+  return 0;
+}
+
+
+static const char *schedule_name (int schedule)
+{
+  return (schedule == TASKPOOL_STATIC ? "static" : "steal");
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench pool [-R resources] [-t threads] [-n items] [-u usec]\n");
+  fprintf (stderr, "         [-k skew] [-c chunk] [-g rows] [-m columns]\n");
+  fprintf (stderr, "  -g 0 skips the grid workload\n");
+}
+
+
+int bench_pool (int argc, char **argv)
+{
+  SYNTHETIC synthetic, small;
+  TASKPOOL_JOB job;
+  TASKPOOL *pool=NULL;
+  TASKPOOL_STATS stats;
+  GRID_SPEC spec;
+  GRID_STATS gstats;
+  FASTRT_ENGINE *engine=NULL;
+  float *cloud=NULL;
+  double base=0.0, t0=0.0, per_call=0.0, pooled=0.0;
+  long chunk=4;
+  int n_threads=0, n_lat=24, n_lon=48, n_runs=200, schedule=0, c=0, i=0, j=0, status=0;
+
+  synthetic.n_items = 4000;
+  synthetic.cost    = 50e-6;
+  synthetic.skew    = 20.0;
+
+  while ((c = getopt (argc, argv, "R:t:n:u:k:c:g:m:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg);          break;
+    case 't': n_threads = atoi (optarg);             break;
+    case 'n': synthetic.n_items = atol (optarg);     break;
+    case 'u': synthetic.cost = atof (optarg) * 1e-6; break;
+    case 'k': synthetic.skew = atof (optarg);        break;
+    case 'c': chunk = atol (optarg);                 break;
+    case 'g': n_lat = atoi (optarg);                 break;
+    case 'm': n_lon = atoi (optarg);                 break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  n_threads = taskpool_threads (n_threads);
+  if (synthetic.n_items < 1 || chunk < 1 || n_lat < 0 || n_lon < 1)  {
+    usage ();
+    return 1;
+  }
+
+  memset (&job, 0, sizeof(TASKPOOL_JOB));
+  job.run = synthetic_task;
+  job.arg = &synthetic;
+
+  if ((pool = taskpool_create (n_threads)) == NULL)  {
+    fprintf (stderr, "Error, cannot start the threads\n");
+    return 1;
+  }
+
+  printf ("synthetic: %ld items of %.0f us, first quarter x%.0f, chunk %ld, %d threads\n",
+	  synthetic.n_items, synthetic.cost * 1e6, synthetic.skew, chunk, n_threads);
+  printf ("%-8s %10s %12s %8s %10s\n", "schedule", "seconds", "items/s", "steals", "imbalance");
+
+  for (schedule=TASKPOOL_STATIC; schedule>=TASKPOOL_STEAL; schedule--)  {
+    if ((status = taskpool_run (pool, &job, synthetic.n_items, chunk, n_threads, schedule,
+				&stats)) != 0)
+      break;
+    printf ("%-8s %10.3f %12.1f %8ld %10.2f\n", schedule_name (schedule), stats.seconds,
+	    synthetic.n_items / stats.seconds, stats.steals,
+	    stats.busy_mean > 0.0 ? stats.busy_max / stats.busy_mean : 1.0);
+  }
+
+  /* short runs of a few empty tasks per worker: the cost of a run */
+  small         = synthetic;
+  small.n_items = 4 * chunk * n_threads;
+  small.cost    = 0.0;
+  job.arg       = &small;
+  for (i=0; status==0 && i<2*n_runs; i++)  {
+    t0 = bench_now ();
+    status = taskpool_run (i < n_runs ? NULL : pool, &job, small.n_items, chunk, n_threads,
+			   TASKPOOL_STEAL, NULL);
+    if (i < n_runs)
+      per_call += bench_now () - t0;
+    else
+      pooled += bench_now () - t0;
+  }
+  taskpool_free (pool);
+  if (status == 0)
+    printf ("%d runs of %ld items: %.3f ms per run with threads per run, %.3f ms with a pool\n",
+	    n_runs, small.n_items, per_call / n_runs * 1e3, pooled / n_runs * 1e3);
+
+  if (status != 0 || n_lat == 0)
+    return (status != 0 ? 1 : 0);
+
+  /* Europe and Africa at 06 UTC in December: the terminator crosses */
+  /* the map, and a cloud band lies over the daylit part             */
+  grid_spec_init (&spec);
+  spec.n_lat     = n_lat;
+  spec.n_lon     = n_lon;
+  spec.lat0      = -35.0;
+  spec.dlat      = (n_lat > 1 ? 105.0 / (n_lat - 1) : 0.0);
+  spec.lon0      = -20.0;
+  spec.dlon      = (n_lon > 1 ? 80.0 / (n_lon - 1) : 0.0);
+  spec.day       = 355;
+  spec.seconds   = 6 * 3600;
+  spec.n_threads = n_threads;
+
+  if ((cloud = (float *) calloc ((size_t) n_lat * n_lon, sizeof(float))) == NULL ||
+      (engine = fastrt_engine_create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    free (cloud);
+    return 1;
+  }
+  for (i=0; i<n_lat; i++)
+    for (j=0; j<n_lon; j++)
+      if (j > n_lon / 2)
+	cloud[i*n_lon+j] = (float) (100.0 + 300.0 * fabs (sin (0.3*i)));
+  spec.cloud = cloud;
+
+  /* warm-up, reads the tables */
+  if ((status = grid_run (engine, &spec, NULL, &gstats)) != 0)
+    fprintf (stderr, "Error %d from grid_run()\n", status);
+
+  if (status == 0)  {
+    printf ("grid: %d x %d cells, %ld daylit, %d threads\n", n_lat, n_lon, gstats.day_cells,
+	    n_threads);
+    printf ("%-8s %10s %12s %8s\n", "schedule", "seconds", "cells/s", "speedup");
+  }
+
+  for (schedule=TASKPOOL_STATIC; status==0 && schedule>=TASKPOOL_STEAL; schedule--)  {
+    spec.schedule = schedule;
+    if ((status = grid_run (engine, &spec, NULL, &gstats)) != 0)  {
+      fprintf (stderr, "Error %d from grid_run()\n", status);
+      break;
+    }
+    if (schedule == TASKPOOL_STATIC)
+      base = gstats.seconds;
+    printf ("%-8s %10.3f %12.1f %8.2f\n", schedule_name (schedule), gstats.seconds,
+	    gstats.cells / gstats.seconds, base / gstats.seconds);
+  }
+
+  fastrt_engine_free (engine);
+  free (cloud);
+  return (status != 0 ? 1 : 0);
+}
@@ -0,0 +1,197 @@
+/************************************************************************/
+/* bench_preload.c                                                      */
+/*                                                                      */
+/* Cold start of an engine with and without fastrt_engine_preload():    */
+/* the day of the app (every step from sunrise to sunset, all four sky  */
+/* conditions of run_fastrt()) is computed                              */
+/*                                                                      */
+/*   cold       with a new engine,                                      */
+/*   concurrent with a new engine while the location is preloaded,      */
+/*   preloaded  after the preload of the location has finished;         */
+/*                                                                      */
+/* reads counts the tables read during the run by any thread; first is  */
+/* the first request after sunrise, the steps before it read nothing.   */
+/*                                                                      */
+/* The results must be the same in all three runs, the preloaded run    */
+/* must not read any table, i.e. the preload covers all nodes of the    */
+/* day, and its first request must be faster than the cold one. Exits   */
+/* with 1 if a check fails, so that it can run as a test.               */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FastRT.h"
+#include "bench.h"
+
+
+#define PRELOAD_START   290
+#define PRELOAD_END     400
+#define PRELOAD_LAMBDA  (PRELOAD_END - PRELOAD_START + 1)
+
+typedef struct {
+  const char *name;
+  double first;         /* latency of the first daylit request [s] */
+  double total;         /* whole day [s]                           */
+  long   misses;        /* tables read by the requests             */
+  long   waits;         /* requests waiting for a node being read  */
+} PRELOAD_RUN;
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench preload [-R resources] [-d day] [-a latitude]\n");
+  fprintf (stderr, "         [-l longitude] [-z altitude] [-s step]\n");
+}
+
+
+static void counters (FASTRT_ENGINE *engine, long *misses, long *waits)
+{
+  pthread_mutex_lock (&engine->store->lock);
+  *misses = engine->store->misses;
+  *waits  = engine->store->waits;
+  pthread_mutex_unlock (&engine->store->lock);
+}
+
+
+/* the day from sunrise to sunset; results into values, n_steps x 4 x PRELOAD_LAMBDA */
+static int run_day (FASTRT_ENGINE *engine, int day, double latitude, double longitude,
+		    double altitude, int sunrise, int n_steps, int step,
+		    double *values, PRELOAD_RUN *run)
+{
+  double t0=0.0, t=0.0;
+  long misses0=0, waits0=0;
+  int i=0, sky=0, status=0, failed=0;
+
+  counters (engine, &misses0, &waits0);
+  t0 = bench_now ();
+  for (i=0; i<n_steps; i++)
+    for (sky=0; sky<4; sky++)  {
+      t = bench_now ();
+      status = run_fastrt_with_engine (engine, values + (i*4 + sky) * PRELOAD_LAMBDA,
+				       PRELOAD_START, PRELOAD_END, 1.0, day, latitude,
+				       longitude, altitude, sunrise + i*step, sky, true);
+      /* before the sun is up, status 1, no table is read */
+      if (status == 0 && run->first == 0.0)
+	run->first = bench_now () - t;
+      if (status < 0)
+	failed++;
+    }
+  run->total  = bench_now () - t0;
+  counters (engine, &run->misses, &run->waits);
+  run->misses -= misses0;
+  run->waits  -= waits0;
+
+  return failed;
+}
+
+
+int bench_preload (int argc, char **argv)
+{
+  FASTRT_PRELOAD spec;
+  FASTRT_PRELOAD_STATS stats;
+  FASTRT_ENGINE *engine=NULL;
+  PRELOAD_RUN runs[3];
+  DAYLIGHT_WINDOW window;
+  double latitude=47.0, longitude=11.0, altitude=0.6, *values[3]={NULL,NULL,NULL};
+  double t0=0.0, t_preload=0.0;
+  int day=172, step=600, n_steps=0, c=0, r=0, failed=0;
+  size_t size=0;
+
+  while ((c = getopt (argc, argv, "R:d:a:l:z:s:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg);  break;
+    case 'd': day = atoi (optarg);           break;
+    case 'a': latitude = atof (optarg);      break;
+    case 'l': longitude = atof (optarg);     break;
+    case 'z': altitude = atof (optarg);      break;
+    case 's': step = atoi (optarg);          break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (step < 1 || daylight_window (day, latitude, -longitude, &window) != 0)  {
+    usage ();
+    return 1;
+  }
+  if (window.type == DAYLIGHT_POLAR_NIGHT)  {
+    fprintf (stderr, "The sun does not rise on day %d\n", day);
+    return 1;
+  }
+  if (window.type == DAYLIGHT_POLAR_DAY)  {
+    window.sunrise = 0;
+    window.sunset  = 86400 - 1;
+  }
+  n_steps = (window.sunset - window.sunrise) / step + 1;
+
+  memset (runs, 0, sizeof(runs));
+  runs[0].name = "cold";
+  runs[1].name = "concurrent";
+  runs[2].name = "preloaded";
+
+  fastrt_preload_location (&spec, day, latitude, longitude, altitude);
+  memset (&stats, 0, sizeof(stats));
+
+  size = (size_t) n_steps * 4 * PRELOAD_LAMBDA;
+  for (r=0; r<3; r++)  {
+    if ((values[r] = (double *) calloc (size, sizeof(double))) == NULL ||
+	(engine = fastrt_engine_create ()) == NULL)  {
+      fprintf (stderr, "Error, out of memory\n");
+      return 1;
+    }
+
+    if (r > 0)  {
+      t0 = bench_now ();
+      if (fastrt_engine_preload (engine, &spec) != 0)  {
+	fprintf (stderr, "Error, cannot start the preload\n");
+	return 1;
+      }
+      if (r == 2)  {
+	fastrt_engine_preload_wait (engine, &stats);
+	t_preload = bench_now () - t0;
+      }
+    }
+
+    failed += run_day (engine, day, latitude, longitude, altitude, window.sunrise,
+		       n_steps, step, values[r], &runs[r]);
+
+    if (r == 1)
+      fastrt_engine_preload_wait (engine, NULL);
+    fastrt_engine_free (engine);
+  }
+
+  printf ("day %d at %.2f %.2f, %.1f km: %d steps x 4 skies\n",
+	  day, latitude, longitude, altitude, n_steps);
+  printf ("preload: %ld nodes (%ld missing) in %.3f s\n",
+	  stats.nodes, stats.missing, t_preload);
+  printf ("%-12s %12s %12s %10s %10s\n", "run", "first [ms]", "day [ms]", "reads", "waits");
+  for (r=0; r<3; r++)
+    printf ("%-12s %12.3f %12.3f %10ld %10ld\n", runs[r].name, runs[r].first * 1e3,
+	    runs[r].total * 1e3, runs[r].misses, runs[r].waits);
+
+  if (failed > 0)
+    fprintf (stderr, "FAIL: %d requests failed\n", failed);
+  for (r=1; r<3; r++)
+    if (memcmp (values[0], values[r], size * sizeof(double)) != 0)  {
+      fprintf (stderr, "FAIL: the %s results differ from the cold ones\n", runs[r].name);
+      failed++;
+    }
+  if (runs[0].first <= runs[2].first)  {
+    fprintf (stderr, "FAIL: the first request is not slower cold than preloaded\n");
+    failed++;
+  }
+  if (runs[2].misses != 0)  {
+    fprintf (stderr, "FAIL: the preloaded run read %ld tables\n", runs[2].misses);
+    failed++;
+  }
+
+  for (r=0; r<3; r++)
+    free (values[r]);
+  return (failed > 0 ? 1 : 0);
+}
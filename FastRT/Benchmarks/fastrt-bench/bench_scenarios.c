@@ -0,0 +1,276 @@
+/************************************************************************/
+/* bench_scenarios.c                                                    */
+/*                                                                      */
+/* Latency and cost per call of the typical requests: one wavelength,   */
+/* the 290-400 nm spectrum of the app, a 0.05 nm spectrum, the four sky */
+/* conditions of run_fastrt(), albedo, aerosol and a whole day.         */
+/*                                                                      */
+/* Every scenario starts with a new engine; the first call (cold)       */
+/* reads the tables, the following calls (warm) reuse them. With -L no  */
+/* engine is used and every call reads its tables, as before the        */
+/* engine existed. The result is JSON, written to stdout or to -o, so   */
+/* that runs can be compared with a diff.                               */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FastRT.h"
+#include "bench.h"
+
+
+#define SCENARIO_MAX_ARGS    32
+#define SCENARIO_MAX_LAMBDA  4096
+
+/* Vienna, 21 June, 11 UTC */
+#define SCENARIO_DAY         172
+#define SCENARIO_LATITUDE    48.2
+#define SCENARIO_LONGITUDE   16.4
+#define SCENARIO_ALTITUDE    0.2
+#define SCENARIO_SECONDS     39600
+#define SCENARIO_DAY_STEP    600    /* integration step of the app [s] */
+
+
+typedef struct {
+  const char *name;
+  const char *args;      /* fastrt options, NULL for run_fastrt()      */
+  int         sky;       /* sky condition of run_fastrt()              */
+  int         full_day;  /* one call integrates a whole day            */
+} SCENARIO;
+
+static const SCENARIO scenarios[] = {
+  { "single_wavelength", "-a 45 -o 300 -w 310 -d 172",                           0, 0 },
+  { "spectrum_290_400",  "-a 45 -o 300 -g 290 -e 400 -s 1 -f 0.6 -d 172",        0, 0 },
+  { "highres_0.05nm",    "-a 45 -o 300 -g 300 -e 320 -s 0.05 -f 0.05 -d 172",    0, 0 },
+  { "sky_cloudless",     NULL,                                                   0, 0 },
+  { "sky_scattered",     NULL,                                                   1, 0 },
+  { "sky_broken",        NULL,                                                   2, 0 },
+  { "sky_overcast",      NULL,                                                   3, 0 },
+  { "albedo_off",        "-a 45 -o 300 -g 290 -e 400 -s 1 -d 172 -p 0",          0, 0 },
+  { "albedo_on",         "-a 45 -o 300 -g 290 -e 400 -s 1 -d 172 -p 0.3",        0, 0 },
+  { "albedo_surface",    "-a 45 -o 300 -g 290 -e 400 -s 1 -d 172 -q 12",         0, 0 },
+  { "aerosol_beta_0.2",  "-a 45 -o 300 -g 290 -e 400 -s 1 -d 172 -b 0.2",        0, 0 },
+  { "full_day",          NULL,                                                   0, 1 },
+  { NULL, NULL, 0, 0 }
+};
+
+
+/* costs of one call */
+typedef struct {
+  double seconds;
+  long   files;
+  long   bytes;
+  long   allocations;
+  int    status;
+} CALL;
+
+
+static int split_args (const char *args, char *buffer, size_t size, char **argv)
+{
+  char *t=NULL;
+  int argc=0;
+
+  argv[argc++] = "fastrt";
+  snprintf (buffer, size, "%s", args);
+  for (t=strtok (buffer, " "); t!=NULL && argc<SCENARIO_MAX_ARGS-1; t=strtok (NULL, " "))
+    argv[argc++] = t;
+  argv[argc] = NULL;
+  return argc;
+}
+
+
+static int run_once (FASTRT_ENGINE *engine, const SCENARIO *s, double *doserates)
+{
+  char buffer[512], *argv[SCENARIO_MAX_ARGS];
+  int argc=0, t=0, status=0;
+
+  if (s->args != NULL)  {
+    argc = split_args (s->args, buffer, sizeof(buffer), argv);
+    return fastrt_engine_run (engine, argc, argv, doserates);
+  }
+
+  if (!s->full_day)
+    return run_fastrt_with_engine (engine, doserates, 290, 400, 1.0, SCENARIO_DAY,
+				   SCENARIO_LATITUDE, SCENARIO_LONGITUDE, SCENARIO_ALTITUDE,
+				   SCENARIO_SECONDS, s->sky, true);
+
+  /* as the app: every step, night steps return at once */
+  for (t=0; t<86400; t+=SCENARIO_DAY_STEP)  {
+    status = run_fastrt_with_engine (engine, doserates, 290, 400, 1.0, SCENARIO_DAY,
+				     SCENARIO_LATITUDE, SCENARIO_LONGITUDE, SCENARIO_ALTITUDE,
+				     t, s->sky, true);
+    if (status < 0)
+      return status;
+  }
+  return 0;
+}
+
+
+static void measure (FASTRT_ENGINE *engine, const SCENARIO *s, double *doserates, CALL *call)
+{
+  long files0=0, bytes0=0, files1=0, bytes1=0, allocs0=0;
+  double t0=0.0;
+
+  ASCII_get_counters (&files0, &bytes0);
+  allocs0 = bench_allocations ();
+  t0 = bench_now ();
+
+  call->status = run_once (engine, s, doserates);
+
+  call->seconds     = bench_now () - t0;
+  call->allocations = (allocs0 < 0 ? -1 : bench_allocations () - allocs0);
+  ASCII_get_counters (&files1, &bytes1);
+  call->files = files1 - files0;
+  call->bytes = bytes1 - bytes0;
+}
+
+
+static int compare_doubles (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+
+/* nearest rank percentile of sorted values */
+static double percentile (const double *sorted, int n, double p)
+{
+  int k = (int) ceil (p / 100.0 * n) - 1;
+
+  if (k < 0)
+    k = 0;
+  if (k >= n)
+    k = n-1;
+  return sorted[k];
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench scenarios [-R resources] [-n calls] [-s scenario] [-L]\n");
+  fprintf (stderr, "         [-o output.json]\n");
+  fprintf (stderr, "  -L   no engine, every call reads its tables\n");
+}
+
+
+int bench_scenarios (int argc, char **argv)
+{
+  const SCENARIO *s=NULL;
+  FASTRT_ENGINE *engine=NULL;
+  CALL cold, call;
+  FILE *out=stdout;
+  double *doserates=NULL, *latency=NULL, sum=0.0;
+  long files=0, bytes=0, allocs=0;
+  const char *only=NULL, *output=NULL;
+  int calls=50, legacy=0, first=1, c=0, i=0, status=0;
+
+  while ((c = getopt (argc, argv, "R:n:s:Lo:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg); break;
+    case 'n': calls = atoi (optarg);        break;
+    case 's': only = optarg;                break;
+    case 'L': legacy = 1;                   break;
+    case 'o': output = optarg;              break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (calls < 1)  {
+    usage ();
+    return 1;
+  }
+
+  doserates = (double *) calloc (SCENARIO_MAX_LAMBDA, sizeof(double));
+  latency   = (double *) calloc (calls, sizeof(double));
+  if (doserates == NULL || latency == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  if (output != NULL && (out = fopen (output, "w")) == NULL)  {
+    fprintf (stderr, "Error, cannot open %s\n", output);
+    return 1;
+  }
+
+  fprintf (out, "{\n  \"benchmark\": \"scenarios\",\n  \"engine\": %s,\n  \"calls\": %d,\n",
+	   legacy ? "false" : "true", calls);
+  fprintf (out, "  \"allocations_counted\": %s,\n", bench_allocations () < 0 ? "false" : "true");
+  fprintf (out, "  \"scenarios\": [");
+
+  for (s=scenarios; s->name!=NULL; s++)  {
+    if (only != NULL && strcmp (only, s->name) != 0)
+      continue;
+
+    if (!legacy && (engine = fastrt_engine_create ()) == NULL)  {
+      fprintf (stderr, "Error, out of memory\n");
+      status = 1;
+      break;
+    }
+
+    measure (engine, s, doserates, &cold);
+
+    sum = 0.0;
+    files = bytes = allocs = 0;
+    for (i=0; i<calls; i++)  {
+      measure (engine, s, doserates, &call);
+      latency[i] = call.seconds;
+      sum    += call.seconds;
+      files  += call.files;
+      bytes  += call.bytes;
+      allocs += call.allocations;
+      if (call.status < 0)
+	break;
+    }
+
+    fastrt_engine_free (engine);
+    engine = NULL;
+
+    if (cold.status < 0 || call.status < 0)  {
+      fprintf (stderr, "Error %d in scenario %s\n", cold.status < 0 ? cold.status : call.status,
+	       s->name);
+      status = 1;
+      break;
+    }
+
+    qsort (latency, calls, sizeof(double), compare_doubles);
+
+    fprintf (out, "%s\n    {\n", first ? "" : ",");
+    fprintf (out, "      \"name\": \"%s\",\n", s->name);
+    if (s->args != NULL)
+      fprintf (out, "      \"args\": \"%s\",\n", s->args);
+    else
+      fprintf (out, "      \"run_fastrt\": { \"sky\": %d, \"full_day\": %s },\n", s->sky,
+	       s->full_day ? "true" : "false");
+    fprintf (out, "      \"status\": %d,\n", call.status);
+    fprintf (out, "      \"cold\": { \"ms\": %.4f, \"files_opened\": %ld, \"bytes_parsed\": %ld, "
+	     "\"allocations\": %ld },\n", cold.seconds * 1e3, cold.files, cold.bytes,
+	     cold.allocations);
+    fprintf (out, "      \"latency_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, "
+	     "\"p99\": %.4f, \"max\": %.4f },\n", sum / calls * 1e3,
+	     percentile (latency, calls, 50) * 1e3, percentile (latency, calls, 90) * 1e3,
+	     percentile (latency, calls, 99) * 1e3, latency[calls-1] * 1e3);
+    fprintf (out, "      \"per_call\": { \"files_opened\": %.2f, \"bytes_parsed\": %.1f, "
+	     "\"allocations\": %.2f }\n", (double) files / calls, (double) bytes / calls,
+	     allocs < 0 ? -1.0 : (double) allocs / calls);
+    fprintf (out, "    }");
+    first = 0;
+
+    fprintf (stderr, "%-18s cold %9.3f ms   p50 %9.3f ms   p99 %9.3f ms   %6.1f files/call\n",
+	     s->name, cold.seconds * 1e3, percentile (latency, calls, 50) * 1e3,
+	     percentile (latency, calls, 99) * 1e3, (double) files / calls);
+  }
+
+  fprintf (out, "\n  ]\n}\n");
+
+  if (out != stdout)
+    fclose (out);
+  free (doserates);
+  free (latency);
+  return status;
+}
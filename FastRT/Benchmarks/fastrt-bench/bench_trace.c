@@ -0,0 +1,114 @@
+/************************************************************************/
+/* bench_trace.c                                                        */
+/*                                                                      */
+/* Where the time of a call goes: runs one request with the stage       */
+/* timers on, prints the summary of the cold (first) and the last warm  */
+/* call, and with -o writes all events as Chrome trace-event JSON.      */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "trace.h"
+#include "bench.h"
+
+
+#define TRACE_BENCH_LAMBDA   4096
+
+
+static void print_summary (const char *title, const TRACE_SUMMARY *summary)
+{
+  int i=0;
+
+  printf ("%s call: %.3f ms\n", title, summary->seconds * 1e3);
+  for (i=0; i<TRACE_STAGES; i++)
+    if (i != TRACE_CALL && summary->count[i] > 0)
+      printf ("  %-12s %10.3f ms %6.1f%% %8ld x\n", trace_stage_name (i),
+	      summary->stage[i] * 1e3, 100.0 * summary->stage[i] / summary->seconds,
+	      summary->count[i]);
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-bench trace [-R resources] [-n calls] [-L] [-o trace.json]\n");
+  fprintf (stderr, "         [-- fastrt options]\n");
+  fprintf (stderr, "  default request: -a 45 -o 300 -u 200 -p 0.3 -b 0.1 -g 290 -e 400 -s 1\n");
+}
+
+
+int bench_trace (int argc, char **argv)
+{
+  static char *request[] = { "fastrt", "-a", "45", "-o", "300", "-u", "200", "-p", "0.3",
+			     "-b", "0.1", "-g", "290", "-e", "400", "-s", "1", NULL };
+  FASTRT_ENGINE *engine=NULL;
+  TRACE_SUMMARY summary;
+  FILE *out=NULL;
+  double *doserates=NULL;
+  char **args=request;
+  const char *output=NULL;
+  int n_args=17, calls=10, legacy=0, c=0, i=0, status=0;
+
+  while ((c = getopt (argc, argv, "R:n:Lo:h")) != -1)  {
+    switch (c)  {
+    case 'R': bench_set_resources (optarg); break;
+    case 'n': calls = atoi (optarg);        break;
+    case 'L': legacy = 1;                   break;
+    case 'o': output = optarg;              break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  /* fastrt options after --, argv[optind-1] is "--" and serves as program name */
+  if (optind < argc && strcmp (argv[optind-1], "--") == 0)  {
+    args   = &argv[optind-1];
+    n_args = argc - optind + 1;
+  }
+
+  if (calls < 1)  {
+    usage ();
+    return 1;
+  }
+
+  if ((doserates = (double *) calloc (TRACE_BENCH_LAMBDA, sizeof(double))) == NULL ||
+      (!legacy && (engine = fastrt_engine_create ()) == NULL))  {
+    fprintf (stderr, "Error, out of memory\n");
+    free (doserates);
+    return 1;
+  }
+
+  trace_enable (1);
+
+  for (i=0; i<calls && status==0; i++)  {
+    if ((status = fastrt_engine_run (engine, n_args, args, doserates)) < 0)  {
+      fprintf (stderr, "Error %d from fastrt\n", status);
+      break;
+    }
+    status = 0;
+
+    if (trace_last_call (&summary) == 0 && (i == 0 || i == calls-1))
+      print_summary (i == 0 ? (legacy ? "first" : "cold") : (legacy ? "last" : "warm"),
+		     &summary);
+  }
+
+  trace_enable (0);
+
+  if (status == 0 && output != NULL)  {
+    if ((out = fopen (output, "w")) == NULL || trace_write_chrome (out) != 0)  {
+      fprintf (stderr, "Error, cannot write %s\n", output);
+      status = 1;
+    }
+    if (out != NULL)
+      fclose (out);
+  }
+
+  fastrt_engine_free (engine);
+  free (doserates);
+  return (status != 0 ? 1 : 0);
+}
@@ -0,0 +1,81 @@
+/************************************************************************/
+/* fastrt-bench                                                         */
+/*                                                                      */
+/* Benchmarks of the FastRT library, run as                             */
+/*                                                                      */
+/*   fastrt-bench <benchmark> [options]                                 */
+/*                                                                      */
+/* The tables are taken from the directory given with -R, else from     */
+/* $FASTRT_RESOURCES, else from the current directory.                  */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "ascii.h"
+#include "bench.h"
+
+
+static const BENCH benchmarks[] = {
+  { "scenarios", "latency, files, bytes and allocations per call, as JSON", bench_scenarios },
+  { "grid", "UV index map over a lat/lon grid, cells per second", bench_grid },
+  { "climatology", "daily doses for sites and days, scaling with threads", bench_climatology },
+  { "pool", "work stealing against static ranges on skewed workloads", bench_pool },
+  { "metrics", "runtime counters of a mixed workload, Prometheus text", bench_metrics },
+  { "trace", "time per stage of a call, Chrome trace-event JSON", bench_trace },
+  { "arena", "checks that warm requests make no heap calls", bench_arena },
+  { "daemon", "throughput and tail latency of the Unix socket server", bench_daemon },
+  { "accuracy", "relative error and speedup of a fast path against run_fastrt_", bench_accuracy },
+  { "preload", "cold start with and without a background preload", bench_preload },
+  { "faults", "page faults of a cold engine per pack order and advice", bench_faults },
+  { "embed", "time to the first result on a pack file, in memory and embedded", bench_embed },
+  { NULL, NULL, NULL }
+};
+
+
+double bench_now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+int bench_set_resources (const char *path)
+{
+  if (path != NULL)
+    ASCII_set_resource_path (path);
+  return 0;
+}
+
+
+static void print_usage (void)
+{
+  int i=0;
+
+  fprintf (stderr, "Usage: fastrt-bench <benchmark> [-R resources] [options]\n");
+  fprintf (stderr, "Benchmarks:\n");
+  for (i=0; benchmarks[i].name != NULL; i++)
+    fprintf (stderr, "  %-12s %s\n", benchmarks[i].name, benchmarks[i].description);
+}
+
+
+int main (int argc, char **argv)
+{
+  int i=0;
+
+  if (argc < 2)  {
+    print_usage ();
+    return 1;
+  }
+
+  for (i=0; benchmarks[i].name != NULL; i++)
+    if (strcmp (argv[1], benchmarks[i].name) == 0)
+      return benchmarks[i].run (argc-1, argv+1);
+
+  print_usage ();
+  return 1;
+}
@@ -5,6 +5,16 @@ let package = Package(
     name: "FastRT",
     products: [
         .library(name: "FastRT", type: .dynamic, targets: ["FastRT"]),
+        .library(name: "FastRTEmbedded", type: .dynamic, targets: ["FastRT", "FastRTEmbedded"]),
+        .executable(name: "fastrt-bench", targets: ["fastrt-bench"]),
+        .executable(name: "fastrt-climatology", targets: ["fastrt-climatology"]),
+        .executable(name: "fastrt-batch", targets: ["fastrt-batch"]),
+        .executable(name: "fastrt-daemon", targets: ["fastrt-daemon"]),
+        .executable(name: "fastrt-pack", targets: ["fastrt-pack"]),
+        .executable(name: "fastrt-tables", targets: ["fastrt-tables"]),
+        .executable(name: "fastrt-densify", targets: ["fastrt-densify"]),
+        .executable(name: "fastrt-subset", targets: ["fastrt-subset"]),
+        .executable(name: "fastrt-embed", targets: ["fastrt-embed"]),
     ],
     targets: [
         .target(
@@ -13,9 +23,62 @@ let package = Package(
                 .copy("./Resources"),
             ],
             linkerSettings: [
-                .unsafeFlags(["-Xlinker", "-no_application_extension"])
+                .unsafeFlags(["-Xlinker", "-no_application_extension"],
+                             .when(platforms: [.macOS, .iOS, .watchOS, .tvOS])),
+                .linkedLibrary("m", .when(platforms: [.linux])),
+                .linkedLibrary("pthread", .when(platforms: [.linux])),
             ]
         ),
+        .target(
+            name: "FastRTEmbedded",
+            dependencies: ["FastRT"],
+            path: "Sources/FastRTEmbedded"
+        ),
+        .target(
+            name: "fastrt-bench",
+            dependencies: ["FastRT", "FastRTEmbedded"],
+            path: "Benchmarks/fastrt-bench"
+        ),
+        .target(
+            name: "fastrt-climatology",
+            dependencies: ["FastRT"],
+            path: "Tools/fastrt-climatology"
+        ),
+        .target(
+            name: "fastrt-batch",
+            dependencies: ["FastRT"],
+            path: "Tools/fastrt-batch"
+        ),
+        .target(
+            name: "fastrt-daemon",
+            dependencies: ["FastRT"],
+            path: "Tools/fastrt-daemon"
+        ),
+        .target(
+            name: "fastrt-pack",
+            dependencies: ["FastRT"],
+            path: "Tools/fastrt-pack"
+        ),
+        .target(
+            name: "fastrt-tables",
+            dependencies: ["FastRT"],
+            path: "Tools/fastrt-tables"
+        ),
+        .target(
+            name: "fastrt-densify",
+            dependencies: ["FastRT"],
+            path: "Tools/fastrt-densify"
+        ),
+        .target(
+            name: "fastrt-subset",
+            dependencies: ["FastRT"],
+            path: "Tools/fastrt-subset"
+        ),
+        .target(
+            name: "fastrt-embed",
+            dependencies: ["FastRT"],
+            path: "Tools/fastrt-embed"
+        ),
     ]
-    
+
 )
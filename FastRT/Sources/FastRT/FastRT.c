@@ -9,6 +9,7 @@
 #include "fastrt_.h"
 #include "sun.h"
 #include <math.h>
+#include <stdlib.h>
 
 void print_debug_params(int argc, char** argv)
 {
@@ -27,6 +28,7 @@ int get_sunrise_sunset(
                        double longitude,
                        double altitude)
 {
+    // exact location, not the cached table quantized to DAYLIGHT_QUANTUM
     return zenith2time(dayinyear,
                 90.0, //expected angle
                 latitude,
@@ -37,6 +39,43 @@ int get_sunrise_sunset(
     
 }
 
+int get_daylight_window(
+                        int *out_sunrise,
+                        int *out_sunset,
+                        int *out_solar_noon,
+                        double *out_min_zenith,
+                        int dayinyear,
+                        double latitude,
+                        double longitude)
+{
+    DAYLIGHT_WINDOW window;
+    // same longitude convention as run_fastrt and get_day_sun_angle_data
+    int status = daylight_window(dayinyear, latitude, -1 * longitude, &window);
+
+    if (status != 0)
+        return status;
+
+    *out_sunrise = window.sunrise;
+    *out_sunset = window.sunset;
+    *out_solar_noon = window.solar_noon;
+    *out_min_zenith = window.min_zenith;
+    return window.type;
+}
+
+bool is_daylight(
+                 int dayinyear,
+                 int seconds_from_midnight,
+                 double latitude,
+                 double longitude)
+{
+    DAYLIGHT_WINDOW window;
+
+    if (daylight_window(dayinyear, latitude, -1 * longitude, &window) != 0)
+        return true; // let run_fastrt decide
+
+    return daylight_contains(&window, seconds_from_midnight);
+}
+
 int get_day_sun_angle_data(
                            double* angles,
                            int* times,
@@ -49,40 +88,54 @@ int get_day_sun_angle_data(
 {
     int i;
     int step_size_seconds = 86400 / num_of_steps;
-    double zenith;
+    int status;
+    int *std_times;
+    double *lats, *longs;
+    SUN_EPHEMERIS eph;
+
+    // declination and equation of time are the same for every step of the day,
+    // so compute them once and evaluate all steps in one vectorizable pass
+    sun_ephemeris(dayinyear, &eph);
+
+    std_times = (int *) calloc(num_of_steps, sizeof(int));
+    lats = (double *) calloc(num_of_steps, sizeof(double));
+    longs = (double *) calloc(num_of_steps, sizeof(double));
+    if (std_times == NULL || lats == NULL || longs == NULL)
+    {
+        free(std_times);
+        free(lats);
+        free(longs);
+        return -1;
+    }
+
     for (i = 0; i < num_of_steps; i++)
     {
         seconds_from_midnight += step_size_seconds;
-        zenith = solar_zenith(seconds_from_midnight % 86400,
-                                     dayinyear,
-                                     latitude,
-                                     -1 * longitude,
-                                     0.0);
         times[i] = seconds_from_midnight;
-        if (zenith < 0.0)
-        {
-            angles[i] = 0.0;
-        }
-        if (zenith > 90)
+        std_times[i] = seconds_from_midnight % 86400;
+        lats[i] = latitude;
+        longs[i] = -1 * longitude;
+    }
+
+    status = solar_zenith_azimuth_soa(&eph, num_of_steps, std_times, lats, longs, 0.0, angles, NULL);
+
+    for (i = 0; i < num_of_steps; i++)
+    {
+        if (angles[i] > 90)
         {
             angles[i] = 90.0;
         }
-        else
-        {
-            angles[i] = zenith;
-        }
     }
-    return 0;
+
+    free(std_times);
+    free(lats);
+    free(longs);
+    return status;
 }
 
 int run_fastrt_test_inputs(double *doserates)
 {
     
-    double zenith = solar_zenith(37800,
-                                 104,
-                                 50.50,
-                                 4.20,
-                                 0.001545);
     char s_StartWavelength[10];
     snprintf(s_StartWavelength, 10, "%d", 290);
     
@@ -149,6 +202,35 @@ int run_fastrt(
                int sky_condition_type,
                bool silent
                )
+{
+    return run_fastrt_with_engine(NULL,
+                                  doserates,
+                                  startWavelength,
+                                  endWavelength,
+                                  stepWavelength,
+                                  dayinyear,
+                                  latitude,
+                                  longitude,
+                                  altitude,
+                                  seconds_from_midnight,
+                                  sky_condition_type,
+                                  silent);
+}
+
+int run_fastrt_with_engine(
+                           FASTRT_ENGINE *engine,
+                           double* doserates,
+                           int startWavelength,
+                           int endWavelength,
+                           double stepWavelength,
+                           int dayinyear,
+                           double latitude,
+                           double longitude,
+                           double altitude,
+                           int seconds_from_midnight,
+                           int sky_condition_type,
+                           bool silent
+                           )
 {
     if (!silent)
     {
@@ -237,7 +319,7 @@ int run_fastrt(
         int argc = 21;
         if (!silent)
             print_debug_params(argc, argv);
-        return run_fastrt_(argc, argv, doserates);
+        return fastrt_engine_run(engine, argc, argv, doserates);
     }
     // scattered clouds
     else if (sky_condition_type == 1)
@@ -257,7 +339,7 @@ int run_fastrt(
         int argc = 21;
         if (!silent)
             print_debug_params(argc, argv);
-        return run_fastrt_(argc, argv, doserates);
+        return fastrt_engine_run(engine, argc, argv, doserates);
     }
     // broken clouds
     else if (sky_condition_type == 2)
@@ -278,7 +360,7 @@ int run_fastrt(
         int argc = 22;
         if (!silent)
             print_debug_params(argc, argv);
-        return run_fastrt_(argc, argv, doserates);
+        return fastrt_engine_run(engine, argc, argv, doserates);
     }
     // overcast
     else if (sky_condition_type == 3)
@@ -298,6 +380,7 @@ int run_fastrt(
         int argc = 21;
         if (!silent)
             print_debug_params(argc, argv);
-        return run_fastrt_(argc, argv, doserates);
+        return fastrt_engine_run(engine, argc, argv, doserates);
     }
+    return -1;
 }
@@ -0,0 +1,197 @@
+/************************************************************************/
+/* arena.c                                                              */
+/*                                                                      */
+/* Bump allocator for the working memory of one request, see arena.h.   */
+/*                                                                      */
+/* A chunk header is followed by its data, which starts at ARENA_ALIGN. */
+/* The arena of a thread is freed by a pthread key destructor when the  */
+/* thread ends; the arena of the main thread lives until exit.          */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "arena.h"
+
+
+/* size of the chunk header, rounded up to ARENA_ALIGN */
+#define ARENA_HEADER  ((sizeof(ARENA_BLOCK) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+#define ROUND(n)      (((n) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+
+static pthread_key_t   arena_key;
+static pthread_once_t  arena_once = PTHREAD_ONCE_INIT;
+static __thread ARENA *arena_local = NULL;
+
+
+static ARENA_BLOCK *new_chunk (ARENA *arena, size_t size)
+{
+  ARENA_BLOCK *chunk=NULL;
+  void *p=NULL;
+
+  if (size < ARENA_CHUNK)
+    size = ARENA_CHUNK;
+
+  if (posix_memalign (&p, ARENA_ALIGN, ARENA_HEADER + size) != 0)
+    return NULL;
+
+  chunk = (ARENA_BLOCK *) p;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->next = arena->chunks;
+
+  arena->chunks = chunk;
+  arena->held  += size;
+  arena->grows++;
+  return chunk;
+}
+
+
+static void free_chunks (ARENA *arena)
+{
+  ARENA_BLOCK *chunk=NULL, *next=NULL;
+
+  for (chunk=arena->chunks; chunk!=NULL; chunk=next)  {
+    next = chunk->next;
+    free (chunk);
+  }
+  arena->chunks = NULL;
+  arena->held   = 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: arena_init                                                            */
+/* Description:                                                                    */
+/*  Initialize an empty arena; the first chunk is allocated by arena_calloc().     */
+/***********************************************************************************/
+
+void arena_init (ARENA *arena)
+{
+  memset (arena, 0, sizeof(ARENA));
+}
+
+
+
+/***********************************************************************************/
+/* Function: arena_calloc                                                          */
+/* Description:                                                                    */
+/*  Zeroed memory for n elements of size bytes, aligned to ARENA_ALIGN, valid      */
+/*  until the next arena_reset().                                                  */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The memory, NULL if out of memory or n*size is 0.                              */
+/***********************************************************************************/
+
+void *arena_calloc (ARENA *arena, size_t n, size_t size)
+{
+  ARENA_BLOCK *chunk=arena->chunks;
+  size_t bytes=0;
+  char *p=NULL;
+
+  if (n == 0 || size == 0 || n > ((size_t) -1 - ARENA_ALIGN) / size)
+    return NULL;
+
+  bytes = ROUND (n * size);
+
+  if (chunk == NULL || chunk->size - chunk->used < bytes)
+    if ((chunk = new_chunk (arena, bytes)) == NULL)
+      return NULL;
+
+  p = (char *) chunk + ARENA_HEADER + chunk->used;
+  chunk->used += bytes;
+
+  arena->used += bytes;
+  if (arena->used > arena->peak)
+    arena->peak = arena->used;
+
+  memset (p, 0, n * size);
+  return p;
+}
+
+
+
+/***********************************************************************************/
+/* Function: arena_reset                                                           */
+/* Description:                                                                    */
+/*  Take back all memory handed out. If the last request needed more than one      */
+/*  chunk, the chunks are replaced by one of the peak size, so that the next       */
+/*  request of the same size fits into a single chunk.                             */
+/***********************************************************************************/
+
+void arena_reset (ARENA *arena)
+{
+  if (arena->chunks != NULL && arena->chunks->next != NULL)  {
+    free_chunks (arena);
+    new_chunk (arena, arena->peak);
+  }
+
+  if (arena->chunks != NULL)
+    arena->chunks->used = 0;
+  arena->used = 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: arena_free                                                            */
+/* Description:                                                                    */
+/*  Free all chunks; the arena is empty afterwards and may be used again.          */
+/***********************************************************************************/
+
+void arena_free (ARENA *arena)
+{
+  free_chunks (arena);
+  arena->used = 0;
+}
+
+
+
+static void free_thread_arena (void *p)
+{
+  arena_free ((ARENA *) p);
+  free (p);
+}
+
+
+static void create_key (void)
+{
+  pthread_key_create (&arena_key, free_thread_arena);
+}
+
+
+
+/***********************************************************************************/
+/* Function: arena_thread                                                          */
+/* Description:                                                                    */
+/*  The arena of the calling thread, created on first use and freed when the       */
+/*  thread ends.                                                                   */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The arena, NULL if out of memory.                                              */
+/***********************************************************************************/
+
+ARENA *arena_thread (void)
+{
+  ARENA *arena=NULL;
+
+  if (arena_local != NULL)
+    return arena_local;
+
+  pthread_once (&arena_once, create_key);
+
+  if ((arena = (ARENA *) calloc (1, sizeof(ARENA))) == NULL)
+    return NULL;
+
+  if (pthread_setspecific (arena_key, arena) != 0)  {
+    free (arena);
+    return NULL;
+  }
+
+  arena_local = arena;
+  return arena;
+}
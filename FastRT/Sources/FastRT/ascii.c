@@ -134,10 +134,13 @@
 #include <float.h>
 #include <math.h>
 
+#ifdef __APPLE__
 #include <CoreFoundation/CFBundle.h>
 #include <CoreFoundation/CFUtilities.h>
+#endif
 
 #include "ascii.h"
+#include "trace.h"
 
 
 
@@ -207,14 +210,65 @@ static int ASCII_comment (char t);
 /*                                                                        @i30_30@ */
 /***********************************************************************************/
 
+/* directory the table files are resolved against, overrides the bundle lookup */
+static char ascii_resource_path[FILENAME_MAX] = "";
+
+void ASCII_set_resource_path(const char *path)
+{
+    if (path == NULL)
+        ascii_resource_path[0] = 0;
+    else
+        snprintf(ascii_resource_path, sizeof(ascii_resource_path), "%s", path);
+}
+
+/* files opened and bytes read by ASCII_checkfile() and ASCII_readfile() */
+static long ascii_files_opened = 0;
+static long ascii_bytes_read = 0;
+
+static void count_file(long bytes)
+{
+    __atomic_fetch_add(&ascii_files_opened, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ascii_bytes_read, bytes, __ATOMIC_RELAXED);
+}
+
+void ASCII_get_counters(long *files_opened, long *bytes_read)
+{
+    if (files_opened != NULL)
+        *files_opened = __atomic_load_n(&ascii_files_opened, __ATOMIC_RELAXED);
+    if (bytes_read != NULL)
+        *bytes_read = __atomic_load_n(&ascii_bytes_read, __ATOMIC_RELAXED);
+}
+
+static int resource_path_override(char *filename, char* resource_path_out)
+{
+    const char *base = ascii_resource_path[0] != 0 ? ascii_resource_path : getenv("FASTRT_RESOURCES");
+    int hasLeadingjunk = 0;
+
+    if (base == NULL || base[0] == 0 || filename[0] == '/')
+        return ASCIIFILE_NOT_FOUND;
+
+    if (strlen(filename) > 2 && filename[0] == '.' && filename[1] == '/')
+        hasLeadingjunk = 2;
+
+    if (snprintf(resource_path_out, 1024, "%s/%s", base, filename + hasLeadingjunk) >= 1024)
+        return ASCIIFILE_NOT_FOUND;
+    return 0;
+}
+
+#ifdef __APPLE__
 void check_and_release_CFRef(CFTypeRef ref)
 {
     if (ref != NULL)
         CFRelease(ref);
 }
+#endif
 
 int swift_package_file_access_shim(char *filename, char* resource_path_out)
 {
+    if (resource_path_override(filename, resource_path_out) == 0)
+        return 0;
+
+#ifdef __APPLE__
     CFBundleRef mainbundle = CFBundleGetMainBundle();
     CFURLRef FastRTBundleURL = CFBundleCopyResourceURL(mainbundle, CFSTR("FastRT_FastRT.bundle"), NULL, NULL);
 //    check_and_release_CFRef(mainbundle);
@@ -247,6 +301,12 @@ int swift_package_file_access_shim(char *filename, char* resource_path_out)
     }
     check_and_release_CFRef(resource_url);
     return 0;
+#else
+    // no bundle outside Apple platforms, resolve relative to the working directory
+    if (snprintf(resource_path_out, 1024, "%s", filename) >= 1024)
+        return ASCIIFILE_NOT_FOUND;
+    return 0;
+#endif
 }
 
 int ASCII_checkfile (char *filename, 
@@ -260,8 +320,10 @@ int ASCII_checkfile (char *filename,
   char line[MAX_LENGTH_OF_LINE+1]="";
   char *token=NULL;
   char *string=NULL;
+  char *last=NULL;
   int temp1=0, temp2=0;
   int min_col=INT_MAX, max_col=0, max_len=0, r=0;
+  long bytes=0;
   
 
   /* reset parameters */
@@ -273,7 +335,10 @@ int ASCII_checkfile (char *filename,
   string = line;
     
     char resource_path[1024] = "";
-    if (swift_package_file_access_shim(filename, resource_path) == ASCIIFILE_NOT_FOUND)
+    double t0 = trace_begin();
+    int resolved = swift_package_file_access_shim(filename, resource_path);
+    trace_end(TRACE_RESOLVE, t0);
+    if (resolved == ASCIIFILE_NOT_FOUND)
         return ASCIIFILE_NOT_FOUND;
   
   if ( (f = fopen(resource_path, "r")) == NULL)
@@ -282,7 +347,9 @@ int ASCII_checkfile (char *filename,
   /* count rows and columns */
   while ( fgets (string, MAX_LENGTH_OF_LINE, f) != NULL )  {
 
-    if ( (token = strtok (string, " \t\n")) != NULL ) { /* if not an empty line */ 
+    bytes += strlen (string);
+
+    if ( (token = strtok_r (string, " \t\n", &last)) != NULL ) { /* if not an empty line */ 
       /* if not a comment     */
       if (!ASCII_comment(token[0]))  {
 
@@ -293,7 +360,7 @@ int ASCII_checkfile (char *filename,
 	temp2 = strlen(token);
 	max_len = (temp2>max_len ? temp2 : max_len);
 
-	while ( (token = strtok (NULL, " \t\n")) != NULL)  {
+	while ( (token = strtok_r (NULL, " \t\n", &last)) != NULL)  {
 
 	  /* check for maximal string length */
 	  temp2 = strlen(token);
@@ -320,6 +387,7 @@ int ASCII_checkfile (char *filename,
   
 
   fclose (f);
+  count_file (bytes);
   return 0;
 }
 
@@ -665,13 +733,18 @@ int ASCII_readfile (char *filename,
   char line[MAX_LENGTH_OF_LINE+1]="";
   char *string=NULL;
   char *t=NULL;
+  char *last=NULL;
   int row=0, column=0;
+  long bytes=0;
 
   
   string = line;
     
     char resource_path[1024] = "";
-    if (swift_package_file_access_shim(filename, resource_path) == ASCIIFILE_NOT_FOUND)
+    double t0 = trace_begin();
+    int resolved = swift_package_file_access_shim(filename, resource_path);
+    trace_end(TRACE_RESOLVE, t0);
+    if (resolved == ASCIIFILE_NOT_FOUND)
         return ASCIIFILE_NOT_FOUND;
   
   if ( (f = fopen(resource_path, "r")) == NULL)
@@ -679,13 +752,14 @@ int ASCII_readfile (char *filename,
 
   while ( fgets (string, MAX_LENGTH_OF_LINE, f) != NULL )  {
 
+    bytes += strlen (string);
     column=0;
 
-    if ( (t = strtok (string, " \t\n") ) != NULL)  {  /* if not an empty line */ 
+    if ( (t = strtok_r (string, " \t\n", &last) ) != NULL)  {  /* if not an empty line */ 
       if (!ASCII_comment(t[0]))  { /* if not a comment */
 	strcpy (array[row][column++], t);
 	
-	while ( (t = strtok (NULL, " \t\n") ) != NULL)  {
+	while ( (t = strtok_r (NULL, " \t\n", &last) ) != NULL)  {
 	  if (ASCII_comment(t[0]))     /* if comment */
 	    break;
 	  strcpy (array[row][column++], t);
@@ -700,6 +774,7 @@ int ASCII_readfile (char *filename,
 
 
   fclose (f);
+  count_file (bytes);
   return 0;
 }
 
@@ -862,6 +937,89 @@ int ASCII_file2double (char *filename,
 
 
 
+/***********************************************************************************/
+/* Function: ASCII_file2matrix                                            @30_30i@ */
+/* Description: As ASCII_file2double, but store the data in a contiguous           */
+/*        rows x max_columns matrix in a single allocation (MATRIX_PACKED,         */
+/*        see matrix.h), value[row*max_columns+column]; the matrix can be freed    */
+/*        with matrix_free (value).                                                */
+/* Parameters:                                                                     */
+/*  char *filename:     Name of the file which should be parsed                    */
+/*  int  *rows:         Number of rows, set by function                            */
+/*  int  *min_columns:  Minimum number of columns, set by function                 */
+/*  int  *max_columns:  Maximum number of columns, set by function                 */
+/*  MATRIX *value:      The matrix, allocated by the function                      */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error                                                        */
+/*                                                                                 */
+/* Example:                                                                        */
+/* Files:                                                                          */
+/* Known bugs:                                                                     */
+/* Author:                                                                @i30_30@ */
+/***********************************************************************************/
+
+int ASCII_file2matrix (char *filename,   
+		       int *rows,        
+		       int *max_columns, 
+		       int *min_columns, 
+		       MATRIX *value)  
+{
+  char ***string = NULL;
+  char *dummy=NULL;
+  int status=0;
+  int max_length=0;
+  int i=0, j=0;
+
+  memset (value, 0, sizeof(MATRIX));
+
+  /* count rows and columns of ASCII file <filename> */
+  if ( (status = ASCII_checkfile (filename, 
+				  rows, 
+				  min_columns, 
+				  max_columns, 
+				  &max_length)) != 0)
+    return status;
+  
+  /* allocate memory for string array */
+  if ( (status = ASCII_calloc_string (&string, 
+				      *rows, 
+				      *max_columns, 
+				      max_length)) != 0 )
+    return status;
+  
+  /* read ASCII file to string array */
+  if ( (status = ASCII_readfile (filename, string)) != 0)  {
+    ASCII_free_string (string, *rows, *max_columns);
+    return status;
+  }
+
+  /* allocate memory for the matrix, at least one element for empty files */
+  if ( (status = matrix_create (value, (*rows > 0 ? *rows : 1), 
+				(*max_columns > 0 ? *max_columns : 1), MATRIX_PACKED)) != 0 )  {
+    ASCII_free_string (string, *rows, *max_columns);
+    return status;
+  }
+
+  /* convert string array to double, as ASCII_string2double */
+  for (i=0; i<*rows; i++) 
+    for (j=0; j<*max_columns; j++)  {
+
+      if (string[i][j][0] == 0)  
+	MATRIX_AT (value, i, j) = NAN;
+      else  
+	MATRIX_AT (value, i, j) = strtod (string[i][j], &dummy);
+
+    }
+
+  /* free memory of string array */
+  ASCII_free_string (string, *rows, *max_columns);
+
+  return 0;  /* everything ok */
+} 
+
+
+
 /***********************************************************************************/
 /* Function: ASCII_file2float                                             @30_30i@ */
 /* Description: Read an ASCII file and store data in a twodimensional array        */
@@ -1239,6 +1397,7 @@ int ASCII_parse (char *string, char *separator, char ***array, int *number)
   char *start=NULL;
   char *t=NULL;
   char *save=NULL;
+  char *last=NULL;
   char **temp=NULL;
 
   /* save start address of string */
@@ -1253,10 +1412,10 @@ int ASCII_parse (char *string, char *separator, char ***array, int *number)
   *number=0;
   
   /* count words */
-  if ( (t = strtok (string, separator) ) != NULL)  {  /* if not an empty line */ 
+  if ( (t = strtok_r (string, separator, &last) ) != NULL)  {  /* if not an empty line */ 
     if (!ASCII_comment(t[0]))  {  /* if not a comment     */
       (*number)++;
-      while ( (t = strtok (NULL, separator) ) != NULL)  {
+      while ( (t = strtok_r (NULL, separator, &last) ) != NULL)  {
 	if (ASCII_comment(t[0]))     /* if comment */
 	  break;
 
@@ -1283,11 +1442,11 @@ int ASCII_parse (char *string, char *separator, char ***array, int *number)
   *number=0;  
 
   /* now set array pointers */
-  if ( (t = strtok (string, separator) ) != NULL)  {
+  if ( (t = strtok_r (string, separator, &last) ) != NULL)  {
     if (!ASCII_comment(t[0]))  {             
       temp[(*number)++] = t;
       
-      while ( (t = strtok (NULL, separator) ) != NULL)  {
+      while ( (t = strtok_r (NULL, separator, &last) ) != NULL)  {
 	if (ASCII_comment(t[0]))    
 	  break;
 
@@ -0,0 +1,491 @@
+/************************************************************************/
+/* climatology.c                                                        */
+/*                                                                      */
+/* Daily erythemal and vitamin D doses for many sites, days and sky     */
+/* conditions, see climatology.h.                                       */
+/*                                                                      */
+/* All threads share the tables of one engine. The checkpoint file is   */
+/* rewritten after every block with the number of finished items and    */
+/* the length of the output at that point; a resumed run truncates the  */
+/* output to that length and continues with the next item.              */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "climatology.h"
+#include "daylight.h"
+#include "dose.h"
+#include "sun.h"
+
+
+#define CLIM_OZONE           400.0   /* as run_fastrt() */
+#define CLIM_ALBEDO          0.03
+
+
+typedef struct {
+  FASTRT_ENGINE   *engine;
+  const CLIM_SPEC *spec;
+  int              n_days;
+  int              n_skies;
+  int              skies[4];
+  long             first;        /* first item of the block          */
+  long             n;            /* items in the block               */
+  double          *erythema;     /* n x n_skies results              */
+  double          *vitamin_d;
+} CLIM_WORK;
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static int standard_time (int t)
+{
+  return ((t % 86400) + 86400) % 86400;
+}
+
+
+/* wavelengths, slit function and surface of run_fastrt() */
+static int clim_template (FASTRT_REQUEST *req, int day)
+{
+  int status=0;
+
+  fastrt_request_init (req);
+  req->o3          = CLIM_OZONE;
+  req->albedo_flag = 1;
+  req->alb         = CLIM_ALBEDO;
+  req->day_flag    = 1;
+  req->day         = day;
+
+  if ((status = fastrt_request_set_lambda (req, DOSE_LAMBDA_START, DOSE_LAMBDA_END, 1.0)) != 0)
+    return status;
+  return fastrt_request_set_fwhm (req, FWHM_DEFAULT);
+}
+
+
+static int daily_dose (FASTRT_ENGINE *engine, FASTRT_REQUEST *req, const CLIM_SITE *site,
+		       int day, int sky, int step, double *erythema, double *vitamin_d)
+{
+  DAYLIGHT_WINDOW window;
+  SUN_EPHEMERIS eph;
+  double doserates[DOSE_N_LAMBDA], zenith=0.0;
+  int t=0, dt=0, start=0, end=0, status=0;
+
+  *erythema  = 0.0;
+  *vitamin_d = 0.0;
+
+  if (step < 1)
+    return -1;
+
+  req->day = day;
+  if ((status = fastrt_request_set_sky (req, sky)) != 0)
+    return status;
+  req->alt = floor (site->altitude * 1000.0 + 0.5) / 1000.0;
+
+  /* sun.c and daylight.c are West positive */
+  if ((status = daylight_window (day, site->latitude, -site->longitude, &window)) != 0)
+    return status;
+
+  if (window.type == DAYLIGHT_POLAR_NIGHT)
+    return 0;
+
+  start = window.sunrise;
+  end   = window.sunset;
+  sun_ephemeris (day, &eph);
+
+  for (t=start; t<end; t+=step)  {
+    dt = (end - t < step ? end - t : step);
+
+    zenith = solar_zenith_eph (&eph, standard_time (t + dt/2),
+			       site->latitude, -site->longitude, 0.0);
+    if (zenith < 0.0 || zenith > 90.0)
+      continue;
+
+    /* run_fastrt() passes the zenith angle with 3 decimals */
+    req->sza = floor (zenith * 1000.0 + 0.5) / 1000.0;
+
+    status = fastrt_compute (engine, req, doserates);
+    if (status < 0)
+      return status;
+    if (status != 0)   /* the app counts failed slices as 0 */
+      continue;
+
+    /* mW m-2 s -> J m-2 */
+    *erythema  += dose_rate (doserates, DOSE_ERYTHEMA)  * dt / 1000.0;
+    *vitamin_d += dose_rate (doserates, DOSE_VITAMIN_D) * dt / 1000.0;
+  }
+
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: climatology_daily_dose                                                */
+/* Description:                                                                    */
+/*  Integrate the erythemal and vitamin D dose rates of one site from sunrise to   */
+/*  sunset in steps of step seconds, for one of the sky conditions of              */
+/*  run_fastrt().                                                                  */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int climatology_daily_dose (FASTRT_ENGINE *engine, const CLIM_SITE *site, int day, int sky,
+			    int step, double *erythema, double *vitamin_d)
+{
+  FASTRT_REQUEST req;
+  int status=0;
+
+  if ((status = clim_template (&req, day)) == 0)
+    status = daily_dose (engine, &req, site, day, sky, step, erythema, vitamin_d);
+
+  fastrt_request_free (&req);
+  return status;
+}
+
+
+static int clim_init (void *arg, TASKPOOL_WORKER *worker)
+{
+  CLIM_WORK *block = (CLIM_WORK *) arg;
+  FASTRT_REQUEST *req=NULL;
+
+  if ((req = (FASTRT_REQUEST *) taskpool_scratch (worker, sizeof(FASTRT_REQUEST))) == NULL)
+    return -1;
+  worker->user = req;
+  return clim_template (req, block->spec->first_day);
+}
+
+
+static int clim_task (void *arg, TASKPOOL_WORKER *worker, long first, long n)
+{
+  CLIM_WORK *block = (CLIM_WORK *) arg;
+  const CLIM_SPEC *spec = block->spec;
+  long i=0, r=0;
+  int s=0, status=0;
+
+  for (i=first; i<first+n; i++)  {
+    long item = block->first + i;
+
+    for (s=0; s<block->n_skies; s++)  {
+      r = i * block->n_skies + s;
+
+      status = daily_dose (block->engine, (FASTRT_REQUEST *) worker->user,
+			   &spec->sites[item / block->n_days],
+			   spec->first_day + (int) (item % block->n_days), block->skies[s],
+			   spec->step, &block->erythema[r], &block->vitamin_d[r]);
+      if (status != 0)  {
+	block->erythema[r]  = NAN;
+	block->vitamin_d[r] = NAN;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+static void clim_fini (void *arg, TASKPOOL_WORKER *worker)
+{
+  (void) arg;
+  if (worker->user != NULL)
+    fastrt_request_free ((FASTRT_REQUEST *) worker->user);
+}
+
+
+static unsigned long long spec_hash (const CLIM_SPEC *spec)
+{
+  unsigned long long hash=0;
+  int header[5];
+
+  header[0] = spec->first_day;
+  header[1] = spec->last_day;
+  header[2] = spec->sky_mask;
+  header[3] = spec->step;
+  header[4] = spec->format;
+
+  hash = tablestore_hash (0, header, sizeof(header));
+  return tablestore_hash (hash, spec->sites, spec->n_sites * sizeof(CLIM_SITE));
+}
+
+
+/* returns 1 and the progress if the checkpoint belongs to spec */
+static int read_checkpoint (const CLIM_SPEC *spec, long *items, long *bytes)
+{
+  FILE *f=NULL;
+  unsigned long long hash=0;
+  int ok=0;
+
+  if (spec->checkpoint == NULL || (f = fopen (spec->checkpoint, "r")) == NULL)
+    return 0;
+
+  ok = (fscanf (f, CLIM_MAGIC " checkpoint %llx %ld %ld", &hash, items, bytes) == 3 &&
+	hash == spec_hash (spec) && *items >= 0 && *bytes > 0);
+
+  fclose (f);
+  return ok;
+}
+
+
+static int write_checkpoint (const CLIM_SPEC *spec, long items, long bytes)
+{
+  char tmp[FILENAME_MAX+8];
+  FILE *f=NULL;
+
+  if (spec->checkpoint == NULL)
+    return 0;
+
+  /* write and rename, so that a crash leaves the old or the new checkpoint */
+  snprintf (tmp, sizeof(tmp), "%s.tmp", spec->checkpoint);
+  if ((f = fopen (tmp, "w")) == NULL)
+    return -1;
+
+  fprintf (f, CLIM_MAGIC " checkpoint %016llx %ld %ld\n", spec_hash (spec), items, bytes);
+  if (fflush (f) != 0 || fsync (fileno (f)) != 0)  {
+    fclose (f);
+    return -1;
+  }
+  fclose (f);
+
+  return rename (tmp, spec->checkpoint);
+}
+
+
+static int write_header (FILE *out, const CLIM_SPEC *spec)
+{
+  int header[5];
+
+  if (spec->format == CLIM_CSV)
+    return (fprintf (out, "site,latitude,longitude,altitude,day,sky,erythema,vitamin_d\n") < 0
+	    ? -1 : 0);
+
+  header[0] = spec->n_sites;
+  header[1] = spec->first_day;
+  header[2] = spec->last_day;
+  header[3] = spec->sky_mask;
+  header[4] = spec->step;
+
+  if (fwrite (CLIM_MAGIC, 1, 8, out) != 8 || fwrite (header, sizeof(int), 5, out) != 5)
+    return -1;
+  return 0;
+}
+
+
+static int write_block (FILE *out, const CLIM_SPEC *spec, const CLIM_WORK *block)
+{
+  int n = (int) (block->n * block->n_skies);
+  int *column=NULL;
+  long i=0;
+  int s=0, r=0, k=0, status=0;
+
+  if (spec->format == CLIM_CSV)  {
+    for (i=0; i<block->n; i++)  {
+      long item = block->first + i;
+      const CLIM_SITE *site = &spec->sites[item / block->n_days];
+      for (s=0; s<block->n_skies; s++, r++)
+	if (fprintf (out, "%ld,%.4f,%.4f,%.3f,%d,%d,%.6g,%.6g\n",
+		     item / block->n_days, site->latitude, site->longitude, site->altitude,
+		     spec->first_day + (int) (item % block->n_days), block->skies[s],
+		     block->erythema[r], block->vitamin_d[r]) < 0)
+	  return -1;
+    }
+    return 0;
+  }
+
+  if ((column = (int *) calloc (n, sizeof(int))) == NULL)
+    return -1;
+
+  if (fwrite (&n, sizeof(int), 1, out) != 1)
+    status = -1;
+
+  for (k=0; k<3 && status==0; k++)  {
+    for (i=0, r=0; i<block->n; i++)  {
+      long item = block->first + i;
+      for (s=0; s<block->n_skies; s++, r++)
+	column[r] = (k == 0 ? (int) (item / block->n_days) :
+		     k == 1 ? spec->first_day + (int) (item % block->n_days) :
+		     block->skies[s]);
+    }
+    if (fwrite (column, sizeof(int), n, out) != (size_t) n)
+      status = -1;
+  }
+
+  if (status == 0 &&
+      (fwrite (block->erythema,  sizeof(double), n, out) != (size_t) n ||
+       fwrite (block->vitamin_d, sizeof(double), n, out) != (size_t) n))
+    status = -1;
+
+  free (column);
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: climatology_spec_init                                                 */
+/* Description:                                                                    */
+/*  Set the defaults: whole year, all sky conditions, binary output.               */
+/***********************************************************************************/
+
+void climatology_spec_init (CLIM_SPEC *spec)
+{
+  memset (spec, 0, sizeof(CLIM_SPEC));
+
+  spec->first_day = 1;
+  spec->last_day  = 365;
+  spec->sky_mask  = CLIM_ALL_SKIES;
+  spec->step      = CLIM_STEP;
+  spec->format    = CLIM_BINARY;
+  spec->block     = CLIM_BLOCK;
+}
+
+
+
+/***********************************************************************************/
+/* Function: climatology_run                                                       */
+/* Description:                                                                    */
+/*  Compute the daily doses of all items of spec, or of the items left by an       */
+/*  earlier run with the same spec and checkpoint file, and append them to the     */
+/*  output.                                                                        */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  FASTRT_ENGINE *engine:   Engine shared by all threads; NULL for a private one. */
+/*  const CLIM_SPEC *spec:   Sites, days, sky conditions and output.               */
+/*  CLIM_STATS *stats:       Statistics, set by function, may be NULL.             */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int climatology_run (FASTRT_ENGINE *engine, const CLIM_SPEC *spec, CLIM_STATS *stats)
+{
+  FASTRT_ENGINE *own=NULL;
+  CLIM_WORK block;
+  CLIM_STATS st;
+  FILE *out=NULL;
+  long n_items=0, done=0, bytes=0, stop=0;
+  TASKPOOL_JOB job;
+  TASKPOOL *pool=NULL;
+  int n_threads=0, block_size=0, i=0, s=0, status=0;
+  double t0 = now();
+
+  memset (&st, 0, sizeof(CLIM_STATS));
+  memset (&block, 0, sizeof(CLIM_WORK));
+
+  if (spec == NULL || spec->sites == NULL || spec->n_sites < 1 || spec->output == NULL ||
+      spec->first_day < 1 || spec->last_day > DAYLIGHT_DAYS || spec->last_day < spec->first_day ||
+      spec->step < 1 || (spec->sky_mask & CLIM_ALL_SKIES) == 0)
+    return -1;
+
+  block.n_days = spec->last_day - spec->first_day + 1;
+  for (s=0; s<4; s++)
+    if (spec->sky_mask & (1 << s))
+      block.skies[block.n_skies++] = s;
+
+  n_items = (long) spec->n_sites * block.n_days;
+
+  n_threads = taskpool_threads (spec->n_threads);
+
+  block_size = (spec->block > 0 ? spec->block : CLIM_BLOCK);
+
+  /* resume or start over */
+  if (read_checkpoint (spec, &done, &bytes) && done <= n_items &&
+      (out = fopen (spec->output, "r+b")) != NULL)  {
+    if (ftruncate (fileno (out), bytes) != 0 || fseek (out, bytes, SEEK_SET) != 0)  {
+      fclose (out);
+      return -1;
+    }
+    st.resumed = done;
+  }
+  else  {
+    done = 0;
+    if ((out = fopen (spec->output, "wb")) == NULL)
+      return -1;
+    if (write_header (out, spec) != 0 || fflush (out) != 0 ||
+	write_checkpoint (spec, 0, ftell (out)) != 0)  {
+      fclose (out);
+      return -1;
+    }
+  }
+
+  stop = n_items;
+  if (spec->max_items > 0 && done + spec->max_items < stop)
+    stop = done + spec->max_items;
+
+  if (engine == NULL)  {
+    if ((own = fastrt_engine_create ()) == NULL)  {
+      fclose (out);
+      return -1;
+    }
+    engine = own;
+  }
+
+  block.engine    = engine;
+  block.spec      = spec;
+  block.erythema  = (double *) calloc ((size_t) block_size * block.n_skies, sizeof(double));
+  block.vitamin_d = (double *) calloc ((size_t) block_size * block.n_skies, sizeof(double));
+  if (block.erythema == NULL || block.vitamin_d == NULL)  {
+    status = -1;
+    goto cleanup;
+  }
+
+  /* the workers of all blocks */
+  if ((pool = taskpool_create (n_threads)) == NULL)  {
+    status = -1;
+    goto cleanup;
+  }
+
+  job.init = clim_init;
+  job.run  = clim_task;
+  job.fini = clim_fini;
+  job.arg  = &block;
+
+  while (done < stop)  {
+    block.first  = done;
+    block.n      = (stop - done < block_size ? stop - done : block_size);
+
+    /* one item per task: items are expensive and neighbours share the site */
+    if ((status = taskpool_run (pool, &job, block.n, 1, n_threads, spec->schedule, NULL)) != 0)
+      break;
+
+    if (write_block (out, spec, &block) != 0 || fflush (out) != 0 || fsync (fileno (out)) != 0)  {
+      status = -1;
+      break;
+    }
+
+    done += block.n;
+    if ((status = write_checkpoint (spec, done, ftell (out))) != 0)
+      break;
+
+    for (i=0; i<block.n * block.n_skies; i++)
+      if (isnan (block.erythema[i]))
+	st.failed++;
+    st.items   += block.n;
+    st.records += block.n * block.n_skies;
+  }
+
+ cleanup:
+  st.remaining = n_items - done;
+  taskpool_free (pool);
+  free (block.erythema);
+  free (block.vitamin_d);
+  fastrt_engine_free (own);
+  if (fclose (out) != 0 && status == 0)
+    status = -1;
+
+  st.seconds = now() - t0;
+  if (stats != NULL)
+    *stats = st;
+
+  return status;
+}
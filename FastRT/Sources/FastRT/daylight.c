@@ -0,0 +1,292 @@
+/************************************************************************/
+/* daylight.c                                                           */
+/*                                                                      */
+/* Annual sunrise, sunset and solar noon tables per location.           */
+/*                                                                      */
+/* A table holds the daylight window of every day of the year for one   */
+/* location. It is built in a single pass over the precomputed          */
+/* ephemerides of all days, and recently used tables are cached by      */
+/* quantized latitude/longitude, so that callers can clip day profiles  */
+/* and dose integrations to daylight with an O(1) lookup.               */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "daylight.h"
+
+
+/* same value as in sun.c, so that results match solar_zenith */
+#define _PI_ 3.1415926
+
+
+typedef struct {
+  long key_lat;              /* quantized latitude,  in DAYLIGHT_QUANTUM */
+  long key_lon;              /* quantized longitude, in DAYLIGHT_QUANTUM */
+  unsigned long last_used;   /* for least recently used replacement      */
+  DAYLIGHT_TABLE *table;     /* NULL if the slot is empty                */
+} DAYLIGHT_CACHE_ENTRY;
+
+static DAYLIGHT_CACHE_ENTRY daylight_cache[DAYLIGHT_CACHE_SIZE];
+static unsigned long daylight_clock = 0;
+static pthread_mutex_t daylight_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static long quantize (double angle)
+{
+  return lround (angle / DAYLIGHT_QUANTUM);
+}
+
+
+
+/***********************************************************************************/
+/* Function: daylight_table_build                                                  */
+/* Description:                                                                    */
+/*  Compute sunrise, sunset, solar noon and minimum zenith angle for all days of   */
+/*  the year at the given location. Sunrise and sunset are the times where the     */
+/*  zenith angle crosses 90 degrees, exactly as returned by zenith2time.           */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  double latitude:        Latitude [degrees] (North positive).                   */
+/*  double longitude:       Longitude [degrees] (West positive).                   */
+/*  DAYLIGHT_TABLE *table:  Table, set by function.                                */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int daylight_table_build (double latitude, double longitude, DAYLIGHT_TABLE *table)
+{
+  SUN_EPHEMERIS eph[DAYLIGHT_DAYS];
+  int sunrise[DAYLIGHT_DAYS], sunset[DAYLIGHT_DAYS], status[DAYLIGHT_DAYS];
+  int noon[DAYLIGHT_DAYS];
+  double zenith[DAYLIGHT_DAYS];
+  int i=0, result=0;
+  int dlong = (int) (240.0 * (0.0-longitude));
+  double phi = latitude*_PI_/180.0, sin_phi = sin(phi), cos_phi = cos(phi);
+  DAYLIGHT_WINDOW *w=NULL;
+
+  if (table == NULL)
+    return -1;
+
+  memset (table, 0, sizeof(DAYLIGHT_TABLE));
+  table->latitude  = latitude;
+  table->longitude = longitude;
+
+  for (i=0; i<DAYLIGHT_DAYS; i++)  {
+    sun_ephemeris (i+1, &eph[i]);
+  }
+
+  for (i=0; i<DAYLIGHT_DAYS; i++)  {
+    /* local apparent time 12:00 converted to standard time */
+    noon[i] = 43200 - dlong - eph[i].eqt;
+
+    /* solar_zenith at solar noon, where the hour angle is zero */
+    zenith[i] = acos(eph[i].sin_delta * sin_phi + eph[i].cos_delta * cos_phi)
+                * (180.0/_PI_);
+  }
+
+  result = zenith2time_soa (eph, DAYLIGHT_DAYS, 90.0, latitude, longitude, 0.0,
+			    sunrise, sunset, status);
+  if (result != 0)
+    return result;
+
+  for (i=0; i<DAYLIGHT_DAYS; i++)  {
+    w = &table->day[i+1];
+
+    w->solar_noon = noon[i];
+    w->min_zenith = zenith[i];
+
+    if (status[i] == 0)  {
+      w->type    = DAYLIGHT_NORMAL;
+      w->sunrise = sunrise[i];
+      w->sunset  = sunset[i];
+    }
+    else if (zenith[i] < 90.0)  {
+      w->type    = DAYLIGHT_POLAR_DAY;
+      w->sunrise = noon[i] - 43200;
+      w->sunset  = noon[i] + 43200;
+    }
+    else  {
+      w->type    = DAYLIGHT_POLAR_NIGHT;
+      w->sunrise = noon[i];
+      w->sunset  = noon[i];
+    }
+  }
+
+  /* day 0 is not a valid Julian day; mirror day 1 so that indexing is safe */
+  table->day[0] = table->day[1];
+
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: daylight_table_get                                                    */
+/* Description:                                                                    */
+/*  Copy the daylight table of a location into table. The location is quantized   */
+/*  to DAYLIGHT_QUANTUM; tables of the DAYLIGHT_CACHE_SIZE most recently used      */
+/*  locations are kept, so that repeated lookups cost a copy only. Thread safe.    */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  double latitude:        Latitude [degrees] (North positive).                   */
+/*  double longitude:       Longitude [degrees] (West positive).                   */
+/*  DAYLIGHT_TABLE *table:  Copy of the cached table, set by function.             */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int daylight_table_get (double latitude, double longitude, DAYLIGHT_TABLE *table)
+{
+  long key_lat = quantize (latitude), key_lon = quantize (longitude);
+  int i=0, victim=0, status=0;
+  DAYLIGHT_CACHE_ENTRY *entry=NULL;
+
+  if (table == NULL)
+    return -1;
+
+  pthread_mutex_lock (&daylight_lock);
+
+  for (i=0; i<DAYLIGHT_CACHE_SIZE; i++)  {
+    entry = &daylight_cache[i];
+    if (entry->table != NULL && entry->key_lat == key_lat && entry->key_lon == key_lon)  {
+      entry->last_used = ++daylight_clock;
+      memcpy (table, entry->table, sizeof(DAYLIGHT_TABLE));
+      pthread_mutex_unlock (&daylight_lock);
+      return 0;
+    }
+    if (entry->last_used < daylight_cache[victim].last_used)
+      victim = i;
+  }
+
+  entry = &daylight_cache[victim];
+  if (entry->table == NULL)
+    entry->table = (DAYLIGHT_TABLE *) calloc (1, sizeof(DAYLIGHT_TABLE));
+
+  if (entry->table == NULL)  {
+    pthread_mutex_unlock (&daylight_lock);
+    return -1;
+  }
+
+  status = daylight_table_build (key_lat * DAYLIGHT_QUANTUM, key_lon * DAYLIGHT_QUANTUM,
+				 entry->table);
+  if (status != 0)  {
+    free (entry->table);
+    entry->table = NULL;
+    entry->last_used = 0;
+    pthread_mutex_unlock (&daylight_lock);
+    return status;
+  }
+
+  entry->key_lat   = key_lat;
+  entry->key_lon   = key_lon;
+  entry->last_used = ++daylight_clock;
+  memcpy (table, entry->table, sizeof(DAYLIGHT_TABLE));
+
+  pthread_mutex_unlock (&daylight_lock);
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: daylight_window                                                       */
+/* Description:                                                                    */
+/*  Look up the daylight window of a single day, through the location cache.       */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  int day:                  Julian day (1..DAYLIGHT_DAYS).                       */
+/*  double latitude:          Latitude [degrees] (North positive).                 */
+/*  double longitude:         Longitude [degrees] (West positive).                 */
+/*  DAYLIGHT_WINDOW *window:  Window, set by function.                             */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int daylight_window (int day, double latitude, double longitude, DAYLIGHT_WINDOW *window)
+{
+  long key_lat = quantize (latitude), key_lon = quantize (longitude);
+  int i=0, status=0;
+  DAYLIGHT_TABLE *table=NULL;
+
+  if (window == NULL || day < 1 || day > DAYLIGHT_DAYS)
+    return -1;
+
+  /* fast path: copy one day only if the location is cached */
+  pthread_mutex_lock (&daylight_lock);
+  for (i=0; i<DAYLIGHT_CACHE_SIZE; i++)  {
+    if (daylight_cache[i].table != NULL &&
+	daylight_cache[i].key_lat == key_lat && daylight_cache[i].key_lon == key_lon)  {
+      daylight_cache[i].last_used = ++daylight_clock;
+      *window = daylight_cache[i].table->day[day];
+      pthread_mutex_unlock (&daylight_lock);
+      return 0;
+    }
+  }
+  pthread_mutex_unlock (&daylight_lock);
+
+  table = (DAYLIGHT_TABLE *) calloc (1, sizeof(DAYLIGHT_TABLE));
+  if (table == NULL)
+    return -1;
+
+  status = daylight_table_get (latitude, longitude, table);
+  if (status == 0)
+    *window = table->day[day];
+
+  free (table);
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: daylight_contains                                                     */
+/* Description:                                                                    */
+/*  Check whether a standard time lies within a daylight window. The time is       */
+/*  taken modulo one day, since windows may extend across midnight (standard       */
+/*  time), e.g. sunrise < 0 far west of the standard meridian.                     */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  1 if the sun is above the horizon, 0 otherwise.                                */
+/***********************************************************************************/
+
+int daylight_contains (const DAYLIGHT_WINDOW *window, int time)
+{
+  int t = ((time % 86400) + 86400) % 86400;
+
+  if (window->type == DAYLIGHT_POLAR_DAY)
+    return 1;
+  if (window->type == DAYLIGHT_POLAR_NIGHT)
+    return 0;
+
+  return (t          >= window->sunrise && t          <= window->sunset) ||
+         (t + 86400  >= window->sunrise && t + 86400  <= window->sunset) ||
+         (t - 86400  >= window->sunrise && t - 86400  <= window->sunset);
+}
+
+
+
+/***********************************************************************************/
+/* Function: daylight_cache_clear                                                  */
+/* Description:                                                                    */
+/*  Free all cached tables.                                                        */
+/***********************************************************************************/
+
+void daylight_cache_clear (void)
+{
+  int i=0;
+
+  pthread_mutex_lock (&daylight_lock);
+  for (i=0; i<DAYLIGHT_CACHE_SIZE; i++)  {
+    free (daylight_cache[i].table);
+    daylight_cache[i].table = NULL;
+    daylight_cache[i].last_used = 0;
+  }
+  pthread_mutex_unlock (&daylight_lock);
+}
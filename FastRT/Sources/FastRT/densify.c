@@ -0,0 +1,795 @@
+/************************************************************************/
+/* densify.c                                                            */
+/*                                                                      */
+/* Offline resampling of the transmittances onto a dense grid, see      */
+/* densify.h.                                                           */
+/*                                                                      */
+/* The input tables are read through one table store shared by the      */
+/* workers of the task pool; a task writes the dense nodes of one cloud */
+/* level, altitude and sza, the check evaluates one random point per    */
+/* task. Dense nodes are interpolated again for every check point       */
+/* instead of being read back, so the check does not depend on the      */
+/* resource path of the output.                                         */
+/*                                                                      */
+/************************************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "densify.h"
+#include "tablestore.h"
+#include "tablegrid.h"
+#include "taskpool.h"
+#include "pack.h"
+#include "spl.h"
+#include "ascii.h"
+
+
+#define DS_NAME   FILENAME_MAX
+
+/* spectra of scratch of linear_point() */
+#define DS_SCRATCH  (TABLEGRID_LINEAR + TABLEGRID_LINEAR*TABLEGRID_LINEAR + TABLEGRID_ALT_NODES)
+
+
+typedef struct {
+  const DENSIFY_SPEC *spec;
+  TABLE_STORE *store;           /* of the input tables                       */
+  TABLE_GRID   grid;            /* of the input tables                       */
+  TABLE_GRID   dense;
+  int          rows;            /* wavelengths of the transmittances         */
+
+  long   tables, skipped;       /* updated atomically by the workers         */
+
+  double *error;                /* largest relative error per check point    */
+  double *sum;                  /* sum of the squared relative errors        */
+  long   *count;                /* values compared                           */
+} DS_RUN;
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static int make_directory (const char *path)
+{
+  if (mkdir (path, 0777) != 0 && errno != EEXIST)
+    return -1;
+  return 0;
+}
+
+
+static int copy_file (const char *from, const char *to)
+{
+  char buffer[65536];
+  FILE *in=NULL, *out=NULL;
+  size_t n=0;
+  int status=0;
+
+  if ((in = fopen (from, "r")) == NULL)
+    return -1;
+  if ((out = fopen (to, "w")) == NULL)  {
+    fclose (in);
+    return -1;
+  }
+  while ((n = fread (buffer, 1, sizeof(buffer), in)) > 0)
+    if (fwrite (buffer, 1, n, out) != n)  {
+      status = -1;
+      break;
+    }
+  if (ferror (in))
+    status = -1;
+  fclose (in);
+  if (fclose (out) != 0)
+    status = -1;
+  return status;
+}
+
+
+/* from the first to the last node of an axis by step, always */
+/* including the last node                                    */
+static int dense_axis (TABLE_GRID *dense, int a, const TABLE_AXIS *axis, double step)
+{
+  double first=axis->x[0], last=axis->x[axis->n-1], *x=NULL;
+  int m=0, n=0, i=0, status=0;
+
+  if (!(step > 0.0))
+    return -1;
+
+  m = (int) floor ((last - first) / step + 1e-6);
+  if ((x = (double *) calloc (m + 2, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  for (i=0; i<=m; i++)
+    x[n++] = first + i * step;
+  if (x[n-1] < last - 1e-6 * step)
+    x[n++] = last;
+
+  status = tablegrid_set (dense, a, x, n);
+  free (x);
+  return status;
+}
+
+
+static void transmittance_name (char *name, const TABLE_GRID *grid, int cloud,
+				double sza, double o3, double alt)
+{
+  snprintf (name, DS_NAME, "./TransmittancesCloudH2O%5.3f/sza%gozone%galt%g",
+	    grid->axis[TABLEGRID_CLOUD].x[cloud], sza, o3, alt);
+}
+
+
+/* the value at sza and o3 of wavelength k of the points x points spectra */
+/* y around them, row major in sza, as in fastrt_compute(): splines in    */
+/* ozone and then in sza through the nodes without NaN; returns 1 if      */
+/* they cannot be interpolated                                            */
+static int cell_value (int points, const double *szagrid, const double *ozonegrid,
+		       double **y, int k, double sza, double o3, double *value)
+{
+  double x_o3[TABLEGRID_NEIGHBOURS], y_o3[TABLEGRID_NEIGHBOURS];
+  double x_sza[TABLEGRID_NEIGHBOURS], y_sza[TABLEGRID_NEIGHBOURS];
+  double a0[TABLEGRID_NEIGHBOURS], a1[TABLEGRID_NEIGHBOURS];
+  double a2[TABLEGRID_NEIGHBOURS], a3[TABLEGRID_NEIGHBOURS];
+  double work[SPLINE_WORK(TABLEGRID_NEIGHBOURS)], v=0.0;
+  int i=0, j=0, n_o3=0, n_sza=0;
+
+  for (i=0; i<points; i++)  {
+    n_o3 = 0;
+    for (j=0; j<points; j++)
+      if (y[i*points+j][k] != NaN)  {
+	x_o3[n_o3]   = ozonegrid[j];
+	y_o3[n_o3++] = y[i*points+j][k];
+      }
+    if (spline_coeffc_buffer (x_o3, y_o3, n_o3, a0, a1, a2, a3, work) == 0 &&
+	calc_splined_value (o3, &v, x_o3, n_o3, a0, a1, a2, a3) == 0)  {
+      x_sza[n_sza]   = szagrid[i];
+      y_sza[n_sza++] = v;
+    }
+  }
+
+  if (spline_coeffc_buffer (x_sza, y_sza, n_sza, a0, a1, a2, a3, work) != 0 ||
+      calc_splined_value (sza, value, x_sza, n_sza, a0, a1, a2, a3) != 0)
+    return 1;
+  return 0;
+}
+
+
+/* the polynomial through the n points x, y at t, as the Newton */
+/* polynomial of fastrt_compute() in altitude                   */
+static double polynomial (int n, const double *x, const double *y, double t)
+{
+  double sum=0.0, l=0.0;
+  int i=0, j=0;
+
+  for (i=0; i<n; i++)  {
+    l = 1.0;
+    for (j=0; j<n; j++)
+      if (j != i)
+	l *= (t - x[j]) / (x[i] - x[j]);
+    sum += l * y[i];
+  }
+  return sum;
+}
+
+
+/* the transmittance at sza and o3 of a cloud level and altitude node */
+/* of the input tables, splined as by fastrt_compute(); returns 1 if   */
+/* it cannot be interpolated, <0 if error                              */
+static int spline_at (DS_RUN *run, int cloud, int alt, double sza, double o3, double *spectrum)
+{
+  char name[DS_NAME];
+  TABLE_NODE *node[TABLEGRID_NEIGHBOURS*TABLEGRID_NEIGHBOURS];
+  double *y[TABLEGRID_NEIGHBOURS*TABLEGRID_NEIGHBOURS], *missing=NULL;
+  double szagrid[TABLEGRID_NEIGHBOURS], ozonegrid[TABLEGRID_NEIGHBOURS];
+  int sza_index[TABLEGRID_NEIGHBOURS], ozone_index[TABLEGRID_NEIGHBOURS];
+  int i=0, j=0, k=0, n=0, status=0;
+
+  tablegrid_neighbours (&run->grid.axis[TABLEGRID_SZA], sza, 1, TABLEGRID_CUBIC,
+			szagrid, sza_index);
+  tablegrid_neighbours (&run->grid.axis[TABLEGRID_OZONE], o3, 0, TABLEGRID_CUBIC,
+			ozonegrid, ozone_index);
+
+  if ((missing = (double *) calloc (run->rows, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  for (k=0; k<run->rows; k++)
+    missing[k] = NaN;
+
+  for (i=0; i<TABLEGRID_NEIGHBOURS; i++)
+    for (j=0; j<TABLEGRID_NEIGHBOURS; j++, n++)  {
+      node[n] = NULL;
+      y[n]    = missing;
+      if (status != 0 || sza_index[i] < 0 || ozone_index[j] < 0)
+	continue;
+
+      transmittance_name (name, &run->grid, cloud, run->grid.axis[TABLEGRID_SZA].x[sza_index[i]],
+			  run->grid.axis[TABLEGRID_OZONE].x[ozone_index[j]],
+			  run->grid.axis[TABLEGRID_ALT].x[alt]);
+      if ((status = tablestore_get (run->store, name, &node[n])) != 0)
+	continue;
+      if (node[n]->status != 0)
+	continue;
+      if (node[n]->rows != run->rows || abs (node[n]->columns) < 1)  {
+	fprintf (stderr, "Error, %s does not match the rawlambdafile\n", name);
+	status = -1;
+	continue;
+      }
+      y[n] = node[n]->data;
+    }
+
+  for (k=0; k<run->rows && status==0; k++)
+    status = cell_value (TABLEGRID_CUBIC, szagrid, ozonegrid, y, k, sza, o3, &spectrum[k]);
+
+  for (n=0; n<TABLEGRID_NEIGHBOURS*TABLEGRID_NEIGHBOURS; n++)
+    if (node[n] != NULL)
+      tablestore_release (run->store, node[n]);
+  free (missing);
+  return status;
+}
+
+
+/* the transmittance at a point of a cloud level as fastrt_compute()     */
+/* interpolates the input tables, the splines at the altitude nodes and  */
+/* their polynomial in altitude; scratch holds TABLEGRID_ALT_NODES       */
+/* spectra. Returns 1 if it cannot be interpolated, <0 if error          */
+static int spline_point (DS_RUN *run, int cloud, double sza, double o3, double alt,
+			 double *spectrum, double *scratch)
+{
+  const TABLE_AXIS *alts = &run->grid.axis[TABLEGRID_ALT];
+  double x_alt[TABLEGRID_ALT_NODES]={0.0}, y_alt[TABLEGRID_ALT_NODES]={0.0};
+  int first=0, exact=0, n_alt=0, z=0, k=0, status=0;
+
+  n_alt = tablegrid_alt_nodes (&run->grid, alt, &first, &exact);
+  if (exact >= 0)
+    return spline_at (run, cloud, first+exact, sza, o3, spectrum);
+
+  for (z=0; z<n_alt && status==0; z++)
+    status = spline_at (run, cloud, first+z, sza, o3, scratch + (size_t) z * run->rows);
+  if (status != 0)
+    return status;
+
+  for (k=0; k<run->rows; k++)  {
+    for (z=0; z<n_alt; z++)  {
+      x_alt[z] = alts->x[first+z];
+      y_alt[z] = scratch[(size_t) z * run->rows + k];
+    }
+    spectrum[k] = polynomial (n_alt, x_alt, y_alt, alt);
+  }
+  return 0;
+}
+
+
+/* the same as fastrt_compute() interpolates the dense tables, linearly */
+/* between the dense nodes around the point, each of them evaluated by  */
+/* spline_point(); scratch holds DS_SCRATCH spectra                     */
+static int linear_point (DS_RUN *run, int cloud, double sza, double o3, double alt,
+			 double *spectrum, double *scratch)
+{
+  const TABLE_GRID *dense = &run->dense;
+  double szagrid[TABLEGRID_LINEAR], ozonegrid[TABLEGRID_LINEAR];
+  double x_alt[TABLEGRID_LINEAR]={0.0}, y_alt[TABLEGRID_LINEAR]={0.0};
+  double *at_alt[TABLEGRID_LINEAR], *corner[TABLEGRID_LINEAR*TABLEGRID_LINEAR], *rest=NULL;
+  int sza_index[TABLEGRID_LINEAR], ozone_index[TABLEGRID_LINEAR];
+  int first=0, exact=0, n_alt=0, z=0, i=0, j=0, k=0, status=0;
+
+  for (z=0; z<TABLEGRID_LINEAR; z++)
+    at_alt[z] = scratch + (size_t) z * run->rows;
+  for (i=0; i<TABLEGRID_LINEAR*TABLEGRID_LINEAR; i++)
+    corner[i] = scratch + (size_t) (TABLEGRID_LINEAR + i) * run->rows;
+  rest = scratch + (size_t) (TABLEGRID_LINEAR + TABLEGRID_LINEAR*TABLEGRID_LINEAR) * run->rows;
+
+  n_alt = tablegrid_alt_nodes (dense, alt, &first, &exact);
+  if (exact >= 0)  {
+    first += exact;
+    n_alt  = 1;
+  }
+  tablegrid_neighbours (&dense->axis[TABLEGRID_SZA], sza, 1, TABLEGRID_LINEAR,
+			szagrid, sza_index);
+  tablegrid_neighbours (&dense->axis[TABLEGRID_OZONE], o3, 0, TABLEGRID_LINEAR,
+			ozonegrid, ozone_index);
+
+  for (z=0; z<n_alt && status==0; z++)  {
+    for (i=0; i<TABLEGRID_LINEAR && status==0; i++)
+      for (j=0; j<TABLEGRID_LINEAR && status==0; j++)
+	status = spline_point (run, cloud, szagrid[i], ozonegrid[j],
+			       dense->axis[TABLEGRID_ALT].x[first+z],
+			       corner[i*TABLEGRID_LINEAR+j], rest);
+    for (k=0; k<run->rows && status==0; k++)
+      status = cell_value (TABLEGRID_LINEAR, szagrid, ozonegrid, corner, k, sza, o3,
+			   &at_alt[z][k]);
+  }
+  if (status != 0)
+    return status;
+
+  for (k=0; k<run->rows; k++)  {
+    for (z=0; z<n_alt; z++)  {
+      x_alt[z] = dense->axis[TABLEGRID_ALT].x[first+z];
+      y_alt[z] = at_alt[z][k];
+    }
+    spectrum[k] = polynomial (n_alt, x_alt, y_alt, alt);
+  }
+  return 0;
+}
+
+
+/* the dense nodes of one cloud level, altitude and sza */
+static int densify_task (void *arg, TASKPOOL_WORKER *worker, long first, long n)
+{
+  DS_RUN *run = (DS_RUN *) arg;
+  const TABLE_AXIS *sza=&run->dense.axis[TABLEGRID_SZA], *o3=&run->dense.axis[TABLEGRID_OZONE];
+  const TABLE_AXIS *alt=&run->dense.axis[TABLEGRID_ALT];
+  char name[DS_NAME], path[FILENAME_MAX+DS_NAME];
+  double *spectrum=NULL, *scratch=NULL;
+  FILE *f=NULL;
+  long t=0;
+  int c=0, z=0, s=0, j=0, k=0, status=0;
+
+  (void) worker;
+  if ((spectrum = (double *) calloc ((size_t) run->rows * (1 + TABLEGRID_ALT_NODES),
+				     sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  scratch = spectrum + run->rows;
+
+  for (t=first; t<first+n && status==0; t++)  {
+    s = (int) (t % sza->n);
+    z = (int) (t / sza->n % alt->n);
+    c = (int) (t / sza->n / alt->n);
+
+    for (j=0; j<o3->n && status==0; j++)  {
+      if ((status = spline_point (run, c, sza->x[s], o3->x[j], alt->x[z], spectrum,
+				  scratch)) != 0)  {
+	if (status == 1)  {
+	  __atomic_fetch_add (&run->skipped, 1, __ATOMIC_RELAXED);
+	  status = 0;
+	}
+	continue;
+      }
+
+      transmittance_name (name, &run->dense, c, sza->x[s], o3->x[j], alt->x[z]);
+      snprintf (path, sizeof(path), "%s/%s", run->spec->output, name + 2);
+      if ((f = fopen (path, "w")) == NULL)  {
+	fprintf (stderr, "Error, cannot write %s\n", path);
+	status = -1;
+	break;
+      }
+      /* the splines undershoot around the zeros of the ultraviolet edge, */
+      /* and fastrt_compute() interpolates the logarithm between clouds    */
+      for (k=0; k<run->rows; k++)
+	fprintf (f, "%e\n", (spectrum[k] > 0.0 ? spectrum[k] : 0.0));
+      if (ferror (f))
+	status = -1;
+      if (fclose (f) != 0)
+	status = -1;
+      __atomic_fetch_add (&run->tables, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  free (spectrum);
+  return status;
+}
+
+
+/* uniform in [0, 1), xorshift64* */
+static double uniform (unsigned long long *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (double) ((*state * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+
+/* one random point of the check */
+static int check_task (void *arg, TASKPOOL_WORKER *worker, long first, long n)
+{
+  DS_RUN *run = (DS_RUN *) arg;
+  const TABLE_GRID *grid = &run->grid;
+  const TABLE_AXIS *sza=&grid->axis[TABLEGRID_SZA], *o3=&grid->axis[TABLEGRID_OZONE];
+  const TABLE_AXIS *alt=&grid->axis[TABLEGRID_ALT];
+  double *spline=NULL, *linear=NULL, *scratch=NULL, s=0.0, o=0.0, a=0.0, max=0.0, e=0.0;
+  double sza_max = (run->spec->check_sza < sza->x[sza->n-1] ? run->spec->check_sza :
+		    sza->x[sza->n-1]);
+  unsigned long long state=0;
+  long t=0;
+  int c=0, k=0, status=0;
+
+  (void) worker;
+  if ((spline = (double *) calloc ((size_t) run->rows * (2 + DS_SCRATCH),
+				   sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  linear  = spline + run->rows;
+  scratch = linear + run->rows;
+
+  for (t=first; t<first+n && status==0; t++)  {
+    c    = (int) (t / run->spec->samples);
+    state = tablestore_hash (run->spec->seed, &t, sizeof(t)) | 1;
+    s = sza->x[0] + (sza_max - sza->x[0])           * uniform (&state);
+    o = o3->x[0]  + (o3->x[o3->n-1]   - o3->x[0])  * uniform (&state);
+    a = alt->x[0] + (alt->x[alt->n-1] - alt->x[0]) * uniform (&state);
+
+    /* points the input tables do not cover are not checked */
+    if ((status = spline_point (run, c, s, o, a, spline, scratch)) != 0)  {
+      status = (status == 1 ? 0 : status);
+      continue;
+    }
+    if ((status = linear_point (run, c, s, o, a, linear, scratch)) != 0)  {
+      if (status == 1)  {
+	run->error[t] = HUGE_VAL;
+	status = 0;
+      }
+      continue;
+    }
+
+    max = 0.0;
+    for (k=0; k<run->rows; k++)
+      if (spline[k] > max)
+	max = spline[k];
+    for (k=0; k<run->rows; k++)  {
+      if (!(spline[k] > DENSIFY_FLOOR * max))
+	continue;
+      e = fabs (linear[k] - spline[k]) / spline[k];
+      if (!(e <= HUGE_VAL))
+	e = HUGE_VAL;
+      if (e > run->error[t])
+	run->error[t] = e;
+      run->sum[t] += e * e;
+      run->count[t]++;
+    }
+  }
+
+  free (spline);
+  return status;
+}
+
+
+/* the altitude of a table file name ending in alt%g, and the length */
+/* of the name before it; 0 if the name does not end so              */
+static int name_altitude (const char *name, double *alt, int *prefix)
+{
+  const char *p=NULL, *q=NULL;
+  char *end=NULL;
+
+  for (q=strstr (name, "alt"); q!=NULL; q=strstr (q+1, "alt"))
+    p = q;
+  if (p == NULL)
+    return 0;
+  *alt = strtod (p+3, &end);
+  if (end == p+3 || *end != 0)
+    return 0;
+  *prefix = (int) (p - name);
+  return 1;
+}
+
+
+/* the file directory/prefix alt%g at every dense altitude: the polynomial */
+/* in altitude of every entry of the files of the input altitudes          */
+static int resample_altitudes (DS_RUN *run, const char *directory, const char *prefix,
+			       int length, DENSIFY_STATS *st)
+{
+  const TABLE_AXIS *alts=&run->grid.axis[TABLEGRID_ALT], *dense=&run->dense.axis[TABLEGRID_ALT];
+  TABLE_NODE *node[TABLEGRID_ALT_NODES];
+  char name[DS_NAME], path[FILENAME_MAX+DS_NAME];
+  double x_alt[TABLEGRID_ALT_NODES]={0.0}, y_alt[TABLEGRID_ALT_NODES]={0.0};
+  FILE *f=NULL;
+  int a=0, first=0, exact=0, n_alt=0, z=0, i=0, j=0, columns=0, status=0;
+
+  for (a=0; a<dense->n && status==0; a++)  {
+    n_alt = tablegrid_alt_nodes (&run->grid, dense->x[a], &first, &exact);
+    if (exact >= 0)  {
+      first += exact;
+      n_alt  = 1;
+    }
+
+    for (z=0; z<n_alt; z++)
+      node[z] = NULL;
+    for (z=0; z<n_alt && status==0; z++)  {
+      x_alt[z] = alts->x[first+z];
+      snprintf (name, sizeof(name), "./%s/%.*salt%g", directory, length, prefix, x_alt[z]);
+      if ((status = tablestore_get (run->store, name, &node[z])) != 0)
+	break;
+      if (node[z]->status != 0 || node[z]->columns < 1 || node[z]->rows != node[0]->rows ||
+	  node[z]->columns != node[0]->columns)  {
+	fprintf (stderr, "Error, cannot interpolate %s in altitude\n", name);
+	status = -1;
+      }
+    }
+
+    if (status == 0)  {
+      columns = node[0]->columns;
+      snprintf (path, sizeof(path), "%s/%s/%.*salt%g", run->spec->output, directory, length,
+		prefix, dense->x[a]);
+      if ((f = fopen (path, "w")) == NULL)
+	status = -1;
+    }
+    if (status == 0)  {
+      for (i=0; i<node[0]->rows; i++)  {
+	for (j=0; j<columns; j++)  {
+	  for (z=0; z<n_alt; z++)
+	    y_alt[z] = node[z]->data[(size_t) i * columns + j];
+	  fprintf (f, " %e", polynomial (n_alt, x_alt, y_alt, dense->x[a]));
+	}
+	fprintf (f, "\n");
+      }
+      if (ferror (f))
+	status = -1;
+      if (fclose (f) != 0)
+	status = -1;
+      st->copied++;
+    }
+
+    for (z=0; z<n_alt; z++)
+      if (node[z] != NULL)
+	tablestore_release (run->store, node[z]);
+  }
+  return status;
+}
+
+
+/* the other files of the input directories, and the output directories */
+static int copy_tree (DS_RUN *run, DENSIFY_STATS *st)
+{
+  const DENSIFY_SPEC *spec = run->spec;
+  const TABLE_AXIS *alts = &run->grid.axis[TABLEGRID_ALT];
+  struct dirent **dirs=NULL, **names=NULL;
+  struct stat sb;
+  char from[FILENAME_MAX+512], to[FILENAME_MAX+512], directory[64];
+  double sza=0.0, o3=0.0, alt=0.0;
+  int n_dirs=0, n_names=0, d=0, i=0, c=0, k=0, length=0, transmittances=0, status=0;
+
+  if ((n_dirs = scandir (spec->input, &dirs, NULL, alphasort)) < 0)
+    return -1;
+
+  for (d=0; d<n_dirs && status==0; d++)  {
+    snprintf (from, sizeof(from), "%s/%s", spec->input, dirs[d]->d_name);
+    if (dirs[d]->d_name[0] == '.' || strcmp (dirs[d]->d_name, TABLEGRID_DIRECTORY) == 0 ||
+	stat (from, &sb) != 0 || !S_ISDIR (sb.st_mode))
+      continue;
+
+    snprintf (to, sizeof(to), "%s/%s", spec->output, dirs[d]->d_name);
+    if ((status = make_directory (to)) != 0)
+      break;
+
+    transmittances = 0;
+    for (c=0; c<run->grid.axis[TABLEGRID_CLOUD].n; c++)  {
+      snprintf (directory, sizeof(directory), "TransmittancesCloudH2O%5.3f",
+		run->grid.axis[TABLEGRID_CLOUD].x[c]);
+      if (strcmp (dirs[d]->d_name, directory) == 0)
+	transmittances = 1;
+    }
+
+    if ((n_names = scandir (from, &names, NULL, alphasort)) < 0)
+      continue;
+    for (i=0; i<n_names && status==0; i++)  {
+      if (names[i]->d_name[0] == '.' ||
+	  (transmittances && sscanf (names[i]->d_name, "sza%lfozone%lfalt%lf", &sza, &o3,
+				     &alt) == 3))
+	continue;
+      snprintf (from, sizeof(from), "%s/%s/%s", spec->input, dirs[d]->d_name,
+		names[i]->d_name);
+      snprintf (to, sizeof(to), "%s/%s/%s", spec->output, dirs[d]->d_name, names[i]->d_name);
+      if (stat (from, &sb) != 0 || !S_ISREG (sb.st_mode))
+	continue;
+
+      /* the files of every altitude are interpolated together */
+      if (!transmittances && name_altitude (names[i]->d_name, &alt, &length) &&
+	  (k = tablegrid_lower (alts, alt)) >= 0 && alts->x[k] == alt)  {
+	if (k == 0)
+	  status = resample_altitudes (run, dirs[d]->d_name, names[i]->d_name, length, st);
+	continue;
+      }
+
+      if ((status = copy_file (from, to)) != 0)
+	fprintf (stderr, "Error, cannot copy %s to %s\n", from, to);
+      else
+	st->copied++;
+    }
+
+    for (i=0; i<n_names; i++)
+      free (names[i]);
+    free (names);
+  }
+
+  for (d=0; d<n_dirs; d++)
+    free (dirs[d]);
+  free (dirs);
+  return status;
+}
+
+
+/* the dense grid: the input grid with the dense sza and ozone axes */
+static int setup (DS_RUN *run)
+{
+  const DENSIFY_SPEC *spec = run->spec;
+  TABLE_NODE *raw=NULL;
+  int a=0, status=0;
+
+  if ((status = tablegrid_read (run->store, &run->grid)) != 0)
+    return status;
+  if (run->grid.points != TABLEGRID_CUBIC)  {
+    fprintf (stderr, "Error, the tables in %s are already dense\n", spec->input);
+    return -1;
+  }
+
+  memset (&run->dense, 0, sizeof(TABLE_GRID));
+  run->dense.points = TABLEGRID_LINEAR;
+  for (a=0; a<TABLEGRID_AXES && status==0; a++)
+    status = tablegrid_set (&run->dense, a, run->grid.axis[a].x, run->grid.axis[a].n);
+  memcpy (run->dense.range, run->grid.range, sizeof(run->dense.range));
+  if (status == 0)
+    status = dense_axis (&run->dense, TABLEGRID_SZA, &run->grid.axis[TABLEGRID_SZA],
+			 spec->sza_step);
+  if (status == 0)
+    status = dense_axis (&run->dense, TABLEGRID_OZONE, &run->grid.axis[TABLEGRID_OZONE],
+			 spec->ozone_step);
+  if (status == 0 && spec->alt_step > 0.0)
+    status = dense_axis (&run->dense, TABLEGRID_ALT, &run->grid.axis[TABLEGRID_ALT],
+			 spec->alt_step);
+  if (status != 0)
+    return status;
+
+  if ((status = tablestore_get (run->store, "./TransmittancesCloudH2O0.000/rawlambdafile",
+				&raw)) != 0)
+    return status;
+  if (raw->status != 0 || raw->rows < 1)  {
+    fprintf (stderr, "Error, cannot read the rawlambdafile of %s\n", spec->input);
+    status = -1;
+  }
+  run->rows = raw->rows;
+  tablestore_release (run->store, raw);
+  return status;
+}
+
+
+static int same_directory (const char *x, const char *y)
+{
+  struct stat sx, sy;
+
+  return (stat (x, &sx) == 0 && stat (y, &sy) == 0 &&
+	  sx.st_dev == sy.st_dev && sx.st_ino == sy.st_ino);
+}
+
+
+
+/***********************************************************************************/
+/* Function: densify_spec_init                                                     */
+/* Description:                                                                    */
+/*  Set the defaults: 1 degree, 5 DU, 1 km, DENSIFY_SAMPLES points per cloud       */
+/*  level up to DENSIFY_CHECK_SZA checked against DENSIFY_MAX_ERROR.               */
+/***********************************************************************************/
+
+void densify_spec_init (DENSIFY_SPEC *spec)
+{
+  memset (spec, 0, sizeof(DENSIFY_SPEC));
+
+  spec->pack_kind  = PACK_LOG16;
+  spec->sza_step   = DENSIFY_SZA_STEP;
+  spec->ozone_step = DENSIFY_OZONE_STEP;
+  spec->alt_step   = DENSIFY_ALT_STEP;
+  spec->samples    = DENSIFY_SAMPLES;
+  spec->check_sza  = DENSIFY_CHECK_SZA;
+  spec->max_error  = DENSIFY_MAX_ERROR;
+  spec->seed       = 1;
+}
+
+
+
+/***********************************************************************************/
+/* Function: densify_run                                                           */
+/* Description:                                                                    */
+/*  Write the dense tree of spec->input to spec->output, check its error and, if  */
+/*  the check passed, build the pack.                                              */
+/*  Sets the resource path of ascii.c to spec->input, or to spec->output with a    */
+/*  pack.                                                                          */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  const DENSIFY_SPEC *spec:  Input, grid and output.                             */
+/*  DENSIFY_STATS *stats:      Statistics, set by function, may be NULL.           */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., 1 if the error exceeds spec->max_error, <0 if error.               */
+/***********************************************************************************/
+
+int densify_run (const DENSIFY_SPEC *spec, DENSIFY_STATS *stats)
+{
+  DS_RUN run;
+  DENSIFY_STATS st;
+  TASKPOOL_JOB job;
+  char path[FILENAME_MAX+64];
+  long n_tasks=0, t=0, count=0;
+  int c=0, status=0;
+  double sum=0.0, t0=now();
+
+  memset (&run, 0, sizeof(DS_RUN));
+  memset (&st, 0, sizeof(DENSIFY_STATS));
+
+  if (spec == NULL || spec->input == NULL || spec->output == NULL || spec->samples < 0)
+    return -1;
+  if ((status = make_directory (spec->output)) != 0)
+    return status;
+  if (same_directory (spec->input, spec->output))  {
+    fprintf (stderr, "Error, %s is the input tree\n", spec->output);
+    return -1;
+  }
+
+  run.spec = spec;
+  ASCII_set_resource_path (spec->input);
+  if ((run.store = tablestore_create ()) == NULL)
+    return ASCII_NO_MEMORY;
+
+  if ((status = setup (&run)) != 0 || (status = copy_tree (&run, &st)) != 0)
+    goto cleanup;
+
+  for (c=0; c<run.dense.axis[TABLEGRID_CLOUD].n && status==0; c++)  {
+    snprintf (path, sizeof(path), "%s/TransmittancesCloudH2O%5.3f", spec->output,
+	      run.dense.axis[TABLEGRID_CLOUD].x[c]);
+    status = make_directory (path);
+  }
+  if (status != 0 || (status = tablegrid_write (&run.dense, spec->output)) != 0)
+    goto cleanup;
+
+  job.init = NULL;
+  job.run  = densify_task;
+  job.fini = NULL;
+  job.arg  = &run;
+  n_tasks  = (long) run.dense.axis[TABLEGRID_CLOUD].n * run.dense.axis[TABLEGRID_ALT].n *
+    run.dense.axis[TABLEGRID_SZA].n;
+  if ((status = taskpool_run (NULL, &job, n_tasks, 1, taskpool_threads (spec->max_threads),
+			      TASKPOOL_STEAL, NULL)) != 0)
+    goto cleanup;
+
+  /* the check */
+  n_tasks = (long) run.grid.axis[TABLEGRID_CLOUD].n * spec->samples;
+  if (n_tasks > 0)  {
+    run.error = (double *) calloc (n_tasks, sizeof(double));
+    run.sum   = (double *) calloc (n_tasks, sizeof(double));
+    run.count = (long *)   calloc (n_tasks, sizeof(long));
+    if (run.error == NULL || run.sum == NULL || run.count == NULL)  {
+      status = ASCII_NO_MEMORY;
+      goto cleanup;
+    }
+
+    job.run = check_task;
+    if ((status = taskpool_run (NULL, &job, n_tasks, 1, taskpool_threads (spec->max_threads),
+				TASKPOOL_STEAL, NULL)) != 0)
+      goto cleanup;
+
+    for (t=0; t<n_tasks; t++)  {
+      if (run.error[t] > st.max_error)
+	st.max_error = run.error[t];
+      sum   += run.sum[t];
+      count += run.count[t];
+    }
+    st.checked   = count;
+    st.rms_error = (count > 0 ? sqrt (sum / count) : 0.0);
+    if (st.max_error > spec->max_error)
+      status = 1;
+  }
+
+  if (status == 0 && spec->pack != NULL)
+    status = pack_build (spec->output, spec->pack, spec->pack_kind, 0.0, NULL);
+
+ cleanup:
+  st.n_sza   = run.dense.axis[TABLEGRID_SZA].n;
+  st.n_ozone = run.dense.axis[TABLEGRID_OZONE].n;
+  st.n_alt   = run.dense.axis[TABLEGRID_ALT].n;
+  st.tables  = run.tables;
+  st.skipped = run.skipped;
+  st.seconds = now() - t0;
+  if (stats != NULL)
+    *stats = st;
+
+  tablestore_free (run.store);
+  tablegrid_free (&run.grid);
+  tablegrid_free (&run.dense);
+  free (run.error);
+  free (run.sum);
+  free (run.count);
+  return status;
+}
@@ -0,0 +1,473 @@
+/************************************************************************/
+/* engine.c                                                             */
+/*                                                                      */
+/* fastrt engine: look-up tables shared by many runs.                   */
+/*                                                                      */
+/* run_fastrt_() reads and parses all table files it needs on every     */
+/* call. An engine keeps them, together with their spline coefficients  */
+/* and convolved spectra, in a table store, so that runs with the same  */
+/* wavelengths only interpolate. An engine may be used by several       */
+/* threads at the same time.                                            */
+/*                                                                      */
+/* fastrt_engine_preload() reads the tables of a range of parameters on */
+/* a background thread, while the engine is already in use. A request   */
+/* needing a node that is still being read waits for that node only.    */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "engine.h"
+#include "daylight.h"
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_create                                                  */
+/* Description:                                                                    */
+/*  Allocate an engine with an empty table store.                                  */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The new engine, NULL if out of memory.                                         */
+/***********************************************************************************/
+
+FASTRT_ENGINE *fastrt_engine_create (void)
+{
+  FASTRT_ENGINE *engine=NULL;
+
+  if ((engine = (FASTRT_ENGINE *) calloc (1, sizeof(FASTRT_ENGINE))) == NULL)
+    return NULL;
+
+  if ((engine->store = tablestore_create ()) == NULL)  {
+    free (engine);
+    return NULL;
+  }
+
+  pthread_mutex_init (&engine->preload_lock, NULL);
+  pthread_mutex_init (&engine->grid_lock, NULL);
+  return engine;
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_free                                                    */
+/* Description:                                                                    */
+/*  Free the engine and all cached tables. A running preload is cancelled.        */
+/***********************************************************************************/
+
+void fastrt_engine_free (FASTRT_ENGINE *engine)
+{
+  if (engine == NULL)
+    return;
+
+  __atomic_store_n (&engine->preload_stop, 1, __ATOMIC_RELAXED);
+  fastrt_engine_preload_wait (engine, NULL);
+  pthread_mutex_destroy (&engine->preload_lock);
+  pthread_mutex_destroy (&engine->grid_lock);
+
+  tablegrid_free (&engine->grid);
+  tablestore_free (engine->store);
+  pack_close (engine->pack);
+  free (engine);
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_open_pack                                               */
+/* Description:                                                                    */
+/*  Read the tables of the engine from a pack built by pack_build() instead of     */
+/*  the Resources tree; tables missing from the pack are still read from their     */
+/*  files. Call it before the engine is used.                                      */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if the pack cannot be opened or the engine has one already.     */
+/***********************************************************************************/
+
+int fastrt_engine_open_pack (FASTRT_ENGINE *engine, const char *path)
+{
+  if (engine == NULL || engine->pack != NULL)
+    return -1;
+
+  if ((engine->pack = pack_open (path)) == NULL)
+    return -1;
+
+  tablestore_set_pack (engine->store, engine->pack);
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_open_pack_memory                                        */
+/* Description:                                                                    */
+/*  As fastrt_engine_open_pack(), for a pack in memory, see pack_open_memory():    */
+/*  e.g. that linked into the binary by the FastRTEmbedded target. The data must   */
+/*  stay as it is as long as the engine.                                           */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if data is not a pack or the engine has one already.            */
+/***********************************************************************************/
+
+int fastrt_engine_open_pack_memory (FASTRT_ENGINE *engine, const void *data, size_t size)
+{
+  if (engine == NULL || engine->pack != NULL)
+    return -1;
+
+  if ((engine->pack = pack_open_memory (data, size)) == NULL)
+    return -1;
+
+  tablestore_set_pack (engine->store, engine->pack);
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_advise_pack                                             */
+/* Description:                                                                    */
+/*  Tell the kernel how the engine will read its pack, one of PACK_ADVISE_*, see   */
+/*  pack_advise(): PACK_ADVISE_SEQUENTIAL for the sweeps over the day of a site    */
+/*  with a pack in PACK_ORDER_SZA, PACK_ADVISE_RANDOM for scattered requests,      */
+/*  PACK_ADVISE_POPULATE for a service which must not fault on its first requests. */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if the engine has no pack or the advice failed.                 */
+/***********************************************************************************/
+
+int fastrt_engine_advise_pack (FASTRT_ENGINE *engine, int advice)
+{
+  if (engine == NULL || engine->pack == NULL)
+    return -1;
+  return pack_advise (engine->pack, advice);
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_grid                                                    */
+/* Description:                                                                    */
+/*  The grid of the tables of the engine, see tablegrid.h, read through its store  */
+/*  on the first call.                                                             */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The grid, NULL if it cannot be read.                                           */
+/***********************************************************************************/
+
+const TABLE_GRID *fastrt_engine_grid (FASTRT_ENGINE *engine)
+{
+  int read=0;
+
+  if ((read = __atomic_load_n (&engine->grid_read, __ATOMIC_ACQUIRE)) == 0)  {
+    pthread_mutex_lock (&engine->grid_lock);
+    if ((read = engine->grid_read) == 0)  {
+      read = (tablegrid_read (engine->store, &engine->grid) == 0 ? 1 : -1);
+      __atomic_store_n (&engine->grid_read, read, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock (&engine->grid_lock);
+  }
+  return (read > 0 ? &engine->grid : NULL);
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_run                                                     */
+/* Description:                                                                    */
+/*  Same as run_fastrt_(), but reads the tables through the engine.                */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error, 10 if the solar zenith angle interpolation failed.    */
+/***********************************************************************************/
+
+int fastrt_engine_run (FASTRT_ENGINE *engine, int argc, char **argv, double *doserates)
+{
+  FASTRT_REQUEST req;
+  int status=0;
+
+  fastrt_request_init (&req);
+
+  status = fastrt_parse_request (argc, argv, &req);
+  if (status == 0)
+    status = fastrt_compute (engine, &req, doserates);
+
+  fastrt_request_free (&req);
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_preload_init                                                   */
+/* Description:                                                                    */
+/*  Set a preload to all tables: the solar zenith angles of the sun above the      */
+/*  horizon, every ozone column, altitude and cloud level of the grid, and the     */
+/*  coefficient tables.                                                            */
+/***********************************************************************************/
+
+void fastrt_preload_init (FASTRT_PRELOAD *spec)
+{
+  memset (spec, 0, sizeof(FASTRT_PRELOAD));
+
+  spec->sza_min   = 0.0;
+  spec->sza_max   = 90.0;
+  spec->o3_min    = 0.0;
+  spec->o3_max    = HUGE_VAL;
+  spec->alt_min   = 0.0;
+  spec->alt_max   = HUGE_VAL;
+  spec->cloud_min = 0.0;
+  spec->cloud_max = HUGE_VAL;
+  spec->coefficients = 1;
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_preload_location                                               */
+/* Description:                                                                    */
+/*  Set a preload to the tables which run_fastrt() needs for one location and      */
+/*  day: the solar zenith angles from solar noon down to the horizon, the fixed    */
+/*  ozone column and the aerosols and clouds of its four sky conditions.           */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., 1 if the sun does not rise that day (spec is set anyway), <0 if    */
+/*  error.                                                                         */
+/***********************************************************************************/
+
+int fastrt_preload_location (FASTRT_PRELOAD *spec, int day, double latitude,
+			     double longitude, double altitude)
+{
+  FASTRT_REQUEST req;
+  DAYLIGHT_WINDOW window;
+  int sky=0, status=0;
+
+  fastrt_preload_init (spec);
+
+  if ((status = daylight_window (day, latitude, -longitude, &window)) != 0)
+    return status;
+
+  spec->sza_min = (window.min_zenith < 90.0 ? window.min_zenith : 90.0);
+  spec->o3_min  = spec->o3_max  = 400.0;
+  spec->alt_min = spec->alt_max = altitude;
+
+  fastrt_request_init (&req);
+  spec->cloud_max = 0.0;
+  for (sky=0; sky<4; sky++)  {
+    fastrt_request_set_sky (&req, sky);
+    if (req.cloudH2O > spec->cloud_max)
+      spec->cloud_max = req.cloudH2O;
+  }
+  fastrt_request_free (&req);
+
+  return (window.type == DAYLIGHT_POLAR_NIGHT ? 1 : 0);
+}
+
+
+
+/* mark the cloud levels interpolated from by cloudH2O */
+static void mark_clouds (double cloudH2O, const TABLE_AXIS *levels, int *used)
+{
+  double x_cloudH2O[TABLEGRID_NEIGHBOURS];
+  int n=0, i=0, k=0;
+
+  if (tablegrid_cloud_neighbours (levels, cloudH2O, x_cloudH2O, &n) != 0)
+    return;
+
+  for (k=0; k<=n; k++)
+    for (i=0; i<levels->n; i++)
+      if (levels->x[i] == x_cloudH2O[k])
+	used[i] = 1;
+}
+
+
+/* look up one node; nonzero once the preload is cancelled */
+static int preload_node (FASTRT_ENGINE *engine, char *filename)
+{
+  TABLE_NODE *node=NULL;
+
+  if (__atomic_load_n (&engine->preload_stop, __ATOMIC_RELAXED))  {
+    engine->preload_stats.cancelled = 1;
+    return 1;
+  }
+
+  engine->preload_stats.nodes++;
+  if (tablestore_get (engine->store, filename, &node) != 0 || node->status != 0)
+    engine->preload_stats.missing++;
+  return 0;
+}
+
+
+/* the nodes of fastrt_compute(), spectra_from_store(),            */
+/* aerosol_scaling_from_store() and                                */
+/* atmospheric_reflectance_from_store(), with their file names     */
+static void *preload_main (void *arg)
+{
+  FASTRT_ENGINE *engine = (FASTRT_ENGINE *) arg;
+  const FASTRT_PRELOAD *spec = &engine->preload;
+  const TABLE_GRID *grid=NULL;
+  const TABLE_AXIS *levels=NULL, *sza=NULL, *o3=NULL, *alt=NULL, *coeff_sza=NULL;
+  char filename[FILENAME_MAX+200]="";
+  int *used=NULL;
+  int sza_first=0, sza_last=0, o3_first=0, o3_last=0, alt_first=0, alt_last=0;
+  int c=0, i=0, j=0, z=0, first=0, last=0, stop=0;
+  double t0=now();
+
+  if ((grid = fastrt_engine_grid (engine)) == NULL)
+    return NULL;
+  levels    = &grid->axis[TABLEGRID_CLOUD];
+  sza       = &grid->axis[TABLEGRID_SZA];
+  o3        = &grid->axis[TABLEGRID_OZONE];
+  alt       = &grid->axis[TABLEGRID_ALT];
+  coeff_sza = &grid->axis[TABLEGRID_COEFF_SZA];
+
+  if ((used = (int *) calloc (levels->n, sizeof(int))) == NULL)
+    return NULL;
+
+  /* the cloud neighbours only change at the tabulated levels */
+  mark_clouds (spec->cloud_min, levels, used);
+  mark_clouds (spec->cloud_max, levels, used);
+  for (c=0; c<levels->n; c++)  {
+    if (levels->x[c] >= spec->cloud_min && levels->x[c] <= spec->cloud_max)
+      mark_clouds (levels->x[c], levels, used);
+    if (c+1 < levels->n && 0.5*(levels->x[c]+levels->x[c+1]) >= spec->cloud_min &&
+	0.5*(levels->x[c]+levels->x[c+1]) <= spec->cloud_max)
+      mark_clouds (0.5*(levels->x[c]+levels->x[c+1]), levels, used);
+  }
+
+  /* only one altitude node if the range is a node, see tablegrid_span() */
+  tablegrid_span (grid, TABLEGRID_SZA,   spec->sza_min, spec->sza_max, &sza_first, &sza_last);
+  tablegrid_span (grid, TABLEGRID_OZONE, spec->o3_min,  spec->o3_max,  &o3_first,  &o3_last);
+  tablegrid_span (grid, TABLEGRID_ALT,   spec->alt_min, spec->alt_max, &alt_first, &alt_last);
+
+  /* the wavelengths of all transmittances */
+  strcpy (filename, "./TransmittancesCloudH2O0.000/rawlambdafile");
+  stop = preload_node (engine, filename);
+
+  for (c=0; c<levels->n && !stop; c++)  {
+    if (!used[c])
+      continue;
+    for (i=sza_first; i<=sza_last && !stop; i++)
+      for (j=o3_first; j<=o3_last && !stop; j++)
+	for (z=alt_first; z<=alt_last && !stop; z++)  {
+	  sprintf (filename, "./TransmittancesCloudH2O%5.3f/sza%gozone%galt%g",
+		   levels->x[c], sza->x[i], o3->x[j], alt->x[z]);
+	  stop = preload_node (engine, filename);
+	}
+  }
+
+  if (spec->coefficients)  {
+    tablegrid_span (grid, TABLEGRID_COEFF_SZA, spec->sza_min, spec->sza_max, &first, &last);
+    for (i=first; i<=last && !stop; i++)
+      for (z=alt_first; z<=alt_last && !stop; z++)  {
+	sprintf (filename, "./TransmittancesCloudH2O0.000_coeffs_beta/sza%galt%g",
+		 coeff_sza->x[i], alt->x[z]);
+	stop = preload_node (engine, filename);
+      }
+
+    for (z=alt_first; z<=alt_last && !stop; z++)  {
+      for (c=0; c<levels->n && !stop; c++)  {
+	if (!used[c])
+	  continue;
+	sprintf (filename, "./AtmosphericReflectivitiesCloudH2O%5.3f/alt%g",
+		 levels->x[c], alt->x[z]);
+	stop = preload_node (engine, filename);
+      }
+
+      sprintf (filename, "./AtmosphericReflectivitiesCloudH2O0.000_coeffs_ozone/alt%g",
+	       alt->x[z]);
+      if (!stop)
+	stop = preload_node (engine, filename);
+      sprintf (filename, "./AtmosphericReflectivitiesCloudH2O0.000_coeffs_beta/alt%g",
+	       alt->x[z]);
+      if (!stop)
+	stop = preload_node (engine, filename);
+    }
+  }
+
+  free (used);
+  engine->preload_stats.seconds = now() - t0;
+  return NULL;
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_preload                                                 */
+/* Description:                                                                    */
+/*  Start reading the tables of spec into the engine on a background thread and    */
+/*  return at once. The engine may be used meanwhile; requests wait only for the   */
+/*  nodes they need which are being read at that moment. One preload runs at a     */
+/*  time; finish it with fastrt_engine_preload_wait().                             */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if started, 1 if a preload is still running, <0 if error.                   */
+/***********************************************************************************/
+
+int fastrt_engine_preload (FASTRT_ENGINE *engine, const FASTRT_PRELOAD *spec)
+{
+  int status=0;
+
+  if (engine == NULL || spec == NULL || spec->sza_min > spec->sza_max ||
+      spec->o3_min > spec->o3_max || spec->alt_min > spec->alt_max ||
+      spec->cloud_min > spec->cloud_max)
+    return -1;
+
+  pthread_mutex_lock (&engine->preload_lock);
+
+  if (engine->preloading)
+    status = 1;
+  else  {
+    engine->preload = *spec;
+    memset (&engine->preload_stats, 0, sizeof(FASTRT_PRELOAD_STATS));
+    __atomic_store_n (&engine->preload_stop, 0, __ATOMIC_RELAXED);
+    if (pthread_create (&engine->preload_thread, NULL, preload_main, engine) != 0)
+      status = -1;
+    else
+      engine->preloading = 1;
+  }
+
+  pthread_mutex_unlock (&engine->preload_lock);
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_preload_wait                                            */
+/* Description:                                                                    */
+/*  Wait for the preload of the engine to finish, if one was started, and return   */
+/*  the counters of the last one in stats.                                         */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int fastrt_engine_preload_wait (FASTRT_ENGINE *engine, FASTRT_PRELOAD_STATS *stats)
+{
+  if (engine == NULL)
+    return -1;
+
+  pthread_mutex_lock (&engine->preload_lock);
+  if (engine->preloading)  {
+    pthread_join (engine->preload_thread, NULL);
+    engine->preloading = 0;
+  }
+  if (stats != NULL)
+    *stats = engine->preload_stats;
+  pthread_mutex_unlock (&engine->preload_lock);
+
+  return 0;
+}
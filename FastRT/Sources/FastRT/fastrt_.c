@@ -33,15 +33,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <getopt.h>
 
 #include "fastrt_.h"
+#include "engine.h"
+#include "tablestore.h"
 #include "ascii.h"
 #include "numeric.h"
+#include "spl.h"
+#include "trace.h"
+#include "metrics.h"
+#include "arena.h"
+#include "matrix.h"
+#include "tablegrid.h"
+#include "reduced.h"
 
-#define DELTA_SZA 3.
-#define DELTA_O3 20.
-#define DELTA_ALT 3.
 #define FWHM_DEFAULT 0.6
 #define SOLAR_FLUX_RESOLUTION 0.05
 #define ALBEDO_RESOLUTION 10.
@@ -142,36 +147,38 @@ int read_slitfunction(char *filename, double **sr_lambda, double **sr, int *rows
 {
   int status=0;
   int max_columns=0, min_columns=0;
-  double **data=NULL;
+  MATRIX data;
   
   /* read files */
-  status = ASCII_file2double (filename, rows,
+  status = ASCII_file2matrix (filename, rows,
    &max_columns, &min_columns, &data);
   if (status!=0) {
     fprintf (stderr, "ERROR: cannot read slitfunction file\n");
-    exit(0);
+    return (-1);
   }
   
   if (max_columns!=min_columns) {
     fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
     fprintf (stderr, "     min = %d, max =%d\n", min_columns, max_columns);
-    exit(0);
+    matrix_free (&data);
+    return (-1);
   }
   if (min_columns<2) {
     fprintf (stderr, " ... ending, too few columns\n");
-    exit(0);
+    matrix_free (&data);
+    return (-1);
   }
   
-  *sr_lambda = ASCII_column (data, *rows, 0);
-  *sr = ASCII_column (data, *rows, 1);
+  *sr_lambda = matrix_column (&data, 0);
+  *sr = matrix_column (&data, 1);
   
-  ASCII_free_double (data, *rows);
+  matrix_free (&data);
   return 0;
 }
 
 int check_spectral_response_function(double *sr_lambda, double *sr, int sr_nlambda)
 {
-  int mid, i;
+  int i;
   double conv_delta=0.0, sum, sum0, central_lambda;
   
   /* check for equidistant relative wavelengths in slitfunction */
@@ -182,14 +189,14 @@ int check_spectral_response_function(double *sr_lambda, double *sr, int sr_nlamb
       if (!double_equal(sr_lambda[i]-sr_lambda[i-1], conv_delta)) {
        fprintf (stderr, " ... wavelengths in slitfunction are not equidistant!\n");
        fprintf (stderr, " ... FWHM must be multiple of %f nm\n", SOLAR_FLUX_RESOLUTION);
-       exit(0);
+       return (-1);
      }
    }
    else {
     fprintf (stderr, "... ERROR: less than 3 slitfunction elements.\n");
     fprintf (stderr, "    For a Kronecker delta slitfunction generate a \n");
     fprintf (stderr, "    triangular slitfunction of %f nm FWHM\n", SOLAR_FLUX_RESOLUTION);
-    exit(0);
+    return (-1);
   }
   
   if (sr_lambda[0] > 250) { /* absolute wavelengths provided, convert to relative wavelengths */
@@ -218,412 +225,691 @@ int check_spectral_response_function(double *sr_lambda, double *sr, int sr_nlamb
 return 0;
 }
 
-/* #include "do_spectra.c"*/
-double *do_spectra(char *filename, double *lambda, int n_lambda,
- double *sr_lambda, double *sr, int sr_nlambda, double *solirr)
-     /* reads data of adjacent data from files and interpolates to the
-    desired wavelengths */
+/* Atlas3 solar spectrum at 0.05nm interval starting from 280nm, see solirr.c */
+extern double solirr[];
+
+
+/* working memory of a request: from the arena of fastrt_compute(), or from
+   the heap (arena NULL) for the public functions whose results the caller frees */
+static double *scratch_doubles (ARENA *arena, int n)
+{
+  if (arena != NULL)
+    return (double *) arena_calloc (arena, n, sizeof(double));
+  return (double *) calloc (n, sizeof(double));
+}
+
+static void scratch_free (ARENA *arena, void *p)
+{
+  if (arena == NULL)
+    free (p);
+}
+
+/* rows x cols with aligned rows; matrix_free() releases both kinds */
+static int scratch_matrix (ARENA *arena, MATRIX *m, int rows, int cols)
+{
+  if (arena != NULL)
+    return matrix_arena (m, arena, rows, cols, MATRIX_ALIGNED);
+  return matrix_create (m, rows, cols, MATRIX_ALIGNED);
+}
+
+/* error values in the first n_lambda columns of a 3 x n_lambda matrix */
+static void set_nan (MATRIX *m, int n_lambda)
+{
+  int i, z;
+
+  for (z=0; z<TABLEGRID_ALT_NODES; z++)
+    for (i=0; i<n_lambda; i++)
+      MATRIX_AT (m, z, i) = NaN;
+}
+
+/* copy a 3 x n_lambda matrix of factors, one row per altitude node,
+   to the n_lambda x 3 array returned by the public functions */
+static int factors_to_array (MATRIX *m, int n_lambda, double ***factor)
+{
+  int i, z, status=0;
+
+  if ( (status = ASCII_calloc_double (factor, n_lambda, TABLEGRID_ALT_NODES)) != 0 )
+    return status;
+  for (z=0; z<TABLEGRID_ALT_NODES; z++)
+    for (i=0; i<n_lambda; i++)
+      (*factor)[i][z] = MATRIX_AT (m, z, i);
+  return 0;
+}
+
+
+/* the number of altitude nodes from the first one filled in by the
+   public functions */
+static int first_alt_nodes (const TABLE_GRID *grid)
+{
+  int n = grid->axis[TABLEGRID_ALT].n;
+  return (n < TABLEGRID_ALT_NODES ? n : TABLEGRID_ALT_NODES);
+}
+
+/* complain about a value the tables were not made for, see tablegrid.h */
+static int outside_range (const TABLE_GRID *grid, int axis, double x)
+{
+  if (tablegrid_in_range(grid, axis, x))
+    return 0;
+  fprintf (stderr, "error: %s %f outside the range %g to %g of the tables\n",
+           tablegrid_name(axis), x, grid->range[axis].min, grid->range[axis].max);
+  return 1;
+}
+
+/* check the shape of a table node, see tablestore_get() */
+static int check_node_columns (TABLE_NODE *node, int min, int exact)
+{
+  if (node->columns < 0) {
+    fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
+    fprintf (stderr, "     in %s\n", node->name);
+    return (-1);
+  }
+  if ((exact && node->columns != min) || node->columns < min) {
+    fprintf (stderr, " ... ending, incorrect number of columns in %s\n", node->name);
+    return (-1);
+  }
+  return 0;
+}
+
+
+#define TERMS_CANCELLATION 1e-6   /* see spectrum_from_terms() */
+
+static void convolve(double *x, int rows, double *a0, double *a1, double *a2, double *a3,
+                     double *lambda, int n_lambda, double *sr_lambda, double *sr,
+                     int sr_nlambda, double *solirr, double *out)
+     /* the spline a0..a3 through rows points x, convolved with the slit function
+        and weighted with the solar irradiance, into the n_lambda values of out */
 {
-  int rows_lambda=0, rows_data=0;
   int status=0;
-  int i=0, k=0, m=0, index;
-  double *x=NULL, *y=NULL;
-  double *a0=NULL, *a1=NULL, *a2=NULL, *a3=NULL;
-  
-  int max_columns=0, min_columns=0;
-  double **rawlambda=NULL, **data=NULL;
-  double irr=0., sr_sum=0., lam;
-  
-  double ynew=0, *global_irradiance=NULL;
-  
-  
-  global_irradiance = calloc (n_lambda, sizeof(double));
-  
+  int i=0, m=0, index;
+  double irr=0., sr_sum=0., lam, ynew=0;
+
+  for (i=0; i<n_lambda; i++)  {
+    irr = 0.;
+    sr_sum=0.;
+    for (m=0;m<sr_nlambda;m++) {
+      lam = lambda[i] + sr_lambda[m];
+      status = calc_splined_value (lam, &ynew, x, rows, a0, a1, a2, a3);
+      index = (int)((lam - 280.)/ SOLAR_FLUX_RESOLUTION + 0.5);
+
+      irr += ynew * sr[m] * solirr[index];
+      sr_sum += sr[m];
+    }
+    if (sr_sum != 0.0)
+      irr /= sr_sum;
+    else
+      irr = 0.;
+
+    /* copy data to result array */
+    if (status==0) {
+      out[i] = irr;
+    }
+    else {
+      out[i] = NaN;
+    }
+  }
+}
+
+
+static const double *convolution_matrix(TABLE_STORE *store, const TABLE_SAMPLING *key,
+                                        TABLE_NODE *raw, double *lambda, int n_lambda,
+                                        double *sr_lambda, double *sr, int sr_nlambda,
+                                        double *solirr)
+     /* the n_lambda x raw->rows matrix taking a spectrum on the raw wavelengths
+        to its convolved spectrum, kept with raw for key and pinned; a row of
+        NaN where the convolution fails. NULL if out of memory or the spline
+        fails */
+{
+  const double *c=NULL;
+  double *matrix=NULL, *y=NULL, *column=NULL, *a0=NULL, *a1=NULL, *a2=NULL, *a3=NULL;
+  int rows=raw->rows, i=0, k=0, status=0;
+
+  if ((c = tablestore_find_spectrum (store, raw, key, SPECTRUM_MATRIX, n_lambda * rows)) != NULL)
+    return c;
+
+  matrix = (double *) calloc ((size_t) n_lambda * rows, sizeof(double));
+  y      = (double *) calloc (rows, sizeof(double));
+  column = (double *) calloc (n_lambda, sizeof(double));
+
+  /* the spline is linear in the values, column k is the convolution of row k */
+  for (k=0; k<rows && matrix!=NULL && y!=NULL && column!=NULL; k++) {
+    y[k] = 1.0;
+    status = spline_coeffc (raw->data, y, rows, &a0, &a1, &a2, &a3);
+    y[k] = 0.0;
+    if (status!=0)
+      break;
+    convolve (raw->data, rows, a0, a1, a2, a3, lambda, n_lambda,
+              sr_lambda, sr, sr_nlambda, solirr, column);
+    for (i=0; i<n_lambda; i++)
+      matrix[i*rows + k] = column[i];
+    free (a0);  free (a1);  free (a2);  free (a3);
+  }
+
+  if (matrix!=NULL && y!=NULL && column!=NULL && status==0)
+    c = tablestore_add_spectrum (store, raw, key, SPECTRUM_MATRIX, n_lambda * rows, matrix);
+
+  free (matrix);
+  free (y);
+  free (column);
+  return c;
+}
+
+
+static int spectrum_from_terms(TABLE_STORE *store, const TABLE_SAMPLING *key, TABLE_NODE *raw,
+                               TABLE_NODE *node, double *lambda, int n_lambda,
+                               double *sr_lambda, double *sr, int sr_nlambda,
+                               double *solirr, double *global_irradiance)
+     /* as spectra_from_store for a node of a spectral basis: the basis spectra
+        are convolved once per basis and key, and combined with the terms of
+        the node, plus the convolved rows of its exceptions. Returns 1 if the
+        sum cancels to below TERMS_CANCELLATION of its terms at a wavelength,
+        as for the smallest transmittances of the ultraviolet, where only the
+        spline of the node itself rounds like the tables do; -1 if out of
+        memory */
+{
+  const PACK_TERMS *terms=&node->terms;
+  const double *c=NULL, *g=NULL;
+  double *basis=NULL, *delta=NULL, v, size;
+  int rows=raw->rows, n_terms=terms->n_terms, i=0, j=0, k=0, e=0, status=0;
+
+  if ((c = convolution_matrix (store, key, raw, lambda, n_lambda,
+                               sr_lambda, sr, sr_nlambda, solirr)) == NULL)
+    return (-1);
+
+  /* the convolved basis spectra, n_terms x n_lambda */
+  if ((g = tablestore_find_spectrum (store, raw, key, SPECTRUM_BASIS + terms->basis_id,
+                                     n_lambda * n_terms)) == NULL) {
+    if ((basis = (double *) calloc ((size_t) n_lambda * n_terms, sizeof(double))) == NULL) {
+      tablestore_unpin_spectrum (store, c);
+      return (-1);
+    }
+    for (j=0; j<n_terms; j++)
+      for (i=0; i<n_lambda; i++) {
+        v = 0.;
+        for (k=0; k<rows; k++)
+          v += c[i*rows + k] * terms->basis[j*rows + k];
+        basis[j*n_lambda + i] = v;
+      }
+    g = tablestore_add_spectrum (store, raw, key, SPECTRUM_BASIS + terms->basis_id,
+                                 n_lambda * n_terms, basis);
+    free (basis);
+    if (g == NULL) {
+      tablestore_unpin_spectrum (store, c);
+      return (-1);
+    }
+  }
+
+  /* what the exceptions add to the sum of the terms */
+  if (terms->n_exceptions > 0 &&
+      (delta = (double *) calloc (terms->n_exceptions, sizeof(double))) == NULL)
+    status = -1;
+  for (e=0; e<terms->n_exceptions && status==0; e++)
+    delta[e] = terms->values[e] - pack_terms_value (terms, terms->index[e]);
+
+  for (i=0; i<n_lambda && status==0; i++) {
+    if (c[i*rows] == NaN) {
+      global_irradiance[i] = NaN;
+      continue;
+    }
+    v = size = 0.;
+    for (j=0; j<n_terms; j++) {
+      v += terms->terms[j] * g[j*n_lambda + i];
+      size += fabs (terms->terms[j] * g[j*n_lambda + i]);
+    }
+    for (e=0; e<terms->n_exceptions; e++) {
+      v += delta[e] * c[i*rows + terms->index[e]];
+      size += fabs (delta[e] * c[i*rows + terms->index[e]]);
+    }
+    if (fabs (v) < TERMS_CANCELLATION * size)
+      status = 1;
+    else
+      global_irradiance[i] = v;
+  }
+
+  free (delta);
+  tablestore_unpin_spectrum (store, g);
+  tablestore_unpin_spectrum (store, c);
+  return status;
+}
+
+
+static int spectra_from_store(TABLE_STORE *store, const TABLE_SAMPLING *key,
+                              char *filename, double *lambda, int n_lambda,
+                              double *sr_lambda, double *sr, int sr_nlambda, double *solirr,
+                              double *global_irradiance)
+     /* as do_spectra, but reads through the table store into the n_lambda
+        values of global_irradiance, and reuses the convolved spectrum of a
+        node for the same wavelengths and slit function; returns -1 if the
+        tables are inconsistent */
+{
+  TABLE_NODE *raw=NULL, *node=NULL;
+  const double *cached=NULL;
+  int status=0;
+  int i=0;
+  double t0=0.;
+
   /* read wavelength file for the transmittance file*/
-  status = ASCII_file2double ("./TransmittancesCloudH2O0.000/rawlambdafile", &rows_lambda,
-   &max_columns, &min_columns, &rawlambda);
-  
-  if (status!=0) {
+  if (tablestore_get (store, "./TransmittancesCloudH2O0.000/rawlambdafile", &raw) != 0)
+    return (-1);
+
+  if (raw->status!=0) {
     fprintf (stderr, "ERROR: cannot read rawlambdafile\n");
-    exit(0);
-  }
-  
-  if (max_columns!=min_columns) {
-    fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
-    fprintf (stderr, "     min = %d, max =%d\n", min_columns, max_columns);
-    exit(0);
+    goto error;
   }
-  
-  if (min_columns != 1) {
+
+  if (check_node_columns (raw, 1, 1) != 0) {
     fprintf (stderr, " Error, wavelength file does not contain a single column\n");
-    exit(0);
+    goto error;
   }
-  
+
   /* read transmittance file */
-  status = ASCII_file2double (filename, &rows_data,
-   &max_columns, &min_columns, &data);
-  
-  if (status!=0) {
+  if (tablestore_get (store, filename, &node) != 0)
+    goto error;
+
+  if (node->status!=0) {
     /* run error loop */
     for (i=0; i<n_lambda; i++)  {
       global_irradiance[i] = NaN;
     }
-    return global_irradiance;
-  }
-  
-  if (max_columns!=min_columns) {
-    fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
-    fprintf (stderr, "     min = %d, max =%d\n", min_columns, max_columns);
-    exit(0);
-  }
-  
-  if (min_columns<1) {
-    fprintf (stderr, " ... ending, too few columns\n");
-    exit(0);
+    tablestore_release (store, node);
+    tablestore_release (store, raw);
+    return 0;
   }
-  
-  if (rows_lambda != rows_data) {
+
+  if (check_node_columns (node, 1, 0) != 0)
+    goto error;
+
+  if (raw->rows != node->rows) {
     fprintf (stderr, " ... Error, the rawlambdafile and a datafile\n");
     fprintf (stderr, "are mutually incompatible, unequal number of rows\n");
-    fprintf (stderr, "rows_lambda = %d\n", rows_lambda);
-    fprintf (stderr, "rows_data = %d\n", rows_data);
-    exit(0);
+    fprintf (stderr, "rows_lambda = %d\n", raw->rows);
+    fprintf (stderr, "rows_data = %d\n", node->rows);
+    goto error;
   }
-  
-  /* interpolate to output wavelengths */
-  x = ASCII_column (rawlambda, rows_lambda, 0);
-  for (k=0; k<1; k++) {
-    y = ASCII_column (data, rows_data, k);
-    
-    /* calculate interpolating spline coefficients */
-    /* fprintf (stderr, " ... spline interpolation\n");*/
-    status = spline_coeffc (x, y, rows_data, &a0, &a1, &a2, &a3);
-    if (status!=0)  {
-      fprintf (stderr, "sorry cannot do spline interpolation\n");
-      fprintf (stderr, "spline_coeffc() returned status %d\n", status);
-      fprintf (stderr, "Wavelength beyond prespecified range?\n");
-      exit(status);
+
+  cached = tablestore_find_spectrum (store, node, key, SPECTRUM_VALUES, n_lambda);
+  if (cached != NULL) {
+    memcpy (global_irradiance, cached, n_lambda * sizeof(double));
+    tablestore_unpin_spectrum (store, cached);
+    tablestore_release (store, node);
+    tablestore_release (store, raw);
+    return 0;
+  }
+
+  /* a spectrum of a basis, from the convolved basis spectra unless they cancel */
+  if (store != NULL && node->terms.n_terms > 0 && node->terms.rows == raw->rows) {
+    t0 = trace_begin();
+    status = spectrum_from_terms (store, key, raw, node, lambda, n_lambda,
+                                  sr_lambda, sr, sr_nlambda, solirr, global_irradiance);
+    trace_end(TRACE_CONVOLVE, t0);
+    if (status<0)
+      goto error;
+
+    if (status==0) {
+      tablestore_unpin_spectrum (store, tablestore_add_spectrum (store, node, key, SPECTRUM_VALUES,
+                                                                 n_lambda, global_irradiance));
+      tablestore_release (store, node);
+      tablestore_release (store, raw);
+      return 0;
     }
+  }
 
-    
-    /* convolve with slitfunction stored in sr. Relative wavelengths stored in sr_lambda */
-    for (i=0; i<n_lambda; i++)  {
-      irr = 0.;
-      sr_sum=0.;
-      for (m=0;m<sr_nlambda;m++) {
-       lam = lambda[i] + sr_lambda[m];
-       status = calc_splined_value (lam, &ynew, x, rows_data, a0, a1, a2, a3);
-       index = (int)((lam - 280.)/ SOLAR_FLUX_RESOLUTION + 0.5);
-       
-       irr += ynew * sr[m] * solirr[index];
-       sr_sum += sr[m];
-     }
-     if (sr_sum != 0.0)
-       irr /= sr_sum;
-     else
-       irr = 0.;
-     
-      /* copy data to result array */
-     if (status==0) {
-       global_irradiance[i] = irr;
-     }
-     else {
-       global_irradiance[i] = NaN;
-     }
-   }
-   free_splinecoef_results(status, a0, a1, a2, a3);
-   free(y);
- }
- free(x);
- ASCII_free_double (data, rows_data);
- ASCII_free_double (rawlambda, rows_lambda);
- 
- return global_irradiance;
+  /* calculate interpolating spline coefficients */
+  status = tablestore_spline (store, node, raw->data, node->rows);
+  if (status!=0)  {
+    fprintf (stderr, "sorry cannot do spline interpolation\n");
+    fprintf (stderr, "spline_coeffc() returned status %d\n", status);
+    fprintf (stderr, "Wavelength beyond prespecified range?\n");
+    goto error;
+  }
+
+  /* convolve with slitfunction stored in sr. Relative wavelengths stored in sr_lambda */
+  t0 = trace_begin();
+  convolve (raw->data, node->rows, node->a0, node->a1, node->a2, node->a3,
+            lambda, n_lambda, sr_lambda, sr, sr_nlambda, solirr, global_irradiance);
+  trace_end(TRACE_CONVOLVE, t0);
+
+  tablestore_unpin_spectrum (store, tablestore_add_spectrum (store, node, key, SPECTRUM_VALUES,
+                                                             n_lambda, global_irradiance));
+
+  tablestore_release (store, node);
+  tablestore_release (store, raw);
+  return 0;
+
+ error:
+  if (node != NULL)
+    tablestore_release (store, node);
+  tablestore_release (store, raw);
+  return (-1);
 }
 
 
-int compute_aerosol_scaling(double sza, double beta, double *lambda, int n_lambda, double ***factor)
-     /* compute multiplication factor for aerosol loading, set to unity if clouds are present */
+double *do_spectra(char *filename, double *lambda, int n_lambda,
+ double *sr_lambda, double *sr, int sr_nlambda, double *solirr)
+     /* reads data of adjacent data from files and interpolates to the
+    desired wavelengths; returns NULL if the tables are inconsistent */
+{
+  double *global_irradiance=NULL;
+
+  if ((global_irradiance = calloc (n_lambda, sizeof(double))) == NULL)
+    return NULL;
+
+  if (spectra_from_store (NULL, 0, filename, lambda, n_lambda,
+                          sr_lambda, sr, sr_nlambda, solirr, global_irradiance) != 0) {
+    free (global_irradiance);
+    return NULL;
+  }
+  return global_irradiance;
+}
+
+
+static int aerosol_scaling_from_store(TABLE_STORE *store, const TABLE_GRID *grid,
+                                      int alt_first, int z0, int nz, double sza, double beta,
+                                      double *lambda, int n_lambda, MATRIX *factor)
+     /* factors at the altitude nodes alt_first+z, z0 <= z < z0+nz, into the
+        rows z of the factor */
 {
   char dummyfilename[FILENAME_MAX+200]="";
-  int rows_data=0;
-  int status=0, dummy;
-  int z=0, i=0, rows_index=0, alt, sza_rounded;
-  int max_columns=0, min_columns=0;
-  double **data=NULL;
+  int status=0;
+  int z=0, i=0, rows_index=0;
+  TABLE_NODE *node=NULL;
+  double *data=NULL, *row=NULL, alt, sza_rounded;
   double beta0=0.02; /* coefficients were computed using beta=beta-beta0 translation */
-  int lambda_start=290, lambda_step=10;
+  const TABLE_AXIS *coeff_sza=&grid->axis[TABLEGRID_COEFF_SZA], *wl=&grid->axis[TABLEGRID_LAMBDA];
 
-  /* allocate memory for double array */
-  if ( (status = ASCII_calloc_double (factor, n_lambda, 3)) != 0 )
-    return status;
-
-  for (z=0; z<3; z++){
-    sza_rounded=(int)((sza/DELTA_SZA)+0.5)*DELTA_SZA;
-    alt=z*DELTA_ALT;
-    dummy = sprintf(dummyfilename,
-      "%s%d%s%d", "./TransmittancesCloudH2O0.000_coeffs_beta/sza", sza_rounded,
+  sza_rounded=coeff_sza->x[tablegrid_nearest(coeff_sza, sza)];
+  for (z=z0; z<z0+nz; z++){
+    alt=grid->axis[TABLEGRID_ALT].x[alt_first+z];
+    sprintf(dummyfilename,
+      "%s%g%s%g", "./TransmittancesCloudH2O0.000_coeffs_beta/sza", sza_rounded,
       "alt", alt);
-    
+
     /* read coefficient file */
-    status = ASCII_file2double (dummyfilename, &rows_data,
-      &max_columns, &min_columns, &data);
-    if (status!=0) {
+    if ((status = tablestore_get (store, dummyfilename, &node)) != 0)
+      return status;
+
+    if ((status = node->status)!=0) {
+      tablestore_release (store, node);
       /* run error loop*/
-      for (i=0; i<n_lambda; i++)  {
-       for (z=0; z<3; z++){
-         (*factor)[i][z] = NaN;
-       }
-     }
-     return status;
-   }
-   
-   if (max_columns!=min_columns) {
-    fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
-    fprintf (stderr, "     min = %d, max =%d\n", min_columns, max_columns);
-    exit(0);
+      set_nan (factor, n_lambda);
+      return status;
+    }
+
+    if (check_node_columns (node, 2, 1) != 0 || node->rows < wl->n) {
+      tablestore_release (store, node);
+      return (-1);
+    }
+
+    data = node->data;
+    row = MATRIX_ROW (factor, z);
+    for (i=0; i<n_lambda; i++) {
+      rows_index=tablegrid_nearest(wl, lambda[i]);
+      row[i]=1.+ data[2*rows_index]*(beta-beta0) + data[2*rows_index+1]*(beta-beta0)*(beta-beta0); /* polynomial coefficients were determined using a beta=beta-beta0 translation */
+    }
+
+    tablestore_release (store, node);
   }
-  
-  if (min_columns!=2) {
-    fprintf (stderr, " ... ending, incorrect number of columns\n");
-    exit(0);
+  return status;
+}
+
+
+int compute_aerosol_scaling(double sza, double beta, double *lambda, int n_lambda, double ***factor)
+     /* compute multiplication factor for aerosol loading, set to unity if clouds are present */
+{
+  const TABLE_GRID *grid=NULL;
+  MATRIX m;
+  int status=0;
+
+  if ( (grid = tablegrid_shared ()) == NULL )
+    return (-1);
+  if ( (status = matrix_create (&m, TABLEGRID_ALT_NODES, n_lambda, MATRIX_ALIGNED)) != 0 )
+    return status;
+
+  status = aerosol_scaling_from_store (NULL, grid, 0, 0, first_alt_nodes (grid),
+                                       sza, beta, lambda, n_lambda, &m);
+  if (factors_to_array (&m, n_lambda, factor) != 0)
+    status = ASCII_NO_MEMORY;
+
+  matrix_free (&m);
+  return status;
+}
+
+
+/* read a two column polynomial coefficient file and evaluate
+   1 + c0*d + c1*d*d at the output wavelengths into factor */
+static int coeffs_from_store(TABLE_STORE *store, const TABLE_AXIS *wl, char *filename, double d,
+                             double *lambda, int n_lambda, double *factor)
+{
+  TABLE_NODE *node=NULL;
+  int i, status=0, rows_index;
+
+  if ((status = tablestore_get (store, filename, &node)) != 0)
+    return status;
+
+  if ((status = node->status)!=0) {
+    tablestore_release (store, node);
+    return status;
   }
-  
+
+  if (check_node_columns (node, 2, 1) != 0 || node->rows < wl->n) {
+    tablestore_release (store, node);
+    return (-1);
+  }
+
   for (i=0; i<n_lambda; i++) {
-    rows_index=(int)((lambda[i]-lambda_start)/lambda_step+0.5);
-      (*factor)[i][z]=1.+ data[rows_index][0]*(beta-beta0) + data[rows_index][1]*(beta-beta0)*(beta-beta0); /* polynomial coefficients were determined using a beta=beta-beta0 translation */
+    rows_index=tablegrid_nearest(wl, lambda[i]);
+    factor[i]=1.+ node->data[2*rows_index]*d + node->data[2*rows_index+1]*d*d;
   }
-  
-  ASCII_free_double (data, rows_data);
-}
-return status;
+
+  tablestore_release (store, node);
+  return 0;
 }
 
 
-int compute_atmospheric_reflectance(double o3, double beta,
+static int atmospheric_reflectance_from_store(ARENA *arena, TABLE_STORE *store,
+  const TABLE_GRID *grid, int alt_first, int z0, int nz, double o3, double beta,
   double cloudH2O, double *x_cloudH2O, int subscr_cloudH2O_max,
-  double *lambda, int n_lambda, double ***AtmReflArray)
-     /* compute multiplication factor for multiple bounces of light at the surface-atmosphere boundary */
-
-     /* improve sensitivity with ozone and aerosols */
+  double *lambda, int n_lambda, MATRIX *AtmReflArray)
+     /* reflectances at the altitude nodes alt_first+z, z0 <= z < z0+nz, into
+        the rows z of AtmReflArray; the working memory comes from arena, or
+        the heap if NULL */
 {
   char dummyfilename[FILENAME_MAX+200]="";
-  int rows_data=0;
-  int status=0, status_c=0, status_v=0, dummy;
-  double *a0=NULL, *a1=NULL, *a2=NULL, *a3=NULL;
-  int z=0, i=0, j, alt, subscr_cloudH2O,
+  int status=0, status_c=0, status_v=0;
+  double *a0=NULL, *a1=NULL, *a2=NULL, *a3=NULL, *work=NULL,
+  c0[4], c1[4], c2[4], c3[4], c_work[SPLINE_WORK(4)];
+  int z=0, i=0, j, subscr_cloudH2O,
   rows_index=0, rows_index_min, rows_index_max, rows_index_nb;
-  int max_columns=0, min_columns=0;
-  double **data, **ozonefactor=NULL, **betafactor=NULL,
-  y_cloudH2O[4], ynew=0., **tmp[4], *x_wl=NULL, *y_wl=NULL;
-  int lambda_start=290, lambda_step=10;
+  MATRIX ozonefactor, betafactor;
+  double y_cloudH2O[4], ynew=0., *x_wl=NULL, *y_wl=NULL, *refl=NULL, alt;
+  TABLE_NODE *tmp[4]={NULL,NULL,NULL,NULL};
+  const TABLE_AXIS *wl=&grid->axis[TABLEGRID_LAMBDA];
   double beta0=0.02; /* coefficients were computed using beta=beta-beta0 translation */
   double o30=300.; /* coefficients were computed using o3=o3-o30 translation */
 
-  rows_index_min=(int)((lambda[0]-lambda_start)/lambda_step+0.5);
-  rows_index_max=(int)((lambda[n_lambda-1]-lambda_start)/lambda_step+0.5);
+  rows_index_min=tablegrid_nearest(wl, lambda[0]);
+  rows_index_max=tablegrid_nearest(wl, lambda[n_lambda-1]);
   rows_index_nb=rows_index_max-rows_index_min+1;
   if (rows_index_nb < 3){
     if (rows_index_min > 0){rows_index_min--;rows_index_nb++;}
-    if (rows_index_max < 11){rows_index_max++;rows_index_nb++;}
+    if (rows_index_max < wl->n-1){rows_index_max++;rows_index_nb++;}
   }
-  x_wl = calloc (rows_index_nb, sizeof(double));
-  y_wl = calloc (rows_index_nb, sizeof(double));
-
-  /*  if ((cloudH2O-cloudH2O_low) < (cloudH2O_high-cloudH2O)){
-      cloudH2O=cloudH2O_low;
-      }
-      else {
-      cloudH2O=cloudH2O_high;
-      }*/
-
 
   /* compute atmospheric reflectance for base case */
-  /* allocate memory for double array */
-  if ( (status = ASCII_calloc_double (AtmReflArray, n_lambda, 3)) != 0 )
-    return status;
-  
-  for (z=0; z<3; z++) {
-    alt=z*DELTA_ALT;
+  /* wavelengths, values and spline coefficients of the grid of the files */
+  if ((x_wl = scratch_doubles (arena, 6*rows_index_nb + SPLINE_WORK(rows_index_nb))) == NULL)
+    return ASCII_NO_MEMORY;
+  y_wl = x_wl + rows_index_nb;
+  a0   = y_wl + rows_index_nb;
+  a1   = a0   + rows_index_nb;
+  a2   = a1   + rows_index_nb;
+  a3   = a2   + rows_index_nb;
+  work = a3   + rows_index_nb;
+
+  for (z=z0; z<z0+nz; z++) {
+    alt=grid->axis[TABLEGRID_ALT].x[alt_first+z];
     for (subscr_cloudH2O=0;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++){
-      dummy = sprintf(dummyfilename,
-        "%s%5.3f%s%d", "./AtmosphericReflectivitiesCloudH2O", x_cloudH2O[subscr_cloudH2O],
+      sprintf(dummyfilename,
+        "%s%5.3f%s%g", "./AtmosphericReflectivitiesCloudH2O", x_cloudH2O[subscr_cloudH2O],
         "/alt", alt);
-      /*    dummy = sprintf(dummyfilename,
-        "%s%d", "./AtmosphericReflectivitiesCloudH2O0.000/alt", alt);*/
-      
+
       /* read coefficient file */
-      status = ASCII_file2double (dummyfilename, &rows_data,
-        &max_columns, &min_columns, &tmp[subscr_cloudH2O]);
+      if ((status = tablestore_get (store, dummyfilename, &tmp[subscr_cloudH2O])) == 0) {
+        status = tmp[subscr_cloudH2O]->status;
+        if (status == 0 && (check_node_columns (tmp[subscr_cloudH2O], 1, 1) != 0 ||
+                            tmp[subscr_cloudH2O]->rows < wl->n))
+          status = -1;
+      }
       if (status!=0) {
-    /* run error loop*/
-       for (i=0; i<n_lambda; i++)  {
-         for (z=0; z<3; z++){
-           (*AtmReflArray)[i][z] = NaN;
-         }
-       }
-       return status;
-     }
-     
-     if (max_columns!=min_columns) {
-       fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
-       fprintf (stderr, "     min = %d, max =%d\n", min_columns, max_columns);
-       exit(0);
-     }
-     
-     if (min_columns!=1) {
-      fprintf (stderr, " ... ending, incorrect number of columns\n");
-      exit(0);
+        /* run error loop*/
+        set_nan (AtmReflArray, n_lambda);
+        for (j=0; j<=subscr_cloudH2O; j++)
+          if (tmp[j] != NULL)
+            tablestore_release (store, tmp[j]);
+        scratch_free (arena, x_wl);
+        return status;
+      }
     }
-  }
-  rows_index=-1;
-  for (i=rows_index_min; i<=rows_index_max; i++) {
-    rows_index++;
-    for (subscr_cloudH2O=0;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++){
-     y_cloudH2O[subscr_cloudH2O]=tmp[subscr_cloudH2O][i][0];
-   }
-   if (subscr_cloudH2O_max==0){
-     ynew=y_cloudH2O[0];
-   }
-   else {
-     status_c = spline_coeffc (x_cloudH2O, y_cloudH2O, subscr_cloudH2O_max+1, &a0, &a1, &a2, &a3);
-     status_v = calc_splined_value (cloudH2O, &ynew, x_cloudH2O, subscr_cloudH2O_max+1, a0, a1, a2, a3);
-     free_splinecoef_results(status_c, a0, a1, a2, a3);
-   }
-   x_wl[rows_index]=lambda_start+i*lambda_step;
-   y_wl[rows_index]=ynew;
- }
-  status_c = spline_coeffc (x_wl, y_wl, rows_index+1, &a0, &a1, &a2, &a3);
-  for (j=0; j<n_lambda; j++) {
-    status_v = calc_splined_value (lambda[j], &ynew, x_wl, rows_index+1, a0, a1, a2, a3);
-    (*AtmReflArray)[j][z]=ynew;
-  }
+    rows_index=-1;
+    for (i=rows_index_min; i<=rows_index_max; i++) {
+      rows_index++;
       for (subscr_cloudH2O=0;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++){
-          ASCII_free_double(tmp[subscr_cloudH2O], rows_data);
+        y_cloudH2O[subscr_cloudH2O]=tmp[subscr_cloudH2O]->data[i];
       }
-
-  free_splinecoef_results(status_c, a0, a1, a2, a3);
-}
-    free(x_wl);
-    free(y_wl);
+      if (subscr_cloudH2O_max==0){
+        ynew=y_cloudH2O[0];
+      }
+      else {
+        status_c = spline_coeffc_buffer (x_cloudH2O, y_cloudH2O, subscr_cloudH2O_max+1,
+                                         c0, c1, c2, c3, c_work);
+        status_v = calc_splined_value (cloudH2O, &ynew, x_cloudH2O, subscr_cloudH2O_max+1, c0, c1, c2, c3);
+        if (status_c == 0)
+          status_c = status_v;
+      }
+      x_wl[rows_index]=wl->x[i];
+      y_wl[rows_index]=ynew;
+    }
+    if (status_c == 0)
+      status_c = spline_coeffc_buffer (x_wl, y_wl, rows_index+1, a0, a1, a2, a3, work);
+    if (status_c != 0) {
+      fprintf (stderr, "sorry cannot do spline interpolation of the reflectance\n");
+      fprintf (stderr, "spline_coeffc() returned status %d\n", status_c);
+      set_nan (AtmReflArray, n_lambda);
+      for (subscr_cloudH2O=0;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++)
+        tablestore_release (store, tmp[subscr_cloudH2O]);
+      scratch_free (arena, x_wl);
+      return status_c;
+    }
+    refl = MATRIX_ROW (AtmReflArray, z);
+    for (j=0; j<n_lambda; j++) {
+      /* no reflectance outside the wavelengths of the nodes */
+      status_v = calc_splined_value (lambda[j], &ynew, x_wl, rows_index+1, a0, a1, a2, a3);
+      refl[j] = (status_v == 0 ? ynew : 0.);
+    }
+    for (subscr_cloudH2O=0;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++){
+      tablestore_release (store, tmp[subscr_cloudH2O]);
+      tmp[subscr_cloudH2O]=NULL;
+    }
+  }
+  scratch_free (arena, x_wl);
 
   /* compute scaling factor for ozone content */
   /* allocate memory for double array */
-if ( (status = ASCII_calloc_double (&ozonefactor, n_lambda, 3)) != 0 ){
-  return status;
-}
+  if ( (status = scratch_matrix (arena, &ozonefactor, TABLEGRID_ALT_NODES, n_lambda)) != 0 ){
+    return status;
+  }
 
-for (z=0; z<3; z++){
-  alt=z*DELTA_ALT;
-  dummy = sprintf(dummyfilename,
-    "%s%d", "./AtmosphericReflectivitiesCloudH2O0.000_coeffs_ozone/alt", alt);
+  for (z=z0; z<z0+nz; z++){
+    alt=grid->axis[TABLEGRID_ALT].x[alt_first+z];
+    sprintf(dummyfilename,
+      "%s%g", "./AtmosphericReflectivitiesCloudH2O0.000_coeffs_ozone/alt", alt);
     /* read coefficient file */
-  status = ASCII_file2double (dummyfilename, &rows_data,
-    &max_columns, &min_columns, &data);
-  if (status!=0) {
-    /* run error loop*/
-    for (i=0; i<n_lambda; i++)  {
-     for (z=0; z<3; z++){
-       ozonefactor[i][z] = NaN;
-     }
-   }
-   return status;
- }
- 
- if (max_columns!=min_columns) {
-  fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
-  fprintf (stderr, "     min = %d, max =%d\n", min_columns, max_columns);
-  exit(0);
-}
-
-if (min_columns!=2) {
-  fprintf (stderr, " ... ending, incorrect number of columns\n");
-  exit(0);
-}
-
-for (i=0; i<n_lambda; i++) {
-  rows_index=(int)((lambda[i]-lambda_start)/lambda_step+0.5);
-  ozonefactor[i][z]=1.+ data[rows_index][0]*(o3-o30) + data[rows_index][1]*(o3-o30)*(o3-o30);
-}
-ASCII_free_double (data, rows_data);
-}
+    status = coeffs_from_store (store, wl, dummyfilename, o3-o30, lambda, n_lambda,
+                                MATRIX_ROW (&ozonefactor, z));
+    if (status!=0) {
+      /* run error loop*/
+      set_nan (AtmReflArray, n_lambda);
+      matrix_free(&ozonefactor);
+      return status;
+    }
+  }
 
   /* compute scaling factor for aerosol loading */
   /* allocate memory for double array */
-if ( (status = ASCII_calloc_double (&betafactor, n_lambda, 3)) != 0 )
-  return status;
+  if ( (status = scratch_matrix (arena, &betafactor, TABLEGRID_ALT_NODES, n_lambda)) != 0 ) {
+    matrix_free(&ozonefactor);
+    return status;
+  }
 
   if (cloudH2O != 0.000){ /* ignore aerosols if clouds are present */
-for (z=0; z<3; z++){
-  for (i=0; i<n_lambda; i++) {
-   betafactor[i][z]=1.;
- }
-}
-}
-else {
-  for (z=0; z<3; z++){
-    alt=z*DELTA_ALT;
-    dummy = sprintf(dummyfilename,
-      "%s%d", "./AtmosphericReflectivitiesCloudH2O0.000_coeffs_beta/alt", alt);
+    for (z=z0; z<z0+nz; z++){
+      for (i=0; i<n_lambda; i++) {
+        MATRIX_AT (&betafactor, z, i)=1.;
+      }
+    }
+  }
+  else {
+    for (z=z0; z<z0+nz; z++){
+      alt=grid->axis[TABLEGRID_ALT].x[alt_first+z];
+      sprintf(dummyfilename,
+        "%s%g", "./AtmosphericReflectivitiesCloudH2O0.000_coeffs_beta/alt", alt);
       /* read coefficient file */
-    status = ASCII_file2double (dummyfilename, &rows_data,
-      &max_columns, &min_columns, &data);
-    if (status!=0) {
-    /* run error loop*/
-     for (i=0; i<n_lambda; i++)  {
-       for (z=0; z<3; z++){
-         betafactor[i][z] = NaN;
-       }
-     }
-     return status;
-   }
-   
-   if (max_columns!=min_columns) {
-     fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
-     fprintf (stderr, "     min = %d, max =%d\n", min_columns, max_columns);
-     exit(0);
-   }
-   
-   if (min_columns!=2) {
-     fprintf (stderr, " ... ending, incorrect number of columns\n");
-     exit(0);
-   }
-   
-   for (i=0; i<n_lambda; i++) {
-     rows_index=(int)((lambda[i]-lambda_start)/lambda_step+0.5);
-     betafactor[i][z]=1.+ data[rows_index][0]*(beta-beta0) + data[rows_index][1]*(beta-beta0)*(beta-beta0);
-   }
-   ASCII_free_double (data, rows_data);
- }
-}
+      status = coeffs_from_store (store, wl, dummyfilename, beta-beta0, lambda, n_lambda,
+                                  MATRIX_ROW (&betafactor, z));
+      if (status!=0) {
+        /* run error loop*/
+        set_nan (AtmReflArray, n_lambda);
+        matrix_free(&betafactor);
+        matrix_free(&ozonefactor);
+        return status;
+      }
+    }
+  }
 
-    /* consider integrating all for loops to save operations */
-for (z=0; z<3; z++){
-  for (i=0; i<n_lambda; i++) {
-    (*AtmReflArray)[i][z]*=betafactor[i][z]*ozonefactor[i][z];
-    /* fprintf (stderr, "function: z %d i %d AtmReflArray %f betafactor %f ozonefactor %f\n",
-       i, z, (*AtmReflArray)[i][z], betafactor[i][z], ozonefactor[i][z]); */
+  /* rows of unit stride, aligned alike */
+  for (z=z0; z<z0+nz; z++){
+    double *r = MATRIX_ROW (AtmReflArray, z);
+    const double *b = MATRIX_ROW (&betafactor, z), *o = MATRIX_ROW (&ozonefactor, z);
+    for (i=0; i<n_lambda; i++) {
+      r[i]*=b[i]*o[i];
+    }
   }
-}
-ASCII_free_double(betafactor, n_lambda);
-ASCII_free_double(ozonefactor, n_lambda);
-return status;
+  matrix_free(&betafactor);
+  matrix_free(&ozonefactor);
+  return status;
 }
 
 
-double *newton_co(int np, double *x, double *y)
+int compute_atmospheric_reflectance(double o3, double beta,
+  double cloudH2O, double *x_cloudH2O, int subscr_cloudH2O_max,
+  double *lambda, int n_lambda, double ***AtmReflArray)
+     /* compute multiplication factor for multiple bounces of light at the surface-atmosphere boundary */
 
-     /*
-      * Newton interpolation
-      *
-      *   Reference: Cheney and Kincaid, Numerical Mathematics and
-      *              Computing, 1980, Brooks/Cole Publishing Company
-      *              Monterey, California.
-      */
+     /* improve sensitivity with ozone and aerosols */
+{
+  const TABLE_GRID *grid=NULL;
+  MATRIX m;
+  int status=0;
+
+  if ( (grid = tablegrid_shared ()) == NULL )
+    return (-1);
+  if ( (status = matrix_create (&m, TABLEGRID_ALT_NODES, n_lambda, MATRIX_ALIGNED)) != 0 )
+    return status;
+
+  status = atmospheric_reflectance_from_store (NULL, NULL, grid, 0, 0, first_alt_nodes (grid),
+                                               o3, beta, cloudH2O, x_cloudH2O,
+                                               subscr_cloudH2O_max, lambda, n_lambda, &m);
+  if (factors_to_array (&m, n_lambda, AtmReflArray) != 0)
+    status = ASCII_NO_MEMORY;
+
+  matrix_free (&m);
+  return status;
+}
+
+
+static void newton_co_buffer(int np, double *x, double *y, double *a)
+     /* as newton_co, into the np coefficients a */
 {
-  double *a=NULL;
   int i, j;
-  a = calloc (np, sizeof(double));
   for (i = 0; i < np; i++){
     a[i] = y[i];
   }
@@ -633,6 +919,21 @@ double *newton_co(int np, double *x, double *y)
       a[i-1] = (a[i-1] - a[i-2]) / (x[i-1] - x[i-j-1]);
     }
   }
+}
+
+double *newton_co(int np, double *x, double *y)
+
+     /*
+      * Newton interpolation
+      *
+      *   Reference: Cheney and Kincaid, Numerical Mathematics and
+      *              Computing, 1980, Brooks/Cole Publishing Company
+      *              Monterey, California.
+      */
+{
+  double *a=NULL;
+  if ((a = calloc (np, sizeof(double))) != NULL)
+    newton_co_buffer (np, x, y, a);
   return a;
 }
 
@@ -656,620 +957,1038 @@ double eval (int n, double *x, double *a, double t)
 }
 
 
-int run_fastrt_(int argc, char **argv, double *doserates_out)
-     /* reads input parameters, accesses irradiance data which represent
-    conditions closest to the specified ones, interpolates the available
-    data, and writes result to standard output */
-{
-  double global_irradiance, *int_grid_data[4][4][3],
-  x_o3[4], y_o3[4], x_sza[4], y_sza[4],
-  x_alt[3], y_alt[3], x_cloudH2O[4]={0.0,0.0,0.0,0.0}, y_cloudH2O[4], ynew=0.;
-  int i, j, k, z, subscr_o3, subscr_sza, subscr_alt,
-  subscr_cloudH2O, subscr_cloudH2O_max=0,
-  n_lambda=0, n_alt=3, start_alt=0;
-  double szagrid[4], ozonegrid[4], altgrid[3];
-  
-  char xfilename[FILENAME_MAX+200]="",
-  srfilename[FILENAME_MAX+200]="",
-  filename[4][4][3][FILENAME_MAX+200];
-  int status=0, status_c=0, status_v=0;
-  
-  double *a0=NULL, *a1=NULL, *a2=NULL, *a3=NULL, *a=NULL;
-  int dummy, c=0, surfaceno=0, index=0;
-
-
-  int sza_flag=0, ozone_flag=0, alt_flag=0,
-  albedo_flag=0, albedo_file_flag=0, albedo_type_flag=0,
-  beta_flag=0, broken_cloud_flag=0, cloudH2O_flag=0,
-  start_lambda_flag=0, end_lambda_flag=0, day_flag=0,
-  step_lambda_flag=0, x_flag=0, fwhm_flag=0, sr_flag=0;
-  
-  double alt=0.0, start_lambda=0.0, end_lambda=0.0, step_lambda=0.0;
-
-  double sza=0.0, o3=0.0, beta=0.0,
-  cloudOD = 0.0,  cloudH2O = 0.0, cloudH2O_low = 0.0, cloudH2O_high = 0.0,
-  visibility, fwhm=0.0, day_corr, angle,
-  pi=3.14159265358979323846264338327, day=0.,
-  alb=0, *albedo=NULL, **AtmReflArray=NULL, **AerosolScalingArray=NULL,
-  AtmAlbFactor=1., *lambda=NULL, *sr_lambda=NULL, *sr=NULL;
-  int sr_nlambda=0;
-  char surfacealbedo[FILENAME_MAX+200]="";
-  
-  double **albedo_measured_lambda=NULL, **albedo_measured=NULL;
-  int rows=0;
-  int max_columns=0, min_columns=0;
-  double **data=NULL, *tmp[4], tau550;
-
-/*  double cloud_H2O_array[9] = {0.0, 0.04, 0.06, 0.10, 0.14, 0.26, 0.41, 0.58, 1.0}; */
-  double cloud_H2O_array[9] = {0.000, 0.005, 0.014, 0.029, 0.057, 0.109, 0.217, 0.460, 1.000};
-
-  double surface_albedo[18][14] = {
+static double surface_albedo[18][14] = {
 /* 290 - 420 nm, 10 nm intervals, 12 + 6 = 18 surface types  */
 /* (1) U. Feister and R. Grewe, Spectral albedo measurements in the
    UV and visible region over different types of surfaces, Photochemistry
    and Photobiology, 62, 736-744, 1995.   */
 /* (2) M. Blumthaler and W. Ambach, Solar UVB-Albedo of various surfaces, Photochemistry
    and Photobiology, 48, 1, pp. 85-88, 1988 */
-    {0.755, 0.764, 0.765, 0.769, 0.775, 0.785, 0.791, 0.796, 0.802, 0.807, 0.810, 0.818, 0.825, 0.826}, /* sno5 (1) */
-    {0.615, 0.623, 0.629, 0.632, 0.640, 0.645, 0.656, 0.661, 0.665, 0.669, 0.670, 0.672, 0.673, 0.677}, /* sno2 (1) */
-    {0.126, 0.138, 0.148, 0.160, 0.171, 0.182, 0.193, 0.200, 0.209, 0.221, 0.229, 0.239, 0.246, 0.254}, /* sand (1) */
-    {0.021, 0.023, 0.024, 0.026, 0.027, 0.029, 0.031, 0.032, 0.033, 0.035, 0.037, 0.039, 0.041, 0.045}, /* lawn (1) */
-    {0.095, 0.096, 0.098, 0.105, 0.110, 0.118, 0.123, 0.131, 0.136, 0.141, 0.150, 0.161, 0.172, 0.179}, /* cdry (1) */
-    {0.072, 0.077, 0.078, 0.083, 0.087, 0.092, 0.097, 0.101, 0.105, 0.110, 0.117, 0.127, 0.137, 0.144}, /* cwet (1) */
-    {0.016, 0.016, 0.017, 0.017, 0.017, 0.018, 0.018, 0.018, 0.019, 0.019, 0.020, 0.022, 0.024, 0.027}, /* gras (1) */
-    {0.018, 0.019, 0.019, 0.020, 0.021, 0.021, 0.022, 0.022, 0.023, 0.024, 0.025, 0.027, 0.025, 0.027}, /* beet (1) */
-    {0.017, 0.017, 0.017, 0.018, 0.018, 0.018, 0.018, 0.018, 0.019, 0.019, 0.019, 0.020, 0.022, 0.024}, /* oat (1) */
-    {0.039, 0.041, 0.044, 0.048, 0.052, 0.055, 0.058, 0.062, 0.066, 0.070, 0.075, 0.080, 0.085, 0.091}, /* loam (1) */
-    {0.015, 0.016, 0.018, 0.018, 0.019, 0.019, 0.019, 0.020, 0.020, 0.020, 0.021, 0.023, 0.026, 0.030}, /* rye (1) */
-    {0.019, 0.019, 0.019, 0.020, 0.021, 0.021, 0.022, 0.023, 0.024, 0.025, 0.026, 0.029, 0.032, 0.035},  /* stub (1) */
-    {0.900, 0.900, 0.906, 0.891, 0.890, 0.901, 0.905, 0.906, 0.915, 0.913, 0.918, 0.920, 0.925, 0.927},  /* snow new (2) */
-    {0.811, 0.811, 0.835, 0.837, 0.838, 0.842, 0.849, 0.854, 0.865, 0.868, 0.862, 0.876, 0.872, 0.879},  /* snow old (2) */
-    {0.060, 0.060, 0.076, 0.085, 0.092, 0.099, 0.103, 0.106, 0.110, 0.113, 0.105, 0.108, 0.129, 0.133},  /* sand dry (2) */
-    {0.137, 0.137, 0.133, 0.141, 0.144, 0.147, 0.150, 0.154, 0.159, 0.164, 0.170, 0.178, 0.184, 0.190},  /* limestone (2) */
-    {0.011, 0.011, 0.011, 0.011, 0.011, 0.010, 0.010, 0.012, 0.011, 0.010, 0.012, 0.012, 0.015, 0.019},  /* meadow (2) */
-    {0.018, 0.018, 0.031, 0.035, 0.037, 0.037, 0.041, 0.045, 0.046, 0.049, 0.055, 0.049, 0.057, 0.065}  /* field dry (2) */
-  };
-
-  #include "solirr.c"
+  {0.755, 0.764, 0.765, 0.769, 0.775, 0.785, 0.791, 0.796, 0.802, 0.807, 0.810, 0.818, 0.825, 0.826}, /* sno5 (1) */
+  {0.615, 0.623, 0.629, 0.632, 0.640, 0.645, 0.656, 0.661, 0.665, 0.669, 0.670, 0.672, 0.673, 0.677}, /* sno2 (1) */
+  {0.126, 0.138, 0.148, 0.160, 0.171, 0.182, 0.193, 0.200, 0.209, 0.221, 0.229, 0.239, 0.246, 0.254}, /* sand (1) */
+  {0.021, 0.023, 0.024, 0.026, 0.027, 0.029, 0.031, 0.032, 0.033, 0.035, 0.037, 0.039, 0.041, 0.045}, /* lawn (1) */
+  {0.095, 0.096, 0.098, 0.105, 0.110, 0.118, 0.123, 0.131, 0.136, 0.141, 0.150, 0.161, 0.172, 0.179}, /* cdry (1) */
+  {0.072, 0.077, 0.078, 0.083, 0.087, 0.092, 0.097, 0.101, 0.105, 0.110, 0.117, 0.127, 0.137, 0.144}, /* cwet (1) */
+  {0.016, 0.016, 0.017, 0.017, 0.017, 0.018, 0.018, 0.018, 0.019, 0.019, 0.020, 0.022, 0.024, 0.027}, /* gras (1) */
+  {0.018, 0.019, 0.019, 0.020, 0.021, 0.021, 0.022, 0.022, 0.023, 0.024, 0.025, 0.027, 0.025, 0.027}, /* beet (1) */
+  {0.017, 0.017, 0.017, 0.018, 0.018, 0.018, 0.018, 0.018, 0.019, 0.019, 0.019, 0.020, 0.022, 0.024}, /* oat (1) */
+  {0.039, 0.041, 0.044, 0.048, 0.052, 0.055, 0.058, 0.062, 0.066, 0.070, 0.075, 0.080, 0.085, 0.091}, /* loam (1) */
+  {0.015, 0.016, 0.018, 0.018, 0.019, 0.019, 0.019, 0.020, 0.020, 0.020, 0.021, 0.023, 0.026, 0.030}, /* rye (1) */
+  {0.019, 0.019, 0.019, 0.020, 0.021, 0.021, 0.022, 0.023, 0.024, 0.025, 0.026, 0.029, 0.032, 0.035},  /* stub (1) */
+  {0.900, 0.900, 0.906, 0.891, 0.890, 0.901, 0.905, 0.906, 0.915, 0.913, 0.918, 0.920, 0.925, 0.927},  /* snow new (2) */
+  {0.811, 0.811, 0.835, 0.837, 0.838, 0.842, 0.849, 0.854, 0.865, 0.868, 0.862, 0.876, 0.872, 0.879},  /* snow old (2) */
+  {0.060, 0.060, 0.076, 0.085, 0.092, 0.099, 0.103, 0.106, 0.110, 0.113, 0.105, 0.108, 0.129, 0.133},  /* sand dry (2) */
+  {0.137, 0.137, 0.133, 0.141, 0.144, 0.147, 0.150, 0.154, 0.159, 0.164, 0.170, 0.178, 0.184, 0.190},  /* limestone (2) */
+  {0.011, 0.011, 0.011, 0.011, 0.011, 0.010, 0.010, 0.012, 0.011, 0.010, 0.012, 0.012, 0.015, 0.019},  /* meadow (2) */
+  {0.018, 0.018, 0.031, 0.035, 0.037, 0.037, 0.041, 0.045, 0.046, 0.049, 0.055, 0.049, 0.057, 0.065}  /* field dry (2) */
+};
 
+/*  double cloud_H2O_array[9] = {0.0, 0.04, 0.06, 0.10, 0.14, 0.26, 0.41, 0.58, 1.0}; */
+static double cloud_H2O_array[9] = {0.000, 0.005, 0.014, 0.029, 0.057, 0.109, 0.217, 0.460, 1.000};
 
-/* accept command line options */
 
-  while ((c=getopt (argc, argv, "a:v:b:cu:t:o:z:p:q:l:f:r:w:g:e:s:x:d:h")) != EOF) {
-    switch(c) {
-      case 'a':
-      sza_flag=1;
-      sza = atof(optarg);
-      if (sza < 0.) {
-       fprintf (stderr, "error: solar zenith angle less than 0 degrees\n");
-       exit(0);
-     }
-     if (sza > 90.) {
-       fprintf (stderr, "warning: solar zenith angle greater than 90 degrees\n");
-     }
-     break;
-     case 'v':
-     beta_flag=1;
-     visibility = atof(optarg);
-     if (visibility < 5.) {
-       fprintf (stderr, "warning: visibility less than 5 km\n");
-       exit(0);
-     }
-     if (visibility > 350.) {
-       fprintf (stderr, "warning: visibility more than 350 km\n");
-       exit(0);
-     }
-      /* parametrization from Iqbal M., An Introduction to Solar Radiation, Academic, San Diego, CA, 1983 */
-     tau550 = (3.912/visibility-0.01162)*(0.02472*(visibility-5.)+1.132);
-     beta=tau550*pow(0.55,1.3);
-      /*      fprintf (stdout, "Aerosol optical depth at 550nm: %6.2f\n", tau550);
-          fprintf (stdout, "beta: %6.2f\n", beta);  */
-     break;
-     case 'b':
-     beta_flag=1;
-     beta = atof(optarg);
-     if (beta < 0.) {
-       fprintf (stderr, "error: Aerosol beta less than 0\n");
-       exit(0);
-     }
-     if (beta > 0.4) {
-       fprintf (stderr, "warning: Aerosol beta greater than 0.4\n");
-       exit(0);
-     }
-     break;
-     case 'c':
-     broken_cloud_flag=1;
-     break;
-     case 't':
-     cloudH2O_flag=1;
-     cloudOD = atof(optarg);
-     if (cloudOD < 0.) {
-       fprintf (stderr, "error: cloud optical depth less than 0\n");
-       exit(0);
-     }
-     if (cloudOD >= 1083.) {
-       fprintf (stderr, "error: cloud optical depth greater than 1083\n");
-       exit(0);
-     }
-      cloudH2O=cloudOD/1083.; /* convert cloud optical depth to cloud liquid water content in a 5km thick cloud (g m-2)*/
-     i=0;
-     while (cloud_H2O_array[i] < cloudH2O){
-       i++;
-     }
-     if (cloud_H2O_array[i] == cloudH2O){
-       x_cloudH2O[0]=cloudH2O;
-       subscr_cloudH2O_max=0;
-       cloudH2O_high=cloudH2O;
-       cloudH2O_low=cloudH2O;
-     }
-     else{
-       subscr_cloudH2O=-1;
-       for(j=0;j<4;j++){
-         k=i-2+j;
-      if ((k>=0) && (k<=8)){ /*8 is the max index of cloud_H2O_array */
-         subscr_cloudH2O++;
-         x_cloudH2O[subscr_cloudH2O]=cloud_H2O_array[k];
-       }
-     }
-     subscr_cloudH2O_max=subscr_cloudH2O;
-     cloudH2O_high=cloud_H2O_array[i];
-     cloudH2O_low=cloud_H2O_array[i-1];
-   }
-   break;
-   case 'u':
-   cloudH2O_flag=1;
-      cloudH2O = atof(optarg)/CLOUD_THICKNESS/1000.; /* convert cloud liquid water column to cloud liquid water content to 2 decimals*/
-   if (cloudH2O < 0.) {
-     fprintf (stderr, "error: cloud liquid water content less than 0\n");
-     exit(0);
-   }
-   if (cloudH2O > 1.) {
-     fprintf (stderr, "error: cloud liquid water content %f in the assumed %f km thick cloud is greater than or equal to 1.\n", cloudH2O, CLOUD_THICKNESS);
-     exit(0);
-   }
-   i=0;
-   while (cloud_H2O_array[i] < cloudH2O){
-     i++;
-   }
-   if (cloud_H2O_array[i] == cloudH2O){
-     x_cloudH2O[0]=cloudH2O;
-     subscr_cloudH2O_max=0;
-     cloudH2O_high=cloudH2O;
-     cloudH2O_low=cloudH2O;
-   }
-   else{
-     subscr_cloudH2O=-1;
-     for(j=0;j<4;j++){
-       k=i-2+j;
-      if ((k>=0) && (k<=8)){ /*8 is the max index of cloud_H2O_array */
-       subscr_cloudH2O++;
-       x_cloudH2O[subscr_cloudH2O]=cloud_H2O_array[k];
-     }
-   }
-   subscr_cloudH2O_max=subscr_cloudH2O;
-   cloudH2O_high=cloud_H2O_array[i];
-   cloudH2O_low=cloud_H2O_array[i-1];
- }
- break;
- case 'o':
- ozone_flag=1;
- o3 = atof(optarg);
- if (o3 < 100.) {
-   fprintf (stderr, "warning: ozone column less than 100 DU\n");
- }
- if (o3 > 600) {
-   fprintf (stderr, "warning: ozone column greater than 600 DU\n");
- }
- break;
- case 'z':
- alt_flag=1;
- alt = atof(optarg);
- if (alt < 0.) {
-   fprintf (stderr, "warning: surface altitude less than 0 km\n");
- }
- if (alt > 6.) {
-   fprintf (stderr, "warning: surface altitude greater than 6 km\n");
- }
- break;
- case 'p':
- albedo_flag=1;
- alb = atof(optarg);
- if (alb < 0.) {
-   fprintf (stderr, "error: surface albedo less than 0\n");
- }
- if (alb > 1.) {
-   fprintf (stderr, "warning: surface albedo greater than 1\n");
- }
- break;
- case 'q':
- albedo_type_flag=1;
- surfaceno = atoi(optarg);
- if (surfaceno < 0) {
-   fprintf (stderr, "error: surface # less than 0\n");
-   return (-1);
- }
- if (surfaceno > 17) {
-   fprintf (stderr, "error: surface # greater than 17\n");
-   return (-1);
- }
- break;
- case 'l':
- albedo_file_flag=1;
- strcpy(surfacealbedo, optarg);
- break;
- case 'f':
- fwhm_flag=1;
- fwhm = atof(optarg);
- if (fwhm <0.05 || fwhm > 55.) {
-   fprintf (stderr,"warning: FWHM not within range [0.05,55] nm\n");
- }
- break;
- case 'r':
- sr_flag=1;
- strcpy(srfilename, optarg);
- break;
- case 'w':
- n_lambda = 1;
- lambda=(double *) calloc (n_lambda, sizeof(double));
- *lambda = atof(optarg);
- if ((*lambda < 290.) || (*lambda > 405.)) {
-   fprintf (stderr, "warning: wavelength outside [290,405] nm\n");
- }
- break;
- case 'g':
- start_lambda_flag=1;
- start_lambda = atof(optarg);
- if (start_lambda < 290.) {
-   fprintf (stderr, "warning: start wavelength less than 290 nm\n");
- }
- break;
- case 'e':
- end_lambda_flag=1;
- end_lambda = atof(optarg);
- if (end_lambda > 405.) {
-   fprintf (stderr, "warning: end wavelength greater than 405 nm\n");
- }
- break;
- case 's':
- step_lambda_flag=1;
- step_lambda = atof(optarg);
- break;
- case 'x':
- x_flag=1;
- strcpy(xfilename, optarg);
- break;
- case 'd':
- day_flag = 1;
- day = atof(optarg);
- break;
- case 'h':
- print_usage();
- return (-1);
- break;
- default:
- print_usage();
- return (-1);
-}
+double fastrt_visibility_to_beta(double visibility)
+     /* Angstrom beta for a visibility in km */
+{
+  double tau550;
+
+  /* parametrization from Iqbal M., An Introduction to Solar Radiation, Academic, San Diego, CA, 1983 */
+  tau550 = (3.912/visibility-0.01162)*(0.02472*(visibility-5.)+1.132);
+  return tau550*pow(0.55,1.3);
 }
 
-#ifdef linux
-optind = 0;
-#else
-optind = 1;
-optreset = 1;
-#endif
-  /* check validity of wavelengths */
-if (!sza_flag || !ozone_flag) {
-  fprintf (stderr, "solar zenith angle or ozone column is inadequately specified");
-  print_usage();
-  return (-1);
 
-}
-if (!(fwhm_flag || sr_flag)) {
-    /* Round off to nearest multiple of SOLAR_FLUX_RESOLUTION */
-  fwhm = (double) (((int) (FWHM_DEFAULT/SOLAR_FLUX_RESOLUTION + 0.5)) * SOLAR_FLUX_RESOLUTION);
-  status = make_slitfunction(fwhm, &sr_lambda, &sr, &sr_nlambda);
-}
-if (fwhm_flag) {
-    /* Round off to nearest multiple of SOLAR_FLUX_RESOLUTION */
-  fwhm = (double) (((int) (fwhm/SOLAR_FLUX_RESOLUTION + 0.5)) * SOLAR_FLUX_RESOLUTION);
-  status = make_slitfunction(fwhm, &sr_lambda, &sr, &sr_nlambda);
-}
-if (sr_flag) {
-    /* 'fprintf (stderr, " ... reading slitfunction from file %s ...\n", srfilename); */
-  status = read_slitfunction(srfilename, &sr_lambda, &sr, &sr_nlambda);
-  status = check_spectral_response_function(sr_lambda, sr, sr_nlambda);
+int fastrt_cloud_levels(const double **levels)
+     /* the cloud liquid water contents of the original tables, in increasing
+        order; returns their number. The tables may have others, see
+        tablegrid.h */
+{
+  *levels = cloud_H2O_array;
+  return (int) (sizeof(cloud_H2O_array) / sizeof(cloud_H2O_array[0]));
 }
 
-if (start_lambda_flag && end_lambda_flag && step_lambda_flag) {
-  n_lambda = (int) ((end_lambda-start_lambda)/step_lambda) + 1;
-  lambda=(double *) calloc (n_lambda, sizeof(double));
-  for (i = 0; i < n_lambda; i++) {
-    lambda[i] = start_lambda + i * step_lambda;
+
+/* the spectrum of a transmittance node into spectrum, as spectra_from_store;
+   NaN if the node is beyond the grid */
+static int transmittance_from_store(TABLE_STORE *store, const TABLE_SAMPLING *key,
+                                    const FASTRT_REQUEST *req, double cloudH2O,
+                                    const TABLE_GRID *grid, int sza_index, int o3_index,
+                                    double alt, double *spectrum)
+{
+  char filename[FILENAME_MAX+200]="";
+  int k;
+
+  if (sza_index < 0 || o3_index < 0) {
+    for (k=0; k<req->n_lambda; k++)
+      spectrum[k] = NaN;
+    return 0;
   }
+
+  sprintf(filename,
+    "%s%5.3f%s%g%s%g%s%g", "./TransmittancesCloudH2O", cloudH2O,
+    "/sza", grid->axis[TABLEGRID_SZA].x[sza_index],
+    "ozone", grid->axis[TABLEGRID_OZONE].x[o3_index],
+    "alt", alt);
+  return spectra_from_store(store, key, filename, req->lambda, req->n_lambda,
+                            req->sr_lambda, req->sr, req->sr_nlambda, solirr, spectrum);
 }
 
-if (x_flag) {
-    /*    fprintf (stderr, " ... reading wavelengths from file %s ...\n", xfilename); */
-  
-    /* read file with user x values */
-  status = read_1c_file (xfilename, &lambda, &n_lambda);
-  if ((lambda[0] < 290.) || (lambda[n_lambda-1] > 405.)) {
-    fprintf (stderr, "warning: wavelength beyond [290,405] nm\n");
+
+/* the spectrum of a transmittance node for the sky of the request: with
+   clouds splined in the logarithm between the levels x_cloudH2O, whose
+   spectra besides the first are read into the rows of blend */
+static int node_spectrum(TABLE_STORE *store, const TABLE_SAMPLING *key, const FASTRT_REQUEST *req,
+                         const TABLE_GRID *grid, double *x_cloudH2O, int subscr_cloudH2O_max,
+                         int sza_index, int o3_index, double alt, MATRIX *blend,
+                         double *spectrum)
+{
+  double a0[4], a1[4], a2[4], a3[4], work[SPLINE_WORK(4)], y_cloudH2O[4], ynew=0., t0=0.;
+  double *tmp[4];
+  int k, subscr_cloudH2O, status_c=0, status_v=0;
+
+  if (req->broken_cloud_flag){
+    /* read fringe spectra files and interpolate to output wavelengths */
+    return transmittance_from_store(store, key, req, 0.0, grid, sza_index, o3_index,
+                                    alt, spectrum);
   }
-  if (status!=0)  {
-    fprintf (stderr, "error reading file %s\n", xfilename);
+
+  /* read fringe spectra files and interpolate to output wavelengths */
+  if (transmittance_from_store(store, key, req, x_cloudH2O[0], grid, sza_index,
+                               o3_index, alt, spectrum) != 0)
     return (-1);
+
+  /* do spline interpolation of cloud tabular entries */
+  if (req->cloudH2O != x_cloudH2O[0]){
+    tmp[0]=spectrum;
+    for (subscr_cloudH2O=1;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++){
+      /* read fringe spectra files and interpolate to output wavelengths */
+      tmp[subscr_cloudH2O] = MATRIX_ROW(blend, subscr_cloudH2O-1);
+      if (transmittance_from_store(store, key, req, x_cloudH2O[subscr_cloudH2O], grid,
+                                   sza_index, o3_index, alt, tmp[subscr_cloudH2O]) != 0)
+        return (-1);
+    }
+    t0 = trace_begin();
+    for (k = 0; k < req->n_lambda; k++) {
+      for (subscr_cloudH2O=0;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++){
+        y_cloudH2O[subscr_cloudH2O]=log(tmp[subscr_cloudH2O][k]);
+      }
+      status_c = spline_coeffc_buffer (x_cloudH2O, y_cloudH2O, subscr_cloudH2O_max+1,
+                                       a0, a1, a2, a3, work);
+      status_v = calc_splined_value (req->cloudH2O, &ynew, x_cloudH2O, subscr_cloudH2O_max+1,
+                                     a0, a1, a2, a3);
+      if ((status_c != 0) || (status_v != 0)) {
+        fprintf (stderr, "sorry cannot do spline interpolation\n");
+        fprintf (stderr, "spline_coeffc() returned status_c status_v %d %d \n", status_c, status_v);
+        trace_end(TRACE_CLOUD, t0);
+        return (status_c != 0 ? status_c : status_v);
+      }
+      spectrum[k] = exp(ynew);
+    }
+    trace_end(TRACE_CLOUD, t0);
   }
+  return 0;
 }
 
-if (lambda == NULL) {
-  fprintf (stderr, "output wavelengths inadequately specified");
-  print_usage();
-  return (-1);
+
+void fastrt_request_init(FASTRT_REQUEST *req)
+{
+  memset (req, 0, sizeof(FASTRT_REQUEST));
 }
 
-if (day_flag == 0) {
-  day_corr=1.;
+
+void fastrt_request_free(FASTRT_REQUEST *req)
+     /* free the data owned by a request filled by fastrt_parse_request */
+{
+  free(req->lambda);
+  free(req->sr_lambda);
+  free(req->sr);
+  free(req->albedo_lambda);
+  free(req->albedo_value);
+  fastrt_request_init(req);
 }
-else {
-    /* correct for deviations from average sun-earth distance
-       From J. Lenoble, "Atmospheric Radiative Transfer", 1993, A. Deepak Publishing */
-  angle = 2.0 * pi * (double) (day-1) / 365.0;
-  day_corr = 1.000110 + 0.034221 * cos(angle) + 0.001280 * sin(angle)
-  + 0.000719 * cos(2*angle) + 0.000077 * sin(2*angle);
+
+
+int fastrt_request_set_fwhm(FASTRT_REQUEST *req, double fwhm)
+     /* replace the slit function of a request by a triangular one */
+{
+  free(req->sr_lambda);
+  free(req->sr);
+  req->sr_lambda=NULL;
+  req->sr=NULL;
+
+  /* Round off to nearest multiple of SOLAR_FLUX_RESOLUTION */
+  req->fwhm = (double) (((int) (fwhm/SOLAR_FLUX_RESOLUTION + 0.5)) * SOLAR_FLUX_RESOLUTION);
+  return make_slitfunction(req->fwhm, &req->sr_lambda, &req->sr, &req->sr_nlambda);
 }
 
-albedo=(double *) calloc (n_lambda, sizeof(double));
 
-if (albedo_flag) {
-  for (k=0;k<n_lambda;k++){
-    albedo[k]=alb;
+int fastrt_request_set_lambda(FASTRT_REQUEST *req, double start_lambda, double end_lambda,
+                              double step_lambda)
+     /* replace the output wavelengths of a request by an equidistant grid */
+{
+  int i, n_lambda;
+
+  n_lambda = (int) ((end_lambda-start_lambda)/step_lambda) + 1;
+  if (n_lambda < 1)
+    return (-1);
+
+  free(req->lambda);
+  req->n_lambda = 0;
+  if ((req->lambda = (double *) calloc (n_lambda, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+
+  for (i = 0; i < n_lambda; i++) {
+    req->lambda[i] = start_lambda + i * step_lambda;
   }
+  req->n_lambda = n_lambda;
+  return 0;
 }
-else if (albedo_type_flag) {
-  for (i = 0; i < n_lambda; i++) {
-    index = (int) ((lambda[i]-290.)/ALBEDO_RESOLUTION + 0.5);
-    albedo[i] = surface_albedo[surfaceno][index];
+
+
+int fastrt_request_set_sky(FASTRT_REQUEST *req, int sky_condition_type)
+     /* set aerosols and clouds of the sky conditions of run_fastrt():
+        0 cloudless, 1 scattered clouds, 2 broken clouds, 3 overcast */
+{
+  req->beta=0.0;
+  req->beta_flag=0;
+  req->cloudH2O=0.0;
+  req->cloudH2O_flag=0;
+  req->broken_cloud_flag=0;
+
+  switch (sky_condition_type) {
+  case 0:
+    req->beta_flag=1;
+    req->beta=fastrt_visibility_to_beta(50.);
+    break;
+  case 1:
+    req->cloudH2O_flag=1;
+    req->cloudH2O=50./CLOUD_THICKNESS/1000.;
+    break;
+  case 2:
+    req->broken_cloud_flag=1;
+    req->cloudH2O_flag=1;
+    req->cloudH2O=450./CLOUD_THICKNESS/1000.;
+    break;
+  case 3:
+    req->cloudH2O_flag=1;
+    req->cloudH2O=45./CLOUD_THICKNESS/1000.;
+    break;
+  default:
+    return (-1);
   }
+  return 0;
 }
-else if (albedo_file_flag){
-  status = ASCII_file2double (surfacealbedo, &rows,
+
+
+static int read_albedo_file(char *filename, FASTRT_REQUEST *req)
+{
+  int status=0, rows=0, max_columns=0, min_columns=0;
+  MATRIX data;
+
+  status = ASCII_file2matrix (filename, &rows,
     &max_columns, &min_columns, &data);
   if (status!=0) {
     fprintf (stderr, "ERROR: cannot read albedo file\n");
-    exit(0);
+    return (-1);
   }
-  
+
   if (max_columns!=min_columns) {
     fprintf (stderr, " !! ATTENTION !! Inconsistent number of columns\n");
     fprintf (stderr, "     min = %d, max =%d\n", min_columns, max_columns);
-    exit(0);
+    matrix_free (&data);
+    return (-1);
   }
   if (min_columns<2) {
     fprintf (stderr, " ... ending, too few columns\n");
-    exit(0);
+    matrix_free (&data);
+    return (-1);
   }
-  
-  *albedo_measured_lambda = ASCII_column (data, rows, 0);
-  *albedo_measured = ASCII_column (data, rows, 1);
-  
-  ASCII_free_double (data, rows);
-  
-    /* interpolate tabulated data to output wavelengths */
-  i=0;
-  for (k=0; k<n_lambda; k++){
-    while ((lambda[k] < (*albedo_measured_lambda)[i]) && (i < rows)) {
-     i++;
-   }
-   albedo[k]= (*albedo_measured)[i] +
-   (lambda[k]-(*albedo_measured_lambda)[i])*
-   ((*albedo_measured)[i+1]-(*albedo_measured)[i])/((*albedo_measured_lambda)[i]-(*albedo_measured_lambda)[i]);
- }
-}
 
-/* find closest precomputed tabulated data entries*/
-for (i=0; i<4; i++){
-  szagrid[i] = (double)((int)(sza/DELTA_SZA)-1+i)*DELTA_SZA;
-  ozonegrid[i] = (double)((int)(o3/DELTA_O3)-1+i)*DELTA_O3;
-}
-for (z=0; z<n_alt; z++){
-  altgrid[z] = (double)(z*DELTA_ALT);
-  if (alt == altgrid[z]) {
-    n_alt=1;
-    start_alt = z;
-  }
+  free(req->albedo_lambda);
+  free(req->albedo_value);
+  req->albedo_lambda = matrix_column (&data, 0);
+  req->albedo_value = matrix_column (&data, 1);
+  req->albedo_rows = rows;
+
+  matrix_free (&data);
+  return 0;
 }
 
-for (i=0; i<4; i++){
-  for (j=0; j<4; j++){
-    for (z=start_alt; z<start_alt+n_alt; z++){
-     if (broken_cloud_flag){
-    /* read fringe spectra files and interpolate to output wavelengths */
-       dummy = sprintf(filename[i][j][z],
-         "%s%d%s%d%s%d", "./TransmittancesCloudH2O0.000/sza", ((int)fabs(szagrid[i])),
-         "ozone", ((int)ozonegrid[j]),
-         "alt", ((int)altgrid[z]));
-       int_grid_data[i][j][z] = do_spectra(filename[i][j][z], lambda, n_lambda,
-         sr_lambda, sr, sr_nlambda, solirr);
-     }
-     else {
-       dummy = sprintf(filename[i][j][z],
-         "%s%5.3f%s%d%s%d%s%d", "./TransmittancesCloudH2O", x_cloudH2O[0],
-         "/sza", ((int)fabs(szagrid[i])),
-         "ozone", ((int)ozonegrid[j]),
-         "alt", ((int)altgrid[z]));
-      /*      fprintf (stderr, "%s\n", filename[i][j][z]);*/
-       
-      /* read fringe spectra files and interpolate to output wavelengths */
-       int_grid_data[i][j][z] = do_spectra(filename[i][j][z], lambda, n_lambda,
-         sr_lambda, sr, sr_nlambda, solirr);
-       
-      /* do spline interpolation of cloud tabular entries */
-       if (cloudH2O != x_cloudH2O[0]){
-         tmp[0]=int_grid_data[i][j][z];
-         for (subscr_cloudH2O=1;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++){
-           dummy = sprintf(filename[i][j][z],
-             "%s%5.3f%s%d%s%d%s%d", "./TransmittancesCloudH2O", x_cloudH2O[subscr_cloudH2O],
-             "/sza", ((int)fabs(szagrid[i])),
-             "ozone", ((int)ozonegrid[j]),
-             "alt", ((int)altgrid[z]));
-           
-          /* read fringe spectra files and interpolate to output wavelengths */
-           tmp[subscr_cloudH2O] = do_spectra(filename[i][j][z], lambda, n_lambda,
-            sr_lambda, sr, sr_nlambda, solirr);
-         }
-         for (k = 0; k < n_lambda; k++) {
-          /*        int_grid_data[i][j][z][k] = int_grid_data[i][j][z][k] +
-                (cloudH2O-cloudH2O_low) *
-                (tmp[k]-int_grid_data[i][j][z][k])/(cloudH2O_high-cloudH2O_low);*/
-           for (subscr_cloudH2O=0;subscr_cloudH2O<=subscr_cloudH2O_max;subscr_cloudH2O++){
-            y_cloudH2O[subscr_cloudH2O]=log(tmp[subscr_cloudH2O][k]);
-          }
-          status_c = spline_coeffc (x_cloudH2O, y_cloudH2O, subscr_cloudH2O_max+1, &a0, &a1, &a2, &a3);
-          status_v = calc_splined_value (cloudH2O, &ynew, x_cloudH2O, subscr_cloudH2O_max+1, a0, a1, a2, a3);
-          int_grid_data[i][j][z][k] = exp(ynew);
-          /*          fprintf (stderr, "%f\n", int_grid_data[i][j][z][k]);*/
-          free_splinecoef_results(status_c, a0, a1, a2, a3);
 
+int fastrt_parse_request(int argc, char **argv, FASTRT_REQUEST *req)
+     /* reads the fastrt command line options into req; unlike getopt this is
+        reentrant, and errors are returned instead of terminating the program.
+        req must be initialized with fastrt_request_init and released with
+        fastrt_request_free, also on error */
+{
+  const char *options = "a:v:b:cu:t:o:z:p:q:l:f:r:w:g:e:s:x:d:h";
+  const char *o=NULL;
+  char *optarg=NULL, *arg=NULL;
+  int argi, pos, c, status=0;
+  int sza_flag=0, ozone_flag=0, fwhm_flag=0, sr_flag=0, x_flag=0,
+  start_lambda_flag=0, end_lambda_flag=0, step_lambda_flag=0;
+  double start_lambda=0.0, end_lambda=0.0, step_lambda=0.0,
+  fwhm=0.0, visibility, cloudOD;
+  char *xfilename=NULL, *srfilename=NULL, *surfacealbedo=NULL;
+
+/* accept command line options */
+
+  for (argi=1; argi<argc; argi++) {
+    arg = argv[argi];
+    if (arg[0] != '-' || arg[1] == '\0')
+      break;
+    if (strcmp(arg, "--") == 0)
+      break;
+
+    for (pos=1; arg[pos] != '\0'; pos++) {
+      c = arg[pos];
+      o = strchr(options, c);
+      optarg = NULL;
+
+      if (c == ':' || o == NULL) {
+        fprintf (stderr, "%s: illegal option -- %c\n", PROGRAM, c);
+        print_usage();
+        return (-1);
+      }
+
+      if (o[1] == ':') {
+        if (arg[pos+1] != '\0')
+          optarg = &arg[pos+1];
+        else if (argi+1 < argc)
+          optarg = argv[++argi];
+        else {
+          fprintf (stderr, "%s: option requires an argument -- %c\n", PROGRAM, c);
+          print_usage();
+          return (-1);
+        }
+      }
+
+      switch(c) {
+      case 'a':
+        sza_flag=1;
+        req->sza = atof(optarg);
+        if (req->sza < 0.) {
+          fprintf (stderr, "error: solar zenith angle less than 0 degrees\n");
+          return (-1);
         }
+        if (req->sza > 90.) {
+          fprintf (stderr, "warning: solar zenith angle greater than 90 degrees\n");
+        }
+        break;
+      case 'v':
+        req->beta_flag=1;
+        visibility = atof(optarg);
+        if (visibility < 5.) {
+          fprintf (stderr, "warning: visibility less than 5 km\n");
+          return (-1);
+        }
+        if (visibility > 350.) {
+          fprintf (stderr, "warning: visibility more than 350 km\n");
+          return (-1);
+        }
+        req->beta=fastrt_visibility_to_beta(visibility);
+        break;
+      case 'b':
+        req->beta_flag=1;
+        req->beta = atof(optarg);
+        if (req->beta < 0.) {
+          fprintf (stderr, "error: Aerosol beta less than 0\n");
+          return (-1);
+        }
+        if (req->beta > 0.4) {
+          fprintf (stderr, "warning: Aerosol beta greater than 0.4\n");
+          return (-1);
+        }
+        break;
+      case 'c':
+        req->broken_cloud_flag=1;
+        break;
+      case 't':
+        req->cloudH2O_flag=1;
+        cloudOD = atof(optarg);
+        if (cloudOD < 0.) {
+          fprintf (stderr, "error: cloud optical depth less than 0\n");
+          return (-1);
+        }
+        if (cloudOD >= 1083.) {
+          fprintf (stderr, "error: cloud optical depth greater than 1083\n");
+          return (-1);
+        }
+        req->cloudH2O=cloudOD/1083.; /* convert cloud optical depth to cloud liquid water content in a 5km thick cloud (g m-2)*/
+        break;
+      case 'u':
+        req->cloudH2O_flag=1;
+        req->cloudH2O = atof(optarg)/CLOUD_THICKNESS/1000.; /* convert cloud liquid water column to cloud liquid water content to 2 decimals*/
+        if (req->cloudH2O < 0.) {
+          fprintf (stderr, "error: cloud liquid water content less than 0\n");
+          return (-1);
+        }
+        if (req->cloudH2O > 1.) {
+          fprintf (stderr, "error: cloud liquid water content %f in the assumed %f km thick cloud is greater than or equal to 1.\n", req->cloudH2O, CLOUD_THICKNESS);
+          return (-1);
+        }
+        break;
+      case 'o':
+        ozone_flag=1;
+        req->o3 = atof(optarg);
+        if (req->o3 < 100.) {
+          fprintf (stderr, "warning: ozone column less than 100 DU\n");
+        }
+        if (req->o3 > 600) {
+          fprintf (stderr, "warning: ozone column greater than 600 DU\n");
+        }
+        break;
+      case 'z':
+        req->alt = atof(optarg);
+        if (req->alt < 0.) {
+          fprintf (stderr, "warning: surface altitude less than 0 km\n");
+        }
+        if (req->alt > 6.) {
+          fprintf (stderr, "warning: surface altitude greater than 6 km\n");
+        }
+        break;
+      case 'p':
+        req->albedo_flag=1;
+        req->alb = atof(optarg);
+        if (req->alb < 0.) {
+          fprintf (stderr, "error: surface albedo less than 0\n");
+        }
+        if (req->alb > 1.) {
+          fprintf (stderr, "warning: surface albedo greater than 1\n");
+        }
+        break;
+      case 'q':
+        req->albedo_type_flag=1;
+        req->surfaceno = atoi(optarg);
+        if (req->surfaceno < 0) {
+          fprintf (stderr, "error: surface # less than 0\n");
+          return (-1);
+        }
+        if (req->surfaceno > 17) {
+          fprintf (stderr, "error: surface # greater than 17\n");
+          return (-1);
+        }
+        break;
+      case 'l':
+        req->albedo_file_flag=1;
+        surfacealbedo = optarg;
+        break;
+      case 'f':
+        fwhm_flag=1;
+        fwhm = atof(optarg);
+        if (fwhm <0.05 || fwhm > 55.) {
+          fprintf (stderr,"warning: FWHM not within range [0.05,55] nm\n");
+        }
+        break;
+      case 'r':
+        sr_flag=1;
+        srfilename = optarg;
+        break;
+      case 'w':
+        free(req->lambda);
+        req->n_lambda = 1;
+        req->lambda=(double *) calloc (req->n_lambda, sizeof(double));
+        if (req->lambda == NULL)
+          return ASCII_NO_MEMORY;
+        *req->lambda = atof(optarg);
+        if ((*req->lambda < 290.) || (*req->lambda > 405.)) {
+          fprintf (stderr, "warning: wavelength outside [290,405] nm\n");
+        }
+        break;
+      case 'g':
+        start_lambda_flag=1;
+        start_lambda = atof(optarg);
+        if (start_lambda < 290.) {
+          fprintf (stderr, "warning: start wavelength less than 290 nm\n");
+        }
+        break;
+      case 'e':
+        end_lambda_flag=1;
+        end_lambda = atof(optarg);
+        if (end_lambda > 405.) {
+          fprintf (stderr, "warning: end wavelength greater than 405 nm\n");
+        }
+        break;
+      case 's':
+        step_lambda_flag=1;
+        step_lambda = atof(optarg);
+        break;
+      case 'x':
+        x_flag=1;
+        xfilename = optarg;
+        break;
+      case 'd':
+        req->day_flag = 1;
+        req->day = atof(optarg);
+        break;
+      case 'h':
+      default:
+        print_usage();
+        return (-1);
       }
+
+      if (optarg != NULL)
+        break;
     }
   }
+
+  /* check validity of wavelengths */
+  if (!sza_flag || !ozone_flag) {
+    fprintf (stderr, "solar zenith angle or ozone column is inadequately specified");
+    print_usage();
+    return (-1);
+  }
+
+  if (!(fwhm_flag || sr_flag))
+    status = fastrt_request_set_fwhm(req, FWHM_DEFAULT);
+  if (fwhm_flag)
+    status = fastrt_request_set_fwhm(req, fwhm);
+  if (sr_flag) {
+    free(req->sr_lambda);
+    free(req->sr);
+    req->sr_lambda = req->sr = NULL;
+    /* 'fprintf (stderr, " ... reading slitfunction from file %s ...\n", srfilename); */
+    status = read_slitfunction(srfilename, &req->sr_lambda, &req->sr, &req->sr_nlambda);
+    if (status==0)
+      status = check_spectral_response_function(req->sr_lambda, req->sr, req->sr_nlambda);
+  }
+  if (status!=0)
+    return status;
+
+  if (start_lambda_flag && end_lambda_flag && step_lambda_flag) {
+    if (fastrt_request_set_lambda(req, start_lambda, end_lambda, step_lambda) != 0) {
+      fprintf (stderr, "output wavelengths inadequately specified");
+      print_usage();
+      return (-1);
+    }
+  }
+
+  if (x_flag) {
+    /*    fprintf (stderr, " ... reading wavelengths from file %s ...\n", xfilename); */
+
+    /* read file with user x values */
+    free(req->lambda);
+    req->lambda = NULL;
+    req->n_lambda = 0;
+    status = read_1c_file (xfilename, &req->lambda, &req->n_lambda);
+    if (status!=0 || req->n_lambda < 1)  {
+      fprintf (stderr, "error reading file %s\n", xfilename);
+      return (-1);
+    }
+    if ((req->lambda[0] < 290.) || (req->lambda[req->n_lambda-1] > 405.)) {
+      fprintf (stderr, "warning: wavelength beyond [290,405] nm\n");
+    }
+  }
+
+  if (req->lambda == NULL) {
+    fprintf (stderr, "output wavelengths inadequately specified");
+    print_usage();
+    return (-1);
+  }
+
+  if (req->albedo_file_flag && !req->albedo_flag && !req->albedo_type_flag)
+    if (read_albedo_file(surfacealbedo, req) != 0)
+      return (-1);
+
+  return 0;
 }
+
+
+/* correct for deviations from average sun-earth distance
+   From J. Lenoble, "Atmospheric Radiative Transfer", 1993, A. Deepak Publishing */
+static double day_correction(const FASTRT_REQUEST *req)
+{
+  double pi=3.14159265358979323846264338327, angle;
+
+  if (req->day_flag == 0)
+    return 1.;
+  angle = 2.0 * pi * (double) (req->day-1) / 365.0;
+  return 1.000110 + 0.034221 * cos(angle) + 0.001280 * sin(angle)
+    + 0.000719 * cos(2*angle) + 0.000077 * sin(2*angle);
 }
 
-free(sr_lambda);
-free(sr);
+/* the surface albedo of the request at its output wavelengths */
+static void surface_albedo_at(const FASTRT_REQUEST *req, double *albedo)
+{
+  double *lambda=req->lambda;
+  int i, k, index, n_lambda=req->n_lambda;
 
-  /* compute multiplication factor for aerosol loading */
-if ((beta != 0.02) && (cloudH2O_flag !=1)) {
-  status = compute_aerosol_scaling(sza, beta, lambda, n_lambda, &AerosolScalingArray);
-  if (status!=0) {
-    fprintf (stderr, "ERROR: computation of aerosol effect failed\n");
-    exit(0);
+  if (req->albedo_flag) {
+    for (k=0;k<n_lambda;k++){
+      albedo[k]=req->alb;
+    }
+  }
+  else if (req->albedo_type_flag) {
+    for (i = 0; i < n_lambda; i++) {
+      index = (int) ((lambda[i]-290.)/ALBEDO_RESOLUTION + 0.5);
+      albedo[i] = surface_albedo[req->surfaceno][index];
+    }
+  }
+  else if (req->albedo_file_flag && req->albedo_rows > 0){
+    /* interpolate tabulated data linearly to output wavelengths */
+    i=0;
+    for (k=0; k<n_lambda; k++){
+      while ((i < req->albedo_rows-2) && (lambda[k] > req->albedo_lambda[i+1])) {
+        i++;
+      }
+      if (req->albedo_rows == 1 || req->albedo_lambda[i+1] == req->albedo_lambda[i])
+        albedo[k] = req->albedo_value[i];
+      else
+        albedo[k]= req->albedo_value[i] +
+          (lambda[k]-req->albedo_lambda[i])*
+          (req->albedo_value[i+1]-req->albedo_value[i])/(req->albedo_lambda[i+1]-req->albedo_lambda[i]);
+    }
   }
 }
 
+
+int fastrt_compute(FASTRT_ENGINE *engine, const FASTRT_REQUEST *req, double *doserates_out)
+     /* accesses irradiance data which represent conditions closest to the
+        specified ones, interpolates the available data, and writes the
+        irradiances at req->lambda to doserates_out. With an engine, the
+        tables are read through its table store, else from the files */
+{
+  TABLE_STORE *store = (engine != NULL ? engine->store : NULL);
+  const TABLE_GRID *grid=NULL;
+  double global_irradiance,
+  x_o3[4], y_o3[4], x_sza[4], y_sza[4]={0.0,0.0,0.0,0.0},
+  x_alt[3], y_alt[3], x_cloudH2O[4]={0.0,0.0,0.0,0.0}, ynew=0.;
+  int i, j, k, z, subscr_o3, subscr_sza, subscr_alt,
+  subscr_cloudH2O_max=0, n_alt=3, start_alt=0, alt_first=0, alt_exact=-1;
+  double szagrid[4], ozonegrid[4], altgrid[TABLEGRID_ALT_NODES];
+  int sza_index[4], ozone_index[4], points=TABLEGRID_CUBIC;
+  int status=0, status_c=0, status_v=0;
+  double a0[4], a1[4], a2[4], a3[4], a[3], work[SPLINE_WORK(4)];
+  ARENA *arena=NULL;
+  MATRIX int_grid_data, blend, AtmReflArray, AerosolScalingArray;
+
+  double sza=req->sza, o3=req->o3, alt=req->alt, beta=req->beta,
+  cloudH2O=req->cloudH2O, day_corr,
+  *albedo=NULL, AtmAlbFactor=1., *lambda=req->lambda;
+  int n_lambda=req->n_lambda;
+  int albedo_any=(req->albedo_flag || req->albedo_type_flag || req->albedo_file_flag);
+  int aerosol=((beta != 0.02) && (req->cloudH2O_flag !=1));
+  TABLE_SAMPLING key;
+  double t_call=0., t0=0., t_interp=0., t_metrics=metrics_request_begin();
+  int paths=0;
+
+  if (req->broken_cloud_flag)
+    paths |= 1 << METRICS_BROKEN;
+  else
+    paths |= 1 << (req->cloudH2O_flag ? METRICS_CLOUDY : METRICS_CLEAR);
+  if (albedo_any)
+    paths |= 1 << METRICS_ALBEDO;
+  if (aerosol)
+    paths |= 1 << METRICS_AEROSOL;
+
+  if (lambda == NULL || n_lambda < 1 || req->sr == NULL) {
+    fprintf (stderr, "output wavelengths inadequately specified");
+    metrics_request_end(t_metrics, paths, -1, 0);
+    return (-1);
+  }
+
+  /* the grid of the tables, read once per process without an engine */
+  if (engine != NULL)
+    grid = fastrt_engine_grid(engine);
+  else
+    grid = tablegrid_shared();
+  if (grid == NULL) {
+    fprintf (stderr, "error: cannot read the grid of the tables\n");
+    metrics_request_end(t_metrics, paths, -1, 0);
+    return (-1);
+  }
+
+  /* tables cut to a part of the parameter space know no other values */
+  if (outside_range(grid, TABLEGRID_SZA, sza) || outside_range(grid, TABLEGRID_OZONE, o3) ||
+      outside_range(grid, TABLEGRID_ALT, alt)) {
+    metrics_request_end(t_metrics, paths, -1, 0);
+    return (-1);
+  }
+
+  if (tablegrid_cloud_neighbours(&grid->axis[TABLEGRID_CLOUD], cloudH2O,
+                                 x_cloudH2O, &subscr_cloudH2O_max) != 0) {
+    fprintf (stderr, "error: cloud liquid water content %f outside the tables\n", cloudH2O);
+    metrics_request_end(t_metrics, paths, -1, 0);
+    return (-1);
+  }
+
+  /* identifies the convolved spectra of a table node for this request */
+  tablestore_sampling (&key, lambda, n_lambda, req->sr_lambda, req->sr, req->sr_nlambda);
+
+  day_corr = day_correction(req);
+
+  /* all working memory of the request comes from the arena of this thread,
+     which is reset at the end; once it has grown to the size of the
+     request, the request does not call malloc */
+  if ((arena = arena_thread()) == NULL ||
+      (albedo = scratch_doubles(arena, n_lambda)) == NULL ||
+      matrix_arena3(&int_grid_data, arena, 16, TABLEGRID_ALT_NODES, n_lambda, MATRIX_ALIGNED) != 0 ||
+      matrix_arena(&blend, arena, 3, n_lambda, MATRIX_ALIGNED) != 0) {
+    if (arena != NULL)
+      arena_reset(arena);
+    metrics_request_end(t_metrics, paths, ASCII_NO_MEMORY, 0);
+    return ASCII_NO_MEMORY;
+  }
+
+  t_call = trace_call_begin();
+
+  surface_albedo_at(req, albedo);
+
+  /* find closest precomputed tabulated data entries, 4 per axis for the
+     splines or 2 for linear interpolation on a dense grid */
+  points = grid->points;
+  tablegrid_neighbours(&grid->axis[TABLEGRID_SZA], sza, 1, points, szagrid, sza_index);
+  tablegrid_neighbours(&grid->axis[TABLEGRID_OZONE], o3, 0, points, ozonegrid, ozone_index);
+  n_alt = tablegrid_alt_nodes(grid, alt, &alt_first, &alt_exact);
+  for (z=0; z<n_alt; z++){
+    altgrid[z] = grid->axis[TABLEGRID_ALT].x[alt_first+z];
+  }
+  if (alt_exact >= 0) {
+    n_alt=1;
+    start_alt = alt_exact;
+  }
+
+  /* the spectrum of node [i][j][z] is row [i*4+j][z] of int_grid_data, the
+     nodes of the other cloud levels are read into the rows of blend */
+  for (i=0; i<points; i++){
+    for (j=0; j<points; j++){
+      for (z=start_alt; z<start_alt+n_alt; z++){
+        if (node_spectrum(store, &key, req, grid, x_cloudH2O, subscr_cloudH2O_max,
+                          sza_index[i], ozone_index[j], altgrid[z], &blend,
+                          MATRIX_ROW3(&int_grid_data, i*4+j, z)) != 0) {
+          status = -1;
+          goto cleanup;
+        }
+      }
+    }
+  }
+
+  /* compute multiplication factor for aerosol loading */
+  if (aerosol) {
+    t0 = trace_begin();
+    status = matrix_arena(&AerosolScalingArray, arena, TABLEGRID_ALT_NODES, n_lambda, MATRIX_ALIGNED);
+    if (status==0)
+      status = aerosol_scaling_from_store(store, grid, alt_first, start_alt, n_alt, sza, beta,
+                                          lambda, n_lambda, &AerosolScalingArray);
+    trace_end(TRACE_AEROSOL, t0);
+    if (status!=0) {
+      fprintf (stderr, "ERROR: computation of aerosol effect failed\n");
+      goto cleanup;
+    }
+  }
+
   /* compute multiplication factor for multiple bounces of light at the surface-atmosphere boundary */
-if (albedo_flag || albedo_type_flag || albedo_file_flag){
-  status = compute_atmospheric_reflectance(o3, beta, cloudH2O, x_cloudH2O, subscr_cloudH2O_max, lambda, n_lambda, &AtmReflArray);
-  if (status!=0) {
-    fprintf (stderr, "ERROR: computation of albedo effect failed\n");
-    exit(0);
+  if (albedo_any){
+    t0 = trace_begin();
+    status = matrix_arena(&AtmReflArray, arena, TABLEGRID_ALT_NODES, n_lambda, MATRIX_ALIGNED);
+    if (status==0)
+      status = atmospheric_reflectance_from_store(arena, store, grid, alt_first, start_alt, n_alt,
+                                                  o3, beta, cloudH2O, x_cloudH2O, subscr_cloudH2O_max,
+                                                  lambda, n_lambda, &AtmReflArray);
+    trace_end(TRACE_REFLECTANCE, t0);
+    if (status!=0) {
+      fprintf (stderr, "ERROR: computation of albedo effect failed\n");
+      goto cleanup;
+    }
   }
-}
 
-for (k = 0; k < n_lambda; k++) {
-  subscr_alt=-1;
-  for (z=start_alt; z<start_alt+n_alt; z++){
-    subscr_sza=-1;
-    for (i=0; i<4; i++){
-     subscr_o3=-1;
-     for (j=0; j<4; j++){
-       if (int_grid_data[i][j][z][k] != NaN) {
-         subscr_o3++;
-         x_o3[subscr_o3]=ozonegrid[j];
-         y_o3[subscr_o3]=int_grid_data[i][j][z][k];
-       }
-     }
+  t_interp = trace_begin();
+  for (k = 0; k < n_lambda; k++) {
+    subscr_alt=-1;
+    for (z=start_alt; z<start_alt+n_alt; z++){
+      subscr_sza=-1;
+      for (i=0; i<points; i++){
+        subscr_o3=-1;
+        for (j=0; j<points; j++){
+          if (MATRIX_AT3(&int_grid_data, i*4+j, z, k) != NaN) {
+            subscr_o3++;
+            x_o3[subscr_o3]=ozonegrid[j];
+            y_o3[subscr_o3]=MATRIX_AT3(&int_grid_data, i*4+j, z, k);
+          }
+        }
 
-    /* interpolated to correct ozone column */
-     status_c = spline_coeffc (x_o3, y_o3, subscr_o3+1, &a0, &a1, &a2, &a3);
-     status_v = calc_splined_value (o3, &ynew, x_o3, subscr_o3+1, a0, a1, a2, a3);
-     free_splinecoef_results(status_c, a0, a1, a2, a3);
+        /* interpolated to correct ozone column */
+        status_c = spline_coeffc_buffer (x_o3, y_o3, subscr_o3+1, a0, a1, a2, a3, work);
+        status_v = calc_splined_value (o3, &ynew, x_o3, subscr_o3+1, a0, a1, a2, a3);
 
-     if ((status_c==0) && (status_v==0)) {
-       subscr_sza++;
-       x_sza[subscr_sza] = szagrid[i];
-       y_sza[subscr_sza] = ynew;
-     }
-   }
-   
-      /* interpolate to correct solar zenith angle */
-   status_c = spline_coeffc (x_sza, y_sza, subscr_sza+1, &a0, &a1, &a2, &a3);
-   status_v = calc_splined_value (sza, &ynew, x_sza, subscr_sza+1, a0, a1, a2, a3);
-   free_splinecoef_results(status_c, a0, a1, a2, a3);
+        if ((status_c==0) && (status_v==0)) {
+          subscr_sza++;
+          x_sza[subscr_sza] = szagrid[i];
+          y_sza[subscr_sza] = ynew;
+        }
+      }
 
+      /* interpolate to correct solar zenith angle */
+      status_c = spline_coeffc_buffer (x_sza, y_sza, subscr_sza+1, a0, a1, a2, a3, work);
+      status_v = calc_splined_value (sza, &ynew, x_sza, subscr_sza+1, a0, a1, a2, a3);
 
       /* correct for multiple bounces between surface and atmosphere and aerosols
-       scaling factors must be multiplied with transmittance at beta=0.02 (default)*/
+         scaling factors must be multiplied with transmittance at beta=0.02 (default)*/
 
       /* compute multiplication factor for aerosol loading */
-   if ((beta != 0.02) && (cloudH2O_flag !=1)) {
-    /*    fprintf (stderr, "k %d z %d AerosolScalingArray %f\n", k, z, AerosolScalingArray[k][z] );*/
-     ynew*=AerosolScalingArray[k][z];
-   }
-   
+      if (aerosol) {
+        ynew*=MATRIX_AT(&AerosolScalingArray, z, k);
+      }
+
       /* compute multiplication factor for multiple bounces of light at the surface-atmosphere boundary */
-   if (albedo_flag || albedo_type_flag || albedo_file_flag){
-     AtmAlbFactor = 1./(1-AtmReflArray[k][z]*albedo[k]);
-     ynew*=AtmAlbFactor;
-    /*    fprintf (stderr, "main: k %d z %d AtmReflArray %f albedo %f AtmAlbFactor %f\n",
-        k, z, AtmReflArray[k][z], albedo[k], AtmAlbFactor); */
-   }
-   
-   if ((status_c==0) && (status_v==0)) {
-     subscr_alt++;
-     x_alt[subscr_alt] = altgrid[z];
-     y_alt[subscr_alt] = ynew;
-   }
-   else {
-     fprintf (stderr, "sorry cannot do spline interpolation\n");
-     fprintf (stderr, "spline_coeffc() returned status_c status_v %d %d \n", status_c, status_v);
-     fprintf (stderr, "solar zenith angle or ozone column is beyond prespecified range?\n");
-     print_usage();
-     exit(status);
-   }
- }
-    
- if (n_alt > 1) {
-  a = newton_co (subscr_alt+1, x_alt, y_alt);
+      if (albedo_any){
+        AtmAlbFactor = 1./(1-MATRIX_AT(&AtmReflArray, z, k)*albedo[k]);
+        ynew*=AtmAlbFactor;
+      }
+
+      if ((status_c==0) && (status_v==0)) {
+        subscr_alt++;
+        x_alt[subscr_alt] = altgrid[z];
+        y_alt[subscr_alt] = ynew;
+      }
+      else {
+        fprintf (stderr, "sorry cannot do spline interpolation\n");
+        fprintf (stderr, "spline_coeffc() returned status_c status_v %d %d \n", status_c, status_v);
+        fprintf (stderr, "solar zenith angle or ozone column is beyond prespecified range?\n");
+        status = (status_c != 0 ? status_c : status_v);
+        goto cleanup;
+      }
+    }
+
+    if (n_alt > 1) {
+      newton_co_buffer (subscr_alt+1, x_alt, y_alt, a);
       /* interpolate to correct surface altitude */
-  ynew = eval (subscr_alt+1, x_alt, a, alt);
-  free(a);
-}
+      ynew = eval (subscr_alt+1, x_alt, a, alt);
+    }
 
     /* copy data to result array */
-if (status==0) {
-  global_irradiance = ynew * day_corr;
-}
-else {
-  fprintf (stderr, "sorry cannot do spline interpolation\n");
-  fprintf (stderr, "calc_splined_value() returned status %d\n", status);
-  fprintf (stderr, "Ozone content, solar zenith angle, altitude, \n");
-  fprintf (stderr, "or wavelength are beyond prespecified range?\n");
-  print_usage();
-  exit(status);
-}
-//    fprintf (stdout, "%6.2f %10.4e\n", lambda[k], global_irradiance);
-doserates_out[k] = global_irradiance;
+    global_irradiance = ynew * day_corr;
+    doserates_out[k] = global_irradiance;
+  }
+
+  // TODO Investigate weird sunset error case where the sza goes wild
+  if (y_sza[3] > 99999)
+    status = 10;
+
+ cleanup:
+  trace_end(TRACE_INTERPOLATE, t_interp);
+
+  trace_call_end(t_call);
+
+  // all used memory is in the arena
+  metrics_request_end(t_metrics, paths, status, arena->used);
+  arena_reset(arena);
+  return status;
 }
-    if ((beta != 0.02) && (cloudH2O_flag !=1))
-    {
-        ASCII_free_double(AerosolScalingArray, n_lambda);
+
+
+int fastrt_reduce(FASTRT_ENGINE *engine, const FASTRT_REQUEST *req, REDUCED_TABLE *table)
+     /* evaluates the request at every sza node of the grid up to the spline
+        in sza, into a table of reduced.h; the sza of the request is not
+        used. With an engine, the tables are read through its table store,
+        else from the files */
+{
+  TABLE_STORE *store = (engine != NULL ? engine->store : NULL);
+  const TABLE_GRID *grid=NULL;
+  const TABLE_AXIS *sza_axis=NULL;
+  double x_o3[4], y_o3[4], x_cloudH2O[4]={0.0,0.0,0.0,0.0}, ynew=0.;
+  double ozonegrid[4], altgrid[TABLEGRID_ALT_NODES], weight[TABLEGRID_ALT_NODES];
+  double a0[4], a1[4], a2[4], a3[4], work[SPLINE_WORK(4)];
+  double o3=req->o3, alt=req->alt, beta=req->beta, day_corr, factor, *albedo=NULL;
+  double *lambda=req->lambda, *value=NULL;
+  int i, j, k, l, m, z, c, subscr_o3, subscr_cloudH2O_max=0;
+  int n_alt=3, start_alt=0, alt_first=0, alt_exact=-1, n_layers=1, mixed=0, valid=0;
+  int ozone_index[4], points=TABLEGRID_CUBIC, status=0, status_c=0, status_v=0;
+  int n_lambda=req->n_lambda;
+  int albedo_any=(req->albedo_flag || req->albedo_type_flag || req->albedo_file_flag);
+  int aerosol=((beta != 0.02) && (req->cloudH2O_flag !=1));
+  TABLE_SAMPLING key;
+  ARENA *arena=NULL;
+  MATRIX spectra, blend, layers, AtmReflArray, AerosolScalingArray;
+
+  memset(table, 0, sizeof(REDUCED_TABLE));
+  if (lambda == NULL || n_lambda < 1 || req->sr == NULL) {
+    fprintf (stderr, "output wavelengths inadequately specified");
+    return (-1);
+  }
+
+  if (engine != NULL)
+    grid = fastrt_engine_grid(engine);
+  else
+    grid = tablegrid_shared();
+  if (grid == NULL) {
+    fprintf (stderr, "error: cannot read the grid of the tables\n");
+    return (-1);
+  }
+  sza_axis = &grid->axis[TABLEGRID_SZA];
+
+  if (outside_range(grid, TABLEGRID_OZONE, o3) || outside_range(grid, TABLEGRID_ALT, alt))
+    return (-1);
+
+  if (tablegrid_cloud_neighbours(&grid->axis[TABLEGRID_CLOUD], req->cloudH2O,
+                                 x_cloudH2O, &subscr_cloudH2O_max) != 0) {
+    fprintf (stderr, "error: cloud liquid water content %f outside the tables\n", req->cloudH2O);
+    return (-1);
+  }
+
+  tablestore_sampling (&key, lambda, n_lambda, req->sr_lambda, req->sr, req->sr_nlambda);
+
+  day_corr = day_correction(req);
+
+  /* the neighbours of every query in ozone and altitude, as fastrt_compute() */
+  points = grid->points;
+  tablegrid_neighbours(&grid->axis[TABLEGRID_OZONE], o3, 0, points, ozonegrid, ozone_index);
+  n_alt = tablegrid_alt_nodes(grid, alt, &alt_first, &alt_exact);
+  for (z=0; z<n_alt; z++){
+    altgrid[z] = grid->axis[TABLEGRID_ALT].x[alt_first+z];
+  }
+  if (alt_exact >= 0) {
+    n_alt=1;
+    start_alt = alt_exact;
+  }
+
+  /* the polynomial through the altitude nodes is a sum of their values
+     with these weights */
+  for (z=start_alt; z<start_alt+n_alt; z++){
+    weight[z] = 1.;
+    for (m=start_alt; m<start_alt+n_alt; m++)
+      if (m != z)
+        weight[z] *= (alt - altgrid[m]) / (altgrid[z] - altgrid[m]);
+  }
+
+  if ((arena = arena_thread()) == NULL ||
+      (albedo = scratch_doubles(arena, n_lambda)) == NULL ||
+      matrix_arena3(&spectra, arena, 4, TABLEGRID_ALT_NODES, n_lambda, MATRIX_ALIGNED) != 0 ||
+      matrix_arena3(&layers, arena, TABLEGRID_ALT_NODES, sza_axis->n, n_lambda, MATRIX_ALIGNED) != 0 ||
+      matrix_arena(&blend, arena, 3, n_lambda, MATRIX_ALIGNED) != 0 ||
+      matrix_arena(&AtmReflArray, arena, TABLEGRID_ALT_NODES, n_lambda, MATRIX_ALIGNED) != 0 ||
+      matrix_arena(&AerosolScalingArray, arena, TABLEGRID_ALT_NODES, n_lambda, MATRIX_ALIGNED) != 0) {
+    status = ASCII_NO_MEMORY;
+    goto cleanup;
+  }
+
+  surface_albedo_at(req, albedo);
+
+  /* the albedo factor does not depend on the sza */
+  if (albedo_any){
+    status = atmospheric_reflectance_from_store(arena, store, grid, alt_first, start_alt, n_alt,
+                                                o3, beta, req->cloudH2O, x_cloudH2O,
+                                                subscr_cloudH2O_max, lambda, n_lambda,
+                                                &AtmReflArray);
+    if (status!=0) {
+      fprintf (stderr, "ERROR: computation of albedo effect failed\n");
+      goto cleanup;
     }
-    // free all used memory
-    ASCII_free_double(AtmReflArray, n_lambda);
+  }
 
-    if (n_lambda > 0)
-    {
-        free(lambda);
-        free(albedo);
+  /* row [z][i] of layers is sza node i at altitude node z, interpolated in
+     ozone and scaled by the factors that do not depend on the sza */
+  for (i=0; i<sza_axis->n; i++){
+    for (j=0; j<points; j++){
+      for (z=start_alt; z<start_alt+n_alt; z++){
+        if (node_spectrum(store, &key, req, grid, x_cloudH2O, subscr_cloudH2O_max,
+                          i, ozone_index[j], altgrid[z], &blend,
+                          MATRIX_ROW3(&spectra, j, z)) != 0) {
+          status = -1;
+          goto cleanup;
+        }
+      }
     }
-    
-for (i=0; i<4; i++){
-  for (j=0; j<4; j++){
+
     for (z=start_alt; z<start_alt+n_alt; z++){
-      free(int_grid_data[i][j][z]);
+      value = MATRIX_ROW3(&layers, z, i);
+      for (k = 0; k < n_lambda; k++) {
+        subscr_o3=-1;
+        for (j=0; j<points; j++){
+          if (MATRIX_AT3(&spectra, j, z, k) != NaN) {
+            subscr_o3++;
+            x_o3[subscr_o3]=ozonegrid[j];
+            y_o3[subscr_o3]=MATRIX_AT3(&spectra, j, z, k);
+          }
+        }
+
+        status_c = spline_coeffc_buffer (x_o3, y_o3, subscr_o3+1, a0, a1, a2, a3, work);
+        status_v = calc_splined_value (o3, &ynew, x_o3, subscr_o3+1, a0, a1, a2, a3);
+
+        if ((status_c==0) && (status_v==0)) {
+          factor = weight[z] * day_corr;
+          if (albedo_any)
+            factor /= (1-MATRIX_AT(&AtmReflArray, z, k)*albedo[k]);
+          value[k] = ynew * factor;
+        }
+        else
+          value[k] = NaN;
+      }
     }
   }
-}
-    // TODO Investigate weird sunset error case where the sza goes wild
-    if (y_sza[3] > 99999)
-    {
-        return 10;
+
+  /* without aerosol the altitude nodes are summed into one layer, unless
+     a node is left out of the spline in sza at some altitudes only */
+  for (i=0; i<sza_axis->n && !mixed; i++)
+    for (k=0; k<n_lambda && !mixed; k++){
+      valid = (MATRIX_AT3(&layers, start_alt, i, k) != NaN);
+      for (z=start_alt+1; z<start_alt+n_alt; z++)
+        if ((MATRIX_AT3(&layers, z, i, k) != NaN) != valid)
+          mixed = 1;
+    }
+  n_layers = ((aerosol || mixed) ? n_alt : 1);
+
+  status = reduced_create(table, sza_axis, aerosol ? &grid->axis[TABLEGRID_COEFF_SZA] : NULL,
+                          n_layers, lambda, n_lambda);
+  if (status != 0)
+    goto cleanup;
+  table->points = points;
+  table->range = grid->range[TABLEGRID_SZA];
+
+  for (i=0; i<sza_axis->n; i++){
+    for (k = 0; k < n_lambda; k++) {
+      for (l=0; l<n_layers; l++){
+        value = table->values + ((size_t) l * sza_axis->n + i) * n_lambda;
+        if (n_layers == n_alt) {
+          value[k] = MATRIX_AT3(&layers, start_alt+l, i, k);
+          continue;
+        }
+        value[k] = 0.;
+        for (z=start_alt; z<start_alt+n_alt && value[k] != NaN; z++)
+          value[k] = (MATRIX_AT3(&layers, z, i, k) != NaN ?
+                      value[k] + MATRIX_AT3(&layers, z, i, k) : NaN);
+      }
     }
+  }
+
+  /* the aerosol factors of every coefficient sza, see aerosol_scaling_from_store() */
+  for (c=0; c<table->coeff_sza.n; c++){
+    status = aerosol_scaling_from_store(store, grid, alt_first, start_alt, n_alt,
+                                        table->coeff_sza.x[c], beta, lambda, n_lambda,
+                                        &AerosolScalingArray);
+    if (status!=0) {
+      fprintf (stderr, "ERROR: computation of aerosol effect failed\n");
+      goto cleanup;
+    }
+    for (l=0; l<n_layers; l++)
+      memcpy(table->aerosol + ((size_t) c * n_layers + l) * n_lambda,
+             MATRIX_ROW(&AerosolScalingArray, start_alt+l), n_lambda * sizeof(double));
+  }
+
+ cleanup:
+  if (status != 0)
+    reduced_free(table);
+  if (arena != NULL)
+    arena_reset(arena);
+  return status;
+}
+
+
+int run_fastrt_(int argc, char **argv, double *doserates_out)
+     /* reads input parameters, accesses irradiance data which represent
+    conditions closest to the specified ones, interpolates the available
+    data, and writes result to doserates_out */
+{
+  FASTRT_REQUEST req;
+  int status=0;
 
-return (0);
+  fastrt_request_init(&req);
+
+  status = fastrt_parse_request(argc, argv, &req);
+  if (status==0)
+    status = fastrt_compute(NULL, &req, doserates_out);
+
+  fastrt_request_free(&req);
+  return status;
 }
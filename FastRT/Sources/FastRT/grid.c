@@ -0,0 +1,421 @@
+/************************************************************************/
+/* grid.c                                                               */
+/*                                                                      */
+/* UV index and burn time maps on a regular latitude/longitude grid.    */
+/*                                                                      */
+/* Rows are evaluated in bands. For each band the solar zenith angles   */
+/* of all cells are computed in one pass, the daylit cells are sorted   */
+/* by the table nodes they interpolate from, and the task pool hands    */
+/* contiguous ranges of the sorted cells to the workers, so that        */
+/* neighbouring cells of the table run one after another and every node */
+/* is read once per map through the engine. Finished bands are written  */
+/* row by row.                                                          */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "grid.h"
+#include "dose.h"
+#include "sun.h"
+
+
+/* cells per task */
+#define GRID_CHUNK           16
+
+
+typedef struct {
+  int                cell;      /* index within the band                  */
+  unsigned long long node;      /* table neighbourhood, sort key          */
+  double             sza, o3, alt, cloud;
+} GRID_CELL;
+
+typedef struct {
+  FASTRT_ENGINE        *engine;
+  const GRID_SPEC      *spec;
+  const FASTRT_REQUEST *templ;
+  GRID_CELL            *cells;
+  int                   n_cells;
+  float                *uvi;         /* band results                    */
+  float                *burn;
+  long                  failed;
+  pthread_mutex_t       lock;
+} GRID_BAND;
+
+/* per worker scratch */
+typedef struct {
+  long                  failed;
+  double                doserates[DOSE_N_LAMBDA];
+} GRID_SCRATCH;
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static int compare_cells (const void *a, const void *b)
+{
+  const GRID_CELL *x = (const GRID_CELL *) a, *y = (const GRID_CELL *) b;
+
+  if (x->node != y->node)
+    return (x->node < y->node ? -1 : 1);
+  return x->cell - y->cell;
+}
+
+
+/* the table nodes used by fastrt_compute() follow from the cloud   */
+/* neighbours, the sza and ozone grid cells and the altitude nodes */
+static unsigned long long node_key (const TABLE_GRID *grid, double sza, double o3, double alt,
+				    double cloud)
+{
+  double x_cloudH2O[TABLEGRID_NEIGHBOURS];
+  int n_cloud=0, alt_first=0, alt_node=0;
+  unsigned long long key=0;
+
+  tablegrid_cloud_neighbours (&grid->axis[TABLEGRID_CLOUD], cloud, x_cloudH2O, &n_cloud);
+
+  tablegrid_alt_nodes (grid, alt, &alt_first, &alt_node);
+  if (alt_node < 0)
+    alt_node = TABLEGRID_ALT_NODES;
+
+  key = (unsigned long long) (tablegrid_lower (&grid->axis[TABLEGRID_CLOUD], x_cloudH2O[0]) + 1);
+  key = key * 8    + n_cloud;
+  key = key * 1024 + (tablegrid_lower (&grid->axis[TABLEGRID_SZA], sza) + 1);
+  key = key * 1024 + (tablegrid_lower (&grid->axis[TABLEGRID_OZONE], o3) + 1);
+  key = key * 64   + alt_first;
+  key = key * 4    + alt_node;
+  return key;
+}
+
+
+static void evaluate_cell (GRID_BAND *band, GRID_CELL *cell, double *doserates, long *failed)
+{
+  FASTRT_REQUEST req = *band->templ;
+  double ery=0.0;
+  int status=0;
+
+  req.sza = cell->sza;
+  req.o3  = cell->o3;
+  req.alt = cell->alt;
+  if (cell->cloud > 0.0)  {
+    req.cloudH2O      = cell->cloud;
+    req.cloudH2O_flag = 1;
+  }
+
+  status = fastrt_compute (band->engine, &req, doserates);
+
+  if (status != 0)  {
+    band->uvi[cell->cell]  = NAN;
+    band->burn[cell->cell] = NAN;
+    (*failed)++;
+    return;
+  }
+
+  ery = dose_rate (doserates, DOSE_ERYTHEMA);
+
+  band->uvi[cell->cell]  = (float) dose_uv_index (ery);
+  band->burn[cell->cell] = (ery > 0.0 ? (float) (band->spec->med * 1000.0 / ery / 60.0)
+			    : INFINITY);
+}
+
+
+static int grid_init (void *arg, TASKPOOL_WORKER *worker)
+{
+  GRID_SCRATCH *scratch=NULL;
+
+  (void) arg;
+  /* the scratch of the pool is kept from the band before */
+  if ((scratch = (GRID_SCRATCH *) taskpool_scratch (worker, sizeof(GRID_SCRATCH))) == NULL)
+    return -1;
+  scratch->failed = 0;
+  return 0;
+}
+
+
+static int grid_task (void *arg, TASKPOOL_WORKER *worker, long first, long n)
+{
+  GRID_BAND *band = (GRID_BAND *) arg;
+  GRID_SCRATCH *scratch = (GRID_SCRATCH *) worker->scratch;
+  long i=0;
+
+  for (i=first; i<first+n; i++)
+    evaluate_cell (band, &band->cells[i], scratch->doserates, &scratch->failed);
+
+  return 0;
+}
+
+
+static void grid_fini (void *arg, TASKPOOL_WORKER *worker)
+{
+  GRID_BAND *band = (GRID_BAND *) arg;
+  GRID_SCRATCH *scratch = (GRID_SCRATCH *) worker->scratch;
+
+  pthread_mutex_lock (&band->lock);
+  band->failed += scratch->failed;
+  pthread_mutex_unlock (&band->lock);
+}
+
+
+static int write_header (FILE *out, const GRID_SPEC *spec, int n_bands)
+{
+  int32_t header[6];
+  double  extent[4];
+
+  header[0] = spec->n_lat;
+  header[1] = spec->n_lon;
+  header[2] = n_bands;
+  header[3] = spec->outputs;
+  header[4] = spec->day;
+  header[5] = spec->seconds;
+
+  extent[0] = spec->lat0;
+  extent[1] = spec->dlat;
+  extent[2] = spec->lon0;
+  extent[3] = spec->dlon;
+
+  if (fwrite (GRID_MAGIC, 1, 8, out) != 8 ||
+      fwrite (header, sizeof(int32_t), 6, out) != 6 ||
+      fwrite (extent, sizeof(double), 4, out) != 4)
+    return -1;
+
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: grid_spec_init                                                        */
+/* Description:                                                                    */
+/*  Set the defaults of a grid: no cells, the sky of run_fastrt(), UV index only. */
+/***********************************************************************************/
+
+void grid_spec_init (GRID_SPEC *spec)
+{
+  memset (spec, 0, sizeof(GRID_SPEC));
+
+  spec->o3         = GRID_OZONE;
+  spec->visibility = GRID_VISIBILITY;
+  spec->albedo     = GRID_ALBEDO;
+  spec->med        = GRID_MED;
+  spec->day        = 1;
+  spec->outputs    = GRID_UV_INDEX;
+}
+
+
+
+/***********************************************************************************/
+/* Function: grid_run                                                              */
+/* Description:                                                                    */
+/*  Evaluate UV index and/or burn time for all cells of a grid at one time and    */
+/*  stream the map to out, see grid.h for the format. Cloudless cells use the     */
+/*  visibility, cloudy cells the cloud liquid water column as fastrt -u; the      */
+/*  spectrum is computed at 290-400 nm with 0.6 nm FWHM. Cells with the sun below */
+/*  the horizon have UV index 0 and infinite burn time.                           */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  FASTRT_ENGINE *engine:   Engine; with NULL a private engine is used.           */
+/*  const GRID_SPEC *spec:   Grid, see grid_spec_init().                           */
+/*  FILE *out:               Binary raster, NULL to evaluate only.                 */
+/*  GRID_STATS *stats:       Statistics, set by function, may be NULL.             */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error. Failed cells are NaN and do not cause an error.      */
+/***********************************************************************************/
+
+int grid_run (FASTRT_ENGINE *engine, const GRID_SPEC *spec, FILE *out, GRID_STATS *stats)
+{
+  FASTRT_ENGINE *own=NULL;
+  const TABLE_GRID *grid=NULL;
+  const TABLE_AXIS *clouds=NULL;
+  FASTRT_REQUEST templ;
+  SUN_EPHEMERIS eph;
+  GRID_BAND band;
+  GRID_STATS st;
+  TASKPOOL_JOB job;
+  TASKPOOL *pool=NULL;
+  int *times=NULL;
+  double *lats=NULL, *lons=NULL, *zenith=NULL;
+  int n_threads=0, band_rows=0, n_bands=0, cap=0;
+  int r0=0, r1=0, n=0, i=0, j=0, c=0, status=0;
+  double t0 = now();
+
+  memset (&st, 0, sizeof(GRID_STATS));
+  memset (&band, 0, sizeof(GRID_BAND));
+  fastrt_request_init (&templ);
+
+  if (spec == NULL || spec->n_lat < 1 || spec->n_lon < 1 ||
+      (spec->outputs & (GRID_UV_INDEX | GRID_BURN_TIME)) == 0)
+    return -1;
+
+  n_bands = ((spec->outputs & GRID_UV_INDEX) != 0) + ((spec->outputs & GRID_BURN_TIME) != 0);
+
+  n_threads = taskpool_threads (spec->n_threads);
+
+  /* enough rows per band to keep all workers busy with few hand-overs */
+  band_rows = spec->band_rows;
+  if (band_rows < 1)
+    band_rows = 1 + (4096 * n_threads) / spec->n_lon;
+  if (band_rows > spec->n_lat)
+    band_rows = spec->n_lat;
+  cap = band_rows * spec->n_lon;
+
+  if (engine == NULL)  {
+    if ((own = fastrt_engine_create ()) == NULL)
+      return -1;
+    engine = own;
+  }
+
+  if ((grid = fastrt_engine_grid (engine)) == NULL)  {
+    status = -1;
+    goto cleanup;
+  }
+  clouds = &grid->axis[TABLEGRID_CLOUD];
+
+  /* everything but the cell is the same for all cells, see run_fastrt() */
+  templ.albedo_flag = 1;
+  templ.alb         = spec->albedo;
+  templ.day_flag    = 1;
+  templ.day         = spec->day;
+  templ.beta_flag   = 1;
+  templ.beta        = fastrt_visibility_to_beta (spec->visibility);
+  if ((status = fastrt_request_set_lambda (&templ, DOSE_LAMBDA_START, DOSE_LAMBDA_END, 1.0)) != 0 ||
+      (status = fastrt_request_set_fwhm (&templ, FWHM_DEFAULT)) != 0)
+    goto cleanup;
+
+  sun_ephemeris (spec->day, &eph);
+
+  times       = (int *)       calloc (cap, sizeof(int));
+  lats        = (double *)    calloc (cap, sizeof(double));
+  lons        = (double *)    calloc (cap, sizeof(double));
+  zenith      = (double *)    calloc (cap, sizeof(double));
+  band.cells  = (GRID_CELL *) calloc (cap, sizeof(GRID_CELL));
+  band.uvi    = (float *)     calloc (cap, sizeof(float));
+  band.burn   = (float *)     calloc (cap, sizeof(float));
+  if (!times || !lats || !lons || !zenith || !band.cells || !band.uvi || !band.burn)  {
+    status = -1;
+    goto cleanup;
+  }
+
+  /* the workers of all bands */
+  if ((pool = taskpool_create (n_threads)) == NULL)  {
+    status = -1;
+    goto cleanup;
+  }
+
+  band.engine = engine;
+  band.spec   = spec;
+  band.templ  = &templ;
+  pthread_mutex_init (&band.lock, NULL);
+
+  job.init = grid_init;
+  job.run  = grid_task;
+  job.fini = grid_fini;
+  job.arg  = &band;
+
+  if (out != NULL && write_header (out, spec, n_bands) != 0)  {
+    status = -1;
+    goto destroy;
+  }
+
+  for (r0=0; r0<spec->n_lat; r0=r1)  {
+    r1 = r0 + band_rows;
+    if (r1 > spec->n_lat)
+      r1 = spec->n_lat;
+    n = (r1 - r0) * spec->n_lon;
+
+    /* solar geometry of the band in one pass; sun.c is West positive */
+    for (i=r0, c=0; i<r1; i++)
+      for (j=0; j<spec->n_lon; j++, c++)  {
+	times[c] = spec->seconds % 86400;
+	lats[c]  = spec->lat0 + i * spec->dlat;
+	lons[c]  = -(spec->lon0 + j * spec->dlon);
+      }
+
+    if ((status = solar_zenith_azimuth_soa (&eph, n, times, lats, lons, 0.0, zenith, NULL)) != 0)
+      goto destroy;
+
+    /* daylit cells, sorted by table neighbourhood */
+    band.n_cells = 0;
+    for (c=0; c<n; c++)  {
+      long cell = (long) r0 * spec->n_lon + c;
+      GRID_CELL *g = &band.cells[band.n_cells];
+
+      /* run_fastrt() passes the zenith angle and altitude with 3 decimals */
+      if (zenith[c] < 0.0 || zenith[c] > 90.0)  {
+	band.uvi[c]  = 0.0f;
+	band.burn[c] = INFINITY;
+	continue;
+      }
+
+      g->cell  = c;
+      g->sza   = floor (zenith[c] * 1000.0 + 0.5) / 1000.0;
+      g->alt   = (spec->altitude != NULL ? floor (spec->altitude[cell] * 1000.0 + 0.5) / 1000.0 : 0.0);
+      g->o3    = (spec->ozone    != NULL ? spec->ozone[cell] : spec->o3);
+      g->cloud = (spec->cloud    != NULL ? spec->cloud[cell] / CLOUD_THICKNESS / 1000.0 : 0.0);
+      if (g->cloud > clouds->x[clouds->n-1])
+	g->cloud = clouds->x[clouds->n-1];
+      if (g->cloud < clouds->x[0])
+	g->cloud = clouds->x[0];
+      g->node  = node_key (grid, g->sza, g->o3, g->alt, g->cloud);
+      band.n_cells++;
+    }
+    st.day_cells += band.n_cells;
+
+    qsort (band.cells, band.n_cells, sizeof(GRID_CELL), compare_cells);
+
+    if ((status = taskpool_run (pool, &job, band.n_cells, GRID_CHUNK, n_threads,
+				spec->schedule, NULL)) != 0)
+      goto destroy;
+
+    /* stream the finished rows */
+    if (out != NULL)  {
+      for (i=r0; i<r1; i++)  {
+	c = (i - r0) * spec->n_lon;
+	if ((spec->outputs & GRID_UV_INDEX) != 0 &&
+	    fwrite (&band.uvi[c], sizeof(float), spec->n_lon, out) != (size_t) spec->n_lon)
+	  status = -1;
+	if ((spec->outputs & GRID_BURN_TIME) != 0 &&
+	    fwrite (&band.burn[c], sizeof(float), spec->n_lon, out) != (size_t) spec->n_lon)
+	  status = -1;
+      }
+      if (status != 0)
+	goto destroy;
+    }
+
+    st.cells += n;
+  }
+
+  if (out != NULL)
+    fflush (out);
+
+ destroy:
+  st.failed = band.failed;
+  pthread_mutex_destroy (&band.lock);
+
+ cleanup:
+  taskpool_free (pool);
+  free (times);
+  free (lats);
+  free (lons);
+  free (zenith);
+  free (band.cells);
+  free (band.uvi);
+  free (band.burn);
+  fastrt_request_free (&templ);
+  fastrt_engine_free (own);
+
+  st.seconds = now() - t0;
+  if (stats != NULL)
+    *stats = st;
+
+  return status;
+}
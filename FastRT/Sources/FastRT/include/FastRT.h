@@ -15,14 +15,22 @@
 #include "spl.h"
 #include "table.h"
 #include "sun.h"
+#include "daylight.h"
 #include "integrat.h"
 #include "function.h"
 #include "cnv.h"
 #include "equation.h"
 #include "fastrt_.h"
+#include "engine.h"
+#include "grid.h"
+#include "trace.h"
+#include "metrics.h"
+#include "arena.h"
 
 int run_fastrt_test_inputs(double *doserates);
 
+// Sunrise and sunset at the exact location, computed on every call.
+// Returns ERROR_NO_ZENITH if the sun does not cross the horizon that day.
 int get_sunrise_sunset(
                        int *out_sunrise,
                        int *out_sunset,
@@ -31,6 +39,24 @@ int get_sunrise_sunset(
                        double longitude,
                        double altitude);
 
+// Daylight window of the day from the cached annual table of the location.
+// Returns DAYLIGHT_NORMAL, DAYLIGHT_POLAR_DAY or DAYLIGHT_POLAR_NIGHT, <0 on error.
+int get_daylight_window(
+                        int *out_sunrise,
+                        int *out_sunset,
+                        int *out_solar_noon,
+                        double *out_min_zenith,
+                        int dayinyear,
+                        double latitude,
+                        double longitude);
+
+// O(1) check whether run_fastrt would find the sun above the horizon
+bool is_daylight(
+                 int dayinyear,
+                 int seconds_from_midnight,
+                 double latitude,
+                 double longitude);
+
 int get_day_sun_angle_data(
                            double* angles,
                            int* times,
@@ -55,4 +81,21 @@ int run_fastrt(
                bool silent
                );
 
+// Same as run_fastrt, but the tables are read once and kept by the engine;
+// use one engine for many runs, e.g. from fastrt_engine_create().
+int run_fastrt_with_engine(
+                           FASTRT_ENGINE *engine,
+                           double* doserates,
+                           int startWavelength,
+                           int endWavelength,
+                           double stepWavelength,
+                           int dayinyear,
+                           double latitude,
+                           double longitude,
+                           double altitude,
+                           int seconds_from_midnight,
+                           int sky_condition_type,
+                           bool silent
+                           );
+
 #endif /* fastrtlib_h */
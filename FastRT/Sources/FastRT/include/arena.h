@@ -0,0 +1,61 @@
+/************************************************************************/
+/* arena.h                                                              */
+/*                                                                      */
+/* Bump allocator for the working memory of one request.                */
+/*                                                                      */
+/* arena_calloc() hands out zeroed, ARENA_ALIGN aligned blocks from a   */
+/* chunk; arena_reset() takes all of them back at once and keeps the    */
+/* chunk. When a request needs more than the chunk holds, further      */
+/* chunks are allocated, and the next reset replaces them by a single   */
+/* chunk large enough for the whole request. From then on, requests of */
+/* that size do not call malloc() or free() at all.                     */
+/*                                                                      */
+/* An arena belongs to one thread. fastrt_compute() uses the arena of   */
+/* the calling thread, arena_thread(), and resets it before returning.  */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __arena_h
+#define __arena_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+
+#define ARENA_ALIGN          64       /* alignment of every block        */
+#define ARENA_CHUNK          65536    /* smallest chunk [bytes]          */
+
+
+typedef struct ARENA_BLOCK {
+  size_t size;                       /* usable bytes                     */
+  size_t used;
+  struct ARENA_BLOCK *next;          /* older chunk                      */
+} ARENA_BLOCK;
+
+typedef struct {
+  ARENA_BLOCK *chunks;               /* newest first                     */
+  size_t used;                       /* bytes handed out since reset     */
+  size_t peak;                       /* most bytes between two resets    */
+  size_t held;                       /* bytes of all chunks              */
+  long   grows;                      /* chunks allocated                 */
+} ARENA;
+
+
+/* prototypes */
+
+void   arena_init    (ARENA *arena);
+void  *arena_calloc  (ARENA *arena, size_t n, size_t size);  /* NULL if out of memory */
+void   arena_reset   (ARENA *arena);
+void   arena_free    (ARENA *arena);
+
+ARENA *arena_thread  (void);         /* of the calling thread, NULL if out of memory */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
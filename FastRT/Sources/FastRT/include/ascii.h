@@ -34,6 +34,8 @@
 extern "C" {
 #endif
 
+#include "matrix.h"
+
 /* errorcodes of ASCII_functions */
 
 #define ASCIIFILE_NOT_FOUND      -1
@@ -48,6 +50,8 @@ extern "C" {
 
 /* prototypes */
 int swift_package_file_access_shim(char *filename, char* resource_path_out);
+void ASCII_set_resource_path(const char *path);
+void ASCII_get_counters(long *files_opened, long *bytes_read);
 int ASCII_checkfile     (char *filename, int *rows, 
 			 int *min_columns, int *max_columns, int *max_length);
 int ASCII_calloc_string (char ****string, int rows, int columns, int length);
@@ -58,6 +62,8 @@ int ASCII_readfile      (char *filename, char ***array);
 int ASCII_string2double (double **value, char *** string, int rows, int columns);
 int ASCII_file2double   (char *filename, int *rows, 
 			 int *max_columns, int *min_columns, double ***value);
+int ASCII_file2matrix   (char *filename, int *rows, 
+			 int *max_columns, int *min_columns, MATRIX *value);
 int ASCII_calloc_float  (float ***value, int rows, int columns);
 int ASCII_calloc_float_3D(float ****value, int rows, int columns, int length);
 int ASCII_calloc_float_4D(float *****value, int rows, int columns, int length, int fourth_dimension);
@@ -0,0 +1,109 @@
+/************************************************************************/
+/* climatology.h                                                        */
+/*                                                                      */
+/* Daily erythemal and vitamin D doses for many sites, days and sky     */
+/* conditions.                                                          */
+/*                                                                      */
+/* The work is a list of items, one per site and day, in site major    */
+/* order; every item yields one record per selected sky condition.      */
+/* Items are evaluated in blocks, and every finished block is appended  */
+/* to the output and recorded in the checkpoint file, so that memory    */
+/* is bounded by the block size and an interrupted run can be resumed.  */
+/*                                                                      */
+/* Binary output: the header                                            */
+/*                                                                      */
+/*   char   magic[8]         "FRTCLIM1"                                 */
+/*   int32  n_sites, first_day, last_day, sky_mask, step                */
+/*                                                                      */
+/* followed by blocks of n records, stored column by column:            */
+/*                                                                      */
+/*   int32  n                                                           */
+/*   int32  site[n], day[n], sky[n]                                     */
+/*   double erythema[n], vitamin_d[n]        daily doses [J m-2]        */
+/*                                                                      */
+/* CSV output has one line per record with the same columns plus the   */
+/* site coordinates. Failed records have NaN doses.                     */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __climatology_h
+#define __climatology_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include "engine.h"
+#include "taskpool.h"
+
+
+#define CLIM_MAGIC           "FRTCLIM1"
+
+/* output formats */
+#define CLIM_BINARY          0
+#define CLIM_CSV             1
+
+/* all four sky conditions of run_fastrt() */
+#define CLIM_ALL_SKIES       0xf
+
+/* defaults of climatology_spec_init() */
+#define CLIM_STEP            600   /* integration step [s], as in the app    */
+#define CLIM_BLOCK           256   /* items per block                        */
+
+
+typedef struct {
+  double latitude;          /* North positive [degrees]                      */
+  double longitude;         /* East positive [degrees], as run_fastrt()      */
+  double altitude;          /* [km]                                          */
+} CLIM_SITE;
+
+typedef struct {
+  const CLIM_SITE *sites;
+  int    n_sites;
+  int    first_day;         /* day of year range, inclusive                  */
+  int    last_day;
+  int    sky_mask;          /* bit s selects sky condition s                 */
+  int    step;              /* integration step [s]                          */
+
+  const char *output;       /* output file                                   */
+  int    format;            /* CLIM_BINARY or CLIM_CSV                       */
+  const char *checkpoint;   /* checkpoint file, NULL for none                */
+
+  int    n_threads;         /* 0: number of online processors                */
+  int    block;             /* items per block                               */
+  int    schedule;          /* TASKPOOL_STEAL (default) or TASKPOOL_STATIC   */
+  long   max_items;         /* stop after this many items, 0: all            */
+} CLIM_SPEC;
+
+typedef struct {
+  long   items;             /* items evaluated by this call                  */
+  long   records;           /* records written by this call                  */
+  long   failed;            /* records with NaN doses                        */
+  long   resumed;           /* items skipped because of the checkpoint       */
+  long   remaining;         /* items left for a later call                   */
+  double seconds;           /* wall clock time                               */
+} CLIM_STATS;
+
+
+/* prototypes */
+
+void climatology_spec_init (CLIM_SPEC *spec);
+
+int  climatology_daily_dose (FASTRT_ENGINE *engine,   /* engine, may be NULL   */
+			     const CLIM_SITE *site,   /* site                  */
+			     int day,                 /* day of year           */
+			     int sky,                 /* sky condition         */
+			     int step,                /* integration step [s]  */
+			     double *erythema,        /* daily dose, set       */
+			     double *vitamin_d);      /* daily dose, set       */
+
+int  climatology_run (FASTRT_ENGINE *engine,          /* engine, may be NULL   */
+		      const CLIM_SPEC *spec,          /* work and output       */
+		      CLIM_STATS *stats);             /* statistics, may be NULL */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/************************************************************************/
+/* daylight.h                                                           */
+/*                                                                      */
+/* Annual sunrise, sunset and solar noon tables per location.           */
+/*                                                                      */
+/* Times are standard times in seconds from midnight (see sun.h),       */
+/* angles are specified in degrees, longitudes are West positive.       */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __daylight_h
+#define __daylight_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include "sun.h"
+
+
+/* days per table; day 366 is only meaningful in leap years */
+#define DAYLIGHT_DAYS          366
+
+/* locations are quantized to this step [degrees] before lookup, */
+/* 0.01 degrees longitude shift sunrise by at most 2.4 seconds   */
+#define DAYLIGHT_QUANTUM       0.01
+
+/* number of locations kept by daylight_table_get() */
+#define DAYLIGHT_CACHE_SIZE    16
+
+/* day types */
+#define DAYLIGHT_NORMAL        0
+#define DAYLIGHT_POLAR_DAY     1   /* sun never sets   */
+#define DAYLIGHT_POLAR_NIGHT   2   /* sun never rises  */
+
+
+typedef struct {
+  int    sunrise;      /* standard time of sunrise [s]                 */
+  int    sunset;       /* standard time of sunset  [s]                 */
+  int    solar_noon;   /* standard time of solar noon [s]              */
+  double min_zenith;   /* zenith angle at solar noon [degrees]         */
+  int    type;         /* DAYLIGHT_NORMAL, _POLAR_DAY or _POLAR_NIGHT  */
+} DAYLIGHT_WINDOW;
+
+typedef struct {
+  double latitude;     /* quantized latitude  [degrees]                */
+  double longitude;    /* quantized longitude [degrees]                */
+  DAYLIGHT_WINDOW day[DAYLIGHT_DAYS+1];   /* indexed by Julian day     */
+} DAYLIGHT_TABLE;
+
+
+/* prototypes */
+
+int daylight_table_build (double latitude,      /* latitude            */
+			  double longitude,     /* longitude           */
+			  DAYLIGHT_TABLE *table); /* table, set        */
+
+int daylight_table_get   (double latitude,      /* latitude            */
+			  double longitude,     /* longitude           */
+			  DAYLIGHT_TABLE *table); /* copy, set         */
+
+int daylight_window      (int day,              /* Julian day          */
+			  double latitude,      /* latitude            */
+			  double longitude,     /* longitude           */
+			  DAYLIGHT_WINDOW *window); /* window, set     */
+
+int daylight_contains    (const DAYLIGHT_WINDOW *window, /* window     */
+			  int time);            /* standard time       */
+
+void daylight_cache_clear (void);
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/************************************************************************/
+/* densify.h                                                            */
+/*                                                                      */
+/* Offline resampling of a table tree onto a finer sza, ozone and       */
+/* altitude grid, so that fastrt_compute() may interpolate linearly     */
+/* between the two nodes around a value on every axis: 8 transmittance  */
+/* nodes per cloud level instead of the 48 of the splines.              */
+/*                                                                      */
+/* Every node of the dense grid is evaluated from the input tables as   */
+/* fastrt_compute() would, with the splines of spl.c through the four   */
+/* neighbours in ozone and then in sza and the polynomial through the   */
+/* three altitude nodes, and written as                                 */
+/*                                                                      */
+/*   TransmittancesCloudH2O%5.3f/sza%gozone%galt%g                      */
+/*                                                                      */
+/* to the output tree, with the grid descriptor of the dense grid and   */
+/* Grid/points set to TABLEGRID_LINEAR, see tablegrid.h. Nodes whose    */
+/* neighbours cannot be splined, as beyond the tabulated range, are     */
+/* left out. The other files per altitude, the reflectivities and the   */
+/* coefficient files, are interpolated entry by entry with the same     */
+/* polynomial; all other files of the input directories are copied.     */
+/*                                                                      */
+/* The error of the dense tables is checked at random points of every   */
+/* cloud level: the linear interpolation of the dense nodes against the */
+/* splines of the input tables, for the transmittances only. The error  */
+/* is relative to the spline value, at the wavelengths where that       */
+/* exceeds DENSIFY_FLOOR of the largest value of the spectrum. Points   */
+/* are drawn up to check_sza; towards the horizon the splines through   */
+/* 3 degree nodes oscillate and are no reference for the dense tables.  */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __densify_h
+#define __densify_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+/* defaults of densify_spec_init() */
+#define DENSIFY_SZA_STEP     1.0    /* [degrees]                             */
+#define DENSIFY_OZONE_STEP   5.0    /* [DU]                                  */
+#define DENSIFY_ALT_STEP     1.0    /* [km]                                  */
+#define DENSIFY_SAMPLES      200    /* points per cloud level of the check   */
+#define DENSIFY_MAX_ERROR    3e-2   /* bound of the relative error           */
+#define DENSIFY_CHECK_SZA    75.0   /* largest sza of the check [degrees]    */
+
+#define DENSIFY_FLOOR        1e-3   /* wavelengths checked, see above        */
+
+
+typedef struct {
+  const char *input;        /* root of the table tree                        */
+  const char *output;       /* root of the dense tree, not the input         */
+  const char *pack;         /* pack built from the output, NULL: none        */
+  int    pack_kind;         /* PACK_LOG16 or PACK_PCA                        */
+
+  double sza_step;          /* of the dense grid [degrees]                   */
+  double ozone_step;        /* [DU]                                          */
+  double alt_step;          /* [km], 0: the altitudes of the input           */
+
+  int    samples;           /* points per cloud level of the check, 0: none  */
+  double check_sza;         /* largest sza of the points [degrees]           */
+  double max_error;         /* bound of the largest relative error           */
+  unsigned int seed;        /* of the points                                 */
+
+  int    max_threads;       /* 0: online processors                          */
+} DENSIFY_SPEC;
+
+typedef struct {
+  int    n_sza, n_ozone;    /* nodes of the dense grid                       */
+  int    n_alt;
+  long   tables;            /* transmittances written                        */
+  long   skipped;           /* dense nodes left out                          */
+  long   copied;            /* other files, copied or interpolated           */
+  long   checked;           /* values compared                               */
+  double max_error;         /* largest relative error of the check           */
+  double rms_error;
+  double seconds;           /* wall clock time                               */
+} DENSIFY_STATS;
+
+
+/* prototypes */
+
+void densify_spec_init (DENSIFY_SPEC *spec);
+
+int  densify_run       (const DENSIFY_SPEC *spec,      /* input and grid      */
+			DENSIFY_STATS *stats);         /* statistics, may be NULL */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+/************************************************************************/
+/* dose.h                                                               */
+/*                                                                      */
+/* Biologically weighted dose rates of fastrt spectra.                  */
+/*                                                                      */
+/* The spectra are irradiances [mW m-2 nm-1] at 290-400 nm in 1 nm      */
+/* steps, as computed by run_fastrt() for the app; weighted dose rates  */
+/* are in mW m-2, i.e. mJ m-2 s-1.                                      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __dose_h
+#define __dose_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+#define DOSE_LAMBDA_START    290
+#define DOSE_LAMBDA_END      400
+#define DOSE_N_LAMBDA        111
+
+/* action spectra */
+#define DOSE_ERYTHEMA        0   /* CIE erythema reference action spectrum */
+#define DOSE_VITAMIN_D       1   /* CIE previtamin D3 action spectrum      */
+
+
+/* prototypes */
+
+const double *dose_action_spectrum (int action);
+
+double dose_rate   (const double *doserates,   /* DOSE_N_LAMBDA irradiances */
+		    int action);               /* DOSE_ERYTHEMA, ...        */
+
+double dose_uv_index (double erythema_rate);   /* from dose_rate [mW m-2]   */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+/************************************************************************/
+/* engine.h                                                             */
+/*                                                                      */
+/* fastrt engine: look-up tables shared by many runs.                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __engine_h
+#define __engine_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <pthread.h>
+
+#include "fastrt_.h"
+#include "tablestore.h"
+#include "tablegrid.h"
+
+
+/* the tables read ahead by fastrt_engine_preload(): all nodes which the  */
+/* requests with parameters in these ranges interpolate from             */
+typedef struct {
+  double sza_min, sza_max;       /* solar zenith angle [degrees]           */
+  double o3_min, o3_max;         /* ozone column [DU]                      */
+  double alt_min, alt_max;       /* altitude [km]                          */
+  double cloud_min, cloud_max;   /* cloud liquid water content [g m-3]     */
+  int    coefficients;           /* also the aerosol and albedo tables     */
+} FASTRT_PRELOAD;
+
+typedef struct {
+  long   nodes;                  /* looked up                              */
+  long   missing;                /* without a readable file                */
+  int    cancelled;              /* stopped by fastrt_engine_free()        */
+  double seconds;
+} FASTRT_PRELOAD_STATS;
+
+struct FASTRT_ENGINE {
+  TABLE_STORE *store;        /* parsed tables, splines and spectra */
+  TABLE_PACK  *pack;         /* from fastrt_engine_open_pack()     */
+
+  /* grid of the tables, read on first use */
+  pthread_mutex_t      grid_lock;
+  int                  grid_read;     /* 1 if read, <0 if it cannot be  */
+  TABLE_GRID           grid;
+
+  /* background preload */
+  pthread_mutex_t      preload_lock;
+  pthread_t            preload_thread;
+  int                  preloading;    /* thread started, not yet joined */
+  int                  preload_stop;  /* set to cancel it               */
+  FASTRT_PRELOAD       preload;
+  FASTRT_PRELOAD_STATS preload_stats;
+};
+
+
+/* prototypes */
+
+FASTRT_ENGINE *fastrt_engine_create (void);
+void fastrt_engine_free (FASTRT_ENGINE *engine);
+int  fastrt_engine_open_pack (FASTRT_ENGINE *engine, const char *path);
+int  fastrt_engine_open_pack_memory (FASTRT_ENGINE *engine, const void *data, size_t size);
+int  fastrt_engine_advise_pack (FASTRT_ENGINE *engine, int advice);
+const TABLE_GRID *fastrt_engine_grid (FASTRT_ENGINE *engine);
+
+int  fastrt_engine_run  (FASTRT_ENGINE *engine,     /* engine, may be NULL */
+			 int argc, char **argv,     /* fastrt options      */
+			 double *doserates);        /* result, set         */
+
+void fastrt_preload_init     (FASTRT_PRELOAD *spec);
+int  fastrt_preload_location (FASTRT_PRELOAD *spec,    /* set                 */
+			      int day,                  /* day of year         */
+			      double latitude,          /* North positive      */
+			      double longitude,         /* East positive       */
+			      double altitude);         /* [km]                */
+
+int  fastrt_engine_preload      (FASTRT_ENGINE *engine, const FASTRT_PRELOAD *spec);
+int  fastrt_engine_preload_wait (FASTRT_ENGINE *engine,
+				 FASTRT_PRELOAD_STATS *stats);  /* set, may be NULL */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -28,7 +28,41 @@
 #define ALBEDO_RESOLUTION 10.
 #define CLOUD_THICKNESS 5.
 
-static void print_usage();
+
+/* one fastrt run, as given by the command line options */
+typedef struct {
+    double sza;               /* -a solar zenith angle [degrees]              */
+    double o3;                /* -o ozone column [DU]                         */
+    double alt;               /* -z surface altitude [km]                     */
+    double beta;              /* -b or -v Angstrom beta                       */
+    int    beta_flag;
+    double cloudH2O;          /* -u or -t cloud liquid water content          */
+    int    cloudH2O_flag;
+    int    broken_cloud_flag; /* -c                                           */
+    double day;               /* -d day of year                               */
+    int    day_flag;
+
+    double alb;               /* -p surface albedo                            */
+    int    albedo_flag;
+    int    surfaceno;         /* -q surface type                              */
+    int    albedo_type_flag;
+    int    albedo_file_flag;  /* -l spectral surface albedo                   */
+    int    albedo_rows;
+    double *albedo_lambda;
+    double *albedo_value;
+
+    double fwhm;              /* -f, -r spectral response function            */
+    int    sr_nlambda;
+    double *sr_lambda;
+    double *sr;
+
+    int    n_lambda;          /* -w, -g -e -s or -x output wavelengths        */
+    double *lambda;
+} FASTRT_REQUEST;
+
+/* cached tables shared by many requests, see engine.h */
+typedef struct FASTRT_ENGINE FASTRT_ENGINE;
+
 
 
 int make_slitfunction(double fwhm, double **sr_lambda, double **sr, int *sr_nlambda);
@@ -53,6 +87,27 @@ int compute_atmospheric_reflectance(double o3, double beta,
 double *newton_co(int np, double *x, double *y);
 
 
+double fastrt_visibility_to_beta(double visibility);
+
+
+int fastrt_cloud_levels(const double **levels);
+
+void fastrt_request_init(FASTRT_REQUEST *req);
+
+void fastrt_request_free(FASTRT_REQUEST *req);
+
+int fastrt_request_set_fwhm(FASTRT_REQUEST *req, double fwhm);
+
+int fastrt_request_set_lambda(FASTRT_REQUEST *req, double start_lambda, double end_lambda,
+                              double step_lambda);
+
+int fastrt_request_set_sky(FASTRT_REQUEST *req, int sky_condition_type);
+
+int fastrt_parse_request(int argc, char **argv, FASTRT_REQUEST *req);
+
+int fastrt_compute(FASTRT_ENGINE *engine, const FASTRT_REQUEST *req, double *doserates);
+
+
 int run_fastrt_(int argc, char **argv, double *doserates);
 
 #endif /* fastrt__h */
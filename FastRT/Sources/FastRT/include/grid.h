@@ -0,0 +1,91 @@
+/************************************************************************/
+/* grid.h                                                               */
+/*                                                                      */
+/* UV index and burn time maps on a regular latitude/longitude grid.    */
+/*                                                                      */
+/* A map is written as a binary raster: the header                     */
+/*                                                                      */
+/*   char   magic[8]         "FRTGRID1"                                 */
+/*   int32  n_lat, n_lon, n_bands, outputs, day, seconds                */
+/*   double lat0, dlat, lon0, dlon                                      */
+/*                                                                      */
+/* followed by n_lat rows, each holding n_bands x n_lon float32 values, */
+/* one block of n_lon values per output in the order of the GRID_*     */
+/* bits (band interleaved by line). All values are in host byte order. */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __grid_h
+#define __grid_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+#include "engine.h"
+#include "taskpool.h"
+
+
+#define GRID_MAGIC           "FRTGRID1"
+
+/* outputs */
+#define GRID_UV_INDEX        1   /* UV index                                 */
+#define GRID_BURN_TIME       2   /* minutes to one MED, INFINITY at night    */
+
+/* defaults of grid_spec_init(), same sky as run_fastrt() */
+#define GRID_OZONE           400.0
+#define GRID_VISIBILITY      50.0
+#define GRID_ALBEDO          0.03
+#define GRID_MED             250.0  /* minimal erythemal dose [J m-2]       */
+
+
+typedef struct {
+  double lat0, dlat;        /* latitude of row i is lat0 + i*dlat [degrees]  */
+  int    n_lat;
+  double lon0, dlon;        /* longitude of column j, East positive          */
+  int    n_lon;
+
+  /* per cell rasters, n_lat x n_lon row major; NULL for the default */
+  const float *altitude;    /* surface altitude [km], default 0              */
+  const float *ozone;       /* ozone column [DU], default o3                 */
+  const float *cloud;       /* cloud liquid water column [g m-2], default 0  */
+
+  double o3;                /* ozone column if no raster [DU]                */
+  double visibility;        /* visibility of cloudless cells [km]            */
+  double albedo;            /* surface albedo                                */
+  double med;               /* dose for the burn time [J m-2]                */
+
+  int    day;               /* day of year                                   */
+  int    seconds;           /* seconds from midnight, standard time (UTC)   */
+
+  int    outputs;           /* GRID_UV_INDEX | GRID_BURN_TIME                */
+  int    n_threads;         /* 0: number of online processors                */
+  int    band_rows;         /* rows evaluated together, 0: automatic         */
+  int    schedule;          /* TASKPOOL_STEAL (default) or TASKPOOL_STATIC   */
+} GRID_SPEC;
+
+typedef struct {
+  long   cells;             /* cells written                                 */
+  long   day_cells;         /* cells with the sun above the horizon          */
+  long   failed;            /* cells where fastrt failed, written as NaN     */
+  double seconds;           /* wall clock time of grid_run()                 */
+} GRID_STATS;
+
+
+/* prototypes */
+
+void grid_spec_init (GRID_SPEC *spec);
+
+int  grid_run       (FASTRT_ENGINE *engine,    /* engine, NULL for a private one */
+		     const GRID_SPEC *spec,    /* grid and outputs               */
+		     FILE *out,                /* binary raster, may be NULL     */
+		     GRID_STATS *stats);       /* statistics, set, may be NULL   */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+/************************************************************************/
+/* matrix.h                                                             */
+/*                                                                      */
+/* Contiguous 2-D and 3-D arrays of double.                             */
+/*                                                                      */
+/* All elements live in one MATRIX_ALIGN aligned block and are found    */
+/* through explicit strides, instead of a pointer per row as with       */
+/* ASCII_calloc_double(). The last dimension is contiguous. With        */
+/* MATRIX_ALIGNED every row starts on MATRIX_ALIGN, so that loops over  */
+/* a row run over aligned, unit stride memory; MATRIX_PACKED rows       */
+/* follow each other without gaps, as the rows of a table file.         */
+/*                                                                      */
+/* A matrix is allocated from the heap and freed by matrix_free(), or   */
+/* taken from an arena, which owns it then.                             */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __matrix_h
+#define __matrix_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "arena.h"
+
+
+#define MATRIX_ALIGN         64   /* alignment of the data and aligned rows  */
+
+/* layouts */
+#define MATRIX_PACKED        0    /* stride of a row is its length           */
+#define MATRIX_ALIGNED       1    /* rows padded to MATRIX_ALIGN             */
+
+
+typedef struct {
+  double *data;                  /* element [0][0][0]                        */
+  int     rank;                  /* 2 or 3                                   */
+  int     n[3];                  /* extents, unused ones are 1               */
+  size_t  stride[3];             /* elements between neighbours, last is 1   */
+  size_t  size;                  /* elements allocated                       */
+  int     owned;                 /* from the heap, freed by matrix_free()    */
+} MATRIX;
+
+
+/* element [i][j] of a 2-D and [i][j][k] of a 3-D matrix */
+#define MATRIX_AT(m, i, j)        ((m)->data[(size_t) (i) * (m)->stride[0] + (j)])
+#define MATRIX_AT3(m, i, j, k)    ((m)->data[(size_t) (i) * (m)->stride[0] + \
+                                             (size_t) (j) * (m)->stride[1] + (k)])
+
+/* contiguous row [i] of a 2-D and [i][j] of a 3-D matrix */
+#define MATRIX_ROW(m, i)          ((m)->data + (size_t) (i) * (m)->stride[0])
+#define MATRIX_ROW3(m, i, j)      ((m)->data + (size_t) (i) * (m)->stride[0] + \
+                                               (size_t) (j) * (m)->stride[1])
+
+
+/* prototypes */
+
+int  matrix_create   (MATRIX *m, int rows, int columns, int layout);
+int  matrix_create3  (MATRIX *m, int n0, int n1, int n2, int layout);
+int  matrix_arena    (MATRIX *m, ARENA *arena, int rows, int columns, int layout);
+int  matrix_arena3   (MATRIX *m, ARENA *arena, int n0, int n1, int n2, int layout);
+void matrix_free     (MATRIX *m);
+
+double *matrix_column (const MATRIX *m, int column);   /* heap copy, as ASCII_column */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
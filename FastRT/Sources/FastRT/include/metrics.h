@@ -0,0 +1,74 @@
+/************************************************************************/
+/* metrics.h                                                            */
+/*                                                                      */
+/* Cumulative runtime counters of the engine for long-running hosts.    */
+/*                                                                      */
+/* Every thread counts into its own slot without locks or atomic        */
+/* read-modify-write operations; metrics_snapshot() adds up the slots   */
+/* of all threads, including threads that have ended. The counters are  */
+/* always on and only ever grow, except the bytes held by table stores. */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __metrics_h
+#define __metrics_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+/* request paths, a request counts in every path it takes */
+#define METRICS_CLEAR        0   /* no clouds                               */
+#define METRICS_CLOUDY       1   /* cloud liquid water or optical depth     */
+#define METRICS_BROKEN       2   /* broken clouds, -c                       */
+#define METRICS_ALBEDO       3   /* surface albedo                          */
+#define METRICS_AEROSOL      4   /* Angstrom beta other than 0.02           */
+#define METRICS_PATHS        5
+
+/* latency histogram, upper bounds of the buckets in seconds; the last */
+/* bucket counts the rest                                              */
+#define METRICS_LATENCY_BOUNDS { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, \
+                                 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5 }
+#define METRICS_BUCKETS      15
+
+
+typedef struct {
+  long   requests;                   /* fastrt_compute() calls               */
+  long   failed;                     /* calls with status != 0               */
+  long   path[METRICS_PATHS];        /* requests per path                    */
+  long   latency[METRICS_BUCKETS];   /* requests per latency bucket          */
+  double latency_sum;                /* [s]                                  */
+  long   cache_hits;                 /* table nodes found in a store         */
+  long   cache_misses;               /* table nodes read from a file         */
+  long   nodes_loaded_max;           /* most nodes read by one request       */
+  long   bytes_held;                 /* bytes held by all table stores       */
+  long   scratch_peak;               /* largest working memory of a request  */
+  int    threads;                    /* threads that have counted            */
+} METRICS_SNAPSHOT;
+
+
+/* prototypes */
+
+double metrics_request_begin (void);
+void   metrics_request_end   (double t0,       /* from metrics_request_begin() */
+			      int paths,       /* bit mask of METRICS_ paths   */
+			      int status,      /* status of the request        */
+			      size_t scratch); /* working memory [bytes]       */
+
+void   metrics_table_lookup  (int hit);        /* 1 found in a store, 0 read   */
+void   metrics_table_bytes   (long bytes);     /* change of bytes held         */
+
+void   metrics_snapshot      (METRICS_SNAPSHOT *snapshot);
+double metrics_latency_bound (int bucket);     /* INFINITY for the last        */
+int    metrics_write_prometheus (FILE *out);
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+/************************************************************************/
+/* pack.h                                                               */
+/*                                                                      */
+/* Compressed pack of the fastrt look-up tables with random access.     */
+/*                                                                      */
+/* A pack holds the table files of a Resources tree in one file, which  */
+/* is mapped into memory and decoded node by node. The transmittance    */
+/* spectra are stored as 16 bit codes of their logarithm (PACK_LOG16)   */
+/* or as the coefficients of a spectral basis of their directory        */
+/* (PACK_PCA), see pack.c; all other tables are stored as the doubles   */
+/* read from their files.                                               */
+/* All numbers are in the byte order of the machine that built the      */
+/* pack; pack_open() refuses a pack of the other byte order.            */
+/*                                                                      */
+/* Payloads are shared: an entry whose table equals that of an earlier  */
+/* one points to its payload instead of a copy, for spectra if the      */
+/* decoded spectrum of the earlier entry is within the relative error   */
+/* of the pack, for other tables if all values are the same. Spectra    */
+/* whose largest value is below a floor may all share the payload of    */
+/* the first of them.                                                   */
+/*                                                                      */
+/* The spectra are laid out in one of the orders PACK_ORDER_*, so that  */
+/* the nodes a workload reads one after the other share pages: by sza   */
+/* for the sweeps of a day at a site, or in the order of a trace of the */
+/* tables an engine read, see tablestore_set_trace(). A PACK_LOG16      */
+/* block runs along the innermost axis of the order. pack_advise()      */
+/* tells the kernel how the pages of a pack will be read.               */
+/*                                                                      */
+/* pack_open_memory() reads a pack from memory instead, e.g. the copy   */
+/* linked into a binary by the FastRTEmbedded target, see fastrt-embed; */
+/* the index and the decoding are the same.                             */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __pack_h
+#define __pack_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+
+#define PACK_MAGIC       "FRTPACK"
+#define PACK_VERSION     2
+#define PACK_BYTE_ORDER  0x01020304u
+
+/* kinds of entries */
+#define PACK_RAW         0      /* rows x columns doubles                       */
+#define PACK_LOG16       1      /* spectrum in a block, see pack.c              */
+#define PACK_PCA         2      /* spectrum as coefficients of a basis          */
+
+#define PACK_MAX_ERROR   1e-6   /* default relative error of the spectra        */
+#define PACK_PCA_ERROR   1e-3   /* default relative error of PACK_PCA           */
+#define PACK_EXACT_FLOOR 1e-4   /* values below, relative to the largest of     */
+                                /* their spectrum, are stored exactly           */
+#define PACK_MAX_TERMS   64     /* basis spectra of PACK_PCA, besides the mean  */
+#define PACK_MAX_LEVELS  32     /* directories reported by pack_build()         */
+
+/* orders of the spectra, per directory and altitude unless a trace */
+#define PACK_ORDER_OZONE   0    /* blocks along ozone, per sza (default)        */
+#define PACK_ORDER_SZA     1    /* blocks along sza, per ozone column           */
+#define PACK_ORDER_MORTON  2    /* blocks of 4 x 4 nodes, Z-order of sza, ozone */
+#define PACK_ORDER_TRACE   3    /* as first read in a trace, then the others    */
+#define PACK_CHAIN        16    /* nodes per block of MORTON and TRACE          */
+
+/* advice of pack_advise() */
+#define PACK_ADVISE_NORMAL     0
+#define PACK_ADVISE_SEQUENTIAL 1  /* sweeps along the order, read far ahead    */
+#define PACK_ADVISE_RANDOM     2  /* no read ahead                             */
+#define PACK_ADVISE_POPULATE   3  /* map all pages now                         */
+
+
+typedef struct {
+  char     magic[8];            /* PACK_MAGIC                                   */
+  uint32_t version;             /* PACK_VERSION                                 */
+  uint32_t byte_order;          /* PACK_BYTE_ORDER as written                   */
+  uint32_t n_entries;
+  uint32_t n_blocks;
+  uint64_t entries;             /* offset of the entries, sorted by name        */
+  uint64_t blocks;              /* offset of the blocks                         */
+  uint64_t names;               /* offset of the names, NUL terminated          */
+  uint64_t size;                /* of the file                                  */
+} PACK_HEADER;
+
+typedef struct {
+  uint32_t name;                /* offset from header.names, without "./"       */
+  uint16_t kind;                /* PACK_RAW, PACK_LOG16 or PACK_PCA             */
+  uint16_t slot;                /* LOG16: node within the block, PCA: basis     */
+  int32_t  rows;
+  int32_t  columns;             /* as node->columns of the table store          */
+  uint64_t offset;              /* RAW, PCA: of the data, LOG16: block          */
+} PACK_ENTRY;
+
+/* PACK_LOG16: nodes of a block; PACK_PCA: the n_nodes spectra of a basis */
+typedef struct {
+  uint64_t offset;              /* of the first node                            */
+  uint32_t n_nodes;             /* e.g. all ozone columns of a sza and altitude */
+  uint32_t rows;                /* wavelengths per node                         */
+} PACK_BLOCK;
+
+typedef struct {
+  const unsigned char *base;    /* the mapped file                              */
+  size_t               size;
+  const PACK_HEADER   *header;
+  const PACK_ENTRY    *entries;
+  const PACK_BLOCK    *blocks;
+  const char          *names;
+  int                  mapped;  /* by pack_open(), unmapped by pack_close()     */
+} TABLE_PACK;
+
+/* a PACK_PCA spectrum, pointing into the pack: the values are           */
+/* sum_j terms[j] * basis[j*rows + k], except at the rows in index       */
+typedef struct {
+  int             basis_id;     /* block of the basis                           */
+  int             rows;
+  int             n_terms;      /* basis spectra, the mean first                */
+  const double   *basis;        /* n_terms x rows                               */
+  const double   *terms;
+  int             n_exceptions;
+  const double   *values;       /* kept as they are                             */
+  const uint16_t *index;        /* rows of the values                           */
+} PACK_TERMS;
+
+/* one directory of the Resources tree, e.g. TransmittancesCloudH2O0.014 */
+typedef struct {
+  char   name[256];
+  long   files;
+  long   spectra;               /* stored as PACK_LOG16 or PACK_PCA             */
+  int    terms;                 /* PACK_PCA: basis spectra, the mean included   */
+  size_t text_bytes;            /* of the files                                 */
+  size_t packed_bytes;          /* of the entries                               */
+  double max_error;             /* largest relative error of a spectrum value   */
+  long   shared;                /* files pointing to the payload of another     */
+} PACK_LEVEL;
+
+typedef struct {
+  int        n_levels;
+  PACK_LEVEL level[PACK_MAX_LEVELS];
+  long       files;
+  long       skipped;           /* files which could not be parsed              */
+  long       values;            /* of the spectra                               */
+  long       exceptions;        /* of them kept as they are                     */
+  size_t     text_bytes;
+  size_t     size;              /* of the pack                                  */
+  double     max_error;
+  long       payloads;          /* distinct payloads of the files               */
+  long       shared;            /* spectra sharing the payload of an equal one  */
+  long       zeros;             /* spectra below the floor, sharing one payload */
+  long       shared_tables;     /* other tables sharing an equal payload        */
+  size_t     shared_bytes;      /* copies of payloads not written               */
+  double     zero_error;        /* largest absolute error of the zeros          */
+} PACK_STATS;
+
+typedef struct {
+  const char *resources;        /* Resources directory                          */
+  const char *output;           /* pack file                                    */
+  int    kind;                  /* PACK_LOG16 or PACK_PCA                       */
+  double max_error;             /* of the spectra, <=0: default of the kind     */
+  double zero_floor;            /* spectra below share one payload, 0: none     */
+  int    order;                 /* PACK_ORDER_*                                 */
+  const char *trace;            /* table names, for PACK_ORDER_TRACE            */
+} PACK_SPEC;
+
+
+/* prototypes */
+
+TABLE_PACK *pack_open  (const char *path);
+TABLE_PACK *pack_open_memory (const void *data,  /* 8 byte aligned, kept open */
+			      size_t size);
+void        pack_close (TABLE_PACK *pack);
+int         pack_advise (const TABLE_PACK *pack, int advice);
+
+int  pack_find  (const TABLE_PACK *pack, const char *filename);  /* entry, <0 if none */
+int  pack_read  (const TABLE_PACK *pack, int entry,
+		 MATRIX *table,                 /* set, rows x |columns|, packed */
+		 int *rows, int *columns);      /* set                           */
+int  pack_terms (const TABLE_PACK *pack, int entry,
+		 PACK_TERMS *terms);            /* set; <0 if not PACK_PCA       */
+double pack_terms_value (const PACK_TERMS *terms, int row);  /* without exceptions */
+int  pack_span  (const TABLE_PACK *pack, int entry,
+		 uint64_t *offset, uint64_t *length);  /* set, read by pack_read() */
+
+int  pack_build (const char *resources,         /* Resources directory           */
+		 const char *output,            /* pack file                     */
+		 int kind,                      /* PACK_LOG16 or PACK_PCA        */
+		 double max_error,              /* of the spectra, <=0: default  */
+		 PACK_STATS *stats);            /* set, may be NULL              */
+void pack_spec_init (PACK_SPEC *spec);
+int  pack_run       (const PACK_SPEC *spec,
+		     PACK_STATS *stats);        /* set, may be NULL              */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
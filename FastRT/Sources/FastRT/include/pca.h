@@ -0,0 +1,34 @@
+/************************************************************************/
+/* pca.h                                                                */
+/*                                                                      */
+/* Principal components of a set of spectra, for the spectral basis    */
+/* of the table pack (see pack.h).                                      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __pca_h
+#define __pca_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+/* prototypes */
+
+int pca_eigen (double *a, int n,        /* symmetric n x n, destroyed      */
+	       double *values,          /* set, n, descending              */
+	       double *vectors);        /* set, n x n, one vector per row  */
+
+int pca_fit   (const double *x, int n, int rows,   /* n spectra x rows      */
+	       double *mean,            /* set, rows                       */
+	       double *weight,          /* set, rows                       */
+	       double *axes,            /* set, rows x rows, one per row   */
+	       double *variance);       /* set, rows, descending           */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+/************************************************************************/
+/* reduced.h                                                            */
+/*                                                                      */
+/* Tables reduced to the solar zenith angle: fastrt_reduce() fixes all  */
+/* other parameters of a request, ozone, altitude, sky, aerosol, albedo */
+/* and day, and evaluates everything that does not depend on the sza    */
+/* once, for every sza node of the grid. A request of a fixed site and  */
+/* sky over a day is then one spline along sza per wavelength, see      */
+/* reduced_eval().                                                      */
+/*                                                                      */
+/* The value of sza node i, layer l and wavelength k is the spline in   */
+/* ozone of the node spectra, clouds blended, times the albedo factor,  */
+/* the weight of the altitude node of the layer in the polynomial of    */
+/* fastrt_compute() and the sun-earth distance factor. Without aerosol  */
+/* the layers are summed into one; the aerosol factors are looked up at */
+/* the coefficient sza nearest to the sza of a query, per altitude      */
+/* node, and so keep one layer per node. Both are linear in the values, */
+/* so that reduced_eval() gives the values of fastrt_compute() up to    */
+/* rounding. A node the splines in ozone cannot use is NaN and left out */
+/* of the spline in sza, as by fastrt_compute().                        */
+/*                                                                      */
+/* reduced_write() stores a table for reuse, in the byte order of the   */
+/* machine; reduced_read() refuses a table of the other byte order.     */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __reduced_h
+#define __reduced_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "fastrt_.h"
+#include "tablegrid.h"
+
+
+#define REDUCED_MAGIC       "FRTREDU"
+#define REDUCED_VERSION     1
+#define REDUCED_BYTE_ORDER  0x01020304u
+
+
+typedef struct {
+  int         points;           /* of the spline in sza, as the grid         */
+  TABLE_AXIS  sza;              /* nodes of the grid                         */
+  TABLE_RANGE range;            /* of the sza queries, see tablegrid.h       */
+  TABLE_AXIS  coeff_sza;        /* of the aerosol factors, n=0: none         */
+  int         n_layers;         /* 1, or the altitude nodes with aerosol     */
+  int         n_lambda;
+  double     *lambda;
+  double     *values;           /* [n_layers][sza.n][n_lambda]               */
+  double     *aerosol;          /* [coeff_sza.n][n_layers][n_lambda]         */
+} REDUCED_TABLE;
+
+typedef struct {
+  char     magic[8];            /* REDUCED_MAGIC                             */
+  uint32_t version;             /* REDUCED_VERSION                           */
+  uint32_t byte_order;          /* REDUCED_BYTE_ORDER as written             */
+  int32_t  points;
+  int32_t  n_sza;
+  int32_t  n_coeff;
+  int32_t  n_layers;
+  int32_t  n_lambda;
+  int32_t  range_set;
+  double   range_min, range_max;
+} REDUCED_HEADER;
+
+
+/* prototypes */
+
+int  fastrt_reduce (FASTRT_ENGINE *engine,           /* engine, may be NULL */
+		    const FASTRT_REQUEST *req,       /* sza ignored         */
+		    REDUCED_TABLE *table);
+
+int  reduced_create (REDUCED_TABLE *table, const TABLE_AXIS *sza,
+		     const TABLE_AXIS *coeff_sza,    /* NULL: no aerosol    */
+		     int n_layers, const double *lambda, int n_lambda);
+void reduced_free   (REDUCED_TABLE *table);
+
+int  reduced_eval   (const REDUCED_TABLE *table, double sza, double *doserates);
+
+int  reduced_write  (const REDUCED_TABLE *table, FILE *f);
+int  reduced_read   (FILE *f, REDUCED_TABLE *table);
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -62,6 +62,8 @@ int exponentialfit       (double *x, double *y, long number,
 			  double *a, double *b);
 int parabolafit          (double *x, double *y, long number, 
 			  double *a0, double *a1, double *a2);
+int parabolafit_fixed    (double *x, double *y, long number, long n_sets,
+			  double a0, double *a1, double *a2);
 int cubicfit             (double *x, double *y, long number, 
 			  double *a0, double *a1, double *a2, double *a3);
 int hyperbolafit         (double *x, double *y, long number, 
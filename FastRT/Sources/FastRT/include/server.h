@@ -0,0 +1,117 @@
+/************************************************************************/
+/* server.h                                                             */
+/*                                                                      */
+/* Dose queries answered from a warm engine over a Unix domain socket.  */
+/*                                                                      */
+/* A client sends SERVER_REQUEST records and reads one reply per        */
+/* request, in the order of the requests: a SERVER_REPLY header         */
+/* followed by reply.n doubles. A client may send many requests before */
+/* reading the replies (pipelining), and many clients may be connected */
+/* at the same time; every connection is served by its own thread, all */
+/* of them share the engine. The records are in host byte order.       */
+/*                                                                      */
+/* Requests, all for the sky conditions of run_fastrt():               */
+/*                                                                      */
+/*   SERVER_SPECTRUM      irradiances at 290-400 nm [mW m-2 nm-1]      */
+/*   SERVER_DOSE          erythemal and vitamin D dose rates [mW m-2]  */
+/*                        and the UV index                             */
+/*   SERVER_DAY           erythemal dose rates of every step of the    */
+/*                        day from midnight, then the vitamin D ones   */
+/*   SERVER_TIME_TO_DOSE  seconds from request.seconds until the dose  */
+/*                        of request.action reaches request.dose       */
+/*                        (INFINITY if not before midnight), and the   */
+/*                        dose reached by midnight [J m-2]             */
+/*                                                                      */
+/* The status of a reply is that of run_fastrt(): 0 if o.k., 1 if the   */
+/* sun is below the horizon (SERVER_SPECTRUM and SERVER_DOSE, with      */
+/* zero values), <0 if error.                                           */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __server_h
+#define __server_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <signal.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+
+#define SERVER_MAGIC         0x31545246u  /* "FRT1"                            */
+
+/* kinds of requests */
+#define SERVER_SPECTRUM      1
+#define SERVER_DOSE          2
+#define SERVER_DAY           3
+#define SERVER_TIME_TO_DOSE  4
+
+#define SERVER_STEP          600    /* default step of the day [s], as the app */
+#define SERVER_MIN_STEP      60
+#define SERVER_MAX_VALUES    (2 * 86400 / SERVER_MIN_STEP)
+#define SERVER_MAX_CLIENTS   256    /* default of server_spec_init()           */
+
+
+typedef struct {
+  uint32_t magic;           /* SERVER_MAGIC                                  */
+  uint32_t id;              /* free for the client, returned in the reply    */
+  int32_t  kind;            /* SERVER_SPECTRUM, ...                          */
+  int32_t  day;             /* day of year                                   */
+  int32_t  seconds;         /* seconds from midnight, as run_fastrt()        */
+  int32_t  sky;             /* sky condition of run_fastrt(), 0..3           */
+  int32_t  step;            /* step of the day [s], 0 for SERVER_STEP        */
+  int32_t  action;          /* DOSE_ERYTHEMA or DOSE_VITAMIN_D               */
+  double   latitude;        /* North positive [degrees]                      */
+  double   longitude;       /* East positive [degrees]                       */
+  double   altitude;        /* [km]                                          */
+  double   dose;            /* target of SERVER_TIME_TO_DOSE [J m-2]         */
+} SERVER_REQUEST;
+
+typedef struct {
+  uint32_t magic;           /* SERVER_MAGIC                                  */
+  uint32_t id;              /* of the request                                */
+  int32_t  status;
+  int32_t  n;               /* doubles following the header                  */
+} SERVER_REPLY;
+
+typedef struct {
+  const char *path;                   /* socket file, replaced if it exists */
+  int    max_clients;                 /* further connections are refused    */
+  volatile sig_atomic_t *stop;        /* server_run() returns once set      */
+} SERVER_SPEC;
+
+typedef struct {
+  long   connections;       /* accepted                                      */
+  long   refused;           /* above max_clients                             */
+  long   requests;
+  long   failed;            /* status < 0                                    */
+} SERVER_STATS;
+
+
+/* prototypes */
+
+void server_spec_init (SERVER_SPEC *spec);
+
+int  server_run       (FASTRT_ENGINE *engine,     /* shared by all clients   */
+		       const SERVER_SPEC *spec,   /* socket and limits       */
+		       SERVER_STATS *stats);      /* set, may be NULL        */
+
+int  server_evaluate  (FASTRT_ENGINE *engine,     /* engine, may be NULL     */
+		       const SERVER_REQUEST *request,
+		       SERVER_REPLY *reply,       /* set                     */
+		       double *values);           /* SERVER_MAX_VALUES       */
+
+/* client side */
+int  server_connect   (const char *path);         /* socket, <0 if error     */
+int  server_send      (int fd, const SERVER_REQUEST *request);
+int  server_receive   (int fd, SERVER_REPLY *reply, double *values, int max_values);
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -46,6 +46,9 @@ extern "C" {
 #define NEGATIVE_WEIGHTING_FACTORS  -6
 #define NO_EXTRAPOLATION            -7
 
+/* work space of spline_coeffc_buffer [doubles] */
+#define SPLINE_WORK(number)         (9*(number))
+
 
 
 /* prototypes */
@@ -53,6 +56,9 @@ int spline (double *x, double *y, int number, double start, double step,
 	    int *newnumber, double **new_x, double **new_y);
 int spline_coeffc (double *x, double *y, int number, 
 		   double **a0, double **a1, double **a2, double **a3);
+int spline_coeffc_buffer (double *x, double *y, int number, 
+			  double *a0, double *a1, double *a2, double *a3,
+			  double *work);
 int appspl (double *x, double *y, double *w, int number, 
 	    double start, double step, 
 	    int *newnumber, double **new_x, double **new_y);
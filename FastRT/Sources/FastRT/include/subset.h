@@ -0,0 +1,81 @@
+/************************************************************************/
+/* subset.h                                                             */
+/*                                                                      */
+/* Tables cut to the part of the parameter space a deployment queries,  */
+/* e.g. the sites of a regional service: a range of solar zenith        */
+/* angles, ozone columns and altitudes.                                 */
+/*                                                                      */
+/* The subset keeps the nodes of every range together with those around */
+/* it which values of the range interpolate from, see tablegrid_span(), */
+/* so that it gives the same values as the full tables anywhere in the  */
+/* ranges. The ranges are written to its grid descriptor, and           */
+/* fastrt_compute() refuses values outside them instead of              */
+/* extrapolating from the nodes at the border, see tablegrid.h.         */
+/*                                                                      */
+/* With a list of sites and days, the sza range reaches from the        */
+/* smallest noon zenith angle of the sites to SUBSET_MAX_SZA and the    */
+/* altitude range covers the sites, unless given explicitly.            */
+/*                                                                      */
+/* The files kept are linked into the output tree, or copied where that */
+/* is on another file system; the pack is built from the output tree.   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __subset_h
+#define __subset_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "tablegrid.h"
+#include "climatology.h"
+
+
+#define SUBSET_MAX_SZA       90.0   /* largest sza of a site, as climatology.c  */
+
+
+typedef struct {
+  const char *input;        /* root of the table tree                        */
+  const char *output;       /* root of the subset, not the input             */
+  const char *pack;         /* pack built from the output, NULL: none        */
+  int    pack_kind;         /* PACK_LOG16 or PACK_PCA                        */
+
+  /* ranges of TABLEGRID_SZA, TABLEGRID_OZONE and TABLEGRID_ALT, unset: */
+  /* from the sites, or the whole axis                                  */
+  TABLE_RANGE range[TABLEGRID_AXES];
+
+  const CLIM_SITE *sites;   /* NULL: none                                    */
+  int    n_sites;
+  int    first_day;         /* day of year range of the sites, inclusive     */
+  int    last_day;
+} SUBSET_SPEC;
+
+typedef struct {
+  TABLE_RANGE range[TABLEGRID_AXES];  /* of the subset                       */
+  int    nodes[TABLEGRID_AXES];       /* of the subset                       */
+  int    input_nodes[TABLEGRID_AXES];
+  long   files;             /* linked or copied                              */
+  long   skipped;           /* files left out                                */
+  size_t bytes;             /* of the files kept                             */
+  size_t input_bytes;       /* of all files                                  */
+  size_t pack_size;
+  double seconds;           /* wall clock time                               */
+} SUBSET_STATS;
+
+
+/* prototypes */
+
+void subset_spec_init (SUBSET_SPEC *spec);
+
+int  subset_run       (const SUBSET_SPEC *spec,       /* input and ranges    */
+		       SUBSET_STATS *stats);          /* statistics, may be NULL */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
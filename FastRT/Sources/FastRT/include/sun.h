@@ -49,8 +49,45 @@ extern "C" {
 #define ERROR_NO_ZENITH     -1
 
 
+/* day dependent quantities, computed once per day by sun_ephemeris() */
+/* and shared by all times and locations of that day                  */
+typedef struct {
+  int    day;             /* Julian day                              */
+  double declination;     /* declination [degrees]                   */
+  double delta;           /* declination [radians]                   */
+  double sin_delta;       /* sin(delta)                              */
+  double cos_delta;       /* cos(delta)                              */
+  int    eqt;             /* equation of time [seconds]              */
+  double eccentricity;    /* eccentricity correction factor E0       */
+} SUN_EPHEMERIS;
+
+
 /* prototypes */
 
+int sun_ephemeris    (int day,             /* Julian day           */
+		      SUN_EPHEMERIS *eph); /* ephemeris, set       */
+
+double solar_zenith_eph  (const SUN_EPHEMERIS *eph, /* ephemeris   */
+			  int time,        /* standard time        */
+			  double latitude, /* latitude             */
+			  double longitude,/* longitude            */
+			  double long_std);/* standard longitude   */
+
+double solar_azimuth_eph (const SUN_EPHEMERIS *eph, /* ephemeris   */
+			  int time,        /* standard time        */
+			  double latitude, /* latitude             */
+			  double longitude,/* longitude            */
+			  double long_std);/* standard longitude   */
+
+int solar_zenith_azimuth_soa (const SUN_EPHEMERIS *eph, /* ephemeris  */
+			      int n,                 /* number of points   */
+			      const int *time,       /* standard times     */
+			      const double *latitude,  /* latitudes        */
+			      const double *longitude, /* longitudes       */
+			      double long_std,       /* standard longitude */
+			      double *zenith,        /* zenith, set        */
+			      double *azimuth);      /* azimuth, set/NULL  */
+
 double eccentricity  (int day);            /* Julian day           */
 
 double declination   (int day);            /* Julian day           */
@@ -84,6 +121,16 @@ int zenith2time      (int day,             /* Julian day           */
 		      int *time1,          /* first time           */
 		      int *time2);         /* second time          */
 
+int zenith2time_soa (const SUN_EPHEMERIS *eph, /* ephemerides     */
+		     int n,                /* number of days       */
+		     double zenith_angle,  /* zenith angle [deg]   */
+		     double latitude,      /* latitude [deg]       */
+		     double longitude,     /* longitude [deg]      */
+		     double long_std,      /* standard longitude   */
+		     int *time1,           /* first times          */
+		     int *time2,           /* second times         */
+		     int *status);         /* status per day       */
+
 int day_of_year (int day,                  /* day of month (1..31) */ 
 		 int month);               /* month        (1..12) */       
 
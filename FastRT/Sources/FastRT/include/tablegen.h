@@ -0,0 +1,140 @@
+/************************************************************************/
+/* tablegen.h                                                           */
+/*                                                                      */
+/* Generation of the look-up tables of fastrt with a radiative         */
+/* transfer solver, in place of produce_cloud_tables.pl and             */
+/* produce_cloudOD0_tables.pl.                                          */
+/*                                                                      */
+/* The job space is every cloud liquid water content times            */
+/*                                                                      */
+/*   one atmospheric reflectivity per altitude,                        */
+/*   one transmittance per solar zenith angle, ozone column and        */
+/*   altitude,                                                          */
+/*                                                                      */
+/* written to the tree of the engine:                                   */
+/*                                                                      */
+/*   AtmosphericReflectivitiesCloudH2O%5.3f/alt%g                       */
+/*   TransmittancesCloudH2O%5.3f/sza%gozone%galt%g                      */
+/*                                                                      */
+/* plus the rawlambdafile of every directory and the grid descriptor   */
+/* of the tables in Grid, see tablegrid.h; the clouds must be given in  */
+/* increasing order. Every job writes a uvspec input deck, runs the     */
+/* solver command with the deck on stdin and reads uvspec output        */
+/* (lambda edir edn eup ...) from its stdout. Up to max_jobs solvers    */
+/* run at a time.                                                       */
+/*                                                                      */
+/* The atmosphere is splined to every altitude and the solver output   */
+/* to the wavelengths of the tables in process, with spl.c.             */
+/*                                                                      */
+/* The hash of every input of a job (deck, atmosphere, cloud file,     */
+/* solver command and wavelengths) is appended to tablegen.manifest in  */
+/* the output directory when the job has written its table; a later     */
+/* run skips the jobs whose hash is unchanged and whose table exists,   */
+/* also after an interrupted run. Work files are kept in .tablegen.     */
+/*                                                                      */
+/* With coefficients, the clear sky jobs are followed by sample jobs   */
+/* on the 10 nm grid of the coefficient files, written to .samples:     */
+/* transmittances per sza and altitude at ozone TABLEGEN_O30 and the    */
+/* Angstrom betas, reflectivities per altitude at the betas and the     */
+/* ozone columns. tablegen_fit() then fits, for every wavelength, the   */
+/* ratio of a sample to the sample at TABLEGEN_BETA0 or TABLEGEN_O30 as */
+/* 1 + c0*d + c1*d*d, d the difference to it, which is what             */
+/* compute_aerosol_scaling() and compute_atmospheric_reflectance()      */
+/* evaluate, and writes                                                 */
+/*                                                                      */
+/*   TransmittancesCloudH2O0.000_coeffs_beta/sza%galt%g                 */
+/*   AtmosphericReflectivitiesCloudH2O0.000_coeffs_beta/alt%g           */
+/*   AtmosphericReflectivitiesCloudH2O0.000_coeffs_ozone/alt%g          */
+/*                                                                      */
+/* and the rms and largest residual of every file and wavelength to     */
+/* tablegen.residuals. The fit only reads the samples, so it can be     */
+/* repeated without the solver.                                         */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __tablegen_h
+#define __tablegen_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+#define TABLEGEN_MANIFEST    "tablegen.manifest"
+#define TABLEGEN_WORK        ".tablegen"
+#define TABLEGEN_SAMPLES     ".samples"
+#define TABLEGEN_RESIDUALS   "tablegen.residuals"
+
+/* the coefficients are for the differences to these, as in fastrt_.c */
+#define TABLEGEN_BETA0       0.02
+#define TABLEGEN_O30         300.0
+#define TABLEGEN_COEFF_SZA   90.0  /* largest sza of the coefficient files */
+
+/* jobs */
+#define TABLEGEN_REFLECTIVITY  0
+#define TABLEGEN_TRANSMITTANCE 1
+
+
+typedef struct {
+  const char *solver;       /* command run by /bin/sh, e.g. ".../uvspec"     */
+  const char *atmosphere;   /* atmosphere file, e.g. afglus.dat              */
+  const char *data_path;    /* data_files_path of the decks, NULL: none      */
+
+  /* wavelengths of the transmittances: lambdafile, or start, end, step */
+  const char *lambdafile;
+  double lambda_start, lambda_end, lambda_step;     /* [nm] */
+  double reflectivity_step; /* of the reflectivities, from lambda_start [nm] */
+
+  double sza_start, sza_end, sza_step;              /* [degrees] */
+  double ozone_start, ozone_end, ozone_step;        /* [DU]      */
+  double alt_low, alt_top;  /* three altitudes from low to top [km]          */
+
+  const double *clouds;     /* liquid water contents [g m-3], NULL: those    */
+  int    n_clouds;          /* of the engine                                 */
+
+  double alpha, beta;       /* Angstrom coefficients                         */
+  double albedo;
+
+  const char *output;       /* root of the table tree                        */
+  const char *pack;         /* pack built from the tree, NULL: none          */
+  int    pack_kind;         /* PACK_LOG16 or PACK_PCA                        */
+
+  int    coefficients;      /* sample and fit the coefficient files          */
+  const double *betas;      /* Angstrom betas of the samples, NULL: default */
+  int    n_betas;
+  const double *ozones;     /* ozone columns of the samples [DU], NULL:      */
+  int    n_ozones;          /* default                                       */
+
+  int    max_jobs;          /* solvers at a time, 0: online processors       */
+  int    force;             /* rerun all jobs                                */
+  int    verbose;           /* one line per job on stderr                    */
+} TABLEGEN_SPEC;
+
+typedef struct {
+  long   jobs;              /* jobs of the spec                              */
+  long   run;               /* solver runs of this call                      */
+  long   skipped;           /* jobs with unchanged inputs                    */
+  long   failed;            /* solver or table errors                        */
+  double solver_seconds;    /* sum over the solver runs                      */
+  long   fitted;            /* coefficient files written                     */
+  double max_residual;      /* largest residual of the fitted ratios         */
+  double seconds;           /* wall clock time                               */
+} TABLEGEN_STATS;
+
+
+/* prototypes */
+
+void tablegen_spec_init (TABLEGEN_SPEC *spec);
+
+int  tablegen_run       (const TABLEGEN_SPEC *spec,      /* jobs and output     */
+			 TABLEGEN_STATS *stats);         /* statistics, may be NULL */
+
+int  tablegen_fit       (const TABLEGEN_SPEC *spec,      /* grids and output    */
+			 TABLEGEN_STATS *stats);         /* statistics, may be NULL */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+/************************************************************************/
+/* tablegrid.h                                                          */
+/*                                                                      */
+/* Grid descriptor of a set of fastrt tables: the nodes of every axis   */
+/* the tables are computed on, which need not be evenly spaced. They    */
+/* are read from one single column file per axis in the Grid directory  */
+/* of the tables,                                                       */
+/*                                                                      */
+/*   Grid/sza          solar zenith angles of the transmittances        */
+/*   Grid/ozone        ozone columns of the transmittances [DU]         */
+/*   Grid/alt          altitudes of all tables [km]                     */
+/*   Grid/cloud        cloud liquid water contents [g m-3]              */
+/*   Grid/coeffs_sza   solar zenith angles of the aerosol coefficients  */
+/*   Grid/coeffs_lambda  wavelengths of the rows of the reflectivities  */
+/*                     and coefficient files [nm]                       */
+/*                                                                      */
+/* through the table store, so a pack carries its grid as well. An axis */
+/* without a file has the nodes of the original tables, 3 degrees,      */
+/* 20 DU, 0, 3 and 6 km, nine cloud levels and 10 nm from 290 nm.       */
+/*                                                                      */
+/* Grid/points holds the number of nodes interpolated from along the    */
+/* sza and ozone axes, TABLEGRID_CUBIC (the default) for the splines    */
+/* through four nodes and a quadratic in altitude, TABLEGRID_LINEAR for */
+/* linear interpolation between the two nodes around a value, which is  */
+/* accurate enough on the dense grids written by densify.h.             */
+/*                                                                      */
+/* Tables cut to a part of the parameter space, see subset.h, hold the  */
+/* range of the values they may be queried at per axis, one row         */
+/* "min max" in Grid/sza_range, Grid/ozone_range or Grid/alt_range.     */
+/* fastrt_compute() refuses values outside; without the file an axis    */
+/* has no range.                                                        */
+/*                                                                      */
+/* Nodes are given in increasing order. The table file names print the  */
+/* nodes with %g, e.g. TransmittancesCloudH2O0.014/sza42ozone320alt3.   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __tablegrid_h
+#define __tablegrid_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include "tablestore.h"
+
+
+#define TABLEGRID_DIRECTORY  "Grid"
+
+/* axes */
+#define TABLEGRID_SZA        0
+#define TABLEGRID_OZONE      1
+#define TABLEGRID_ALT        2
+#define TABLEGRID_CLOUD      3
+#define TABLEGRID_COEFF_SZA  4
+#define TABLEGRID_LAMBDA     5
+#define TABLEGRID_AXES       6
+
+#define TABLEGRID_NEIGHBOURS 4   /* nodes of the sza, ozone and cloud splines */
+#define TABLEGRID_ALT_NODES  3   /* nodes of the altitude polynomial          */
+
+/* points */
+#define TABLEGRID_CUBIC      4
+#define TABLEGRID_LINEAR     2
+
+
+typedef struct {
+  int     n;
+  double *x;                     /* n nodes, increasing                       */
+} TABLE_AXIS;
+
+typedef struct {
+  int     set;                   /* 0: any value                              */
+  double  min, max;
+} TABLE_RANGE;
+
+typedef struct {
+  TABLE_AXIS  axis[TABLEGRID_AXES];
+  TABLE_RANGE range[TABLEGRID_AXES];  /* of the queries, see above            */
+  int         points;            /* TABLEGRID_CUBIC or TABLEGRID_LINEAR       */
+} TABLE_GRID;
+
+
+/* prototypes */
+
+int  tablegrid_default (TABLE_GRID *grid);
+int  tablegrid_read    (TABLE_STORE *store,           /* store, may be NULL  */
+			TABLE_GRID *grid);            /* set                 */
+const TABLE_GRID *tablegrid_shared (void);
+int  tablegrid_set     (TABLE_GRID *grid, int axis, const double *x, int n);
+int  tablegrid_write   (const TABLE_GRID *grid,
+			const char *root);            /* root of the tables  */
+void tablegrid_free    (TABLE_GRID *grid);
+
+const char *tablegrid_name (int axis);
+
+int  tablegrid_lower      (const TABLE_AXIS *axis, double x);
+int  tablegrid_nearest    (const TABLE_AXIS *axis, double x);
+void tablegrid_neighbours (const TABLE_AXIS *axis, double x, int mirror, int points,
+			   double *nodes,             /* points, set         */
+			   int *index);               /* points, set         */
+int  tablegrid_alt_nodes  (const TABLE_GRID *grid, double alt,
+			   int *first,                /* set                 */
+			   int *exact);               /* set                 */
+int  tablegrid_span       (const TABLE_GRID *grid, int axis, double min, double max,
+			   int *first,                /* set                 */
+			   int *last);                /* set                 */
+int  tablegrid_in_range   (const TABLE_GRID *grid, int axis, double x);
+int  tablegrid_cloud_neighbours (const TABLE_AXIS *axis, double cloudH2O,
+				 double *x_cloudH2O,  /* TABLEGRID_NEIGHBOURS, set */
+				 int *subscr_cloudH2O_max);
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/************************************************************************/
+/* tablestore.h                                                         */
+/*                                                                      */
+/* Shared, thread safe cache of the fastrt look-up table files.         */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __tablestore_h
+#define __tablestore_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "matrix.h"
+#include "pack.h"
+
+
+#define TABLESTORE_MAX_SPECTRA  (256L << 20)   /* default bytes of spectra */
+
+/* kinds of the spectra of a node for one sampling */
+#define SPECTRUM_VALUES  0      /* the convolved spectrum of the node            */
+#define SPECTRUM_MATRIX  1      /* the convolution matrix, of the wavelength file */
+#define SPECTRUM_BASIS   2      /* + basis_id: the convolved basis spectra       */
+
+/* the output sampling spectra are convolved for: the wavelengths and the
+   slit function of a request, set by tablestore_sampling() */
+typedef struct {
+  unsigned long long hash;
+  const double *lambda;
+  const double *sr_lambda;
+  const double *sr;
+  int           n_lambda;
+  int           sr_nlambda;
+} TABLE_SAMPLING;
+
+/* a copy of a sampling, shared by the spectra convolved for it */
+typedef struct SAMPLING_COPY {
+  TABLE_SAMPLING        sampling;
+  long                  refs;      /* spectra using it                       */
+  struct SAMPLING_COPY *next;
+} SAMPLING_COPY;
+
+/* convolved spectrum of a node for one output sampling; values follow it */
+typedef struct NODE_SPECTRUM {
+  SAMPLING_COPY        *sampling;
+  int                   kind;
+  int                   n_values;
+  long                  users;     /* pinned by find or add, not evicted     */
+  struct TABLE_NODE    *node;
+  double               *values;
+  struct NODE_SPECTRUM *next;      /* of the node                            */
+  struct NODE_SPECTRUM *newer, *older;   /* least recently used list        */
+} NODE_SPECTRUM;
+
+/* one table file, e.g. ./TransmittancesCloudH2O0.000/sza30ozone300alt0 */
+typedef struct TABLE_NODE {
+  char   *name;          /* file name as requested                      */
+  int     status;        /* 0 if read, ASCII error code otherwise       */
+  int     loading;       /* being read by the thread that inserted it   */
+  int     rows;
+  int     columns;
+  MATRIX  table;         /* rows x |columns|, packed                    */
+  double *data;          /* table.data, row major                       */
+  PACK_TERMS terms;      /* n_terms > 0 if read from a PACK_PCA entry   */
+
+  /* spline coefficients of column 0, attached by tablestore_spline() */
+  double *a0, *a1, *a2, *a3;
+
+  NODE_SPECTRUM     *spectra;   /* attached by tablestore_add_spectrum() */
+  struct TABLE_NODE *next;      /* hash chain                            */
+} TABLE_NODE;
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t  loaded;        /* a node has been read                  */
+  int             n_buckets;
+  TABLE_NODE    **buckets;
+  long            n_nodes;
+  size_t          bytes;         /* bytes held by nodes, splines, spectra */
+  long            hits;
+  long            misses;
+  long            waits;         /* hits on a node still being read       */
+  const TABLE_PACK *pack;        /* tables read from a pack, may be NULL  */
+  FILE           *trace;         /* names of the tables read, may be NULL */
+
+  SAMPLING_COPY  *samplings;     /* of the spectra held                   */
+  NODE_SPECTRUM  *newest, *oldest;
+  size_t          spectra_bytes; /* of the spectra and their samplings    */
+  size_t          max_spectra;   /* bytes above which spectra are evicted */
+  long            evicted;       /* spectra evicted so far                */
+} TABLE_STORE;
+
+
+/* prototypes */
+
+TABLE_STORE *tablestore_create (void);
+void tablestore_free     (TABLE_STORE *store);
+void tablestore_set_pack (TABLE_STORE *store, const TABLE_PACK *pack);
+void tablestore_set_trace (TABLE_STORE *store, FILE *trace);
+
+int  tablestore_get      (TABLE_STORE *store, char *filename, TABLE_NODE **node);
+void tablestore_release  (TABLE_STORE *store, TABLE_NODE *node);
+
+int  tablestore_spline   (TABLE_STORE *store, TABLE_NODE *node,
+			  double *x, int number);
+
+void tablestore_sampling (TABLE_SAMPLING *sampling, const double *lambda, int n_lambda,
+			  const double *sr_lambda, const double *sr, int sr_nlambda);
+void tablestore_set_max_spectra (TABLE_STORE *store, size_t bytes);
+
+const double *tablestore_find_spectrum (TABLE_STORE *store, TABLE_NODE *node,
+					const TABLE_SAMPLING *sampling, int kind,
+					int n_values);
+const double *tablestore_add_spectrum  (TABLE_STORE *store, TABLE_NODE *node,
+					const TABLE_SAMPLING *sampling, int kind,
+					int n_values, const double *values);
+void tablestore_unpin_spectrum (TABLE_STORE *store, const double *values);
+
+unsigned long long tablestore_hash (unsigned long long hash,
+				    const void *data, size_t size);
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+/************************************************************************/
+/* taskpool.h                                                           */
+/*                                                                      */
+/* Work-stealing pool for the batch functions of the engine.            */
+/*                                                                      */
+/* The items 0..n-1 of a job are cut into tasks of chunk items. Every   */
+/* worker starts with a contiguous range of tasks and works through it  */
+/* front to back; an idle worker steals the back half of the largest    */
+/* remaining range. Callers order the items by table neighbourhood, so */
+/* that the ranges, also after stealing, keep neighbouring nodes on one */
+/* worker. TASKPOOL_STATIC disables stealing, for comparison.           */
+/*                                                                      */
+/* A TASKPOOL keeps its worker threads, their scratch arenas and arenas */
+/* (see arena.h) from one taskpool_run() to the next, so that a caller  */
+/* which runs a job per band or block does not start threads for each. */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __taskpool_h
+#define __taskpool_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <pthread.h>
+
+
+/* schedules */
+#define TASKPOOL_STEAL       0   /* default                                  */
+#define TASKPOOL_STATIC      1   /* fixed contiguous ranges, no stealing     */
+
+#define TASKPOOL_ALIGN       64  /* alignment of workers and scratch arenas  */
+
+
+typedef struct TASKPOOL_WORKER {
+  int     id;              /* 0 .. n_threads-1                              */
+  void   *user;            /* free for the job, e.g. set by init()          */
+
+  /* scratch arena, see taskpool_scratch() */
+  void   *scratch;
+  size_t  scratch_size;
+
+  /* remaining tasks [head, tail), protected by lock */
+  pthread_mutex_t lock;
+  long    head, tail;
+
+  long    tasks;           /* tasks run                                     */
+  long    steals;          /* successful steals                             */
+  double  busy;            /* seconds spent in run()                        */
+
+  struct TASKPOOL_RUN *pool;
+  struct TASKPOOL     *owner;  /* persistent pool of the worker             */
+} TASKPOOL_WORKER;
+
+typedef struct TASKPOOL TASKPOOL;
+
+typedef struct {
+  /* called once per worker and run before its first task, may be NULL */
+  int  (*init) (void *arg, TASKPOOL_WORKER *worker);
+  /* items first .. first+n-1 */
+  int  (*run)  (void *arg, TASKPOOL_WORKER *worker, long first, long n);
+  /* called once per worker and run after its last task, also if init() */
+  /* failed; may be NULL                                                  */
+  void (*fini) (void *arg, TASKPOOL_WORKER *worker);
+  void  *arg;
+} TASKPOOL_JOB;
+
+typedef struct {
+  int    threads;          /* workers used                                  */
+  long   tasks;
+  long   steals;
+  double seconds;          /* wall clock time                               */
+  double busy_max;         /* busy time of the busiest worker               */
+  double busy_mean;        /* mean busy time; busy_max/busy_mean >= 1 is    */
+                           /* the load imbalance                            */
+} TASKPOOL_STATS;
+
+
+/* prototypes */
+
+int   taskpool_threads (int n_threads);   /* <1: number of online processors */
+
+TASKPOOL *taskpool_create (int n_threads);        /* <1: online processors   */
+void  taskpool_free    (TASKPOOL *pool);
+
+int   taskpool_run     (TASKPOOL *pool,           /* NULL: threads of the call */
+			const TASKPOOL_JOB *job,  /* callbacks               */
+			long n_items,             /* items 0..n_items-1      */
+			long chunk,               /* items per task, >= 1    */
+			int n_threads,            /* <1: online processors,  */
+			                          /* at most those of pool   */
+			int schedule,             /* TASKPOOL_STEAL or _STATIC */
+			TASKPOOL_STATS *stats);   /* statistics, may be NULL */
+
+void *taskpool_scratch (TASKPOOL_WORKER *worker,  /* worker                  */
+			size_t size);             /* bytes needed            */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+/************************************************************************/
+/* trace.h                                                              */
+/*                                                                      */
+/* Per-stage timers of fastrt_compute(), off by default.                */
+/*                                                                      */
+/* When enabled with trace_enable(), every stage records an event in a  */
+/* buffer of the calling thread and adds its time to the summary of the */
+/* current call, which trace_last_call() returns after the call. The    */
+/* events of all threads can be written as Chrome trace-event JSON      */
+/* (chrome://tracing, Perfetto). Stages nest: resolve is part of parse, */
+/* parse, spline and convolve happen inside the table reads of a call.  */
+/* Times in the summary include nested stages.                          */
+/*                                                                      */
+/* When disabled, a stage costs one relaxed load of the switch.         */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __trace_h
+#define __trace_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+
+/* stages */
+#define TRACE_RESOLVE        0   /* file name to resource path               */
+#define TRACE_PARSE          1   /* reading an ASCII table                   */
+#define TRACE_SPLINE         2   /* spline coefficients of a table node      */
+#define TRACE_CONVOLVE       3   /* slit function convolution, do_spectra    */
+#define TRACE_CLOUD          4   /* log-space blending of cloud nodes        */
+#define TRACE_AEROSOL        5   /* aerosol scaling factors                  */
+#define TRACE_REFLECTANCE    6   /* compute_atmospheric_reflectance          */
+#define TRACE_INTERPOLATE    7   /* ozone, sza and altitude interpolation    */
+#define TRACE_CALL           8   /* whole fastrt_compute()                   */
+#define TRACE_STAGES         9
+
+/* events kept per thread; later events are counted as dropped */
+#define TRACE_MAX_EVENTS     65536
+
+
+typedef struct {
+  double seconds;                /* whole call                               */
+  double stage[TRACE_STAGES];    /* seconds per stage                        */
+  long   count[TRACE_STAGES];    /* times each stage was entered             */
+} TRACE_SUMMARY;
+
+
+/* prototypes */
+
+void   trace_enable      (int on);
+int    trace_enabled     (void);
+
+double trace_begin       (void);                 /* 0 if disabled            */
+void   trace_end         (int stage, double t0); /* t0 from trace_begin()    */
+
+double trace_call_begin  (void);                 /* 0 if disabled            */
+void   trace_call_end    (double t0);
+
+int    trace_last_call   (TRACE_SUMMARY *summary);  /* of this thread        */
+const char *trace_stage_name (int stage);
+
+int    trace_write_chrome (FILE *out);           /* events of all threads    */
+void   trace_reset       (void);                 /* drop recorded events     */
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
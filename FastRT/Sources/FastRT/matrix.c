@@ -0,0 +1,161 @@
+/************************************************************************/
+/* matrix.c                                                             */
+/*                                                                      */
+/* Contiguous 2-D and 3-D arrays of double, see matrix.h.               */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "matrix.h"
+#include "ascii.h"
+
+
+#define PAD  (MATRIX_ALIGN / sizeof(double))
+
+
+/* set up extents and strides; 2-D matrices are 3-D ones with n[2] == 1 */
+static int set_layout (MATRIX *m, int rank, int n0, int n1, int n2, int layout)
+{
+  size_t row=0;
+
+  memset (m, 0, sizeof(MATRIX));
+
+  if (n0 < 1 || n1 < 1 || n2 < 1)
+    return -1;
+
+  m->rank = rank;
+  m->n[0] = n0;
+  m->n[1] = n1;
+  m->n[2] = n2;
+
+  /* length of the contiguous rows */
+  row = (size_t) (rank == 2 ? n1 : n2);
+  if (layout == MATRIX_ALIGNED)
+    row = (row + PAD - 1) / PAD * PAD;
+
+  if (rank == 2)  {
+    m->stride[0] = row;
+    m->stride[1] = 1;
+    m->stride[2] = 1;
+  }
+  else  {
+    m->stride[2] = 1;
+    m->stride[1] = row;
+    m->stride[0] = row * n1;
+  }
+
+  if ((size_t) n0 > SIZE_MAX / sizeof(double) / m->stride[0])
+    return -1;
+
+  m->size = (size_t) n0 * m->stride[0];
+  return 0;
+}
+
+
+static int create (MATRIX *m, ARENA *arena, int rank, int n0, int n1, int n2, int layout)
+{
+  void *p=NULL;
+
+  if (set_layout (m, rank, n0, n1, n2, layout) != 0)
+    return ASCII_NO_MEMORY;
+
+  if (arena != NULL)  {
+    if ((m->data = (double *) arena_calloc (arena, m->size, sizeof(double))) == NULL)
+      return ASCII_NO_MEMORY;
+    return 0;
+  }
+
+  if (posix_memalign (&p, MATRIX_ALIGN, m->size * sizeof(double)) != 0)
+    return ASCII_NO_MEMORY;
+
+  memset (p, 0, m->size * sizeof(double));
+  m->data  = (double *) p;
+  m->owned = 1;
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: matrix_create, matrix_create3                                         */
+/* Description:                                                                    */
+/*  Allocate a zeroed rows x columns or n0 x n1 x n2 matrix from the heap.         */
+/*  layout is MATRIX_PACKED or MATRIX_ALIGNED.                                     */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., ASCII_NO_MEMORY if out of memory or an extent is < 1.             */
+/***********************************************************************************/
+
+int matrix_create (MATRIX *m, int rows, int columns, int layout)
+{
+  return create (m, NULL, 2, rows, columns, 1, layout);
+}
+
+
+int matrix_create3 (MATRIX *m, int n0, int n1, int n2, int layout)
+{
+  return create (m, NULL, 3, n0, n1, n2, layout);
+}
+
+
+
+/***********************************************************************************/
+/* Function: matrix_arena, matrix_arena3                                           */
+/* Description:                                                                    */
+/*  As matrix_create(), but from an arena; the matrix is valid until the arena is  */
+/*  reset and need not be freed.                                                   */
+/***********************************************************************************/
+
+int matrix_arena (MATRIX *m, ARENA *arena, int rows, int columns, int layout)
+{
+  return create (m, arena, 2, rows, columns, 1, layout);
+}
+
+
+int matrix_arena3 (MATRIX *m, ARENA *arena, int n0, int n1, int n2, int layout)
+{
+  return create (m, arena, 3, n0, n1, n2, layout);
+}
+
+
+
+/***********************************************************************************/
+/* Function: matrix_free                                                           */
+/* Description:                                                                    */
+/*  Free a matrix from matrix_create(); a matrix from an arena is only cleared.    */
+/***********************************************************************************/
+
+void matrix_free (MATRIX *m)
+{
+  if (m->owned)
+    free (m->data);
+  memset (m, 0, sizeof(MATRIX));
+}
+
+
+
+/***********************************************************************************/
+/* Function: matrix_column                                                         */
+/* Description:                                                                    */
+/*  Copy a column of a 2-D matrix into a new array, as ASCII_column().             */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The column, NULL if out of memory.                                             */
+/***********************************************************************************/
+
+double *matrix_column (const MATRIX *m, int column)
+{
+  double *col=NULL;
+  int i=0;
+
+  if ((col = (double *) calloc (m->n[0], sizeof(double))) == NULL)
+    return NULL;
+
+  for (i=0; i<m->n[0]; i++)
+    col[i] = MATRIX_AT (m, i, column);
+
+  return col;
+}
@@ -0,0 +1,332 @@
+/************************************************************************/
+/* metrics.c                                                            */
+/*                                                                      */
+/* Cumulative runtime counters of the engine, see metrics.h.            */
+/*                                                                      */
+/* A slot has a single writer, its thread, which updates a counter with */
+/* a relaxed load and store; readers load the counters relaxed. A       */
+/* snapshot is therefore not a consistent cut across counters, but      */
+/* every counter is exact. A slot is registered once per thread; when   */
+/* the thread ends, a pthread key destructor adds it to the retired     */
+/* counts under the lock and frees it, so that the counts of finished   */
+/* threads are kept but their slots are not.                            */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "metrics.h"
+
+
+typedef struct METRICS_SLOT {
+  long requests;
+  long failed;
+  long path[METRICS_PATHS];
+  long latency[METRICS_BUCKETS];
+  long latency_ns;
+  long cache_hits;
+  long cache_misses;
+  long nodes_loaded_max;
+  long bytes_held;
+  long scratch_peak;
+  struct METRICS_SLOT *next;
+} METRICS_SLOT;
+
+
+static pthread_mutex_t  metrics_lock  = PTHREAD_MUTEX_INITIALIZER;
+static METRICS_SLOT    *metrics_slots = NULL;
+static METRICS_SLOT     metrics_retired;          /* of the threads that ended */
+static int              metrics_retired_threads = 0;
+static pthread_key_t    metrics_key;
+static pthread_once_t   metrics_once = PTHREAD_ONCE_INIT;
+
+static __thread METRICS_SLOT *metrics_local = NULL;
+static __thread long          metrics_request_nodes = 0;
+
+static const double metrics_bounds[METRICS_BUCKETS-1] = METRICS_LATENCY_BOUNDS;
+
+static const char *metrics_paths[METRICS_PATHS] = {
+  "clear", "cloudy", "broken", "albedo", "aerosol"
+};
+
+
+#define LOAD(x)        __atomic_load_n (&(x), __ATOMIC_RELAXED)
+#define STORE(x, v)    __atomic_store_n (&(x), (v), __ATOMIC_RELAXED)
+#define ADD(x, v)      STORE (x, LOAD (x) + (v))
+#define MAX(x, v)      do { if ((v) > LOAD (x)) STORE (x, (v)); } while (0)
+
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* add the counters of a slot to a sum */
+static void add_slot (METRICS_SLOT *sum, const METRICS_SLOT *slot)
+{
+  int i=0;
+
+  sum->requests += LOAD (slot->requests);
+  sum->failed   += LOAD (slot->failed);
+  for (i=0; i<METRICS_PATHS; i++)
+    sum->path[i] += LOAD (slot->path[i]);
+  for (i=0; i<METRICS_BUCKETS; i++)
+    sum->latency[i] += LOAD (slot->latency[i]);
+  sum->latency_ns   += LOAD (slot->latency_ns);
+  sum->cache_hits   += LOAD (slot->cache_hits);
+  sum->cache_misses += LOAD (slot->cache_misses);
+  sum->bytes_held   += LOAD (slot->bytes_held);
+  if (LOAD (slot->nodes_loaded_max) > sum->nodes_loaded_max)
+    sum->nodes_loaded_max = LOAD (slot->nodes_loaded_max);
+  if (LOAD (slot->scratch_peak) > sum->scratch_peak)
+    sum->scratch_peak = LOAD (slot->scratch_peak);
+}
+
+
+/* the thread of a slot has ended: keep its counts, free the slot */
+static void retire_slot (void *p)
+{
+  METRICS_SLOT *slot=(METRICS_SLOT *) p, **link=NULL;
+
+  pthread_mutex_lock (&metrics_lock);
+  for (link=&metrics_slots; *link!=NULL; link=&(*link)->next)
+    if (*link == slot)  {
+      *link = slot->next;
+      break;
+    }
+  add_slot (&metrics_retired, slot);
+  metrics_retired_threads++;
+  pthread_mutex_unlock (&metrics_lock);
+
+  metrics_local = NULL;
+  free (slot);
+}
+
+
+static void create_key (void)
+{
+  pthread_key_create (&metrics_key, retire_slot);
+}
+
+
+static METRICS_SLOT *local_slot (void)
+{
+  METRICS_SLOT *slot=NULL;
+
+  if (metrics_local != NULL)
+    return metrics_local;
+
+  pthread_once (&metrics_once, create_key);
+
+  if ((slot = (METRICS_SLOT *) calloc (1, sizeof(METRICS_SLOT))) == NULL)
+    return NULL;
+
+  if (pthread_setspecific (metrics_key, slot) != 0)  {
+    free (slot);
+    return NULL;
+  }
+
+  pthread_mutex_lock (&metrics_lock);
+  slot->next    = metrics_slots;
+  metrics_slots = slot;
+  pthread_mutex_unlock (&metrics_lock);
+
+  metrics_local = slot;
+  return slot;
+}
+
+
+
+/***********************************************************************************/
+/* Function: metrics_request_begin, metrics_request_end                            */
+/* Description:                                                                    */
+/*  Count a request of this thread: its paths, status, latency, the table nodes    */
+/*  it read and its working memory.                                                */
+/***********************************************************************************/
+
+double metrics_request_begin (void)
+{
+  metrics_request_nodes = 0;
+  return now();
+}
+
+
+void metrics_request_end (double t0, int paths, int status, size_t scratch)
+{
+  METRICS_SLOT *slot=NULL;
+  double seconds = now() - t0;
+  int i=0;
+
+  if ((slot = local_slot ()) == NULL)
+    return;
+
+  ADD (slot->requests, 1);
+  if (status != 0)
+    ADD (slot->failed, 1);
+
+  for (i=0; i<METRICS_PATHS; i++)
+    if (paths & (1 << i))
+      ADD (slot->path[i], 1);
+
+  for (i=0; i<METRICS_BUCKETS-1 && seconds > metrics_bounds[i]; i++)
+    ;
+  ADD (slot->latency[i], 1);
+  ADD (slot->latency_ns, (long) (seconds * 1e9));
+
+  MAX (slot->nodes_loaded_max, metrics_request_nodes);
+  MAX (slot->scratch_peak, (long) scratch);
+}
+
+
+
+/***********************************************************************************/
+/* Function: metrics_table_lookup, metrics_table_bytes                             */
+/* Description:                                                                    */
+/*  Count a table node taken from a store (hit) or read from its file, and a       */
+/*  change of the bytes held by a store.                                           */
+/***********************************************************************************/
+
+void metrics_table_lookup (int hit)
+{
+  METRICS_SLOT *slot=NULL;
+
+  if ((slot = local_slot ()) == NULL)
+    return;
+
+  if (hit)
+    ADD (slot->cache_hits, 1);
+  else  {
+    ADD (slot->cache_misses, 1);
+    metrics_request_nodes++;
+  }
+}
+
+
+void metrics_table_bytes (long bytes)
+{
+  METRICS_SLOT *slot=NULL;
+
+  if ((slot = local_slot ()) != NULL)
+    ADD (slot->bytes_held, bytes);
+}
+
+
+
+/***********************************************************************************/
+/* Function: metrics_snapshot                                                      */
+/* Description:                                                                    */
+/*  Add up the counters of all threads, those that have ended included.           */
+/***********************************************************************************/
+
+void metrics_snapshot (METRICS_SNAPSHOT *snapshot)
+{
+  METRICS_SLOT *slot=NULL, sum;
+  int i=0;
+
+  memset (snapshot, 0, sizeof(METRICS_SNAPSHOT));
+
+  pthread_mutex_lock (&metrics_lock);
+  sum = metrics_retired;
+  snapshot->threads = metrics_retired_threads;
+  for (slot=metrics_slots; slot!=NULL; slot=slot->next)  {
+    add_slot (&sum, slot);
+    snapshot->threads++;
+  }
+  pthread_mutex_unlock (&metrics_lock);
+
+  snapshot->requests = sum.requests;
+  snapshot->failed   = sum.failed;
+  for (i=0; i<METRICS_PATHS; i++)
+    snapshot->path[i] = sum.path[i];
+  for (i=0; i<METRICS_BUCKETS; i++)
+    snapshot->latency[i] = sum.latency[i];
+  snapshot->latency_sum      = sum.latency_ns * 1e-9;
+  snapshot->cache_hits       = sum.cache_hits;
+  snapshot->cache_misses     = sum.cache_misses;
+  snapshot->bytes_held       = sum.bytes_held;
+  snapshot->nodes_loaded_max = sum.nodes_loaded_max;
+  snapshot->scratch_peak     = sum.scratch_peak;
+}
+
+
+double metrics_latency_bound (int bucket)
+{
+  if (bucket < 0 || bucket >= METRICS_BUCKETS-1)
+    return INFINITY;
+  return metrics_bounds[bucket];
+}
+
+
+
+/***********************************************************************************/
+/* Function: metrics_write_prometheus                                              */
+/* Description:                                                                    */
+/*  Write a snapshot in the Prometheus text exposition format.                     */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., -1 if writing failed.                                              */
+/***********************************************************************************/
+
+int metrics_write_prometheus (FILE *out)
+{
+  METRICS_SNAPSHOT s;
+  long cumulative=0;
+  int i=0;
+
+  metrics_snapshot (&s);
+
+  fprintf (out, "# HELP fastrt_requests_total Calls of fastrt_compute.\n");
+  fprintf (out, "# TYPE fastrt_requests_total counter\n");
+  fprintf (out, "fastrt_requests_total %ld\n", s.requests);
+
+  fprintf (out, "# HELP fastrt_requests_failed_total Calls with a nonzero status.\n");
+  fprintf (out, "# TYPE fastrt_requests_failed_total counter\n");
+  fprintf (out, "fastrt_requests_failed_total %ld\n", s.failed);
+
+  fprintf (out, "# HELP fastrt_path_requests_total Requests per path.\n");
+  fprintf (out, "# TYPE fastrt_path_requests_total counter\n");
+  for (i=0; i<METRICS_PATHS; i++)
+    fprintf (out, "fastrt_path_requests_total{path=\"%s\"} %ld\n", metrics_paths[i], s.path[i]);
+
+  fprintf (out, "# HELP fastrt_request_seconds Latency of fastrt_compute.\n");
+  fprintf (out, "# TYPE fastrt_request_seconds histogram\n");
+  for (i=0; i<METRICS_BUCKETS; i++)  {
+    cumulative += s.latency[i];
+    if (i < METRICS_BUCKETS-1)
+      fprintf (out, "fastrt_request_seconds_bucket{le=\"%g\"} %ld\n", metrics_bounds[i],
+	       cumulative);
+    else
+      fprintf (out, "fastrt_request_seconds_bucket{le=\"+Inf\"} %ld\n", cumulative);
+  }
+  fprintf (out, "fastrt_request_seconds_sum %.9f\n", s.latency_sum);
+  fprintf (out, "fastrt_request_seconds_count %ld\n", cumulative);
+
+  fprintf (out, "# HELP fastrt_table_cache_hits_total Table nodes found in a store.\n");
+  fprintf (out, "# TYPE fastrt_table_cache_hits_total counter\n");
+  fprintf (out, "fastrt_table_cache_hits_total %ld\n", s.cache_hits);
+
+  fprintf (out, "# HELP fastrt_table_cache_misses_total Table nodes read from their file.\n");
+  fprintf (out, "# TYPE fastrt_table_cache_misses_total counter\n");
+  fprintf (out, "fastrt_table_cache_misses_total %ld\n", s.cache_misses);
+
+  fprintf (out, "# HELP fastrt_request_nodes_loaded_max Most table nodes read by one request.\n");
+  fprintf (out, "# TYPE fastrt_request_nodes_loaded_max gauge\n");
+  fprintf (out, "fastrt_request_nodes_loaded_max %ld\n", s.nodes_loaded_max);
+
+  fprintf (out, "# HELP fastrt_table_bytes Bytes held by the table stores.\n");
+  fprintf (out, "# TYPE fastrt_table_bytes gauge\n");
+  fprintf (out, "fastrt_table_bytes %ld\n", s.bytes_held);
+
+  fprintf (out, "# HELP fastrt_request_scratch_bytes_max Largest working memory of a request.\n");
+  fprintf (out, "# TYPE fastrt_request_scratch_bytes_max gauge\n");
+  fprintf (out, "fastrt_request_scratch_bytes_max %ld\n", s.scratch_peak);
+
+  return (ferror (out) ? -1 : 0);
+}
@@ -0,0 +1,1758 @@
+/************************************************************************/
+/* pack.c                                                               */
+/*                                                                      */
+/* Compressed pack of the fastrt look-up tables, see pack.h.            */
+/*                                                                      */
+/* The transmittance spectra of one directory, solar zenith angle and   */
+/* altitude form a block, ordered by ozone column (PACK_ORDER_OZONE;    */
+/* the other orders run the blocks along sza, a tile of the Z-order of  */
+/* sza and ozone, or a trace, see order_spectra()). Every spectrum is   */
+/* stored as the logarithm of its values, predicted from the previous   */
+/* wavelength and the previous node of the block                        */
+/*                                                                      */
+/*   p[k] = r[k-1] + rp[k] - rp[k-1]                                    */
+/*                                                                      */
+/* (r the reconstructed logarithms of the node, rp those of the node    */
+/* before it), and the prediction errors are quantized to 16 bit codes  */
+/* with a scale per node of at most twice the relative error allowed.   */
+/* Values which are not positive, like some numerical noise of the      */
+/* tables below 295 nm or the NaN of the engine, values below           */
+/* PACK_EXACT_FLOOR of the largest of their spectrum and prediction     */
+/* errors outside the range of the codes are kept as they are, marked   */
+/* by the code EXCEPTION, and so are all values of the spectra of       */
+/* noise, with values far above 1, as in some tables of sza 90 with     */
+/* clouds. The engine splines the small values next to values many      */
+/* orders larger, so that an error relative to the value alone would    */
+/* grow with the size of its neighbours. Since the predictions use the  */
+/* reconstructed values, the errors do not add up along the block;      */
+/* a node is decoded with two additions per value of the nodes before   */
+/* it in its block, and one exponential per value of its own.           */
+/*                                                                      */
+/* A node record is                                                     */
+/*                                                                      */
+/*   double   scale                                                     */
+/*   double   first         logarithm of the first positive value       */
+/*   uint32_t n_exceptions, reserved                                    */
+/*   int16_t  codes[rows]   padded to 8 bytes                           */
+/*   double   exceptions[n_exceptions]                                  */
+/*                                                                      */
+/* With PACK_PCA, the spectra of a directory are instead stored as the  */
+/* coefficients of a basis fitted to them (see pca.c): the mean and the */
+/* first K principal components of the spectra, each normalized to its  */
+/* largest value. K is chosen to give the smallest pack for the error   */
+/* allowed, values off by more or below PACK_EXACT_FLOOR are kept as    */
+/* they are; spectra of noise, with values far above 1, have no         */
+/* coefficients at all. A node record is then                           */
+/*                                                                      */
+/*   uint32_t n_exceptions, reserved                                    */
+/*   double   terms[K+1]                                                */
+/*   double   exceptions[n_exceptions]                                  */
+/*   uint16_t index[n_exceptions]   rows of the exceptions, padded      */
+/*                                                                      */
+/* Since a spectrum is linear in its coefficients, anything linear done */
+/* to it, like the convolution with the slit function, can be done to   */
+/* the K+1 basis spectra once instead, see spectra_from_store().        */
+/*                                                                      */
+/* Payloads are content addressed while the pack is built: a spectrum   */
+/* is looked up by the hash of its logarithms quantized to steps of the */
+/* relative error, and shares the payload of a spectrum with the same   */
+/* hash whose decoded values are within the error of its own; it is     */
+/* then left out of its block, the next node predicted from the one     */
+/* before it. Spectra below the zero floor are hashed by their length   */
+/* only. Other tables share a payload with exactly the same values.     */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pack.h"
+#include "pca.h"
+#include "ascii.h"
+#include "tablestore.h"
+
+
+#define EXCEPTION        (-32768)
+#define MAX_CODE         32767
+#define ALIGN8(n)        (((n) + 7) & ~(size_t) 7)
+#define RECORD_SIZE(rows, n_exceptions) \
+  (24 + ALIGN8 (2 * (size_t) (rows)) + 8 * (size_t) (n_exceptions))
+#define PCA_RECORD_SIZE(n_terms, n_exceptions) \
+  (8 + 8 * (size_t) (n_terms) + 8 * (size_t) (n_exceptions) + ALIGN8 (2 * (size_t) (n_exceptions)))
+#define PCA_MAX_PEAK     10.0   /* above, a spectrum is noise and kept as it is  */
+
+
+/* a file of the tree while the pack is built */
+typedef struct {
+  char   *name;           /* "TransmittancesCloudH2O0.000/sza0ozone100alt0" */
+  int     level;          /* directory, index into stats->level             */
+  int     rows;
+  int     columns;
+  MATRIX  table;
+  size_t  text_bytes;
+  int     spectrum;       /* sza%dozone%dalt%d with one column              */
+  int     sza, o3, alt;
+  unsigned morton;        /* Z-order of the sza and ozone ranks             */
+  int     trace;          /* first access in the trace, -1: none            */
+  int     rank;           /* in the order of the pack                       */
+  int     chain;          /* PACK_LOG16 block                               */
+  int     block, slot;
+  uint64_t offset;
+} PACK_FILE;
+
+/* a payload of the pack, which later files may share */
+typedef struct {
+  unsigned long long key;
+  PACK_FILE *file;        /* the first with it, block, slot and offset set  */
+  double    *decoded;     /* the spectrum as pack_read() returns it         */
+  size_t     bytes;       /* of the payload                                 */
+} PACK_PAYLOAD;
+
+/* the payloads by key, open addressing */
+typedef struct {
+  PACK_PAYLOAD *payload;
+  int           n;
+  int          *slot;     /* index+1 into payload, 0: empty                 */
+  int           n_slots;  /* a power of 2 above twice the files             */
+  double        max_error;
+  double        zero_floor;
+} PACK_SHARE;
+
+/* growing output */
+typedef struct {
+  unsigned char *data;
+  size_t         size;
+  size_t         max;
+} PACK_BUFFER;
+
+
+static int put (PACK_BUFFER *b, const void *data, size_t size)
+{
+  unsigned char *tmp=NULL;
+  size_t max=b->max;
+
+  while (b->size + size > max)
+    max = (max > 0 ? 2 * max : 1 << 20);
+  if (max != b->max)  {
+    if ((tmp = (unsigned char *) realloc (b->data, max)) == NULL)
+      return ASCII_NO_MEMORY;
+    b->data = tmp;
+    b->max  = max;
+  }
+
+  if (data != NULL)
+    memcpy (b->data + b->size, data, size);
+  else
+    memset (b->data + b->size, 0, size);
+  b->size += size;
+  return 0;
+}
+
+
+static int pad8 (PACK_BUFFER *b)
+{
+  return put (b, NULL, ALIGN8 (b->size) - b->size);
+}
+
+
+
+/* the value of spectrum t at or below which its values are kept exactly; */
+/* all of them for a spectrum of noise                                     */
+static double exact_floor (const double *t, int rows)
+{
+  double peak=0.0;
+  int k=0;
+
+  for (k=0; k<rows; k++)
+    if (isfinite (t[k]) && t[k] > peak)
+      peak = t[k];
+  return (peak > PCA_MAX_PEAK ? INFINITY : PACK_EXACT_FLOOR * peak);
+}
+
+
+/* decode one record: reconstructed logarithms into r, the values into out */
+/* (if not NULL); returns the size of the record, 0 if it has fewer        */
+/* exceptions than its codes ask for                                       */
+static size_t decode_node (const unsigned char *record, int rows, const double *rp,
+			   double *r, double *out)
+{
+  const int16_t *codes = (const int16_t *) (record + 24);
+  const unsigned char *exceptions = record + 24 + ALIGN8 (2 * (size_t) rows);
+  double scale=0.0, first=0.0, p=0.0, x=0.0;
+  uint32_t n_exceptions=0;
+  int k=0, e=0;
+
+  memcpy (&scale, record, sizeof(double));
+  memcpy (&first, record + 8, sizeof(double));
+  memcpy (&n_exceptions, record + 16, sizeof(uint32_t));
+
+  for (k=0; k<rows; k++)  {
+    if (k == 0)
+      p = first;
+    else if (rp != NULL)
+      p = r[k-1] + rp[k] - rp[k-1];
+    else
+      p = r[k-1];
+
+    if (codes[k] == EXCEPTION)  {
+      if (e >= (int) n_exceptions)
+	return 0;
+      memcpy (&x, exceptions + 8 * e++, sizeof(double));
+      r[k] = (x > 0.0 && !isinf (x)) ? log (x) : p;
+      if (out != NULL)
+	out[k] = x;
+    }
+    else  {
+      r[k] = p + codes[k] * scale;
+      if (out != NULL)
+	out[k] = exp (r[k]);
+    }
+  }
+
+  return RECORD_SIZE (rows, n_exceptions);
+}
+
+
+/* append the record of spectrum t, predicted from rp (NULL for the first   */
+/* node of a block), with a relative error of at most max_error; values     */
+/* at or below the exact floor or not predicted within the range of the    */
+/* codes are kept as they are. The reconstruction of the decoder is in r.   */
+static int encode_node (PACK_BUFFER *out, const double *t, int rows, const double *rp,
+			double max_error, double *r, int16_t *codes, double *exceptions)
+{
+  double first=0.0, scale=0.0, y=0.0, e=0.0, max=0.0, p=0.0, floor_t=exact_floor (t, rows);
+  uint32_t header[2]={0,0};
+  int n_exceptions=0, k=0, status=0;
+
+  for (k=0; k<rows; k++)
+    if (t[k] > 0.0 && !isinf (t[k]))  {
+      first = log (t[k]);
+      break;
+    }
+
+  /* the scale of the budget, or finer if the open loop errors are small */
+  for (k=0; k<rows; k++)  {
+    y = (t[k] > 0.0 && !isinf (t[k])) ? log (t[k]) : (k > 0 ? r[k-1] : first);
+    if (k == 0)
+      p = first;
+    else if (rp != NULL)
+      p = r[k-1] + rp[k] - rp[k-1];
+    else
+      p = r[k-1];
+    r[k] = y;
+    e = fabs (y - p);
+    if (e > max)
+      max = e;
+  }
+  scale = 1.99 * max_error;
+  if (max > 0.0 && max / (MAX_CODE - 767) < scale)
+    scale = max / (MAX_CODE - 767);
+
+  /* closed loop, so that the errors do not add up */
+  for (k=0; k<rows; k++)  {
+    if (k == 0)
+      p = first;
+    else if (rp != NULL)
+      p = r[k-1] + rp[k] - rp[k-1];
+    else
+      p = r[k-1];
+
+    if (t[k] > floor_t && !isinf (t[k]) && fabs (log (t[k]) - p) < MAX_CODE * scale)  {
+      codes[k] = (int16_t) floor ((log (t[k]) - p) / scale + 0.5);
+      r[k] = p + codes[k] * scale;
+    }
+    else  {
+      codes[k] = EXCEPTION;
+      exceptions[n_exceptions++] = t[k];
+      r[k] = (t[k] > 0.0 && !isinf (t[k])) ? log (t[k]) : p;
+    }
+  }
+
+  header[0] = (uint32_t) n_exceptions;
+  if ((status = put (out, &scale, sizeof(double))) != 0 ||
+      (status = put (out, &first, sizeof(double))) != 0 ||
+      (status = put (out, header, sizeof(header))) != 0 ||
+      (status = put (out, codes, 2 * (size_t) rows)) != 0 ||
+      (status = pad8 (out)) != 0 ||
+      (status = put (out, exceptions, 8 * (size_t) n_exceptions)) != 0)
+    return status;
+
+  return 0;
+}
+
+
+
+static int share_init (PACK_SHARE *share, int n_files, double max_error, double zero_floor)
+{
+  memset (share, 0, sizeof(PACK_SHARE));
+  share->max_error  = max_error;
+  share->zero_floor = zero_floor;
+  for (share->n_slots=1024; share->n_slots < 2 * n_files; share->n_slots *= 2)
+    ;
+  share->payload = (PACK_PAYLOAD *) calloc (n_files + 1, sizeof(PACK_PAYLOAD));
+  share->slot    = (int *) calloc (share->n_slots, sizeof(int));
+  return (share->payload == NULL || share->slot == NULL ? ASCII_NO_MEMORY : 0);
+}
+
+
+static void share_free (PACK_SHARE *share)
+{
+  int i=0;
+
+  if (share->payload != NULL)
+    for (i=0; i<share->n; i++)
+      free (share->payload[i].decoded);
+  free (share->payload);
+  free (share->slot);
+  memset (share, 0, sizeof(PACK_SHARE));
+}
+
+
+/* the key of a spectrum: its length and logarithms in steps of the error, */
+/* or its length only below the zero floor                                 */
+static unsigned long long spectrum_key (const PACK_SHARE *share, const double *t, int rows,
+					int *zero)
+{
+  unsigned long long key=0;
+  long long q=0;
+  double peak=0.0;
+  int k=0;
+
+  for (k=0; k<rows; k++)
+    if (fabs (t[k]) > peak)
+      peak = fabs (t[k]);
+
+  key = tablestore_hash (0, "spectrum", 8);
+  key = tablestore_hash (key, &rows, sizeof(int));
+  *zero = (peak < share->zero_floor);
+  if (*zero)
+    return tablestore_hash (key, "zero", 4);
+
+  for (k=0; k<rows; k++)  {
+    if (t[k] > 0.0 && !isinf (t[k]))  {
+      q = (long long) floor (log (t[k]) / share->max_error + 0.5);
+      key = tablestore_hash (key, &q, sizeof(q));
+    }
+    else
+      key = tablestore_hash (key, &t[k], sizeof(double));
+  }
+  return key;
+}
+
+
+/* the key of any other table: its shape and values */
+static unsigned long long table_key (const PACK_FILE *f)
+{
+  unsigned long long key=0;
+
+  key = tablestore_hash (0, "table", 5);
+  key = tablestore_hash (key, &f->rows, sizeof(int));
+  key = tablestore_hash (key, &f->columns, sizeof(int));
+  return tablestore_hash (key, f->table.data,
+			  (size_t) f->rows * abs (f->columns) * sizeof(double));
+}
+
+
+/* the payload with key which f may share: for a spectrum, t, decoded to   */
+/* within the error of the pack and exactly at or below its exact floor,  */
+/* the largest error in err; a zero; or the same table. NULL if none       */
+static PACK_PAYLOAD *share_find (const PACK_SHARE *share, unsigned long long key,
+				 const PACK_FILE *f, const double *t, int zero, double *err)
+{
+  PACK_PAYLOAD *p=NULL;
+  double e=0.0, max=0.0, floor_t=(t != NULL ? exact_floor (t, f->rows) : 0.0);
+  int i=0, k=0;
+
+  for (i=(int) (key & (share->n_slots - 1)); share->slot[i] != 0;
+       i=(i + 1) & (share->n_slots - 1))  {
+    p = &share->payload[share->slot[i] - 1];
+    if (p->key != key || p->file->rows != f->rows || p->file->columns != f->columns ||
+	(p->decoded == NULL) != (t == NULL))
+      continue;
+    if (t == NULL)  {
+      if (memcmp (p->file->table.data, f->table.data,
+		  (size_t) f->rows * abs (f->columns) * sizeof(double)) == 0)
+	return p;
+      continue;
+    }
+
+    for (k=0, max=0.0; k<f->rows; k++)  {
+      if (zero)
+	e = fabs (p->decoded[k] - t[k]);
+      else if (t[k] > floor_t)
+	e = fabs (p->decoded[k] - t[k]) / t[k];
+      else
+	e = (p->decoded[k] == t[k] ? 0.0 : INFINITY);
+      if (e > max)
+	max = e;
+    }
+    if (zero || max <= share->max_error)  {
+      *err = max;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+
+/* add the payload of f, with the decoded spectrum unless NULL */
+static int share_add (PACK_SHARE *share, unsigned long long key, PACK_FILE *f,
+		      const double *decoded, size_t bytes)
+{
+  PACK_PAYLOAD *p = &share->payload[share->n];
+  int i=0;
+
+  p->key   = key;
+  p->file  = f;
+  p->bytes = bytes;
+  if (decoded != NULL)  {
+    if ((p->decoded = (double *) calloc (f->rows, sizeof(double))) == NULL)
+      return ASCII_NO_MEMORY;
+    memcpy (p->decoded, decoded, f->rows * sizeof(double));
+  }
+
+  for (i=(int) (key & (share->n_slots - 1)); share->slot[i] != 0;
+       i=(i + 1) & (share->n_slots - 1))
+    ;
+  share->slot[i] = ++share->n;
+  return 0;
+}
+
+
+/* count a spectrum sharing payload p with error err */
+static void count_shared (PACK_STATS *stats, const PACK_FILE *f, const PACK_PAYLOAD *p,
+			  int zero, double err)
+{
+  PACK_LEVEL *level = (f->level >= 0 ? &stats->level[f->level] : NULL);
+
+  if (zero)  {
+    stats->zeros++;
+    if (err > stats->zero_error)
+      stats->zero_error = err;
+  }
+  else  {
+    stats->shared++;
+    if (err > stats->max_error)
+      stats->max_error = err;
+    if (level != NULL && err > level->max_error)
+      level->max_error = err;
+  }
+  stats->values       += f->rows;
+  stats->shared_bytes += p->bytes;
+  if (level != NULL)  {
+    level->spectra++;
+    level->shared++;
+  }
+}
+
+
+
+/* size of the PACK_LOG16 record at offset of a block of rows, 0 if it does */
+/* not fit into the pack                                                    */
+static size_t log16_record (const TABLE_PACK *pack, uint64_t offset, uint32_t rows)
+{
+  uint32_t n_exceptions=0;
+  size_t size=0;
+
+  if (offset > pack->size || pack->size - offset < 24)
+    return 0;
+  memcpy (&n_exceptions, pack->base + offset + 16, sizeof(uint32_t));
+  size = RECORD_SIZE (rows, n_exceptions);
+  return (size <= pack->size - offset ? size : 0);
+}
+
+
+/* the same for the PACK_PCA record at offset of a basis of n_terms */
+static size_t pca_record (const TABLE_PACK *pack, uint64_t offset, uint32_t n_terms)
+{
+  uint32_t n_exceptions=0;
+  size_t size=0;
+
+  if (offset > pack->size || pack->size - offset < 8)
+    return 0;
+  memcpy (&n_exceptions, pack->base + offset, sizeof(uint32_t));
+  size = PCA_RECORD_SIZE (n_terms, n_exceptions);
+  return (size <= pack->size - offset ? size : 0);
+}
+
+
+/* whether the entries and blocks of a pack point into it: names, the data   */
+/* of PACK_RAW entries, blocks and bases; the records themselves are checked */
+/* as they are read, so that opening a pack touches only its index           */
+static int check_entries (const TABLE_PACK *pack)
+{
+  const PACK_HEADER *h=pack->header;
+  const PACK_ENTRY *e=NULL;
+  const PACK_BLOCK *b=NULL;
+  uint64_t size=h->size;
+  uint32_t i=0;
+
+  /* the names are last, so the last one ends with the pack */
+  if (h->n_entries > 0 && pack->base[size - 1] != 0)
+    return -1;
+
+  for (i=0; i<h->n_entries; i++)  {
+    e = &pack->entries[i];
+    if (e->name >= size - h->names || e->rows < 0 || e->columns == INT32_MIN)
+      return -1;
+
+    switch (e->kind)  {
+    case PACK_RAW:
+      if (e->offset > size ||
+	  (uint64_t) e->rows * abs (e->columns) > (size - e->offset) / sizeof(double))
+	return -1;
+      break;
+    case PACK_LOG16:
+      if (e->offset >= h->n_blocks)
+	return -1;
+      b = &pack->blocks[e->offset];
+      if (e->slot >= b->n_nodes || b->rows != (uint32_t) e->rows || e->columns != 1 ||
+	  b->offset > size)
+	return -1;
+      break;
+    case PACK_PCA:
+      if (e->slot >= h->n_blocks)
+	return -1;
+      b = &pack->blocks[e->slot];
+      if (b->rows != (uint32_t) e->rows || e->columns != 1 || e->offset > size ||
+	  b->offset > size ||
+	  (uint64_t) b->n_nodes * b->rows > (size - b->offset) / sizeof(double))
+	return -1;
+      break;
+    default:
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+/* the pack of the size bytes at base if its header is of this version and */
+/* byte order and fits the size, and its entries fit the pack              */
+static TABLE_PACK *check_pack (const void *base, size_t size)
+{
+  TABLE_PACK *pack=NULL;
+  const PACK_HEADER *h=(const PACK_HEADER *) base;
+
+  if (size < sizeof(PACK_HEADER) ||
+      memcmp (h->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+      h->version != PACK_VERSION || h->byte_order != PACK_BYTE_ORDER ||
+      h->size != (uint64_t) size ||
+      h->entries + (uint64_t) h->n_entries * sizeof(PACK_ENTRY) > h->size ||
+      h->blocks + (uint64_t) h->n_blocks * sizeof(PACK_BLOCK) > h->size ||
+      h->names >= h->size ||
+      (pack = (TABLE_PACK *) calloc (1, sizeof(TABLE_PACK))) == NULL)
+    return NULL;
+
+  pack->base    = (const unsigned char *) base;
+  pack->size    = size;
+  pack->header  = h;
+  pack->entries = (const PACK_ENTRY *) (pack->base + h->entries);
+  pack->blocks  = (const PACK_BLOCK *) (pack->base + h->blocks);
+  pack->names   = (const char *) (pack->base + h->names);
+  if (check_entries (pack) != 0)  {
+    free (pack);
+    return NULL;
+  }
+  return pack;
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_open                                                             */
+/* Description:                                                                    */
+/*  Map a pack into memory and check its header and entries.                       */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The pack, NULL if it cannot be read, is not a pack of this version and byte    */
+/*  order, or its entries point outside it.                                        */
+/***********************************************************************************/
+
+TABLE_PACK *pack_open (const char *path)
+{
+  TABLE_PACK *pack=NULL;
+  struct stat st;
+  void *base=MAP_FAILED;
+  int fd=-1;
+
+  if ((fd = open (path, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat (fd, &st) == 0 && (size_t) st.st_size >= sizeof(PACK_HEADER))
+    base = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  if ((pack = check_pack (base, (size_t) st.st_size)) == NULL)  {
+    munmap (base, (size_t) st.st_size);
+    return NULL;
+  }
+  pack->mapped = 1;
+  return pack;
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_open_memory                                                      */
+/* Description:                                                                    */
+/*  Read a pack from the size bytes at data, e.g. a pack linked into the binary,   */
+/*  without any file access. data must be aligned to 8 bytes and stay as it is     */
+/*  until pack_close(), which does not free it.                                    */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The pack, NULL if data is not a pack of this version and byte order.           */
+/***********************************************************************************/
+
+TABLE_PACK *pack_open_memory (const void *data, size_t size)
+{
+  if (data == NULL || ((uintptr_t) data & 7) != 0)
+    return NULL;
+  return check_pack (data, size);
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_close                                                            */
+/* Description:                                                                    */
+/*  Unmap the pack, or leave the memory of pack_open_memory() as it is. No table   */
+/*  of it may be read any more.                                                    */
+/***********************************************************************************/
+
+void pack_close (TABLE_PACK *pack)
+{
+  if (pack == NULL)
+    return;
+
+  if (pack->mapped)
+    munmap ((void *) pack->base, pack->size);
+  free (pack);
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_advise                                                           */
+/* Description:                                                                    */
+/*  Tell the kernel how the pages of the pack will be read, one of PACK_ADVISE_*:  */
+/*  SEQUENTIAL for sweeps along the order of the pack, RANDOM for scattered        */
+/*  requests, POPULATE to map all pages at once, so that no request of an engine   */
+/*  faults on the pack any more.                                                   */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int pack_advise (const TABLE_PACK *pack, int advice)
+{
+  uintptr_t page=(uintptr_t) sysconf (_SC_PAGESIZE), start=0;
+  size_t size=0;
+  void *base=NULL;
+  int a=POSIX_MADV_NORMAL;
+
+  if (pack == NULL)
+    return -1;
+
+  /* the pages of a pack in memory, which need not start a page */
+  start = (uintptr_t) pack->base & ~(page - 1);
+  base  = (void *) start;
+  size  = pack->size + ((uintptr_t) pack->base - start);
+
+  switch (advice)  {
+  case PACK_ADVISE_NORMAL:     a = POSIX_MADV_NORMAL;     break;
+  case PACK_ADVISE_SEQUENTIAL: a = POSIX_MADV_SEQUENTIAL; break;
+  case PACK_ADVISE_RANDOM:     a = POSIX_MADV_RANDOM;     break;
+  case PACK_ADVISE_POPULATE:
+#ifdef MADV_POPULATE_READ
+    if (madvise (base, size, MADV_POPULATE_READ) == 0)
+      return 0;
+#endif
+    a = POSIX_MADV_WILLNEED;
+    break;
+  default:
+    return -1;
+  }
+
+  return (posix_madvise (base, size, a) == 0 ? 0 : -1);
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_find                                                             */
+/* Description:                                                                    */
+/*  Find the entry of a table file, named as by fastrt, e.g.                       */
+/*  ./TransmittancesCloudH2O0.000/sza0ozone100alt0.                                */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The index of the entry, <0 if the file is not in the pack.                     */
+/***********************************************************************************/
+
+int pack_find (const TABLE_PACK *pack, const char *filename)
+{
+  int lo=0, hi=0, mid=0, cmp=0;
+
+  if (pack == NULL)
+    return -1;
+
+  while (filename[0] == '.' && filename[1] == '/')
+    filename += 2;
+
+  hi = (int) pack->header->n_entries - 1;
+  while (lo <= hi)  {
+    mid = lo + (hi - lo) / 2;
+    cmp = strcmp (pack->names + pack->entries[mid].name, filename);
+    if (cmp == 0)
+      return mid;
+    if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+
+  return -1;
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_read                                                             */
+/* Description:                                                                    */
+/*  Decode one entry into a new packed matrix, as ASCII_file2matrix() reads the    */
+/*  file. Only the nodes before it in its block are touched.                       */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int pack_read (const TABLE_PACK *pack, int entry, MATRIX *table, int *rows, int *columns)
+{
+  PACK_TERMS terms;
+  const PACK_ENTRY *e=NULL;
+  const PACK_BLOCK *b=NULL;
+  const unsigned char *record=NULL;
+  double *r=NULL, *rp=NULL, *tmp=NULL;
+  size_t size=0;
+  int n_columns=0, i=0, status=0;
+
+  if (pack == NULL || entry < 0 || entry >= (int) pack->header->n_entries)
+    return -1;
+
+  e = &pack->entries[entry];
+  n_columns = abs (e->columns);
+  if ((status = matrix_create (table, e->rows, n_columns, MATRIX_PACKED)) != 0)
+    return status;
+
+  *rows    = e->rows;
+  *columns = e->columns;
+
+  if (e->kind == PACK_RAW)  {
+    memcpy (table->data, pack->base + e->offset, (size_t) e->rows * n_columns * sizeof(double));
+    return 0;
+  }
+
+  if (e->kind == PACK_PCA)  {
+    if ((status = pack_terms (pack, entry, &terms)) != 0 || terms.rows != e->rows)  {
+      matrix_free (table);
+      return (status != 0 ? status : -1);
+    }
+    for (i=0; i<terms.rows; i++)
+      table->data[i] = pack_terms_value (&terms, i);
+    for (i=0; i<terms.n_exceptions; i++)
+      table->data[terms.index[i]] = terms.values[i];
+    return 0;
+  }
+
+  if (e->offset >= pack->header->n_blocks ||
+      pack->blocks[e->offset].rows != (uint32_t) e->rows)  {
+    matrix_free (table);
+    return -1;
+  }
+  b = &pack->blocks[e->offset];
+  if ((r = (double *) calloc (2 * (size_t) b->rows, sizeof(double))) == NULL)  {
+    matrix_free (table);
+    return ASCII_NO_MEMORY;
+  }
+  rp = r + b->rows;
+
+  record = pack->base + b->offset;
+  for (i=0; i<=e->slot; i++)  {
+    if ((size = log16_record (pack, record - pack->base, b->rows)) == 0 ||
+	decode_node (record, b->rows, i > 0 ? rp : NULL, r,
+		     i == e->slot ? table->data : NULL) == 0)  {
+      status = -1;
+      break;
+    }
+    record += size;
+    tmp = rp;  rp = r;  r = tmp;
+  }
+
+  free (r < rp ? r : rp);
+  if (status != 0)
+    matrix_free (table);
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_terms                                                            */
+/* Description:                                                                    */
+/*  The coefficients and exceptions of a PACK_PCA entry and its basis, pointing    */
+/*  into the pack, so that a caller can work with the coefficients instead of      */
+/*  the decoded spectrum.                                                          */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if the entry is not PACK_PCA or its record does not fit the     */
+/*  pack.                                                                          */
+/***********************************************************************************/
+
+int pack_terms (const TABLE_PACK *pack, int entry, PACK_TERMS *terms)
+{
+  const PACK_ENTRY *e=NULL;
+  const PACK_BLOCK *b=NULL;
+  const unsigned char *record=NULL;
+  uint32_t n_exceptions=0;
+  int i=0;
+
+  if (pack == NULL || entry < 0 || entry >= (int) pack->header->n_entries)
+    return -1;
+
+  e = &pack->entries[entry];
+  if (e->kind != PACK_PCA || e->slot >= pack->header->n_blocks)
+    return -1;
+
+  b = &pack->blocks[e->slot];
+  if (pca_record (pack, e->offset, b->n_nodes) == 0)
+    return -1;
+  record = pack->base + e->offset;
+  memcpy (&n_exceptions, record, sizeof(uint32_t));
+
+  terms->basis_id     = e->slot;
+  terms->rows         = (int) b->rows;
+  terms->n_terms      = (int) b->n_nodes;
+  terms->basis        = (const double *) (pack->base + b->offset);
+  terms->terms        = (const double *) (record + 8);
+  terms->n_exceptions = (int) n_exceptions;
+  terms->values       = terms->terms + terms->n_terms;
+  terms->index        = (const uint16_t *) (terms->values + n_exceptions);
+  for (i=0; i<terms->n_exceptions; i++)
+    if (terms->index[i] >= terms->rows)
+      return -1;
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_span                                                             */
+/* Description:                                                                    */
+/*  The bytes of the pack which pack_read() of an entry reads, apart from the      */
+/*  index and the basis of a PACK_PCA entry: the data of the entry, or the nodes   */
+/*  of its PACK_LOG16 block up to its own.                                         */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int pack_span (const TABLE_PACK *pack, int entry, uint64_t *offset, uint64_t *length)
+{
+  const PACK_ENTRY *e=NULL;
+  const PACK_BLOCK *b=NULL;
+  uint64_t end=0;
+  size_t size=0;
+  int i=0;
+
+  if (pack == NULL || entry < 0 || entry >= (int) pack->header->n_entries)
+    return -1;
+
+  e = &pack->entries[entry];
+  switch (e->kind)  {
+  case PACK_RAW:
+    *offset = e->offset;
+    *length = (uint64_t) e->rows * abs (e->columns) * sizeof(double);
+    return 0;
+  case PACK_PCA:
+    if (e->slot >= pack->header->n_blocks ||
+	(size = pca_record (pack, e->offset, pack->blocks[e->slot].n_nodes)) == 0)
+      return -1;
+    *offset = e->offset;
+    *length = size;
+    return 0;
+  }
+
+  if (e->offset >= pack->header->n_blocks)
+    return -1;
+  b = &pack->blocks[e->offset];
+  for (i=0, end=b->offset; i<=e->slot; i++)  {
+    if ((size = log16_record (pack, end, b->rows)) == 0)
+      return -1;
+    end += size;
+  }
+  *offset = b->offset;
+  *length = end - b->offset;
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_terms_value                                                      */
+/* Description:                                                                    */
+/*  Value of a PACK_PCA spectrum at row from its coefficients; the exceptions are  */
+/*  not looked at.                                                                 */
+/***********************************************************************************/
+
+double pack_terms_value (const PACK_TERMS *terms, int row)
+{
+  double v=0.0;
+  int j=0;
+
+  for (j=0; j<terms->n_terms; j++)
+    v += terms->terms[j] * terms->basis[j * terms->rows + row];
+  return v;
+}
+
+
+
+static int compare_names (const void *a, const void *b)
+{
+  const PACK_FILE *x = *(PACK_FILE * const *) a, *y = *(PACK_FILE * const *) b;
+  return strcmp (x->name, y->name);
+}
+
+
+/* spectra by directory, solar zenith angle, altitude and ozone: PACK_ORDER_OZONE */
+static int compare_nodes (const void *a, const void *b)
+{
+  const PACK_FILE *x = *(PACK_FILE * const *) a, *y = *(PACK_FILE * const *) b;
+
+  if (x->level != y->level)  return x->level - y->level;
+  if (x->sza != y->sza)      return x->sza - y->sza;
+  if (x->alt != y->alt)      return x->alt - y->alt;
+  if (x->rows != y->rows)    return x->rows - y->rows;
+  return x->o3 - y->o3;
+}
+
+
+/* by directory, altitude, ozone and solar zenith angle: PACK_ORDER_SZA */
+static int compare_sza (const void *a, const void *b)
+{
+  const PACK_FILE *x = *(PACK_FILE * const *) a, *y = *(PACK_FILE * const *) b;
+
+  if (x->level != y->level)  return x->level - y->level;
+  if (x->alt != y->alt)      return x->alt - y->alt;
+  if (x->o3 != y->o3)        return x->o3 - y->o3;
+  if (x->rows != y->rows)    return x->rows - y->rows;
+  return x->sza - y->sza;
+}
+
+
+/* by directory, altitude and Z-order of sza and ozone: PACK_ORDER_MORTON */
+static int compare_morton (const void *a, const void *b)
+{
+  const PACK_FILE *x = *(PACK_FILE * const *) a, *y = *(PACK_FILE * const *) b;
+
+  if (x->level != y->level)  return x->level - y->level;
+  if (x->alt != y->alt)      return x->alt - y->alt;
+  if (x->rows != y->rows)    return x->rows - y->rows;
+  return (x->morton > y->morton) - (x->morton < y->morton);
+}
+
+
+/* the spectra of the trace as first accessed, then the others: PACK_ORDER_TRACE */
+static int compare_trace (const void *a, const void *b)
+{
+  const PACK_FILE *x = *(PACK_FILE * const *) a, *y = *(PACK_FILE * const *) b;
+
+  if (x->trace >= 0 && y->trace >= 0)  return x->trace - y->trace;
+  if (x->trace >= 0 || y->trace >= 0)  return (x->trace >= 0 ? -1 : 1);
+  return compare_nodes (a, b);
+}
+
+
+/* spectra by directory, length and order of the pack, for PACK_PCA */
+static int compare_levels (const void *a, const void *b)
+{
+  const PACK_FILE *x = *(PACK_FILE * const *) a, *y = *(PACK_FILE * const *) b;
+
+  if (x->level != y->level)  return x->level - y->level;
+  if (x->rows != y->rows)    return x->rows - y->rows;
+  return x->rank - y->rank;
+}
+
+
+/* y may follow x in its PACK_LOG16 block: along the innermost axis of the */
+/* order, or anywhere along the trace                                      */
+static int same_chain (const PACK_FILE *x, const PACK_FILE *y, int order)
+{
+  if (x->rows != y->rows)
+    return 0;
+
+  switch (order)  {
+  case PACK_ORDER_SZA:
+    return (x->level == y->level && x->alt == y->alt && x->o3 == y->o3);
+  case PACK_ORDER_MORTON:
+    return (x->level == y->level && x->alt == y->alt && (x->morton >> 4) == (y->morton >> 4));
+  case PACK_ORDER_TRACE:
+    if (x->trace >= 0 || y->trace >= 0)
+      return (x->trace >= 0 && y->trace >= 0);
+    break;
+  }
+  return (x->level == y->level && x->sza == y->sza && x->alt == y->alt);
+}
+
+
+/* the blocks of the ordered nodes, of at most PACK_CHAIN nodes along the */
+/* Z-order, a tile of 4 x 4 nodes, and the trace                          */
+static void set_chains (PACK_FILE **nodes, int n_nodes, int order)
+{
+  int i=0, first=0, chain=0, max=0xffff;
+
+  if (order == PACK_ORDER_MORTON || order == PACK_ORDER_TRACE)
+    max = PACK_CHAIN;
+
+  for (i=0; i<n_nodes; i++)  {
+    if (i > 0 && (!same_chain (nodes[first], nodes[i], order) || i - first >= max))  {
+      chain++;
+      first = i;
+    }
+    nodes[i]->chain = chain;
+  }
+}
+
+
+static int compare_ints (const void *a, const void *b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+  return (x > y) - (x < y);
+}
+
+
+/* the distinct values of x, sorted; returns their number */
+static int distinct (int *x, int n)
+{
+  int i=0, m=0;
+
+  qsort (x, n, sizeof(int), compare_ints);
+  for (i=0; i<n; i++)
+    if (m == 0 || x[i] != x[m-1])
+      x[m++] = x[i];
+  return m;
+}
+
+
+/* the bits of a and b interleaved, those of a first */
+static unsigned interleave (unsigned a, unsigned b)
+{
+  unsigned z=0;
+  int k=0;
+
+  for (k=0; k<16; k++)
+    z |= ((a >> k) & 1u) << (2*k + 1) | ((b >> k) & 1u) << (2*k);
+  return z;
+}
+
+
+/* the first access of every spectrum in a trace of table names, one per */
+/* line as written by tablestore_set_trace()                             */
+static int read_trace (const char *trace, PACK_FILE *files, int n_files)
+{
+  PACK_FILE **by_name=NULL, key, *k=&key, **f=NULL;
+  FILE *in=NULL;
+  char line[FILENAME_MAX+256], *name=NULL;
+  int i=0, n=0;
+
+  if ((in = fopen (trace, "r")) == NULL)
+    return -1;
+  if ((by_name = (PACK_FILE **) calloc (n_files, sizeof(PACK_FILE *))) == NULL)  {
+    fclose (in);
+    return ASCII_NO_MEMORY;
+  }
+  for (i=0; i<n_files; i++)
+    by_name[i] = &files[i];
+  qsort (by_name, n_files, sizeof(PACK_FILE *), compare_names);
+
+  while (fgets (line, sizeof(line), in) != NULL)  {
+    line[strcspn (line, "\r\n")] = 0;
+    for (name=line; name[0] == '.' && name[1] == '/'; name+=2)
+      ;
+    key.name = name;
+    f = (PACK_FILE **) bsearch (&k, by_name, n_files, sizeof(PACK_FILE *), compare_names);
+    if (f != NULL && (*f)->spectrum && (*f)->trace < 0)
+      (*f)->trace = n++;
+  }
+
+  fclose (in);
+  free (by_name);
+  return 0;
+}
+
+
+/* sort the spectra into the order of the pack and rank them */
+static int order_spectra (PACK_FILE **nodes, int n_nodes, PACK_FILE *files, int n_files,
+			  int order, const char *trace)
+{
+  int *sza=NULL, *o3=NULL, n_sza=0, n_o3=0, i=0, a=0, b=0, status=0;
+
+  for (i=0; i<n_files; i++)
+    files[i].trace = -1;
+
+  switch (order)  {
+  case PACK_ORDER_OZONE:
+    qsort (nodes, n_nodes, sizeof(PACK_FILE *), compare_nodes);
+    break;
+  case PACK_ORDER_SZA:
+    qsort (nodes, n_nodes, sizeof(PACK_FILE *), compare_sza);
+    break;
+  case PACK_ORDER_MORTON:
+    sza = (int *) calloc (n_nodes + 1, sizeof(int));
+    o3  = (int *) calloc (n_nodes + 1, sizeof(int));
+    if (sza == NULL || o3 == NULL)  {
+      status = ASCII_NO_MEMORY;
+      break;
+    }
+    for (i=0; i<n_nodes; i++)  {
+      sza[i] = nodes[i]->sza;
+      o3[i]  = nodes[i]->o3;
+    }
+    n_sza = distinct (sza, n_nodes);
+    n_o3  = distinct (o3, n_nodes);
+    for (i=0; i<n_nodes; i++)  {
+      a = (int) ((int *) bsearch (&nodes[i]->sza, sza, n_sza, sizeof(int), compare_ints) - sza);
+      b = (int) ((int *) bsearch (&nodes[i]->o3, o3, n_o3, sizeof(int), compare_ints) - o3);
+      nodes[i]->morton = interleave ((unsigned) a, (unsigned) b);
+    }
+    qsort (nodes, n_nodes, sizeof(PACK_FILE *), compare_morton);
+    break;
+  case PACK_ORDER_TRACE:
+    if (trace == NULL || (status = read_trace (trace, files, n_files)) != 0)  {
+      status = (status != 0 ? status : -1);
+      break;
+    }
+    qsort (nodes, n_nodes, sizeof(PACK_FILE *), compare_trace);
+    break;
+  default:
+    status = -1;
+  }
+
+  for (i=0; i<n_nodes; i++)
+    nodes[i]->rank = i;
+  free (sza);
+  free (o3);
+  return status;
+}
+
+
+/* the files of the subdirectories of resources */
+static int scan_tree (const char *resources, PACK_FILE **files, int *n_files, PACK_STATS *stats)
+{
+  struct dirent **dirs=NULL, **names=NULL;
+  struct stat st;
+  char path[FILENAME_MAX+256], name[FILENAME_MAX+256];
+  PACK_FILE *f=NULL, *tmp=NULL;
+  int n_dirs=0, n_names=0, max=0, d=0, i=0, n=0, level=0, status=0;
+  int max_columns=0, min_columns=0;
+
+  if ((n_dirs = scandir (resources, &dirs, NULL, alphasort)) < 0)
+    return -1;
+
+  ASCII_set_resource_path (resources);
+
+  for (d=0; d<n_dirs && status==0; d++)  {
+    snprintf (path, sizeof(path), "%s/%s", resources, dirs[d]->d_name);
+    if (dirs[d]->d_name[0] == '.' || stat (path, &st) != 0 || !S_ISDIR (st.st_mode))
+      continue;
+    if ((n_names = scandir (path, &names, NULL, alphasort)) < 0)
+      continue;
+
+    level = -1;
+    if (stats->n_levels < PACK_MAX_LEVELS)  {
+      level = stats->n_levels++;
+      snprintf (stats->level[level].name, sizeof(stats->level[level].name), "%s",
+		dirs[d]->d_name);
+    }
+
+    for (i=0; i<n_names && status==0; i++)  {
+      snprintf (path, sizeof(path), "%s/%s/%s", resources, dirs[d]->d_name, names[i]->d_name);
+      if (names[i]->d_name[0] == '.' || stat (path, &st) != 0 || !S_ISREG (st.st_mode))
+	continue;
+
+      if (n == max)  {
+	max = (max > 0 ? 2 * max : 1024);
+	if ((tmp = (PACK_FILE *) realloc (*files, max * sizeof(PACK_FILE))) == NULL)  {
+	  status = ASCII_NO_MEMORY;
+	  break;
+	}
+	*files = tmp;
+      }
+      f = &(*files)[n];
+      memset (f, 0, sizeof(PACK_FILE));
+
+      snprintf (name, sizeof(name), "./%s/%s", dirs[d]->d_name, names[i]->d_name);
+      if (ASCII_file2matrix (name, &f->rows, &max_columns, &min_columns, &f->table) != 0 ||
+	  f->rows < 1)  {
+	matrix_free (&f->table);
+	stats->skipped++;
+	continue;
+      }
+      f->columns = (max_columns != min_columns ? -max_columns : min_columns);
+
+      if ((f->name = strdup (name + 2)) == NULL)  {
+	matrix_free (&f->table);
+	status = ASCII_NO_MEMORY;
+	break;
+      }
+      f->level      = level;
+      f->text_bytes = (size_t) st.st_size;
+      f->spectrum   = (f->columns == 1 && f->rows <= 0xffff &&
+		       sscanf (names[i]->d_name, "sza%dozone%dalt%d", &f->sza, &f->o3, &f->alt) == 3);
+      n++;
+    }
+
+    for (i=0; i<n_names; i++)
+      free (names[i]);
+    free (names);
+  }
+
+  for (d=0; d<n_dirs; d++)
+    free (dirs[d]);
+  free (dirs);
+
+  *n_files = n;
+  return status;
+}
+
+
+/* encode the spectra block by block into data, checking every node; a node */
+/* sharing the payload of an earlier one is left out of its block           */
+static int encode_spectra (PACK_FILE **nodes, int n_nodes, PACK_SHARE *share,
+			   PACK_BUFFER *data, PACK_BUFFER *blocks, PACK_STATS *stats)
+{
+  PACK_BLOCK block;
+  PACK_LEVEL *level=NULL;
+  PACK_PAYLOAD *p=NULL;
+  double *r=NULL, *rp=NULL, *exceptions=NULL, *decoded=NULL, *tmp=NULL;
+  double *dr=NULL, *drp=NULL, err=0.0, floor_t=0.0;
+  unsigned long long key=0;
+  int16_t *codes=NULL;
+  uint32_t n_exceptions=0;
+  int rows=0, i=0, k=0, first=0, zero=0, status=0;
+  size_t start=0;
+
+  for (i=0; i<n_nodes; i++)
+    if (nodes[i]->rows > rows)
+      rows = nodes[i]->rows;
+
+  r          = (double *)  calloc (rows, sizeof(double));
+  rp         = (double *)  calloc (rows, sizeof(double));
+  exceptions = (double *)  calloc (rows, sizeof(double));
+  decoded    = (double *)  calloc (rows, sizeof(double));
+  dr         = (double *)  calloc (rows, sizeof(double));
+  drp        = (double *)  calloc (rows, sizeof(double));
+  codes      = (int16_t *) calloc (rows, sizeof(int16_t));
+  if (r == NULL || rp == NULL || exceptions == NULL || decoded == NULL ||
+      dr == NULL || drp == NULL || codes == NULL)
+    status = ASCII_NO_MEMORY;
+
+  for (first=0; first<n_nodes && status==0; first=i)  {
+    memset (&block, 0, sizeof(PACK_BLOCK));
+    block.offset = data->size;
+    block.rows   = (uint32_t) nodes[first]->rows;
+
+    for (i=first; i<n_nodes && nodes[i]->chain == nodes[first]->chain &&
+	   block.n_nodes <= 0xffff && status==0; i++)  {
+      key = spectrum_key (share, nodes[i]->table.data, block.rows, &zero);
+      if ((p = share_find (share, key, nodes[i], nodes[i]->table.data, zero, &err)) != NULL)  {
+	nodes[i]->block = p->file->block;
+	nodes[i]->slot  = p->file->slot;
+	count_shared (stats, nodes[i], p, zero, err);
+	continue;
+      }
+
+      start = data->size;
+      status = encode_node (data, nodes[i]->table.data, block.rows, block.n_nodes > 0 ? rp : NULL,
+			    share->max_error, r, codes, exceptions);
+      if (status != 0)
+	break;
+
+      /* decode it again, as pack_read() will */
+      decode_node (data->data + start, block.rows, block.n_nodes > 0 ? drp : NULL, dr, decoded);
+      level = (nodes[i]->level >= 0 ? &stats->level[nodes[i]->level] : NULL);
+      floor_t = exact_floor (nodes[i]->table.data, block.rows);
+      for (k=0; k<(int) block.rows; k++)  {
+	if (nodes[i]->table.data[k] > floor_t)
+	  err = fabs (decoded[k] - nodes[i]->table.data[k]) / nodes[i]->table.data[k];
+	else
+	  err = (decoded[k] == nodes[i]->table.data[k] ? 0.0 : INFINITY);
+	if (err > stats->max_error)
+	  stats->max_error = err;
+	if (level != NULL && err > level->max_error)
+	  level->max_error = err;
+      }
+      memcpy (&n_exceptions, data->data + start + 16, sizeof(uint32_t));
+      stats->values     += block.rows;
+      stats->exceptions += n_exceptions;
+      stats->payloads++;
+      if (level != NULL)  {
+	level->spectra++;
+	level->packed_bytes += data->size - start;
+      }
+
+      nodes[i]->block = (int) (blocks->size / sizeof(PACK_BLOCK));
+      nodes[i]->slot  = (int) block.n_nodes++;
+      status = share_add (share, key, nodes[i], decoded, data->size - start);
+      tmp = rp;   rp = r;    r = tmp;
+      tmp = drp;  drp = dr;  dr = tmp;
+    }
+
+    if (status == 0 && block.n_nodes > 0)
+      status = put (blocks, &block, sizeof(PACK_BLOCK));
+  }
+
+  free (r);  free (rp);  free (exceptions);
+  free (decoded);  free (dr);  free (drp);  free (codes);
+  return status;
+}
+
+
+
+/* fit the basis of the n spectra of one directory and encode them into data */
+static int encode_level (PACK_FILE **nodes, int n, PACK_SHARE *share,
+			 PACK_BUFFER *data, PACK_BUFFER *blocks, PACK_STATS *stats)
+{
+  PACK_BLOCK block;
+  PACK_TERMS t;
+  PACK_LEVEL *level=NULL;
+  PACK_PAYLOAD *p=NULL;
+  double *x=NULL, *mean=NULL, *weight=NULL, *axes=NULL, *variance=NULL;
+  double *z=NULL, *recon=NULL, *peak=NULL, *basis=NULL, *terms=NULL, *values=NULL;
+  double *decoded=NULL, max_error=share->max_error, v=0.0, y=0.0, err=0.0, floor_t=0.0;
+  unsigned long long key=0;
+  uint16_t *index=NULL;
+  uint32_t header[2]={0,0};
+  size_t *bytes=NULL, start=0;
+  int *fitted=NULL;
+  int rows=nodes[0]->rows, max_terms=0, n_fit=0, n_terms=0, n_exceptions=0;
+  int i=0, j=0, k=0, K=0, zero=0, status=0;
+
+  level = (nodes[0]->level >= 0 ? &stats->level[nodes[0]->level] : NULL);
+  max_terms = (rows < PACK_MAX_TERMS ? rows : PACK_MAX_TERMS);
+
+  x        = (double *)   calloc ((size_t) n * rows, sizeof(double));
+  z        = (double *)   calloc ((size_t) n * max_terms + 1, sizeof(double));
+  recon    = (double *)   calloc ((size_t) n * rows, sizeof(double));
+  peak     = (double *)   calloc (n, sizeof(double));
+  fitted   = (int *)      calloc (n, sizeof(int));
+  mean     = (double *)   calloc (rows, sizeof(double));
+  weight   = (double *)   calloc (rows, sizeof(double));
+  axes     = (double *)   calloc ((size_t) rows * rows, sizeof(double));
+  variance = (double *)   calloc (rows, sizeof(double));
+  basis    = (double *)   calloc ((size_t) (max_terms + 1) * rows, sizeof(double));
+  terms    = (double *)   calloc (max_terms + 1, sizeof(double));
+  values   = (double *)   calloc (rows, sizeof(double));
+  decoded  = (double *)   calloc (rows, sizeof(double));
+  index    = (uint16_t *) calloc (rows, sizeof(uint16_t));
+  bytes    = (size_t *)   calloc (max_terms + 1, sizeof(size_t));
+  if (x == NULL || z == NULL || recon == NULL || peak == NULL || fitted == NULL ||
+      mean == NULL || weight == NULL || axes == NULL || variance == NULL ||
+      basis == NULL || terms == NULL || values == NULL || decoded == NULL ||
+      index == NULL || bytes == NULL)  {
+    status = ASCII_NO_MEMORY;
+    goto cleanup;
+  }
+
+  /* the spectra which are not noise, normalized to their largest value */
+  for (i=0; i<n; i++)  {
+    fitted[i] = 1;
+    for (k=0; k<rows; k++)  {
+      y = nodes[i]->table.data[k];
+      if (!isfinite (y))
+	fitted[i] = 0;
+      else if (fabs (y) > peak[i])
+	peak[i] = fabs (y);
+    }
+    if (!fitted[i] || peak[i] <= 0.0 || peak[i] > PCA_MAX_PEAK)  {
+      fitted[i] = 0;
+      continue;
+    }
+    for (k=0; k<rows; k++)
+      x[n_fit * rows + k] = nodes[i]->table.data[k] / peak[i];
+    n_fit++;
+  }
+
+  if (n_fit > 0)  {
+    if ((status = pca_fit (x, n_fit, rows, mean, weight, axes, variance)) != 0)
+      goto cleanup;
+  }
+  else
+    max_terms = 0;
+
+  /* coefficients of all axes; x is the normalized spectrum again */
+  for (i=0, n_fit=0; i<n; i++)  {
+    if (!fitted[i])
+      continue;
+    for (k=0; k<rows; k++)
+      recon[i*rows + k] = mean[k];
+    for (j=0; j<max_terms; j++)  {
+      v = 0.0;
+      for (k=0; k<rows; k++)
+	v += axes[j*rows + k] * weight[k] * (x[n_fit*rows + k] - mean[k]);
+      z[i*max_terms + j] = v;
+    }
+    n_fit++;
+  }
+
+  /* the size of the pack with the first K axes, adding one axis after the other */
+  for (K=0; K<=max_terms; K++)  {
+    bytes[K] = (size_t) (K + 1) * rows * sizeof(double);
+    for (i=0; i<n; i++)  {
+      n_exceptions = 0;
+      floor_t = exact_floor (nodes[i]->table.data, rows);
+      for (k=0; k<rows; k++)  {
+	y = nodes[i]->table.data[k];
+	v = (fitted[i] ? peak[i] * recon[i*rows + k] : 0.0);
+	if (y <= floor_t ? v != y : !(fabs (v - y) <= max_error * fabs (y)))
+	  n_exceptions++;
+      }
+      bytes[K] += PCA_RECORD_SIZE (K + 1, n_exceptions);
+
+      if (fitted[i] && K < max_terms)
+	for (k=0; k<rows; k++)
+	  recon[i*rows + k] += z[i*max_terms + K] * axes[K*rows + k] / weight[k];
+    }
+  }
+  for (K=0, j=0; j<=max_terms; j++)
+    if (bytes[j] < bytes[K])
+      K = j;
+  n_terms = K + 1;
+
+  /* the basis: the mean and the first K axes, unweighted */
+  for (k=0; k<rows; k++)
+    basis[k] = mean[k];
+  for (j=1; j<n_terms; j++)
+    for (k=0; k<rows; k++)
+      basis[j*rows + k] = axes[(j-1)*rows + k] / weight[k];
+
+  memset (&block, 0, sizeof(PACK_BLOCK));
+  block.offset  = data->size;
+  block.n_nodes = (uint32_t) n_terms;
+  block.rows    = (uint32_t) rows;
+  if ((status = put (data, basis, (size_t) n_terms * rows * sizeof(double))) != 0 ||
+      (status = put (blocks, &block, sizeof(PACK_BLOCK))) != 0)
+    goto cleanup;
+  if (level != NULL)  {
+    level->terms = n_terms;
+    level->packed_bytes += (size_t) n_terms * rows * sizeof(double);
+  }
+
+  memset (&t, 0, sizeof(PACK_TERMS));
+  t.rows    = rows;
+  t.n_terms = n_terms;
+  t.basis   = basis;
+  t.terms   = terms;
+
+  for (i=0; i<n && status==0; i++)  {
+    key = spectrum_key (share, nodes[i]->table.data, rows, &zero);
+    if ((p = share_find (share, key, nodes[i], nodes[i]->table.data, zero, &err)) != NULL)  {
+      nodes[i]->block  = p->file->block;
+      nodes[i]->offset = p->file->offset;
+      count_shared (stats, nodes[i], p, zero, err);
+      continue;
+    }
+
+    terms[0] = (fitted[i] ? peak[i] : 0.0);
+    for (j=1; j<n_terms; j++)
+      terms[j] = (fitted[i] ? peak[i] * z[i*max_terms + j-1] : 0.0);
+
+    /* decode as pack_read() will, keeping what is off or below the floor */
+    n_exceptions = 0;
+    floor_t = exact_floor (nodes[i]->table.data, rows);
+    for (k=0; k<rows; k++)  {
+      y = nodes[i]->table.data[k];
+      v = pack_terms_value (&t, k);
+      if (y <= floor_t ? v != y : !(fabs (v - y) <= max_error * fabs (y)))  {
+	values[n_exceptions]  = y;
+	index[n_exceptions++] = (uint16_t) k;
+	v = y;
+      }
+      decoded[k] = v;
+      if (y > floor_t)
+	err = fabs (v - y) / fabs (y);
+      else
+	err = (v == y ? 0.0 : INFINITY);
+      if (err > stats->max_error)
+	stats->max_error = err;
+      if (level != NULL && err > level->max_error)
+	level->max_error = err;
+    }
+
+    start = data->size;
+    header[0] = (uint32_t) n_exceptions;
+    if ((status = put (data, header, sizeof(header))) != 0 ||
+	(status = put (data, terms, (size_t) n_terms * sizeof(double))) != 0 ||
+	(status = put (data, values, (size_t) n_exceptions * sizeof(double))) != 0 ||
+	(status = put (data, index, (size_t) n_exceptions * sizeof(uint16_t))) != 0 ||
+	(status = pad8 (data)) != 0)
+      break;
+
+    nodes[i]->block  = (int) (blocks->size / sizeof(PACK_BLOCK)) - 1;
+    nodes[i]->offset = start;
+    stats->values     += rows;
+    stats->exceptions += n_exceptions;
+    stats->payloads++;
+    if (level != NULL)  {
+      level->spectra++;
+      level->packed_bytes += data->size - start;
+    }
+    status = share_add (share, key, nodes[i], decoded, data->size - start);
+  }
+
+ cleanup:
+  free (x);  free (z);  free (recon);  free (peak);  free (fitted);
+  free (mean);  free (weight);  free (axes);  free (variance);
+  free (basis);  free (terms);  free (values);  free (decoded);  free (index);  free (bytes);
+  return status;
+}
+
+
+/* encode the spectra directory by directory into data */
+static int encode_pca (PACK_FILE **nodes, int n_nodes, PACK_SHARE *share,
+		       PACK_BUFFER *data, PACK_BUFFER *blocks, PACK_STATS *stats)
+{
+  int first=0, i=0, status=0;
+
+  for (first=0; first<n_nodes && status==0; first=i)  {
+    for (i=first; i<n_nodes && nodes[i]->level == nodes[first]->level &&
+	   nodes[i]->rows == nodes[first]->rows; i++)
+      ;
+    if (blocks->size / sizeof(PACK_BLOCK) >= 0xffff)
+      return -1;
+    status = encode_level (nodes + first, i - first, share, data, blocks, stats);
+  }
+
+  return status;
+}
+
+
+/***********************************************************************************/
+/* Function: pack_build                                                            */
+/* Description:                                                                    */
+/*  Pack all table files in the subdirectories of a Resources tree, with the       */
+/*  transmittances stored as kind (PACK_LOG16 or PACK_PCA) with a relative error   */
+/*  of at most max_error (PACK_MAX_ERROR or PACK_PCA_ERROR if <= 0), in the        */
+/*  default order; see pack_run().                                                 */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int pack_build (const char *resources, const char *output, int kind, double max_error,
+		PACK_STATS *stats)
+{
+  PACK_SPEC spec;
+
+  pack_spec_init (&spec);
+  spec.resources = resources;
+  spec.output    = output;
+  spec.kind      = kind;
+  spec.max_error = max_error;
+  return pack_run (&spec, stats);
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_spec_init                                                        */
+/* Description:                                                                    */
+/*  Set a spec to PACK_LOG16 with the default error and order, no zero floor.      */
+/***********************************************************************************/
+
+void pack_spec_init (PACK_SPEC *spec)
+{
+  memset (spec, 0, sizeof(PACK_SPEC));
+  spec->kind  = PACK_LOG16;
+  spec->order = PACK_ORDER_OZONE;
+}
+
+
+
+/***********************************************************************************/
+/* Function: pack_run                                                              */
+/* Description:                                                                    */
+/*  Pack all table files in the subdirectories of spec->resources into             */
+/*  spec->output. Every spectrum is decoded again after encoding and compared      */
+/*  with its file; the sizes and the largest relative error per directory are      */
+/*  returned in stats. Equal tables share their payload, see pack.h; spectra       */
+/*  whose largest absolute value is below spec->zero_floor share that of the       */
+/*  first of them, their largest absolute error is returned in stats->zero_error   */
+/*  and is not part of stats->max_error.                                           */
+/*  Sets the resource path of ascii.c to spec->resources.                          */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error, also if the trace of PACK_ORDER_TRACE cannot be read. */
+/***********************************************************************************/
+
+int pack_run (const PACK_SPEC *spec, PACK_STATS *stats)
+{
+  PACK_STATS local;
+  PACK_HEADER header;
+  PACK_ENTRY entry;
+  PACK_BUFFER data, blocks, entries, names;
+  PACK_FILE *files=NULL, **order=NULL;
+  PACK_SHARE share;
+  PACK_PAYLOAD *p=NULL;
+  FILE *f=NULL;
+  unsigned long long key=0;
+  size_t bytes=0, base=0;
+  double max_error=spec->max_error;
+  int kind=spec->kind, n_files=0, n_nodes=0, i=0, status=0;
+
+  if (stats == NULL)
+    stats = &local;
+  if (kind != PACK_LOG16 && kind != PACK_PCA)
+    return -1;
+  if (max_error <= 0.0)
+    max_error = (kind == PACK_PCA ? PACK_PCA_ERROR : PACK_MAX_ERROR);
+  memset (stats, 0, sizeof(PACK_STATS));
+  memset (&data, 0, sizeof(PACK_BUFFER));
+  memset (&blocks, 0, sizeof(PACK_BUFFER));
+  memset (&entries, 0, sizeof(PACK_BUFFER));
+  memset (&names, 0, sizeof(PACK_BUFFER));
+  memset (&share, 0, sizeof(PACK_SHARE));
+
+  if ((status = scan_tree (spec->resources, &files, &n_files, stats)) != 0 || n_files == 0)  {
+    if (status == 0)
+      status = -1;
+    goto cleanup;
+  }
+
+  if ((order = (PACK_FILE **) calloc (n_files, sizeof(PACK_FILE *))) == NULL ||
+      share_init (&share, n_files, max_error, spec->zero_floor) != 0)  {
+    status = ASCII_NO_MEMORY;
+    goto cleanup;
+  }
+
+  /* the header is written last, the data follows it */
+  if ((status = put (&data, NULL, ALIGN8 (sizeof(PACK_HEADER)))) != 0)
+    goto cleanup;
+
+  /* spectra in blocks, in the order of the spec */
+  for (i=0, n_nodes=0; i<n_files; i++)
+    if (files[i].spectrum)
+      order[n_nodes++] = &files[i];
+  if ((status = order_spectra (order, n_nodes, files, n_files, spec->order, spec->trace)) != 0)
+    goto cleanup;
+  if (kind == PACK_PCA)  {
+    qsort (order, n_nodes, sizeof(PACK_FILE *), compare_levels);
+    status = encode_pca (order, n_nodes, &share, &data, &blocks, stats);
+  }
+  else  {
+    set_chains (order, n_nodes, spec->order);
+    status = encode_spectra (order, n_nodes, &share, &data, &blocks, stats);
+  }
+  if (status != 0)
+    goto cleanup;
+
+  /* all other tables as they are */
+  for (i=0; i<n_files && status==0; i++)  {
+    if (files[i].spectrum)
+      continue;
+    bytes = (size_t) files[i].rows * abs (files[i].columns) * sizeof(double);
+    key = table_key (&files[i]);
+    if ((p = share_find (&share, key, &files[i], NULL, 0, NULL)) != NULL)  {
+      files[i].offset = p->file->offset;
+      stats->shared_tables++;
+      stats->shared_bytes += bytes;
+      if (files[i].level >= 0)
+	stats->level[files[i].level].shared++;
+      continue;
+    }
+    files[i].offset = data.size;
+    if ((status = put (&data, files[i].table.data, bytes)) == 0)
+      status = share_add (&share, key, &files[i], NULL, bytes);
+    stats->payloads++;
+    if (files[i].level >= 0)
+      stats->level[files[i].level].packed_bytes += bytes;
+  }
+  if (status != 0 || (status = pad8 (&data)) != 0)
+    goto cleanup;
+
+  /* entries sorted by name */
+  for (i=0; i<n_files; i++)
+    order[i] = &files[i];
+  qsort (order, n_files, sizeof(PACK_FILE *), compare_names);
+
+  base = data.size + blocks.size;
+  for (i=0; i<n_files && status==0; i++)  {
+    memset (&entry, 0, sizeof(PACK_ENTRY));
+    entry.name    = (uint32_t) names.size;
+    entry.kind    = (uint16_t) (order[i]->spectrum ? kind : PACK_RAW);
+    entry.rows    = order[i]->rows;
+    entry.columns = order[i]->columns;
+    entry.offset  = order[i]->offset;
+    if (order[i]->spectrum && kind == PACK_LOG16)  {
+      entry.slot   = (uint16_t) order[i]->slot;
+      entry.offset = (uint64_t) order[i]->block;
+    }
+    else if (order[i]->spectrum)
+      entry.slot   = (uint16_t) order[i]->block;
+    if ((status = put (&entries, &entry, sizeof(PACK_ENTRY))) == 0)
+      status = put (&names, order[i]->name, strlen (order[i]->name) + 1);
+
+    if (order[i]->level >= 0)  {
+      stats->level[order[i]->level].files++;
+      stats->level[order[i]->level].text_bytes   += order[i]->text_bytes;
+      stats->level[order[i]->level].packed_bytes += sizeof(PACK_ENTRY) + strlen (order[i]->name) + 1;
+    }
+    stats->files++;
+    stats->text_bytes += order[i]->text_bytes;
+  }
+  if (status != 0)
+    goto cleanup;
+
+  memset (&header, 0, sizeof(PACK_HEADER));
+  memcpy (header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+  header.version    = PACK_VERSION;
+  header.byte_order = PACK_BYTE_ORDER;
+  header.n_entries  = (uint32_t) n_files;
+  header.n_blocks   = (uint32_t) (blocks.size / sizeof(PACK_BLOCK));
+  header.blocks     = data.size;
+  header.entries    = base;
+  header.names      = base + entries.size;
+  header.size       = header.names + names.size;
+  memcpy (data.data, &header, sizeof(PACK_HEADER));
+  stats->size = (size_t) header.size;
+
+  if ((f = fopen (spec->output, "wb")) == NULL ||
+      fwrite (data.data, 1, data.size, f) != data.size ||
+      fwrite (blocks.data, 1, blocks.size, f) != blocks.size ||
+      fwrite (entries.data, 1, entries.size, f) != entries.size ||
+      fwrite (names.data, 1, names.size, f) != names.size)
+    status = -1;
+  if (f != NULL && fclose (f) != 0)
+    status = -1;
+
+ cleanup:
+  for (i=0; i<n_files; i++)  {
+    matrix_free (&files[i].table);
+    free (files[i].name);
+  }
+  free (files);
+  free (order);
+  share_free (&share);
+  free (data.data);
+  free (blocks.data);
+  free (entries.data);
+  free (names.data);
+  return status;
+}
@@ -0,0 +1,180 @@
+/************************************************************************/
+/* pca.c                                                                */
+/*                                                                      */
+/* Principal components of a set of spectra, see pca.h.                 */
+/*                                                                      */
+/* The spectra are centred on their mean and every wavelength is        */
+/* weighted by the inverse of its root mean square, so that the small   */
+/* transmittances of the ultraviolet count as much as those of the      */
+/* visible. The axes are the eigenvectors of the covariance of the      */
+/* weighted spectra, found by cyclic Jacobi rotations, which is fast    */
+/* enough for the about hundred wavelengths of a table.                 */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pca.h"
+#include "ascii.h"
+
+
+#define PCA_MAX_SWEEPS 64
+
+
+/***********************************************************************************/
+/* Function: pca_eigen                                                             */
+/* Description:                                                                    */
+/*  Eigenvalues and eigenvectors of the symmetric n x n matrix a (row major),      */
+/*  which is destroyed. The values are sorted in descending order, and row i of    */
+/*  vectors is the normalized eigenvector of values[i].                            */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if out of memory or not converged.                              */
+/***********************************************************************************/
+
+int pca_eigen (double *a, int n, double *values, double *vectors)
+{
+  double *v=NULL, off=0.0, norm=0.0, theta=0.0, t=0.0, c=0.0, s=0.0;
+  double apq=0.0, x=0.0, y=0.0;
+  int *order=NULL, sweep=0, p=0, q=0, k=0, i=0, j=0, tmp=0;
+
+  if ((v = (double *) calloc ((size_t) n * n, sizeof(double))) == NULL ||
+      (order = (int *) calloc (n, sizeof(int))) == NULL)  {
+    free (v);
+    return ASCII_NO_MEMORY;
+  }
+
+  for (i=0; i<n; i++)
+    v[i*n + i] = 1.0;
+
+  for (i=0; i<n*n; i++)
+    norm += a[i] * a[i];
+
+  for (sweep=0; sweep<PCA_MAX_SWEEPS; sweep++)  {
+    off = 0.0;
+    for (p=0; p<n; p++)
+      for (q=p+1; q<n; q++)
+	off += a[p*n + q] * a[p*n + q];
+    if (off <= 1e-30 * norm)
+      break;
+
+    for (p=0; p<n; p++)
+      for (q=p+1; q<n; q++)  {
+	if ((apq = a[p*n + q]) == 0.0)
+	  continue;
+
+	/* the rotation zeroing a[p][q] */
+	theta = (a[q*n + q] - a[p*n + p]) / (2.0 * apq);
+	t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs (theta) + sqrt (theta * theta + 1.0));
+	c = 1.0 / sqrt (t * t + 1.0);
+	s = t * c;
+
+	for (k=0; k<n; k++)  {
+	  x = a[k*n + p];
+	  y = a[k*n + q];
+	  a[k*n + p] = c * x - s * y;
+	  a[k*n + q] = s * x + c * y;
+	}
+	for (k=0; k<n; k++)  {
+	  x = a[p*n + k];
+	  y = a[q*n + k];
+	  a[p*n + k] = c * x - s * y;
+	  a[q*n + k] = s * x + c * y;
+	}
+	for (k=0; k<n; k++)  {
+	  x = v[k*n + p];
+	  y = v[k*n + q];
+	  v[k*n + p] = c * x - s * y;
+	  v[k*n + q] = s * x + c * y;
+	}
+      }
+  }
+
+  /* sort by descending eigenvalue */
+  for (i=0; i<n; i++)
+    order[i] = i;
+  for (i=0; i<n; i++)
+    for (j=i+1; j<n; j++)
+      if (a[order[j]*n + order[j]] > a[order[i]*n + order[i]])  {
+	tmp = order[i];
+	order[i] = order[j];
+	order[j] = tmp;
+      }
+
+  for (i=0; i<n; i++)  {
+    values[i] = a[order[i]*n + order[i]];
+    for (k=0; k<n; k++)
+      vectors[i*n + k] = v[k*n + order[i]];
+  }
+
+  free (v);
+  free (order);
+  return (sweep < PCA_MAX_SWEEPS ? 0 : -1);
+}
+
+
+
+/***********************************************************************************/
+/* Function: pca_fit                                                               */
+/* Description:                                                                    */
+/*  Principal components of n spectra of rows values each (row major in x).        */
+/*  A spectrum is approximated by the first K axes as                              */
+/*                                                                                 */
+/*    x[k] = mean[k] + sum_j z[j] * axes[j*rows + k] / weight[k],                  */
+/*                                                                                 */
+/*    z[j] = sum_k axes[j*rows + k] * weight[k] * (x[k] - mean[k]),                */
+/*                                                                                 */
+/*  with variance[j] the mean square of z[j] over the spectra.                     */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int pca_fit (const double *x, int n, int rows, double *mean, double *weight,
+	     double *axes, double *variance)
+{
+  double *cov=NULL, *z=NULL;
+  int i=0, k=0, l=0, status=0;
+
+  if (n < 1 || rows < 1)
+    return -1;
+
+  if ((cov = (double *) calloc ((size_t) rows * rows, sizeof(double))) == NULL ||
+      (z = (double *) calloc (rows, sizeof(double))) == NULL)  {
+    free (cov);
+    return ASCII_NO_MEMORY;
+  }
+
+  memset (mean, 0, rows * sizeof(double));
+  memset (weight, 0, rows * sizeof(double));
+  for (i=0; i<n; i++)
+    for (k=0; k<rows; k++)  {
+      mean[k]   += x[i*rows + k];
+      weight[k] += x[i*rows + k] * x[i*rows + k];
+    }
+  for (k=0; k<rows; k++)  {
+    mean[k] /= n;
+    weight[k] = (weight[k] > 0.0 ? 1.0 / sqrt (weight[k] / n) : 1.0);
+  }
+
+  for (i=0; i<n; i++)  {
+    for (k=0; k<rows; k++)
+      z[k] = (x[i*rows + k] - mean[k]) * weight[k];
+    for (k=0; k<rows; k++)
+      for (l=k; l<rows; l++)
+	cov[k*rows + l] += z[k] * z[l];
+  }
+  for (k=0; k<rows; k++)
+    for (l=k; l<rows; l++)  {
+      cov[k*rows + l] /= n;
+      cov[l*rows + k] = cov[k*rows + l];
+    }
+
+  status = pca_eigen (cov, rows, variance, axes);
+
+  free (cov);
+  free (z);
+  return status;
+}
@@ -0,0 +1,285 @@
+/************************************************************************/
+/* reduced.c                                                            */
+/*                                                                      */
+/* Tables reduced to the solar zenith angle, see reduced.h; they are    */
+/* made by fastrt_reduce() in fastrt_.c, which reads the tables.        */
+/*                                                                      */
+/* A stored table is a REDUCED_HEADER followed by the doubles of the    */
+/* sza nodes, the coefficient sza nodes, the wavelengths, the values    */
+/* and the aerosol factors, in that order.                              */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reduced.h"
+#include "ascii.h"
+#include "numeric.h"
+#include "spl.h"
+
+
+static int copy_axis (TABLE_AXIS *copy, const TABLE_AXIS *axis)
+{
+  copy->n = 0;
+  copy->x = NULL;
+  if (axis == NULL || axis->n < 1)
+    return 0;
+  if ((copy->x = (double *) calloc (axis->n, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  memcpy (copy->x, axis->x, axis->n * sizeof(double));
+  copy->n = axis->n;
+  return 0;
+}
+
+
+static int read_doubles (FILE *f, double *x, size_t n)
+{
+  return (fread (x, sizeof(double), n, f) == n ? 0 : -1);
+}
+
+
+static int write_doubles (FILE *f, const double *x, size_t n)
+{
+  return (fwrite (x, sizeof(double), n, f) == n ? 0 : -1);
+}
+
+
+
+/***********************************************************************************/
+/* Function: reduced_create                                                        */
+/* Description:                                                                    */
+/*  Allocate a table over copies of the sza nodes, with aerosol factors at the     */
+/*  nodes coeff_sza unless NULL, for n_layers and the wavelengths lambda. The      */
+/*  values are NaN, the aerosol factors 1; the points are those of a spline and    */
+/*  the range is unset.                                                            */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int reduced_create (REDUCED_TABLE *table, const TABLE_AXIS *sza, const TABLE_AXIS *coeff_sza,
+		    int n_layers, const double *lambda, int n_lambda)
+{
+  size_t n_values=0, n_aerosol=0, i=0;
+
+  memset (table, 0, sizeof(REDUCED_TABLE));
+  if (sza == NULL || sza->n < 1 || n_layers < 1 || n_lambda < 1)
+    return -1;
+
+  table->points   = TABLEGRID_CUBIC;
+  table->n_layers = n_layers;
+  table->n_lambda = n_lambda;
+
+  if (copy_axis (&table->sza, sza) != 0 || copy_axis (&table->coeff_sza, coeff_sza) != 0)  {
+    reduced_free (table);
+    return ASCII_NO_MEMORY;
+  }
+
+  n_values  = (size_t) n_layers * sza->n * n_lambda;
+  n_aerosol = (size_t) table->coeff_sza.n * n_layers * n_lambda;
+
+  table->lambda  = (double *) calloc (n_lambda, sizeof(double));
+  table->values  = (double *) calloc (n_values, sizeof(double));
+  table->aerosol = (double *) calloc (n_aerosol > 0 ? n_aerosol : 1, sizeof(double));
+  if (table->lambda == NULL || table->values == NULL || table->aerosol == NULL)  {
+    reduced_free (table);
+    return ASCII_NO_MEMORY;
+  }
+
+  memcpy (table->lambda, lambda, n_lambda * sizeof(double));
+  for (i=0; i<n_values; i++)
+    table->values[i] = NaN;
+  for (i=0; i<n_aerosol; i++)
+    table->aerosol[i] = 1.0;
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: reduced_free                                                          */
+/* Description:                                                                    */
+/*  Free the arrays of a table made by reduced_create() or reduced_read().         */
+/***********************************************************************************/
+
+void reduced_free (REDUCED_TABLE *table)
+{
+  free (table->sza.x);
+  free (table->coeff_sza.x);
+  free (table->lambda);
+  free (table->values);
+  free (table->aerosol);
+  memset (table, 0, sizeof(REDUCED_TABLE));
+}
+
+
+
+/***********************************************************************************/
+/* Function: reduced_eval                                                          */
+/* Description:                                                                    */
+/*  The doserates at the wavelengths of the table for the solar zenith angle sza:  */
+/*  per layer the spline through the values at the sza neighbours of              */
+/*  fastrt_compute(), times the aerosol factor of the coefficient node nearest to  */
+/*  sza, summed over the layers.                                                   */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error, or the status of the splines, 10 if the spline        */
+/*  values run away towards sunset, as fastrt_compute().                           */
+/***********************************************************************************/
+
+int reduced_eval (const REDUCED_TABLE *table, double sza, double *doserates)
+{
+  double nodes[4], x[4], y[4]={0.0,0.0,0.0,0.0}, a0[4], a1[4], a2[4], a3[4];
+  double work[SPLINE_WORK(4)], ynew=0.0, sum=0.0, value=0.0;
+  const double *aerosol=NULL;
+  int index[4], i=0, k=0, l=0, n=0, status_c=0, status_v=0;
+  size_t layer=0;
+
+  if (table->range.set && (sza < table->range.min || sza > table->range.max))  {
+    fprintf (stderr, "error: sza %f outside the range %g to %g of the tables\n",
+	     sza, table->range.min, table->range.max);
+    return -1;
+  }
+
+  tablegrid_neighbours (&table->sza, sza, 1, table->points, nodes, index);
+  if (table->coeff_sza.n > 0)
+    aerosol = table->aerosol + (size_t) tablegrid_nearest (&table->coeff_sza, sza) *
+      table->n_layers * table->n_lambda;
+
+  layer = (size_t) table->sza.n * table->n_lambda;
+  for (k=0; k<table->n_lambda; k++)  {
+    sum = 0.0;
+    for (l=0; l<table->n_layers; l++)  {
+      n = 0;
+      for (i=0; i<table->points; i++)  {
+	if (index[i] < 0)
+	  continue;
+	value = table->values[l * layer + (size_t) index[i] * table->n_lambda + k];
+	if (value != NaN)  {
+	  x[n] = nodes[i];
+	  y[n] = value;
+	  n++;
+	}
+      }
+
+      status_c = spline_coeffc_buffer (x, y, n, a0, a1, a2, a3, work);
+      status_v = calc_splined_value (sza, &ynew, x, n, a0, a1, a2, a3);
+      if (status_c != 0 || status_v != 0)  {
+	fprintf (stderr, "sorry cannot do spline interpolation\n");
+	fprintf (stderr, "spline_coeffc() returned status_c status_v %d %d \n", status_c, status_v);
+	return (status_c != 0 ? status_c : status_v);
+      }
+
+      if (aerosol != NULL)
+	ynew *= aerosol[l * table->n_lambda + k];
+      sum += ynew;
+    }
+    doserates[k] = sum;
+  }
+
+  if (y[3] > 99999)
+    return 10;
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: reduced_write                                                         */
+/* Description:                                                                    */
+/*  Write the table to f, see above.                                               */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int reduced_write (const REDUCED_TABLE *table, FILE *f)
+{
+  REDUCED_HEADER header;
+  size_t n_values=0, n_aerosol=0;
+
+  memset (&header, 0, sizeof(REDUCED_HEADER));
+  memcpy (header.magic, REDUCED_MAGIC, sizeof(REDUCED_MAGIC));
+  header.version    = REDUCED_VERSION;
+  header.byte_order = REDUCED_BYTE_ORDER;
+  header.points     = table->points;
+  header.n_sza      = table->sza.n;
+  header.n_coeff    = table->coeff_sza.n;
+  header.n_layers   = table->n_layers;
+  header.n_lambda   = table->n_lambda;
+  header.range_set  = table->range.set;
+  header.range_min  = table->range.min;
+  header.range_max  = table->range.max;
+
+  n_values  = (size_t) table->n_layers * table->sza.n * table->n_lambda;
+  n_aerosol = (size_t) table->coeff_sza.n * table->n_layers * table->n_lambda;
+
+  if (fwrite (&header, sizeof(REDUCED_HEADER), 1, f) != 1 ||
+      write_doubles (f, table->sza.x, table->sza.n) != 0 ||
+      write_doubles (f, table->coeff_sza.x, table->coeff_sza.n) != 0 ||
+      write_doubles (f, table->lambda, table->n_lambda) != 0 ||
+      write_doubles (f, table->values, n_values) != 0 ||
+      write_doubles (f, table->aerosol, n_aerosol) != 0)
+    return -1;
+  return (fflush (f) == 0 ? 0 : -1);
+}
+
+
+
+/***********************************************************************************/
+/* Function: reduced_read                                                          */
+/* Description:                                                                    */
+/*  Read a table written by reduced_write() from f; free it with reduced_free().   */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error, also for a table of another version or byte order.    */
+/***********************************************************************************/
+
+int reduced_read (FILE *f, REDUCED_TABLE *table)
+{
+  REDUCED_HEADER header;
+  size_t n_values=0, n_aerosol=0;
+
+  memset (table, 0, sizeof(REDUCED_TABLE));
+  if (fread (&header, sizeof(REDUCED_HEADER), 1, f) != 1 ||
+      memcmp (header.magic, REDUCED_MAGIC, sizeof(REDUCED_MAGIC)) != 0 ||
+      header.version != REDUCED_VERSION || header.byte_order != REDUCED_BYTE_ORDER ||
+      (header.points != TABLEGRID_CUBIC && header.points != TABLEGRID_LINEAR) ||
+      header.n_sza < 1 || header.n_coeff < 0 || header.n_layers < 1 || header.n_lambda < 1)
+    return -1;
+
+  table->points      = header.points;
+  table->sza.n       = header.n_sza;
+  table->coeff_sza.n = header.n_coeff;
+  table->n_layers    = header.n_layers;
+  table->n_lambda    = header.n_lambda;
+  table->range.set   = header.range_set;
+  table->range.min   = header.range_min;
+  table->range.max   = header.range_max;
+
+  n_values  = (size_t) header.n_layers * header.n_sza * header.n_lambda;
+  n_aerosol = (size_t) header.n_coeff * header.n_layers * header.n_lambda;
+
+  table->sza.x       = (double *) calloc (header.n_sza, sizeof(double));
+  table->coeff_sza.x = (double *) calloc (header.n_coeff > 0 ? header.n_coeff : 1, sizeof(double));
+  table->lambda      = (double *) calloc (header.n_lambda, sizeof(double));
+  table->values      = (double *) calloc (n_values, sizeof(double));
+  table->aerosol     = (double *) calloc (n_aerosol > 0 ? n_aerosol : 1, sizeof(double));
+  if (table->sza.x == NULL || table->coeff_sza.x == NULL || table->lambda == NULL ||
+      table->values == NULL || table->aerosol == NULL)  {
+    reduced_free (table);
+    return ASCII_NO_MEMORY;
+  }
+
+  if (read_doubles (f, table->sza.x, table->sza.n) != 0 ||
+      read_doubles (f, table->coeff_sza.x, table->coeff_sza.n) != 0 ||
+      read_doubles (f, table->lambda, table->n_lambda) != 0 ||
+      read_doubles (f, table->values, n_values) != 0 ||
+      read_doubles (f, table->aerosol, n_aerosol) != 0)  {
+    reduced_free (table);
+    return -1;
+  }
+  return 0;
+}
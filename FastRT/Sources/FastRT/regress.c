@@ -453,6 +453,46 @@ int parabolafit (double *x, double *y, long number,
 
 
 
+/*****************************************************************/
+/* fit parabolas  a0 + a1*x + a2*x^2  with a given a0 to n_sets  */
+/* sets of data points y[set*number+i] on the same points x[i];  */
+/* the normal equations are the same for all sets and solved     */
+/* once; a1 and a2 have n_sets elements                          */
+/*****************************************************************/
+
+int parabolafit_fixed (double *x, double *y, long number, long n_sets,
+		       double a0, double *a1, double *a2)
+{
+  double s2=0, s3=0, s4=0, b1=0, b2=0, det=0, d=0;
+  long i=0, set=0;
+
+  for (i=0; i<number; i++)  {
+    s2 += (x[i] * x[i]);
+    s3 += (x[i] * x[i] * x[i]);
+    s4 += (x[i] * x[i] * x[i] * x[i]);
+  }
+
+  det = s2 * s4 - s3 * s3;
+  if (number < 2 || det <= 1e-12 * s2 * s4)
+    return FIT_NOT_POSSIBLE;
+
+  for (set=0; set<n_sets; set++)  {
+    b1 = 0;
+    b2 = 0;
+    for (i=0; i<number; i++)  {
+      d = y[set*number + i] - a0;
+      b1 += (d * x[i]);
+      b2 += (d * x[i] * x[i]);
+    }
+    a1[set] = (s4 * b1 - s3 * b2) / det;
+    a2[set] = (s2 * b2 - s3 * b1) / det;
+  }
+
+  return 0;
+}
+
+
+
 /***********************************************************/
 /* fit a cubic  a0 + a1*x + a2*x^2 + a3*x^3 to data points */ 
 /***********************************************************/
@@ -0,0 +1,474 @@
+/************************************************************************/
+/* server.c                                                             */
+/*                                                                      */
+/* Dose queries answered from a warm engine over a Unix domain socket,  */
+/* see server.h.                                                        */
+/*                                                                      */
+/* The main thread accepts connections and starts a detached thread for */
+/* each. A connection thread reads whatever the client has sent,        */
+/* answers every complete request in it and writes the replies in one   */
+/* go, so that pipelined requests cost one read and one write per       */
+/* batch. All threads poll with a timeout, so that they notice the stop */
+/* flag; server_run() returns after the last connection has ended.      */
+/*                                                                      */
+/************************************************************************/
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "dose.h"
+#include "FastRT.h"
+
+
+#define SERVER_POLL_MS       200
+#define SERVER_PIPELINE      64          /* requests read at once           */
+#define SERVER_FLUSH         65536       /* bytes of replies written at once */
+
+/* the stop flag is set by a signal handler or by another thread */
+#define STOPPED(spec)        __atomic_load_n ((spec)->stop, __ATOMIC_RELAXED)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL         0           /* SO_NOSIGPIPE is set instead     */
+#endif
+
+
+typedef struct {
+  FASTRT_ENGINE     *engine;
+  const SERVER_SPEC *spec;
+  pthread_mutex_t    lock;
+  pthread_cond_t     done;
+  int                active;             /* connection threads running      */
+  SERVER_STATS       stats;
+} SERVER;
+
+typedef struct {
+  SERVER *server;
+  int     fd;
+} CONNECTION;
+
+
+static int write_all (int fd, const void *buffer, size_t size)
+{
+  const char *p = (const char *) buffer;
+  ssize_t n=0;
+
+  while (size > 0)  {
+    if ((n = send (fd, p, size, MSG_NOSIGNAL)) < 0)  {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    p    += n;
+    size -= n;
+  }
+  return 0;
+}
+
+
+static int read_all (int fd, void *buffer, size_t size)
+{
+  char *p = (char *) buffer;
+  ssize_t n=0;
+
+  while (size > 0)  {
+    if ((n = read (fd, p, size)) <= 0)  {
+      if (n < 0 && errno == EINTR)
+	continue;
+      return -1;
+    }
+    p    += n;
+    size -= n;
+  }
+  return 0;
+}
+
+
+static void no_sigpipe (int fd)
+{
+#ifdef SO_NOSIGPIPE
+  int on=1;
+  setsockopt (fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+  (void) fd;
+#endif
+}
+
+
+/* irradiances at 290-400 nm, zero at night; returns the status of run_fastrt() */
+static int spectrum (FASTRT_ENGINE *engine, const SERVER_REQUEST *request, int seconds,
+		     double *doserates)
+{
+  int status=0;
+
+  memset (doserates, 0, DOSE_N_LAMBDA * sizeof(double));
+  status = run_fastrt_with_engine (engine, doserates, DOSE_LAMBDA_START, DOSE_LAMBDA_END, 1.0,
+				   request->day, request->latitude, request->longitude,
+				   request->altitude, seconds, request->sky, true);
+  if (status != 0)
+    memset (doserates, 0, DOSE_N_LAMBDA * sizeof(double));
+  return status;
+}
+
+
+/* dose rates of action in the steps of the day, from midnight */
+static int day_rates (FASTRT_ENGINE *engine, const SERVER_REQUEST *request, int step,
+		      int action, double *rates)
+{
+  double doserates[DOSE_N_LAMBDA];
+  int t=0, i=0, status=0;
+
+  for (t=0, i=0; t<86400; t+=step, i++)  {
+    if ((status = spectrum (engine, request, t + step/2, doserates)) < 0)
+      return status;
+    rates[i] = dose_rate (doserates, action);
+  }
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: server_evaluate                                                       */
+/* Description:                                                                    */
+/*  Answer one request; this is what the server does for every request it reads.   */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The status of the reply, also set in reply->status.                            */
+/***********************************************************************************/
+
+int server_evaluate (FASTRT_ENGINE *engine, const SERVER_REQUEST *request, SERVER_REPLY *reply,
+		     double *values)
+{
+  double doserates[DOSE_N_LAMBDA], rate=0.0, dose=0.0, slice=0.0, reached=INFINITY;
+  int step = (request->step > 0 ? request->step : SERVER_STEP);
+  int n_steps=0, t=0, dt=0, status=0;
+
+  reply->magic  = SERVER_MAGIC;
+  reply->id     = request->id;
+  reply->status = -1;
+  reply->n      = 0;
+
+  if (request->magic != SERVER_MAGIC || request->sky < 0 || request->sky > 3 ||
+      step < SERVER_MIN_STEP || step > 86400)
+    return -1;
+
+  n_steps = (86400 + step - 1) / step;
+
+  switch (request->kind)  {
+  case SERVER_SPECTRUM:
+    status = spectrum (engine, request, request->seconds, values);
+    reply->n = DOSE_N_LAMBDA;
+    break;
+
+  case SERVER_DOSE:
+    status = spectrum (engine, request, request->seconds, doserates);
+    values[0] = dose_rate (doserates, DOSE_ERYTHEMA);
+    values[1] = dose_rate (doserates, DOSE_VITAMIN_D);
+    values[2] = dose_uv_index (values[0]);
+    reply->n = 3;
+    break;
+
+  case SERVER_DAY:
+    if ((status = day_rates (engine, request, step, DOSE_ERYTHEMA, values)) == 0)
+      status = day_rates (engine, request, step, DOSE_VITAMIN_D, values + n_steps);
+    reply->n = 2 * n_steps;
+    break;
+
+  case SERVER_TIME_TO_DOSE:
+    if (request->action != DOSE_ERYTHEMA && request->action != DOSE_VITAMIN_D)
+      return -1;
+    if (request->seconds < 0 || request->seconds >= 86400 || request->dose < 0.0)
+      return -1;
+
+    for (t=request->seconds; t<86400; t+=dt)  {
+      dt = (86400 - t < step ? 86400 - t : step);
+      if ((status = spectrum (engine, request, t + dt/2, doserates)) < 0)
+	break;
+      status = 0;
+
+      /* mW m-2 s -> J m-2 */
+      rate  = dose_rate (doserates, request->action) / 1000.0;
+      slice = rate * dt;
+      if (isinf (reached) && dose + slice >= request->dose)
+	reached = (t - request->seconds) + (rate > 0.0 ? (request->dose - dose) / rate : 0.0);
+      dose += slice;
+    }
+    values[0] = reached;
+    values[1] = dose;
+    reply->n = 2;
+    break;
+
+  default:
+    return -1;
+  }
+
+  if (status < 0)
+    reply->n = 0;
+  reply->status = status;
+  return status;
+}
+
+
+static void count (SERVER *server, long requests, long failed)
+{
+  pthread_mutex_lock (&server->lock);
+  server->stats.requests += requests;
+  server->stats.failed   += failed;
+  pthread_mutex_unlock (&server->lock);
+}
+
+
+static void *serve (void *arg)
+{
+  CONNECTION *connection = (CONNECTION *) arg;
+  SERVER *server = connection->server;
+  SERVER_REQUEST *in=NULL;
+  SERVER_REPLY reply;
+  struct pollfd pfd;
+  char *out=NULL;
+  double *values=NULL;
+  size_t have=0, used=0, off=0, cap=0;
+  long requests=0, failed=0;
+  ssize_t n=0;
+  int fd = connection->fd, ok=1;
+
+  free (connection);
+
+  cap    = SERVER_FLUSH + sizeof(SERVER_REPLY) + SERVER_MAX_VALUES * sizeof(double);
+  in     = (SERVER_REQUEST *) calloc (SERVER_PIPELINE, sizeof(SERVER_REQUEST));
+  out    = (char *) malloc (cap);
+  values = (double *) calloc (SERVER_MAX_VALUES, sizeof(double));
+
+  pfd.fd     = fd;
+  pfd.events = POLLIN;
+
+  while (ok && in != NULL && out != NULL && values != NULL && !STOPPED (server->spec))  {
+    if ((n = poll (&pfd, 1, SERVER_POLL_MS)) == 0 || (n < 0 && errno == EINTR))
+      continue;
+
+    n = read (fd, (char *) in + have, SERVER_PIPELINE * sizeof(SERVER_REQUEST) - have);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    have += n;
+
+    used = 0;
+    for (off=0; ok && have - off >= sizeof(SERVER_REQUEST); off+=sizeof(SERVER_REQUEST))  {
+      const SERVER_REQUEST *request = (const SERVER_REQUEST *) ((char *) in + off);
+
+      if (request->magic != SERVER_MAGIC)  {
+	ok = 0;    /* out of step, drop the client */
+	break;
+      }
+
+      if (server_evaluate (server->engine, request, &reply, values) < 0)
+	failed++;
+      requests++;
+
+      memcpy (out + used, &reply, sizeof(SERVER_REPLY));
+      memcpy (out + used + sizeof(SERVER_REPLY), values, reply.n * sizeof(double));
+      used += sizeof(SERVER_REPLY) + reply.n * sizeof(double);
+
+      if (used >= SERVER_FLUSH)  {
+	ok = (write_all (fd, out, used) == 0);
+	used = 0;
+      }
+    }
+
+    if (ok && used > 0)
+      ok = (write_all (fd, out, used) == 0);
+
+    /* keep a partial request */
+    memmove (in, (char *) in + off, have - off);
+    have -= off;
+  }
+
+  close (fd);
+  free (in);
+  free (out);
+  free (values);
+
+  count (server, requests, failed);
+
+  pthread_mutex_lock (&server->lock);
+  server->active--;
+  pthread_cond_signal (&server->done);
+  pthread_mutex_unlock (&server->lock);
+  return NULL;
+}
+
+
+
+/***********************************************************************************/
+/* Function: server_spec_init                                                      */
+/* Description:                                                                    */
+/*  Set the defaults of a server; path and stop must be set by the caller.         */
+/***********************************************************************************/
+
+void server_spec_init (SERVER_SPEC *spec)
+{
+  memset (spec, 0, sizeof(SERVER_SPEC));
+  spec->max_clients = SERVER_MAX_CLIENTS;
+}
+
+
+
+/***********************************************************************************/
+/* Function: server_run                                                            */
+/* Description:                                                                    */
+/*  Listen on spec->path and answer requests until *spec->stop is set; the socket  */
+/*  file is removed before returning.                                              */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if the socket could not be set up.                              */
+/***********************************************************************************/
+
+int server_run (FASTRT_ENGINE *engine, const SERVER_SPEC *spec, SERVER_STATS *stats)
+{
+  SERVER server;
+  CONNECTION *connection=NULL;
+  struct sockaddr_un addr;
+  struct pollfd pfd;
+  pthread_attr_t attr;
+  pthread_t thread;
+  int listener=-1, fd=-1, n=0;
+
+  if (spec->path == NULL || spec->stop == NULL ||
+      strlen (spec->path) >= sizeof(addr.sun_path))
+    return -1;
+
+  memset (&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, spec->path);
+
+  if ((listener = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    return -1;
+
+  unlink (spec->path);
+  if (bind (listener, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+      listen (listener, SOMAXCONN) != 0)  {
+    close (listener);
+    return -1;
+  }
+
+  memset (&server, 0, sizeof(SERVER));
+  server.engine = engine;
+  server.spec   = spec;
+  pthread_mutex_init (&server.lock, NULL);
+  pthread_cond_init (&server.done, NULL);
+
+  pthread_attr_init (&attr);
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+
+  pfd.fd     = listener;
+  pfd.events = POLLIN;
+
+  while (!STOPPED (spec))  {
+    if ((n = poll (&pfd, 1, SERVER_POLL_MS)) <= 0)
+      continue;
+    if ((fd = accept (listener, NULL, NULL)) < 0)
+      continue;
+    no_sigpipe (fd);
+
+    pthread_mutex_lock (&server.lock);
+    if (server.active >= spec->max_clients ||
+	(connection = (CONNECTION *) calloc (1, sizeof(CONNECTION))) == NULL)  {
+      server.stats.refused++;
+      pthread_mutex_unlock (&server.lock);
+      close (fd);
+      continue;
+    }
+
+    connection->server = &server;
+    connection->fd     = fd;
+
+    if (pthread_create (&thread, &attr, serve, connection) != 0)  {
+      server.stats.refused++;
+      free (connection);
+      close (fd);
+    }
+    else  {
+      server.active++;
+      server.stats.connections++;
+    }
+    pthread_mutex_unlock (&server.lock);
+  }
+
+  close (listener);
+  unlink (spec->path);
+
+  /* the connection threads use the engine */
+  pthread_mutex_lock (&server.lock);
+  while (server.active > 0)
+    pthread_cond_wait (&server.done, &server.lock);
+  pthread_mutex_unlock (&server.lock);
+
+  if (stats != NULL)
+    *stats = server.stats;
+
+  pthread_attr_destroy (&attr);
+  pthread_cond_destroy (&server.done);
+  pthread_mutex_destroy (&server.lock);
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: server_connect, server_send, server_receive                           */
+/* Description:                                                                    */
+/*  The client side: connect to a server, send a request and read a reply. Replies */
+/*  with more than max_values values are an error.                                 */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  server_connect() the socket, the others 0; <0 if error.                        */
+/***********************************************************************************/
+
+int server_connect (const char *path)
+{
+  struct sockaddr_un addr;
+  int fd=-1;
+
+  if (strlen (path) >= sizeof(addr.sun_path))
+    return -1;
+
+  memset (&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+
+  if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    return -1;
+
+  if (connect (fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)  {
+    close (fd);
+    return -1;
+  }
+
+  no_sigpipe (fd);
+  return fd;
+}
+
+
+int server_send (int fd, const SERVER_REQUEST *request)
+{
+  return write_all (fd, request, sizeof(SERVER_REQUEST));
+}
+
+
+int server_receive (int fd, SERVER_REPLY *reply, double *values, int max_values)
+{
+  if (read_all (fd, reply, sizeof(SERVER_REPLY)) != 0 || reply->magic != SERVER_MAGIC ||
+      reply->n < 0 || reply->n > max_values)
+    return -1;
+  return read_all (fd, values, reply->n * sizeof(double));
+}
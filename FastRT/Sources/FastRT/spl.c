@@ -223,6 +223,118 @@ int spline_coeffc (double *x, double *y, int number,
 
 
 
+/****************************************************************/
+/* as spline_coeffc, but into coefficient arrays of number      */
+/* elements supplied by the caller, with SPLINE_WORK(number)    */
+/* doubles of work space; nothing is allocated                  */
+/****************************************************************/
+
+int spline_coeffc_buffer (double *x, double *y, int number, 
+			  double *a0, double *a1, double *a2, double *a3,
+			  double *work)
+{
+  int i=0, n=number-2;
+  double *h=NULL, *b=NULL, *m0=NULL, *m1=NULL, *m2=NULL;
+  double *alpha=NULL, *gamma=NULL, *r=NULL, *res=NULL;
+
+  if (number<2)
+    return TOO_FEW_DATA_POINTS;
+
+  for (i=0; i<number; i++)
+    a0[i] = a1[i] = a2[i] = a3[i] = 0;
+
+  if (number==2)  {     /* linear interpolation */
+
+    if (x[1] <= x[0])
+      return X_NOT_ASCENDING;
+
+    a0[0] = y[0];
+    a1[0] = (y[1]-y[0])/(x[1]-x[0]);
+
+    return 0;
+  }
+
+  h     = work;                    /* number-1 */
+  b     = h     + (number-1);      /* n        */
+  m0    = b     + n;               /* n        */
+  m1    = m0    + n;               /* n        */
+  m2    = m1    + n;               /* n        */
+  alpha = m2    + n;               /* n+1      */
+  gamma = alpha + (n+1);           /* n+1      */
+  r     = gamma + (n+1);           /* n+1      */
+  res   = r     + (n+1);           /* n        */
+
+  for (i=0; i<number-1; i++)  {
+    h[i] = x[i+1] - x[i];
+    if ( h[i] <= 0 )  {
+      fprintf(stderr,"x not ascending %d %f %f\n", i, x[i], x[i+1]);
+      return X_NOT_ASCENDING;
+    }
+  }
+  
+  /* linear equation system mx = b, m tridiagonal */
+  for (i=0; i<n; i++)
+    m0[i] = m2[i] = 0;
+
+  for (i=1; i<n; i++)
+    m0[i] = h[i];
+  
+  for (i=0; i<n; i++)
+    m1[i] = 2.0*(h[i]+h[i+1]);
+  
+  for (i=0; i<n-1; i++)
+    m2[i] = h[i+1];
+  
+  for (i=0; i<n; i++)
+    b[i] = 3.0 / h[i+1] * (y[i+2]-y[i+1]) - 3.0 / h[i] * (y[i+1]-y[i]);
+  
+  /* solve as solve_three_ms */
+  for (i=0; i<n; i++)
+    if (m1[i] == 0)
+      return SPLINE_NOT_POSSIBLE;
+
+  for (i=0; i<=n; i++)
+    alpha[i] = gamma[i] = r[i] = 0;
+
+  alpha[1] = m1[0];
+  gamma[1] = m2[0]/alpha[1];
+  
+  for (i=2; i<=n-1; i++)  {
+    if ( (alpha[i] = m1[i-1] - m0[i-1]*gamma[i-1]) == 0)
+      return SPLINE_NOT_POSSIBLE;
+    gamma[i] = m2[i-1]/alpha[i];
+  }
+
+  alpha[n] = m1[n-1] - m0[n-1]*gamma[n-1];
+
+  r[1] = b[0]/m1[0];
+
+  for (i=2; i<=n; i++)  
+    r[i] = (b[i-1] - m0[i-1]*r[i-1])/alpha[i];
+
+  res[n-1] = r[n];
+  
+  for (i=n-1; i>=1; i--)
+    res[i-1] = r[i] - gamma[i] * res[i];
+
+  for (i=1; i<number-1; i++)
+    a2[i] = res[i-1];
+
+  a1[0] = (y[1] - y[0]) / h[0];
+  a0[0] = y[0];
+  
+  for (i=1; i<number-1; i++)  {
+    a3[i] = (a2[i+1] - a2[i]) / 3.0 / h[i];
+    a1[i] = (y[i+1] - y[i]) / h[i]  - h[i] / 3.0 * (a2[i+1] + 2.0*a2[i]);
+    a0[i] = y[i];
+  }
+  
+  return 0;
+}
+
+
+
+
 /***********************************************************************/ 
 /* calculate approximating natural splines; input data as in spline,   */
 /* except the weighting factor w[i]                                    */
@@ -0,0 +1,367 @@
+/************************************************************************/
+/* subset.c                                                             */
+/*                                                                      */
+/* Tables cut to ranges of the parameter space, see subset.h.           */
+/*                                                                      */
+/* A file is kept if the nodes in its name are in the span of their     */
+/* axis: sza%gozone%galt%g for the transmittances, sza%galt%g for the   */
+/* aerosol coefficients on the coefficient sza axis and alt%g for the   */
+/* reflectivities; all other files are kept. The names print the nodes  */
+/* with %g, so a name matches a node if both print the same.            */
+/*                                                                      */
+/************************************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "subset.h"
+#include "tablestore.h"
+#include "pack.h"
+#include "sun.h"
+#include "ascii.h"
+
+
+/* the axes with a range, see subset.h */
+#define SB_CUT(a)  ((a) == TABLEGRID_SZA || (a) == TABLEGRID_OZONE || (a) == TABLEGRID_ALT)
+
+
+typedef struct {
+  const SUBSET_SPEC *spec;
+  TABLE_GRID   grid;            /* of the input tables                       */
+  TABLE_GRID   subset;
+  int          first[TABLEGRID_AXES];  /* span of the ranges in grid         */
+  int          last[TABLEGRID_AXES];
+} SB_RUN;
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static int make_directory (const char *path)
+{
+  if (mkdir (path, 0777) != 0 && errno != EEXIST)
+    return -1;
+  return 0;
+}
+
+
+static int same_directory (const char *x, const char *y)
+{
+  struct stat sx, sy;
+
+  return (stat (x, &sx) == 0 && stat (y, &sy) == 0 &&
+	  sx.st_dev == sy.st_dev && sx.st_ino == sy.st_ino);
+}
+
+
+/* a hard link, or a copy across file systems */
+static int link_file (const char *from, const char *to)
+{
+  char buffer[65536];
+  FILE *in=NULL, *out=NULL;
+  size_t n=0;
+  int status=0;
+
+  if (unlink (to) != 0 && errno != ENOENT)
+    return -1;
+  if (link (from, to) == 0)
+    return 0;
+
+  if ((in = fopen (from, "r")) == NULL)
+    return -1;
+  if ((out = fopen (to, "w")) == NULL)  {
+    fclose (in);
+    return -1;
+  }
+  while ((n = fread (buffer, 1, sizeof(buffer), in)) > 0)
+    if (fwrite (buffer, 1, n, out) != n)  {
+      status = -1;
+      break;
+    }
+  if (ferror (in))
+    status = -1;
+  fclose (in);
+  if (fclose (out) != 0)
+    status = -1;
+  return status;
+}
+
+
+/* whether x is a node of the span of axis a */
+static int in_span (const SB_RUN *run, int a, double x)
+{
+  const TABLE_AXIS *axis = &run->grid.axis[a];
+  char name[32], node[32];
+  int k = tablegrid_nearest (axis, x);
+
+  snprintf (name, sizeof(name), "%g", x);
+  snprintf (node, sizeof(node), "%g", axis->x[k]);
+  return (k >= run->first[a] && k <= run->last[a] && strcmp (name, node) == 0);
+}
+
+
+/* see above */
+static int keep_file (const SB_RUN *run, const char *name)
+{
+  double sza=0.0, o3=0.0, alt=0.0;
+  int n=0;
+
+  if (sscanf (name, "sza%lfozone%lfalt%lf%n", &sza, &o3, &alt, &n) == 3 && name[n] == 0)
+    return (in_span (run, TABLEGRID_SZA, sza) && in_span (run, TABLEGRID_OZONE, o3) &&
+	    in_span (run, TABLEGRID_ALT, alt));
+  if (sscanf (name, "sza%lfalt%lf%n", &sza, &alt, &n) == 2 && name[n] == 0)
+    return (in_span (run, TABLEGRID_COEFF_SZA, sza) && in_span (run, TABLEGRID_ALT, alt));
+  if (sscanf (name, "alt%lf%n", &alt, &n) == 1 && name[n] == 0)
+    return in_span (run, TABLEGRID_ALT, alt);
+  return 1;
+}
+
+
+/* the ranges of the spec, filled in from the sites, within those of the input */
+static int set_ranges (SB_RUN *run, TABLE_RANGE *range)
+{
+  const SUBSET_SPEC *spec = run->spec;
+  const TABLE_RANGE *input=NULL;
+  double noon=0.0;
+  int a=0, s=0, day=0;
+
+  memcpy (range, spec->range, TABLEGRID_AXES * sizeof(TABLE_RANGE));
+
+  if (spec->sites != NULL && spec->n_sites > 0)  {
+    if (spec->first_day < 1 || spec->last_day > 365 || spec->first_day > spec->last_day)  {
+      fprintf (stderr, "Error, days %d to %d, 1 to 365 expected\n", spec->first_day,
+	       spec->last_day);
+      return -1;
+    }
+
+    if (!range[TABLEGRID_SZA].set)  {
+      range[TABLEGRID_SZA].set = 1;
+      range[TABLEGRID_SZA].min = SUBSET_MAX_SZA;
+      range[TABLEGRID_SZA].max = SUBSET_MAX_SZA;
+      for (day=spec->first_day; day<=spec->last_day; day++)
+	for (s=0; s<spec->n_sites; s++)  {
+	  noon = fabs (spec->sites[s].latitude - declination (day));
+	  if (noon < range[TABLEGRID_SZA].min)
+	    range[TABLEGRID_SZA].min = noon;
+	}
+      /* run_fastrt() rounds the zenith angle to 3 decimals */
+      range[TABLEGRID_SZA].min = floor (range[TABLEGRID_SZA].min * 1000.0) / 1000.0;
+    }
+
+    if (!range[TABLEGRID_ALT].set)  {
+      range[TABLEGRID_ALT].set = 1;
+      range[TABLEGRID_ALT].min = range[TABLEGRID_ALT].max = spec->sites[0].altitude;
+      for (s=1; s<spec->n_sites; s++)  {
+	if (spec->sites[s].altitude < range[TABLEGRID_ALT].min)
+	  range[TABLEGRID_ALT].min = spec->sites[s].altitude;
+	if (spec->sites[s].altitude > range[TABLEGRID_ALT].max)
+	  range[TABLEGRID_ALT].max = spec->sites[s].altitude;
+      }
+    }
+  }
+
+  for (a=0; a<TABLEGRID_AXES; a++)  {
+    input = &run->grid.range[a];
+    if (!SB_CUT (a))
+      range[a].set = 0;
+    if (!range[a].set)  {
+      range[a] = *input;
+      continue;
+    }
+    if (range[a].min > range[a].max)  {
+      fprintf (stderr, "Error, %s range %g to %g\n", tablegrid_name (a), range[a].min,
+	       range[a].max);
+      return -1;
+    }
+    if (input->set && (range[a].min < input->min || range[a].max > input->max))  {
+      fprintf (stderr, "Error, %s range %g to %g outside %g to %g of %s\n", tablegrid_name (a),
+	       range[a].min, range[a].max, input->min, input->max, spec->input);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+/* the grid of the subset: the spans of the input axes with the ranges */
+static int setup (SB_RUN *run)
+{
+  TABLE_RANGE range[TABLEGRID_AXES];
+  const TABLE_AXIS *axis=NULL;
+  int a=0, status=0;
+
+  if ((status = tablegrid_read (NULL, &run->grid)) != 0 ||
+      (status = set_ranges (run, range)) != 0)
+    return status;
+
+  memset (&run->subset, 0, sizeof(TABLE_GRID));
+  run->subset.points = run->grid.points;
+  for (a=0; a<TABLEGRID_AXES && status==0; a++)  {
+    axis = &run->grid.axis[a];
+    run->first[a] = 0;
+    run->last[a]  = axis->n - 1;
+    if (range[a].set)
+      tablegrid_span (&run->grid, a, range[a].min, range[a].max, &run->first[a],
+		      &run->last[a]);
+    /* the aerosol coefficients are looked up at the sza of the request */
+    if (a == TABLEGRID_COEFF_SZA && range[TABLEGRID_SZA].set)
+      tablegrid_span (&run->grid, a, range[TABLEGRID_SZA].min, range[TABLEGRID_SZA].max,
+		      &run->first[a], &run->last[a]);
+
+    status = tablegrid_set (&run->subset, a, axis->x + run->first[a],
+			    run->last[a] - run->first[a] + 1);
+    run->subset.range[a] = range[a];
+  }
+  return status;
+}
+
+
+/* the files kept of the input directories, linked into the output */
+static int link_tree (SB_RUN *run, SUBSET_STATS *st)
+{
+  const SUBSET_SPEC *spec = run->spec;
+  struct dirent **dirs=NULL, **names=NULL;
+  struct stat sb;
+  char from[FILENAME_MAX+512], to[FILENAME_MAX+512];
+  int n_dirs=0, n_names=0, d=0, i=0, status=0;
+
+  if ((n_dirs = scandir (spec->input, &dirs, NULL, alphasort)) < 0)
+    return -1;
+
+  for (d=0; d<n_dirs && status==0; d++)  {
+    snprintf (from, sizeof(from), "%s/%s", spec->input, dirs[d]->d_name);
+    if (dirs[d]->d_name[0] == '.' || strcmp (dirs[d]->d_name, TABLEGRID_DIRECTORY) == 0 ||
+	stat (from, &sb) != 0 || !S_ISDIR (sb.st_mode))
+      continue;
+
+    snprintf (to, sizeof(to), "%s/%s", spec->output, dirs[d]->d_name);
+    if ((status = make_directory (to)) != 0)
+      break;
+
+    if ((n_names = scandir (from, &names, NULL, alphasort)) < 0)
+      continue;
+    for (i=0; i<n_names && status==0; i++)  {
+      snprintf (from, sizeof(from), "%s/%s/%s", spec->input, dirs[d]->d_name,
+		names[i]->d_name);
+      snprintf (to, sizeof(to), "%s/%s/%s", spec->output, dirs[d]->d_name, names[i]->d_name);
+      if (names[i]->d_name[0] == '.' || stat (from, &sb) != 0 || !S_ISREG (sb.st_mode))
+	continue;
+
+      st->input_bytes += (size_t) sb.st_size;
+      if (!keep_file (run, names[i]->d_name))  {
+	st->skipped++;
+	continue;
+      }
+
+      if ((status = link_file (from, to)) != 0)
+	fprintf (stderr, "Error, cannot link or copy %s to %s\n", from, to);
+      else  {
+	st->files++;
+	st->bytes += (size_t) sb.st_size;
+      }
+    }
+
+    for (i=0; i<n_names; i++)
+      free (names[i]);
+    free (names);
+  }
+
+  for (d=0; d<n_dirs; d++)
+    free (dirs[d]);
+  free (dirs);
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: subset_spec_init                                                      */
+/* Description:                                                                    */
+/*  Set the defaults: no ranges, no sites, the days of the whole year.             */
+/***********************************************************************************/
+
+void subset_spec_init (SUBSET_SPEC *spec)
+{
+  memset (spec, 0, sizeof(SUBSET_SPEC));
+
+  spec->pack_kind = PACK_LOG16;
+  spec->first_day = 1;
+  spec->last_day  = 365;
+}
+
+
+
+/***********************************************************************************/
+/* Function: subset_run                                                            */
+/* Description:                                                                    */
+/*  Write the subset of spec->input for the ranges of spec to spec->output and     */
+/*  build the pack.                                                                */
+/*  Sets the resource path of ascii.c to spec->input, or to spec->output with a    */
+/*  pack.                                                                          */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  const SUBSET_SPEC *spec:  Input, ranges and output.                            */
+/*  SUBSET_STATS *stats:      Statistics, set by function, may be NULL.            */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error, e.g. a range outside that of the input.               */
+/***********************************************************************************/
+
+int subset_run (const SUBSET_SPEC *spec, SUBSET_STATS *stats)
+{
+  SB_RUN run;
+  SUBSET_STATS st;
+  PACK_STATS ps;
+  int a=0, status=0;
+  double t0=now();
+
+  memset (&run, 0, sizeof(SB_RUN));
+  memset (&st, 0, sizeof(SUBSET_STATS));
+
+  if (spec == NULL || spec->input == NULL || spec->output == NULL)
+    return -1;
+  if ((status = make_directory (spec->output)) != 0)
+    return status;
+  if (same_directory (spec->input, spec->output))  {
+    fprintf (stderr, "Error, %s is the input tree\n", spec->output);
+    return -1;
+  }
+
+  run.spec = spec;
+  ASCII_set_resource_path (spec->input);
+
+  if ((status = setup (&run)) != 0 || (status = link_tree (&run, &st)) != 0 ||
+      (status = tablegrid_write (&run.subset, spec->output)) != 0)
+    goto cleanup;
+
+  if (spec->pack != NULL)  {
+    if ((status = pack_build (spec->output, spec->pack, spec->pack_kind, 0.0, &ps)) == 0)
+      st.pack_size = ps.size;
+  }
+
+ cleanup:
+  for (a=0; a<TABLEGRID_AXES; a++)  {
+    st.range[a]       = run.subset.range[a];
+    st.nodes[a]       = run.subset.axis[a].n;
+    st.input_nodes[a] = run.grid.axis[a].n;
+  }
+  st.seconds = now() - t0;
+  if (stats != NULL)
+    *stats = st;
+
+  tablegrid_free (&run.grid);
+  tablegrid_free (&run.subset);
+  return status;
+}
@@ -293,16 +293,11 @@ double hour_angle (int time)
 double solar_zenith (int time, int day, 
 		     double latitude, double longitude, double long_std)
 {
-  double theta=0, omega=0, delta=0, phi = latitude*_PI_/180.0;
-  int lat = LAT (time, day, longitude, long_std);
+  SUN_EPHEMERIS eph;
 
-  delta = _PI_/180.0*declination (day);
-  omega = _PI_/180.0*hour_angle (lat);
-    
-  theta = acos(sin(delta) * sin(phi) + cos(delta) * cos(phi) * cos(omega));
+  sun_ephemeris (day, &eph);
 
-  theta *= (180.0/_PI_);   /* convert to degrees */
-  return theta;
+  return solar_zenith_eph (&eph, time, latitude, longitude, long_std);
 }
 
 
@@ -333,23 +328,199 @@ double solar_zenith (int time, int day,
 double solar_azimuth (int time, int day, 
 		      double latitude, double longitude, double long_std)
 {
-  double theta=0, omega=0, delta=0, phi = latitude*_PI_/180.0, psi=0;
-  int lat = LAT (time, day, longitude, long_std);
+  SUN_EPHEMERIS eph;
 
-  delta = _PI_/180.0*declination (day);
-  omega = _PI_/180.0*hour_angle (lat);
-  theta = _PI_/180.0*solar_zenith (time, day, latitude, longitude, long_std);
+  sun_ephemeris (day, &eph);
 
+  return solar_azimuth_eph (&eph, time, latitude, longitude, long_std);
+}
 
-  psi = -acos((cos(theta)*sin(phi) - sin(delta)) / sin(theta) / cos (phi));
 
-  /* adjust sign */
-  if (lat>43200 || lat<0)
-    psi=-psi;
 
-  psi *= (180.0/_PI_);   /* convert to degrees */
-  
-  return psi;
+/***********************************************************************************/
+/* Function: sun_ephemeris                                                @42_30i@ */
+/* Description:                                                                    */
+/*  Calculate the day dependent quantities (declination, equation of time and      */
+/*  eccentricity) once, so that zenith and azimuth angles for many times and       */
+/*  locations of the same day do not recompute them.                               */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  int day:             Julian day (leap day is usually @strong{not} counted.     */
+/*  SUN_EPHEMERIS *eph:  Ephemeris, set by function.                               */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/*                                                                                 */
+/* Example:                                                                        */
+/* Files:                                                                          */
+/* Known bugs:                                                                     */
+/* Author:                                                                         */
+/*                                                                        @i42_30@ */
+/***********************************************************************************/
+
+int sun_ephemeris (int day, SUN_EPHEMERIS *eph)
+{
+  if (eph == NULL)
+    return -1;
+
+  eph->day          = day;
+  eph->declination  = declination (day);
+  eph->delta        = _PI_/180.0*eph->declination;
+  eph->sin_delta    = sin (eph->delta);
+  eph->cos_delta    = cos (eph->delta);
+  eph->eqt          = equation_of_time (day);
+  eph->eccentricity = eccentricity (day);
+
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: solar_zenith_eph                                             @42_30i@ */
+/* Description:                                                                    */
+/*  Same as solar_zenith, but with the day dependent quantities taken from a       */
+/*  precomputed ephemeris.                                                         */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  SUN_EPHEMERIS *eph: Ephemeris of the day, see sun_ephemeris.                   */
+/*  int time:           Standard time [seconds since midnight].                    */
+/*  double latitude:    Latitude [degrees] (North positive).                       */
+/*  double longitude:   Longitude [degrees] (West positive).                       */
+/*  double long_std:    Standard longitude [degrees].                              */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The solar zenith angle [degrees].                                              */
+/*                                                                                 */
+/* Example:                                                                        */
+/* Files:                                                                          */
+/* Known bugs:                                                                     */
+/* Author:                                                                         */
+/*                                                                        @i42_30@ */
+/***********************************************************************************/
+
+double solar_zenith_eph (const SUN_EPHEMERIS *eph, int time,
+			 double latitude, double longitude, double long_std)
+{
+  double zenith=0;
+
+  solar_zenith_azimuth_soa (eph, 1, &time, &latitude, &longitude, long_std,
+			    &zenith, NULL);
+
+  return zenith;
+}
+
+
+
+/***********************************************************************************/
+/* Function: solar_azimuth_eph                                            @42_30i@ */
+/* Description:                                                                    */
+/*  Same as solar_azimuth, but with the day dependent quantities taken from a      */
+/*  precomputed ephemeris.                                                         */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  See solar_zenith_eph.                                                          */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The solar azimuth angle [degrees].                                             */
+/*                                                                                 */
+/* Example:                                                                        */
+/* Files:                                                                          */
+/* Known bugs:                                                                     */
+/* Author:                                                                         */
+/*                                                                        @i42_30@ */
+/***********************************************************************************/
+
+double solar_azimuth_eph (const SUN_EPHEMERIS *eph, int time,
+			  double latitude, double longitude, double long_std)
+{
+  double zenith=0, azimuth=0;
+
+  solar_zenith_azimuth_soa (eph, 1, &time, &latitude, &longitude, long_std,
+			    &zenith, &azimuth);
+
+  return azimuth;
+}
+
+
+
+/***********************************************************************************/
+/* Function: solar_zenith_azimuth_soa                                     @42_30i@ */
+/* Description:                                                                    */
+/*  Calculate solar zenith and azimuth angles for n points of the same day.        */
+/*  Times and locations are passed as separate arrays (structure of arrays),       */
+/*  point i is (time[i], latitude[i], longitude[i]). The loops are free of         */
+/*  branches and calls other than the trigonometric functions, so that the         */
+/*  compiler may vectorize them. Results are identical to solar_zenith and         */
+/*  solar_azimuth.                                                                 */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  SUN_EPHEMERIS *eph:  Ephemeris of the day, see sun_ephemeris.                  */
+/*  int n:               Number of points.                                         */
+/*  int *time:           Standard times [seconds since midnight].                  */
+/*  double *latitude:    Latitudes [degrees] (North positive).                     */
+/*  double *longitude:   Longitudes [degrees] (West positive).                     */
+/*  double long_std:     Standard longitude [degrees].                             */
+/*  double *zenith:      Solar zenith angles [degrees], set by function.           */
+/*  double *azimuth:     Solar azimuth angles [degrees], set by function;          */
+/*                       may be NULL if not needed.                                */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/*                                                                                 */
+/* Example:                                                                        */
+/* Files:                                                                          */
+/* Known bugs:                                                                     */
+/* Author:                                                                         */
+/*                                                                        @i42_30@ */
+/***********************************************************************************/
+
+int solar_zenith_azimuth_soa (const SUN_EPHEMERIS *eph, int n,
+			      const int *restrict time,
+			      const double *restrict latitude,
+			      const double *restrict longitude,
+			      double long_std,
+			      double *restrict zenith,
+			      double *restrict azimuth)
+{
+  int i=0, lat=0;
+  double phi=0, omega=0, theta=0, psi=0, sign=0;
+  double sin_delta=0, cos_delta=0;
+  int eqt=0;
+
+  if (eph == NULL || n < 0)
+    return -1;
+
+  sin_delta = eph->sin_delta;
+  cos_delta = eph->cos_delta;
+  eqt       = eph->eqt;
+
+  /* zenith angle; pg. 15 */
+  for (i=0; i<n; i++)  {
+    lat   = time[i] + (int) (240.0 * (long_std-longitude[i])) + eqt;
+    phi   = latitude[i]*_PI_/180.0;
+    omega = _PI_/180.0*hour_angle (lat);
+
+    zenith[i] = acos(sin_delta * sin(phi) + cos_delta * cos(phi) * cos(omega))
+                * (180.0/_PI_);
+  }
+
+  if (azimuth == NULL)
+    return 0;
+
+  /* azimuth angle; pg. 15 */
+  for (i=0; i<n; i++)  {
+    lat   = time[i] + (int) (240.0 * (long_std-longitude[i])) + eqt;
+    phi   = latitude[i]*_PI_/180.0;
+    theta = _PI_/180.0*zenith[i];
+
+    psi  = -acos((cos(theta)*sin(phi) - sin_delta) / sin(theta) / cos (phi));
+    sign = (lat>43200 || lat<0) ? -1.0 : 1.0;
+
+    azimuth[i] = sign * psi * (180.0/_PI_);
+  }
+
+  return 0;
 }
 
 
@@ -512,25 +683,92 @@ int zenith2time (int day,
 		 int *time1, 
 		 int *time2)
 {
-  double delta = _PI_/180.0*declination (day);
+  SUN_EPHEMERIS eph;
+  int t1=0, t2=0, status=0;
+
+  sun_ephemeris (day, &eph);
+
+  zenith2time_soa (&eph, 1, zenith_angle, latitude, longitude, long_std,
+		   &t1, &t2, &status);
+
+  if (status != 0)
+    return status;
+
+  *time1 = t1;
+  *time2 = t2;
+
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: zenith2time_soa                                              @42_30i@ */
+/* Description:                                                                    */
+/*  Calculate the times for a given solar zenith angle and location for n days     */
+/*  at once, e.g. sunrise and sunset for a whole year. eph[i] is the ephemeris     */
+/*  of the i'th day; the loop is free of branches so that it may be vectorized.    */
+/*  Results are identical to zenith2time.                                          */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  SUN_EPHEMERIS *eph:   Ephemerides of the n days, see sun_ephemeris.            */
+/*  int n:                Number of days.                                          */
+/*  double zenith_angle:  Solar zenith angle [degrees].                            */
+/*  double latitude:      Latitude [degrees] (North positive).                     */
+/*  double longitude:     Longitude [degrees] (West positive).                     */
+/*  double long_std:      Standard longitude [degrees].                            */
+/*  int *time1:           1st time of occurence, set by function.                  */ 
+/*  int *time2:           2nd time of occurence, set by function.                  */ 
+/*  int *status:          0 if o.k., ERROR_NO_ZENITH if the zenith angle is not    */
+/*                        reached on that day; set by function.                    */ 
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/*                                                                                 */
+/* Example:                                                                        */
+/* Files:                                                                          */
+/* Known bugs:                                                                     */
+/* Author:                                                                         */
+/*                                                                        @i42_30@ */
+/***********************************************************************************/
+
+int zenith2time_soa (const SUN_EPHEMERIS *restrict eph,
+		     int n,
+		     double zenith_angle,
+		     double latitude,
+		     double longitude,
+		     double long_std,
+		     int *restrict time1,
+		     int *restrict time2,
+		     int *restrict status)
+{
   double phi   = _PI_/180.0*latitude;
   double theta = _PI_/180.0*zenith_angle;
-  double cos_omega = (cos(theta) - sin(delta)*sin(phi)) / 
-                      cos(delta) / cos(phi);
-  double omega1=0, omega2=0;
-  int lat1=0, lat2=0;
-
-  if (fabs(cos_omega) > 1.0)
-    return ERROR_NO_ZENITH;
+  double cos_theta = cos(theta), sin_phi = sin(phi), cos_phi = cos(phi);
+  double cos_omega=0, omega1=0, omega2=0;
+  int i=0, lat1=0, lat2=0, reached=0;
+  int dlong = (int) (240.0 * (long_std-longitude));
+
+  if (eph == NULL || n < 0)
+    return -1;
+
+  for (i=0; i<n; i++)  {
+    cos_omega = (cos_theta - eph[i].sin_delta*sin_phi) / 
+                 eph[i].cos_delta / cos_phi;
+    reached   = (fabs(cos_omega) <= 1.0);
+
+    /* clamp so that acos stays defined; the result is discarded anyway */
+    omega1 = acos (reached ? cos_omega : 1.0);
+    omega2 = 0.0-omega1;
   
-  omega1 = acos (cos_omega);
-  omega2 = 0.0-omega1;
-  
-  lat1 = 43200*(1-omega1/_PI_);
-  lat2 = 43200*(1-omega2/_PI_);
-  
-  *time1 = standard_time (lat1, day, longitude, long_std);
-  *time2 = standard_time (lat2, day, longitude, long_std);
+    lat1 = 43200*(1-omega1/_PI_);
+    lat2 = 43200*(1-omega2/_PI_);
+
+    /* standard_time() */
+    time1[i]  = reached ? lat1 - dlong - eph[i].eqt : 0;
+    time2[i]  = reached ? lat2 - dlong - eph[i].eqt : 0;
+    status[i] = reached ? 0 : ERROR_NO_ZENITH;
+  }
 
   return 0;
 }
@@ -0,0 +1,1420 @@
+/************************************************************************/
+/* tablegen.c                                                           */
+/*                                                                      */
+/* Generation of the look-up tables with a radiative transfer solver,  */
+/* see tablegen.h.                                                      */
+/*                                                                      */
+/* The atmosphere of every altitude, the cloud file of every cloud and  */
+/* altitude, the unit solar file and the wavelength grids are written   */
+/* once, before the jobs. A job only writes its deck, runs the solver   */
+/* and splines its output, so the jobs are independent and run on the   */
+/* task pool, one job per task, each blocked in waitpid() while its     */
+/* solver runs.                                                         */
+/*                                                                      */
+/************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "tablegen.h"
+#include "tablestore.h"
+#include "tablegrid.h"
+#include "taskpool.h"
+#include "fastrt_.h"
+#include "pack.h"
+#include "spl.h"
+#include "regress.h"
+#include "ascii.h"
+
+
+extern char **environ;
+
+#define TG_MAX_ALTS        3
+#define TG_MAX_COLUMNS    16
+#define TG_NAME          128
+#define TG_PI            3.14159265358979323846
+
+/* produce_cloud_tables.pl */
+#define TG_REFLECTIVITY_OZONE  300.0  /* [DU]                                 */
+#define TG_SZA_MIN             0.15   /* instead of 0, a DISORT singularity   */
+#define TG_CLOUD_RM            7.2    /* effective radius of alto-stratus [um] */
+#define TG_CLOUD_BOTTOM        2.0    /* above ground [km]                    */
+#define TG_CLOUD_TOP           7.0
+
+/* sample sets of the coefficient files */
+#define TG_SET_TRANSMITTANCE_BETA  0
+#define TG_SET_REFLECTIVITY_BETA   1
+#define TG_SET_REFLECTIVITY_OZONE  2
+
+static const double default_betas[]  = { 0.0, 0.05, 0.1, 0.2, 0.3 };
+static const double default_ozones[] = { 100.0, 200.0, 400.0, 500.0, 600.0 };
+
+
+typedef struct {
+  char  *data;
+  size_t size, max;
+} TG_TEXT;
+
+typedef struct {
+  int    kind;                  /* TABLEGEN_REFLECTIVITY or _TRANSMITTANCE   */
+  int    cloud, alt;            /* indices into the run, cloud -1: clear sky  */
+  double sza, ozone, beta;
+  int    sample;                /* on the grid of the coefficient files      */
+  char   name[TG_NAME];         /* table, relative to the output root        */
+  unsigned long long hash;      /* of all inputs                             */
+  int    status;                /* 0: written, 1: skipped, <0: failed        */
+  double seconds;               /* solver run                                */
+} TG_JOB;
+
+typedef struct {
+  char   name[TG_NAME];
+  unsigned long long hash;
+  long   line;
+  int    used;                  /* looked up by a job of this run            */
+} TG_ENTRY;
+
+typedef struct {
+  int    set;                   /* TG_SET_TRANSMITTANCE_BETA ...             */
+  double sza;
+  int    alt;
+  char   name[TG_NAME];         /* coefficient file                          */
+  double *rms, *max;            /* residuals per wavelength                  */
+  int    status;
+} TG_FIT;
+
+typedef struct {
+  const TABLEGEN_SPEC *spec;
+  const double *clouds;
+  int    n_clouds;
+  double *betas, *ozones;       /* of the samples, without the references    */
+  int    n_betas, n_ozones;
+  double *coeff_sza;            /* sza of the coefficient files              */
+  int    n_coeff_sza;
+
+  double alts[TG_MAX_ALTS];
+  int    n_alts;
+
+  double *lambda, *reflectivity_lambda;   /* wavelengths of the tables [nm] */
+  int    n_lambda, n_reflectivity_lambda;
+  unsigned long long grid_hash;           /* of the solver and wavelengths  */
+
+  char   work[FILENAME_MAX];
+  char   solar_file[FILENAME_MAX+32];
+  char   atmosphere[TG_MAX_ALTS][FILENAME_MAX+32];
+  unsigned long long atmosphere_hash[TG_MAX_ALTS];
+  char  *wc_file;               /* n_clouds x n_alts names, "" for no cloud   */
+  unsigned long long *wc_hash;
+
+  TG_JOB *jobs;
+  long    n_jobs;
+  long   *todo;                 /* jobs to run                               */
+
+  FILE   *manifest;             /* appended to by the workers, under lock    */
+  pthread_mutex_t lock;
+
+  TG_FIT *fits;
+  int     n_fits;
+} TG_RUN;
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static int text_printf (TG_TEXT *text, const char *format, ...)
+{
+  va_list args;
+  char *tmp=NULL;
+  int n=0;
+
+  for (;;)  {
+    va_start (args, format);
+    n = vsnprintf (text->data + text->size, text->max - text->size, format, args);
+    va_end (args);
+    if (n < 0)
+      return -1;
+    if (text->data != NULL && text->size + n < text->max)
+      break;
+
+    text->max = 2 * text->max + n + 256;
+    if ((tmp = (char *) realloc (text->data, text->max)) == NULL)
+      return ASCII_NO_MEMORY;
+    text->data = tmp;
+  }
+  text->size += n;
+  return 0;
+}
+
+
+/* writes a file atomically */
+static int write_file (const char *path, const char *data, size_t size)
+{
+  char tmp[FILENAME_MAX+256];
+  FILE *f=NULL;
+  int status=0;
+
+  snprintf (tmp, sizeof(tmp), "%s.tmp", path);
+  if ((f = fopen (tmp, "w")) == NULL)
+    return -1;
+  if (fwrite (data, 1, size, f) != size)
+    status = -1;
+  if (fclose (f) != 0)
+    status = -1;
+  if (status == 0)
+    status = rename (tmp, path);
+  else
+    unlink (tmp);
+  return status;
+}
+
+
+static int make_directory (const char *path)
+{
+  if (mkdir (path, 0777) != 0 && errno != EEXIST)
+    return -1;
+  return 0;
+}
+
+
+/* the numbers of every line of a text file, which is not a comment; */
+/* returns the number of rows, or <0                                   */
+static int read_rows (const char *filename, int min_columns, double **data, int *columns,
+		      TG_TEXT *comments)
+{
+  FILE *f=NULL;
+  char line[4096], *p=NULL, *end=NULL;
+  double row[TG_MAX_COLUMNS], *tmp=NULL;
+  int rows=0, max=0, n=0;
+
+  *data    = NULL;
+  *columns = 0;
+  if ((f = fopen (filename, "r")) == NULL)
+    return -1;
+
+  while (fgets (line, sizeof(line), f) != NULL)  {
+    for (p=line; *p == ' ' || *p == '\t'; p++);
+    if (*p == '#')  {
+      if (comments != NULL && text_printf (comments, "%s", line) != 0)
+	break;
+      continue;
+    }
+
+    for (n=0; n<TG_MAX_COLUMNS; n++, p=end)  {
+      row[n] = strtod (p, &end);
+      if (end == p)
+	break;
+    }
+    if (n == 0)
+      continue;
+    if (n < min_columns || (*columns > 0 && n < *columns))  {
+      rows = -1;
+      break;
+    }
+    if (*columns == 0)
+      *columns = n;
+
+    if (rows == max)  {
+      max = (max > 0 ? 2 * max : 256);
+      if ((tmp = (double *) realloc (*data, (size_t) max * *columns * sizeof(double))) == NULL)  {
+	rows = ASCII_NO_MEMORY;
+	break;
+      }
+      *data = tmp;
+    }
+    memcpy (*data + (size_t) rows * *columns, row, *columns * sizeof(double));
+    rows++;
+  }
+
+  fclose (f);
+  if (rows <= 0)  {
+    free (*data);
+    *data = NULL;
+  }
+  return rows;
+}
+
+
+/* y splined from (x, y) to the n_new wavelengths x_new, x ascending */
+static int resample (double *x, double *y, int n, const double *x_new, int n_new, double *y_new)
+{
+  double *a0=NULL, *a1=NULL, *a2=NULL, *a3=NULL;
+  int i=0, status=0;
+
+  if ((status = spline_coeffc (x, y, n, &a0, &a1, &a2, &a3)) != 0)
+    return status;
+
+  for (i=0; i<n_new && status==0; i++)
+    status = calc_splined_value (x_new[i], &y_new[i], x, n, a0, a1, a2, a3);
+
+  free (a0);
+  free (a1);
+  free (a2);
+  free (a3);
+  return status;
+}
+
+
+/* the atmosphere splined to the altitude zout and all levels above, */
+/* in the format of the atmosphere files of libRadtran                */
+static int atmosphere_at (const char *filename, double zout, TG_TEXT *out)
+{
+  double *data=NULL, *z=NULL, *y=NULL, *level=NULL, *column=NULL;
+  int rows=0, columns=0, n=0, i=0, c=0, status=0;
+
+  if ((rows = read_rows (filename, 2, &data, &columns, out)) < 2)
+    return -1;
+
+  /* the files go from the top down, spline wants ascending altitudes */
+  z      = (double *) calloc (rows, sizeof(double));
+  y      = (double *) calloc (rows, sizeof(double));
+  level  = (double *) calloc (rows + 1, sizeof(double));
+  column = (double *) calloc ((size_t) (rows + 1) * columns, sizeof(double));
+  if (z == NULL || y == NULL || level == NULL || column == NULL)  {
+    status = ASCII_NO_MEMORY;
+    goto cleanup;
+  }
+
+  for (i=0; i<rows; i++)
+    z[i] = data[(size_t) (rows-1-i) * columns];
+
+  level[n++] = zout;
+  for (i=0; i<rows; i++)
+    if (z[i] > zout)
+      level[n++] = z[i];
+
+  for (c=0; c<columns && status==0; c++)  {
+    for (i=0; i<rows; i++)
+      y[i] = data[(size_t) (rows-1-i) * columns + c];
+    if (c == 0)
+      memcpy (column, level, n * sizeof(double));
+    else
+      status = resample (z, y, rows, level, n, column + (size_t) c * n);
+  }
+
+  for (i=n-1; i>=0 && status==0; i--)  {
+    status = text_printf (out, "%10.3f %11.5f %8.3f", column[i],
+			  columns > 1 ? column[n + i] : 0.0, columns > 2 ? column[2*n + i] : 0.0);
+    for (c=3; c<columns && status==0; c++)
+      status = text_printf (out, " %13.6e", column[(size_t) c * n + i]);
+    if (status == 0)
+      status = text_printf (out, "\n");
+  }
+
+ cleanup:
+  free (data);
+  free (z);
+  free (y);
+  free (level);
+  free (column);
+  return status;
+}
+
+
+/* alto-stratus of water content W between zout+2 and zout+7 km, */
+/* on the levels of the atmosphere                                  */
+static int cloud_at (const char *atmosphere, double W, double zout, TG_TEXT *out)
+{
+  double *data=NULL, z=0.0;
+  int rows=0, columns=0, i=0, status=0;
+
+  if ((rows = read_rows (atmosphere, 1, &data, &columns, NULL)) < 1)
+    return -1;
+
+  for (i=0; i<rows && status==0; i++)  {
+    z = data[(size_t) i * columns];
+    if (z > zout + TG_CLOUD_BOTTOM && z < zout + TG_CLOUD_TOP)
+      status = text_printf (out, "%g %g %g\n", z, W, TG_CLOUD_RM);
+    else
+      status = text_printf (out, "%g 0. 0.\n", z);
+  }
+
+  free (data);
+  return status;
+}
+
+
+static int grid (double start, double end, double step, double **x)
+{
+  int n=0, i=0;
+
+  if (step <= 0.0 || end < start)
+    return -1;
+  n = (int) floor ((end - start) / step + 1e-6) + 1;
+  if ((*x = (double *) calloc (n, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  for (i=0; i<n; i++)
+    (*x)[i] = start + i * step;
+  return n;
+}
+
+
+static int write_lambda (const char *path, const double *lambda, int n)
+{
+  TG_TEXT text;
+  int i=0, status=0;
+
+  memset (&text, 0, sizeof(TG_TEXT));
+  for (i=0; i<n && status==0; i++)
+    status = text_printf (&text, "%6.2f\n", lambda[i]);
+  if (status == 0)
+    status = write_file (path, text.data, text.size);
+  free (text.data);
+  return status;
+}
+
+
+/* the grid descriptor of the tables, see tablegrid.h */
+static int write_grid (const TG_RUN *run)
+{
+  const TABLEGEN_SPEC *spec = run->spec;
+  TABLE_GRID tg;
+  double *sza=NULL, *ozone=NULL;
+  int n_sza=0, n_ozone=0, n_coeff=0, i=0, status=0;
+
+  memset (&tg, 0, sizeof(TABLE_GRID));
+  tg.points = TABLEGRID_CUBIC;
+  if ((n_sza = grid (spec->sza_start, spec->sza_end, spec->sza_step, &sza)) < 1 ||
+      (n_ozone = grid (spec->ozone_start, spec->ozone_end, spec->ozone_step, &ozone)) < 1)  {
+    status = -1;
+    goto cleanup;
+  }
+  for (i=0; i<n_sza; i++)
+    if (sza[i] <= TABLEGEN_COEFF_SZA + 1e-6)
+      n_coeff = i+1;
+
+  if ((status = tablegrid_set (&tg, TABLEGRID_SZA, sza, n_sza)) == 0 &&
+      (status = tablegrid_set (&tg, TABLEGRID_OZONE, ozone, n_ozone)) == 0 &&
+      (status = tablegrid_set (&tg, TABLEGRID_ALT, run->alts, run->n_alts)) == 0 &&
+      (status = tablegrid_set (&tg, TABLEGRID_CLOUD, run->clouds, run->n_clouds)) == 0 &&
+      (status = tablegrid_set (&tg, TABLEGRID_COEFF_SZA, sza, n_coeff)) == 0 &&
+      (status = tablegrid_set (&tg, TABLEGRID_LAMBDA, run->reflectivity_lambda,
+			       run->n_reflectivity_lambda)) == 0)
+    status = tablegrid_write (&tg, spec->output);
+
+ cleanup:
+  tablegrid_free (&tg);
+  free (sza);
+  free (ozone);
+  return status;
+}
+
+
+static const char *wc_name (const TG_RUN *run, const TG_JOB *job)
+{
+  if (job->cloud < 0)
+    return "";
+  return run->wc_file + (size_t) (job->cloud * run->n_alts + job->alt) * (FILENAME_MAX+32);
+}
+
+
+/* the uvspec input of a job, see write_radtran_inp in produce_cloud_tables.pl */
+static int make_deck (const TG_RUN *run, const TG_JOB *job, TG_TEXT *deck)
+{
+  const TABLEGEN_SPEC *spec = run->spec;
+  const char *wc_file = wc_name (run, job);
+  double start=0.0, end=0.0, b=0.0, visibility=0.0;
+  int status=0;
+
+  /* visibility of the Angstrom beta, Iqbal 1983, as the scripts */
+  b = 0.0849870 - job->beta * pow (0.55, -spec->alpha);
+  visibility = (-b - sqrt (b*b - 4*(-0.000287246)*3.94486)) / (2*(-0.000287246));
+
+  if (job->kind == TABLEGEN_REFLECTIVITY || job->sample)  {
+    start = run->reflectivity_lambda[0];
+    end   = run->reflectivity_lambda[run->n_reflectivity_lambda - 1];
+  }
+  else  {
+    start = run->lambda[0];
+    end   = run->lambda[run->n_lambda - 1];
+  }
+
+  status |= text_printf (deck, "atmosphere_file %s\n", run->atmosphere[job->alt]);
+  status |= text_printf (deck, "ozone_column %10.4f\n", job->ozone);
+  status |= text_printf (deck, "albedo %10.4f\n", spec->albedo);
+  status |= text_printf (deck, "sza %10.4f\n", job->sza);
+  status |= text_printf (deck, "angstrom %10.4f %10.4f\n", spec->alpha, job->beta);
+  status |= text_printf (deck, "solar_file %s\n", run->solar_file);
+  status |= text_printf (deck, "aerosol_visibility %10.4f\n", visibility);
+  status |= text_printf (deck, "o3_crs Molina\n");
+  status |= text_printf (deck, "wvn %10.4f %10.4f\n", start, end);
+  status |= text_printf (deck, "aerosol_season 1\n");
+  status |= text_printf (deck, "aerosol_haze 1\n");
+  status |= text_printf (deck, "aerosol_vulcan 1\n");
+  if (spec->data_path != NULL)
+    status |= text_printf (deck, "data_files_path %s\n", spec->data_path);
+  status |= text_printf (deck, "deltam  on\n");
+  status |= text_printf (deck, "nstr  12\n");
+  if (wc_file[0] != 0)
+    status |= text_printf (deck, "wc_file  %s\n", wc_file);
+
+  if (job->kind == TABLEGEN_REFLECTIVITY)  {
+    /* diffuse illumination of the upside down atmosphere, seen from the top */
+    status |= text_printf (deck, "fisot\n");
+    status |= text_printf (deck, "reverse\n");
+    status |= text_printf (deck, "zout 120.0\n");
+    status |= text_printf (deck, "rte_solver disort\n");
+  }
+  else  {
+    status |= text_printf (deck, "zout %10.4f\n", run->alts[job->alt]);
+    /* sdisort is not suited for clouds, produce_cloudOD0_tables.pl */
+    status |= text_printf (deck, "rte_solver %s\n", wc_file[0] != 0 ? "disort" : "sdisort");
+  }
+
+  return (status != 0 ? -1 : 0);
+}
+
+
+static unsigned long long job_hash (const TG_RUN *run, const TG_JOB *job, const TG_TEXT *deck)
+{
+  unsigned long long hash = run->grid_hash;
+
+  hash = tablestore_hash (hash, deck->data, deck->size);
+  hash = tablestore_hash (hash, &run->atmosphere_hash[job->alt], sizeof(unsigned long long));
+  if (job->cloud < 0)
+    return hash;
+  return tablestore_hash (hash, &run->wc_hash[job->cloud * run->n_alts + job->alt],
+			  sizeof(unsigned long long));
+}
+
+
+static int compare_entries (const void *a, const void *b)
+{
+  const TG_ENTRY *x = (const TG_ENTRY *) a, *y = (const TG_ENTRY *) b;
+  int c = strcmp (x->name, y->name);
+
+  if (c != 0)
+    return c;
+  return (x->line < y->line ? -1 : x->line > y->line);
+}
+
+
+/* the latest hash of every table in the manifest, sorted by name */
+static int read_manifest (const char *path, TG_ENTRY **entries)
+{
+  FILE *f=NULL;
+  TG_ENTRY entry, *tmp=NULL;
+  char line[TG_NAME+64];
+  int n=0, max=0, i=0, j=0;
+
+  *entries = NULL;
+  if ((f = fopen (path, "r")) == NULL)
+    return 0;
+
+  memset (&entry, 0, sizeof(TG_ENTRY));
+  while (fgets (line, sizeof(line), f) != NULL)  {
+    if (sscanf (line, "%llx %127s", &entry.hash, entry.name) != 2)
+      continue;
+    if (n == max)  {
+      max = (max > 0 ? 2 * max : 1024);
+      if ((tmp = (TG_ENTRY *) realloc (*entries, max * sizeof(TG_ENTRY))) == NULL)  {
+	fclose (f);
+	return ASCII_NO_MEMORY;
+      }
+      *entries = tmp;
+    }
+    entry.line = n;
+    (*entries)[n++] = entry;
+  }
+  fclose (f);
+
+  /* a table may be appended several times, the last line counts */
+  qsort (*entries, n, sizeof(TG_ENTRY), compare_entries);
+  for (i=0, j=0; i<n; i++)  {
+    if (j > 0 && strcmp ((*entries)[j-1].name, (*entries)[i].name) == 0)
+      j--;
+    (*entries)[j++] = (*entries)[i];
+  }
+  return j;
+}
+
+
+static TG_ENTRY *find_entry (TG_ENTRY *entries, int n, const char *name)
+{
+  int lo=0, hi=n-1, mid=0, c=0;
+
+  while (lo <= hi)  {
+    mid = (lo + hi) / 2;
+    if ((c = strcmp (name, entries[mid].name)) == 0)
+      return &entries[mid];
+    if (c < 0)
+      hi = mid - 1;
+    else
+      lo = mid + 1;
+  }
+  return NULL;
+}
+
+
+static int write_manifest (const char *path, const TG_ENTRY *entries, int n_entries,
+			   const TG_JOB *jobs, long n_jobs)
+{
+  TG_TEXT text;
+  long i=0;
+  int status=0;
+
+  memset (&text, 0, sizeof(TG_TEXT));
+
+  /* tables of other specs stay valid */
+  for (i=0; i<n_entries && status==0; i++)
+    if (!entries[i].used)
+      status = text_printf (&text, "%016llx %s\n", entries[i].hash, entries[i].name);
+  for (i=0; i<n_jobs && status==0; i++)
+    if (jobs[i].status >= 0)
+      status = text_printf (&text, "%016llx %s\n", jobs[i].hash, jobs[i].name);
+
+  if (status == 0)
+    status = write_file (path, text.data != NULL ? text.data : "", text.size);
+  free (text.data);
+  return status;
+}
+
+
+static int run_solver (const char *solver, const char *deck, const char *out)
+{
+  posix_spawn_file_actions_t actions;
+  char *argv[4];
+  pid_t pid=0;
+  int status=0, wstatus=0;
+
+  argv[0] = (char *) "sh";
+  argv[1] = (char *) "-c";
+  argv[2] = (char *) solver;
+  argv[3] = NULL;
+
+  if (posix_spawn_file_actions_init (&actions) != 0)
+    return -1;
+  if (posix_spawn_file_actions_addopen (&actions, 0, deck, O_RDONLY, 0) != 0 ||
+      posix_spawn_file_actions_addopen (&actions, 1, out, O_WRONLY | O_CREAT | O_TRUNC, 0644) != 0 ||
+      posix_spawn (&pid, "/bin/sh", &actions, NULL, argv, environ) != 0)
+    status = -1;
+  posix_spawn_file_actions_destroy (&actions);
+  if (status != 0)
+    return status;
+
+  while (waitpid (pid, &wstatus, 0) < 0)
+    if (errno != EINTR)
+      return -1;
+
+  return (WIFEXITED (wstatus) && WEXITSTATUS (wstatus) == 0 ? 0 : -1);
+}
+
+
+/* the table of a job from the solver output: the reflectivity eup/pi */
+/* or the transmittance edir+edn, at the wavelengths of the table      */
+static int write_table (const TG_RUN *run, const TG_JOB *job, const char *out)
+{
+  int coarse = (job->kind == TABLEGEN_REFLECTIVITY || job->sample);
+  const double *lambda = (coarse ? run->reflectivity_lambda : run->lambda);
+  int n_lambda = (coarse ? run->n_reflectivity_lambda : run->n_lambda);
+  char path[FILENAME_MAX+TG_NAME+8];
+  double *data=NULL, *x=NULL, *y=NULL, *value=NULL;
+  TG_TEXT text;
+  int rows=0, columns=0, i=0, status=0;
+
+  memset (&text, 0, sizeof(TG_TEXT));
+  if ((rows = read_rows (out, 4, &data, &columns, NULL)) < 2)
+    return -1;
+
+  x     = (double *) calloc (rows, sizeof(double));
+  y     = (double *) calloc (rows, sizeof(double));
+  value = (double *) calloc (n_lambda, sizeof(double));
+  if (x == NULL || y == NULL || value == NULL)  {
+    status = ASCII_NO_MEMORY;
+    goto cleanup;
+  }
+
+  for (i=0; i<rows; i++)  {
+    x[i] = data[(size_t) i * columns];
+    y[i] = (job->kind == TABLEGEN_REFLECTIVITY ?
+	    data[(size_t) i * columns + 3] / TG_PI :
+	    data[(size_t) i * columns + 1] + data[(size_t) i * columns + 2]);
+  }
+
+  /* the spline is linear in y, so the sum may be splined */
+  if ((status = resample (x, y, rows, lambda, n_lambda, value)) != 0)
+    goto cleanup;
+
+  for (i=0; i<n_lambda && status==0; i++)
+    status = text_printf (&text, job->kind == TABLEGEN_REFLECTIVITY ? "%13.6e\n" : "%12.6e\n",
+			  value[i]);
+
+  snprintf (path, sizeof(path), "%s/%s", run->spec->output, job->name);
+  if (status == 0)
+    status = write_file (path, text.data, text.size);
+
+ cleanup:
+  free (data);
+  free (x);
+  free (y);
+  free (value);
+  free (text.data);
+  return status;
+}
+
+
+static int tablegen_task (void *arg, TASKPOOL_WORKER *worker, long first, long n)
+{
+  TG_RUN *run = (TG_RUN *) arg;
+  TG_JOB *job=NULL;
+  TG_TEXT deck;
+  char deck_file[FILENAME_MAX+64], out_file[FILENAME_MAX+64];
+  long i=0;
+  double t0=0.0;
+
+  (void) worker;
+  memset (&deck, 0, sizeof(TG_TEXT));
+
+  for (i=first; i<first+n; i++)  {
+    job = &run->jobs[run->todo[i]];
+    snprintf (deck_file, sizeof(deck_file), "%s/job%ld.inp", run->work, run->todo[i]);
+    snprintf (out_file, sizeof(out_file), "%s/job%ld.out", run->work, run->todo[i]);
+
+    deck.size = 0;
+    t0 = now ();
+    if (make_deck (run, job, &deck) != 0 ||
+	write_file (deck_file, deck.data, deck.size) != 0 ||
+	run_solver (run->spec->solver, deck_file, out_file) != 0)
+      job->status = -1;
+    job->seconds = now () - t0;
+
+    if (job->status == 0 && write_table (run, job, out_file) != 0)
+      job->status = -2;
+
+    if (run->spec->verbose)
+      fprintf (stderr, "%s %.2f s%s\n", job->name, job->seconds,
+	       job->status == -1 ? ", solver failed" : job->status < 0 ? ", bad output" : "");
+
+    /* the work files of failed jobs are kept for inspection */
+    if (job->status != 0)
+      continue;
+    unlink (deck_file);
+    unlink (out_file);
+
+    pthread_mutex_lock (&run->lock);
+    fprintf (run->manifest, "%016llx %s\n", job->hash, job->name);
+    fflush (run->manifest);
+    pthread_mutex_unlock (&run->lock);
+  }
+
+  free (deck.data);
+  return 0;
+}
+
+
+static const char *set_directory[3] = {
+  TABLEGEN_SAMPLES "/TransmittancesCloudH2O0.000_beta",
+  TABLEGEN_SAMPLES "/AtmosphericReflectivitiesCloudH2O0.000_beta",
+  TABLEGEN_SAMPLES "/AtmosphericReflectivitiesCloudH2O0.000_ozone" };
+
+static const char *coeff_directory[3] = {
+  "TransmittancesCloudH2O0.000_coeffs_beta",
+  "AtmosphericReflectivitiesCloudH2O0.000_coeffs_beta",
+  "AtmosphericReflectivitiesCloudH2O0.000_coeffs_ozone" };
+
+
+static int make_directory_of (const char *root, const char *name)
+{
+  char path[FILENAME_MAX+TG_NAME+8];
+
+  snprintf (path, sizeof(path), "%s/%s", root, name);
+  return make_directory (path);
+}
+
+
+/* the table of a sample: value is beta or ozone; the reference */
+/* of the ozone set is the sample at TABLEGEN_BETA0              */
+static void sample_name (char *name, int set, double sza, double alt, double value)
+{
+  if (set == TG_SET_REFLECTIVITY_OZONE && fabs (value - TABLEGEN_O30) < 1e-9)  {
+    set   = TG_SET_REFLECTIVITY_BETA;
+    value = TABLEGEN_BETA0;
+  }
+
+  if (set == TG_SET_TRANSMITTANCE_BETA)
+    snprintf (name, TG_NAME, "%s/sza%galt%gbeta%5.3f", set_directory[set], sza, alt, value);
+  else if (set == TG_SET_REFLECTIVITY_BETA)
+    snprintf (name, TG_NAME, "%s/alt%gbeta%5.3f", set_directory[set], alt, value);
+  else
+    snprintf (name, TG_NAME, "%s/alt%gozone%g", set_directory[set], alt, value);
+}
+
+
+/* the values of a sample set other than the reference */
+static int sample_values (const double *values, int n, double reference, double **out)
+{
+  int i=0, m=0;
+
+  if ((*out = (double *) calloc (n > 0 ? n : 1, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  for (i=0; i<n; i++)
+    if (fabs (values[i] - reference) > 1e-9)
+      (*out)[m++] = values[i];
+  return m;
+}
+
+
+/* the grids of the spec */
+static int setup (TG_RUN *run)
+{
+  const TABLEGEN_SPEC *spec = run->spec;
+  double *data=NULL, *sza=NULL, zstep=0.0;
+  int z=0, i=0, n=0, columns=0;
+
+  if (spec->clouds != NULL)  {
+    run->clouds   = spec->clouds;
+    run->n_clouds = spec->n_clouds;
+  }
+  else
+    run->n_clouds = fastrt_cloud_levels (&run->clouds);
+
+  zstep = (spec->alt_top - spec->alt_low) / 2.0;
+  run->n_alts = (zstep > 0.0 ? TG_MAX_ALTS : 1);
+  for (z=0; z<run->n_alts; z++)
+    run->alts[z] = spec->alt_low + z * zstep;
+
+  /* wavelengths */
+  if (spec->lambdafile != NULL)  {
+    if ((run->n_lambda = read_rows (spec->lambdafile, 1, &data, &columns, NULL)) < 2)
+      return -1;
+    if ((run->lambda = (double *) calloc (run->n_lambda, sizeof(double))) == NULL)  {
+      free (data);
+      return ASCII_NO_MEMORY;
+    }
+    for (i=0; i<run->n_lambda; i++)
+      run->lambda[i] = data[(size_t) i * columns];
+    free (data);
+  }
+  else if ((run->n_lambda = grid (spec->lambda_start, spec->lambda_end, spec->lambda_step,
+				  &run->lambda)) < 2)
+    return -1;
+
+  if ((run->n_reflectivity_lambda = grid (spec->lambda_start, spec->lambda_end,
+					  spec->reflectivity_step, &run->reflectivity_lambda)) < 2)
+    return -1;
+
+  run->grid_hash = tablestore_hash (0, spec->solver, strlen (spec->solver));
+  run->grid_hash = tablestore_hash (run->grid_hash, run->lambda, run->n_lambda * sizeof(double));
+  run->grid_hash = tablestore_hash (run->grid_hash, run->reflectivity_lambda,
+				    run->n_reflectivity_lambda * sizeof(double));
+
+  if (!spec->coefficients)
+    return 0;
+
+  if (spec->betas != NULL)
+    run->n_betas = sample_values (spec->betas, spec->n_betas, TABLEGEN_BETA0, &run->betas);
+  else
+    run->n_betas = sample_values (default_betas, sizeof(default_betas) / sizeof(double),
+				  TABLEGEN_BETA0, &run->betas);
+  if (spec->ozones != NULL)
+    run->n_ozones = sample_values (spec->ozones, spec->n_ozones, TABLEGEN_O30, &run->ozones);
+  else
+    run->n_ozones = sample_values (default_ozones, sizeof(default_ozones) / sizeof(double),
+				   TABLEGEN_O30, &run->ozones);
+  if (run->n_betas < 1 || run->n_ozones < 1)
+    return -1;
+
+  /* the engine rounds sza to the coefficient files */
+  if ((n = grid (spec->sza_start, spec->sza_end, spec->sza_step, &sza)) < 1)
+    return -1;
+  run->coeff_sza = sza;
+  for (i=0; i<n; i++)
+    if (sza[i] <= TABLEGEN_COEFF_SZA + 1e-6)
+      run->n_coeff_sza = i+1;
+  return (run->n_coeff_sza > 0 ? 0 : -1);
+}
+
+
+/* the inputs shared by the jobs, see tablegen.c */
+static int prepare (TG_RUN *run)
+{
+  const TABLEGEN_SPEC *spec = run->spec;
+  char path[FILENAME_MAX+TG_NAME+64], *wc=NULL;
+  TG_TEXT text;
+  int c=0, z=0, i=0, status=0;
+
+  memset (&text, 0, sizeof(TG_TEXT));
+
+  /* the work directory */
+  snprintf (run->work, sizeof(run->work), "%s/" TABLEGEN_WORK, spec->output);
+  if (make_directory (spec->output) != 0 || make_directory (run->work) != 0)
+    return -1;
+
+  /* unit extraterrestrial flux, so that the solver yields transmittances */
+  snprintf (run->solar_file, sizeof(run->solar_file), "%s/unit_solar_file", run->work);
+  status = text_printf (&text, "#unit extraterrestrial fluxes to obtain atmospheric transmission\n");
+  for (i=0; i<4400 && status==0; i++)
+    status = text_printf (&text, "%6.2f %8.5f\n", 200.0 + i * 0.05, 1.0);
+  if (status != 0 || (status = write_file (run->solar_file, text.data, text.size)) != 0)
+    goto cleanup;
+
+  /* the atmosphere above every altitude */
+  for (z=0; z<run->n_alts && status==0; z++)  {
+    text.size = 0;
+    snprintf (run->atmosphere[z], sizeof(run->atmosphere[z]), "%s/atmosphere_alt%g",
+	      run->work, run->alts[z]);
+    if ((status = atmosphere_at (spec->atmosphere, run->alts[z], &text)) == 0 &&
+	(status = write_file (run->atmosphere[z], text.data, text.size)) == 0)
+      run->atmosphere_hash[z] = tablestore_hash (0, text.data, text.size);
+  }
+  if (status != 0)
+    goto cleanup;
+
+  /* the cloud of every water content and altitude, none for clear sky */
+  run->wc_file = (char *) calloc ((size_t) run->n_clouds * run->n_alts, FILENAME_MAX+32);
+  run->wc_hash = (unsigned long long *) calloc ((size_t) run->n_clouds * run->n_alts,
+						sizeof(unsigned long long));
+  if (run->wc_file == NULL || run->wc_hash == NULL)  {
+    status = ASCII_NO_MEMORY;
+    goto cleanup;
+  }
+
+  for (c=0; c<run->n_clouds && status==0; c++)  {
+    snprintf (path, sizeof(path), "%s/AtmosphericReflectivitiesCloudH2O%5.3f", spec->output,
+	      run->clouds[c]);
+    if ((status = make_directory (path)) != 0)
+      break;
+    strcat (path, "/rawlambdafile");
+    if ((status = write_lambda (path, run->reflectivity_lambda, run->n_reflectivity_lambda)) != 0)
+      break;
+
+    snprintf (path, sizeof(path), "%s/TransmittancesCloudH2O%5.3f", spec->output, run->clouds[c]);
+    if ((status = make_directory (path)) != 0)
+      break;
+    strcat (path, "/rawlambdafile");
+    if ((status = write_lambda (path, run->lambda, run->n_lambda)) != 0)
+      break;
+
+    if (run->clouds[c] <= 0.0)
+      continue;
+    for (z=0; z<run->n_alts && status==0; z++)  {
+      text.size = 0;
+      wc = run->wc_file + (size_t) (c * run->n_alts + z) * (FILENAME_MAX+32);
+      snprintf (wc, FILENAME_MAX+32, "%s/wc%5.3f_alt%g", run->work, run->clouds[c], run->alts[z]);
+      if ((status = cloud_at (run->atmosphere[z], run->clouds[c], run->alts[z], &text)) == 0 &&
+	  (status = write_file (wc, text.data, text.size)) == 0)
+	run->wc_hash[c * run->n_alts + z] = tablestore_hash (0, text.data, text.size);
+    }
+  }
+
+  if (status == 0)
+    status = write_grid (run);
+
+  for (c=0; c<3 && spec->coefficients && status==0; c++)  {
+    snprintf (path, sizeof(path), "%s/%s", spec->output, set_directory[c]);
+    *strrchr (path, '/') = 0;
+    if ((status = make_directory (path)) == 0)
+      status = make_directory_of (spec->output, set_directory[c]);
+  }
+
+ cleanup:
+  free (text.data);
+  return status;
+}
+
+
+/* all jobs, cloud by cloud as the scripts */
+static int enumerate (TG_RUN *run)
+{
+  const TABLEGEN_SPEC *spec = run->spec;
+  double *sza=NULL, *ozone=NULL;
+  TG_JOB *job=NULL;
+  int n_sza=0, n_ozone=0, c=0, z=0, i=0, j=0;
+
+  if ((n_sza = grid (spec->sza_start, spec->sza_end, spec->sza_step, &sza)) < 1 ||
+      (n_ozone = grid (spec->ozone_start, spec->ozone_end, spec->ozone_step, &ozone)) < 1)  {
+    free (sza);
+    return -1;
+  }
+
+  run->n_jobs = (long) run->n_clouds * run->n_alts * (1 + (long) n_sza * n_ozone);
+  if (spec->coefficients)
+    run->n_jobs += (long) run->n_alts * ((long) run->n_coeff_sza * (1 + run->n_betas) +
+					 1 + run->n_betas + run->n_ozones);
+  run->jobs   = (TG_JOB *) calloc (run->n_jobs, sizeof(TG_JOB));
+  run->todo   = (long *) calloc (run->n_jobs, sizeof(long));
+  if (run->jobs == NULL || run->todo == NULL)  {
+    free (sza);
+    free (ozone);
+    return ASCII_NO_MEMORY;
+  }
+
+  job = run->jobs;
+  for (c=0; c<run->n_clouds; c++)  {
+    for (z=0; z<run->n_alts; z++, job++)  {
+      job->kind  = TABLEGEN_REFLECTIVITY;
+      job->cloud = c;
+      job->alt   = z;
+      job->ozone = TG_REFLECTIVITY_OZONE;
+      job->beta  = spec->beta;
+      snprintf (job->name, TG_NAME, "AtmosphericReflectivitiesCloudH2O%5.3f/alt%g",
+		run->clouds[c], run->alts[z]);
+    }
+    for (z=0; z<run->n_alts; z++)
+      for (i=0; i<n_sza; i++)
+	for (j=0; j<n_ozone; j++, job++)  {
+	  job->kind  = TABLEGEN_TRANSMITTANCE;
+	  job->cloud = c;
+	  job->alt   = z;
+	  job->sza   = (sza[i] == 0.0 ? TG_SZA_MIN : sza[i]);
+	  job->ozone = ozone[j];
+	  job->beta  = spec->beta;
+	  snprintf (job->name, TG_NAME, "TransmittancesCloudH2O%5.3f/sza%gozone%galt%g",
+		    run->clouds[c], sza[i], ozone[j], run->alts[z]);
+	}
+  }
+
+  /* the samples of the coefficient files, clear sky */
+  for (z=0; z<run->n_alts && spec->coefficients; z++)  {
+    for (i=0; i<run->n_coeff_sza; i++)
+      for (j=-1; j<run->n_betas; j++, job++)  {
+	job->kind   = TABLEGEN_TRANSMITTANCE;
+	job->sample = 1;
+	job->cloud  = -1;
+	job->alt    = z;
+	job->sza    = (run->coeff_sza[i] == 0.0 ? TG_SZA_MIN : run->coeff_sza[i]);
+	job->ozone  = TABLEGEN_O30;
+	job->beta   = (j < 0 ? TABLEGEN_BETA0 : run->betas[j]);
+	sample_name (job->name, TG_SET_TRANSMITTANCE_BETA, run->coeff_sza[i], run->alts[z], job->beta);
+      }
+    for (j=-1; j<run->n_betas + run->n_ozones; j++, job++)  {
+      job->kind   = TABLEGEN_REFLECTIVITY;
+      job->sample = 1;
+      job->cloud  = -1;
+      job->alt    = z;
+      job->ozone  = (j < run->n_betas ? TABLEGEN_O30 : run->ozones[j - run->n_betas]);
+      job->beta   = (j < 0 ? TABLEGEN_BETA0 : j < run->n_betas ? run->betas[j] : TABLEGEN_BETA0);
+      if (j < run->n_betas)
+	sample_name (job->name, TG_SET_REFLECTIVITY_BETA, 0.0, run->alts[z], job->beta);
+      else
+	sample_name (job->name, TG_SET_REFLECTIVITY_OZONE, 0.0, run->alts[z], job->ozone);
+    }
+  }
+
+  free (sza);
+  free (ozone);
+  return 0;
+}
+
+
+
+/* the coefficient files of the samples */
+static int enumerate_fits (TG_RUN *run)
+{
+  TG_FIT *fit=NULL;
+  int z=0, i=0, set=0, rows=run->n_reflectivity_lambda;
+
+  run->n_fits = run->n_alts * (run->n_coeff_sza + 2);
+  if ((run->fits = (TG_FIT *) calloc (run->n_fits, sizeof(TG_FIT))) == NULL)
+    return ASCII_NO_MEMORY;
+
+  fit = run->fits;
+  for (z=0; z<run->n_alts; z++)
+    for (i=-2; i<run->n_coeff_sza; i++, fit++)  {
+      fit->set = (i >= 0 ? TG_SET_TRANSMITTANCE_BETA :
+		  i == -2 ? TG_SET_REFLECTIVITY_BETA : TG_SET_REFLECTIVITY_OZONE);
+      fit->alt = z;
+      if (i >= 0)  {
+	fit->sza = run->coeff_sza[i];
+	snprintf (fit->name, TG_NAME, "%s/sza%galt%g", coeff_directory[fit->set], fit->sza,
+		  run->alts[z]);
+      }
+      else
+	snprintf (fit->name, TG_NAME, "%s/alt%g", coeff_directory[fit->set], run->alts[z]);
+
+      if ((fit->rms = (double *) calloc (2 * rows, sizeof(double))) == NULL)
+	return ASCII_NO_MEMORY;
+      fit->max = fit->rms + rows;
+    }
+
+  for (set=0; set<3; set++)
+    if (make_directory_of (run->spec->output, coeff_directory[set]) != 0)
+      return -1;
+  return 0;
+}
+
+
+/* one spectrum of rows values, on the grid of the coefficient files */
+static int read_sample (const TG_RUN *run, int set, const TG_FIT *fit, double value, double *y)
+{
+  char name[TG_NAME], path[FILENAME_MAX+TG_NAME+8];
+  double *data=NULL;
+  int rows=0, columns=0, i=0;
+
+  sample_name (name, set, fit->sza, run->alts[fit->alt], value);
+  snprintf (path, sizeof(path), "%s/%s", run->spec->output, name);
+  if ((rows = read_rows (path, 1, &data, &columns, NULL)) != run->n_reflectivity_lambda)  {
+    free (data);
+    return -1;
+  }
+  for (i=0; i<rows; i++)
+    y[i] = data[(size_t) i * columns];
+  free (data);
+  return 0;
+}
+
+
+/* the coefficients of one file: for every wavelength the ratios */
+/* y[l*n + k] of the samples to the reference, at x[k]            */
+static int fit_node (const TG_RUN *run, TG_FIT *fit)
+{
+  const double *values = (fit->set == TG_SET_REFLECTIVITY_OZONE ? run->ozones : run->betas);
+  double reference = (fit->set == TG_SET_REFLECTIVITY_OZONE ? TABLEGEN_O30 : TABLEGEN_BETA0);
+  int n = 1 + (fit->set == TG_SET_REFLECTIVITY_OZONE ? run->n_ozones : run->n_betas);
+  int rows = run->n_reflectivity_lambda, k=0, l=0, status=0;
+  char path[FILENAME_MAX+TG_NAME+8];
+  double *x=NULL, *y=NULL, *base=NULL, *sample=NULL, *c0=NULL, *c1=NULL, r=0.0;
+  TG_TEXT text;
+
+  memset (&text, 0, sizeof(TG_TEXT));
+
+  x      = (double *) calloc (n, sizeof(double));
+  y      = (double *) calloc ((size_t) rows * n, sizeof(double));
+  base   = (double *) calloc (4 * rows, sizeof(double));
+  if (x == NULL || y == NULL || base == NULL)  {
+    status = ASCII_NO_MEMORY;
+    goto cleanup;
+  }
+  sample = base + rows;
+  c0     = sample + rows;
+  c1     = c0 + rows;
+
+  if ((status = read_sample (run, fit->set, fit, reference, base)) != 0)
+    goto cleanup;
+
+  for (l=0; l<rows; l++)
+    y[(size_t) l * n] = 1.0;
+  for (k=1; k<n && status==0; k++)  {
+    x[k] = values[k-1] - reference;
+    if ((status = read_sample (run, fit->set, fit, values[k-1], sample)) != 0)
+      break;
+    for (l=0; l<rows; l++)
+      y[(size_t) l * n + k] = (base[l] != 0.0 ? sample[l] / base[l] : 1.0);
+  }
+  if (status != 0)
+    goto cleanup;
+
+  /* the ratio is 1 at the reference, the form of the engine */
+  if ((status = parabolafit_fixed (x, y, n, rows, 1.0, c0, c1)) != 0)
+    goto cleanup;
+
+  for (l=0; l<rows && status==0; l++)  {
+    fit->rms[l] = fit->max[l] = 0.0;
+    for (k=0; k<n; k++)  {
+      r = 1.0 + c0[l] * x[k] + c1[l] * x[k] * x[k] - y[(size_t) l * n + k];
+      fit->rms[l] += r * r;
+      if (fabs (r) > fit->max[l])
+	fit->max[l] = fabs (r);
+    }
+    fit->rms[l] = sqrt (fit->rms[l] / n);
+    status = text_printf (&text, "%13g%13g\n", c0[l], c1[l]);
+  }
+
+  snprintf (path, sizeof(path), "%s/%s", run->spec->output, fit->name);
+  if (status == 0)
+    status = write_file (path, text.data, text.size);
+
+ cleanup:
+  free (x);
+  free (y);
+  free (base);
+  free (text.data);
+  return status;
+}
+
+
+static int fit_task (void *arg, TASKPOOL_WORKER *worker, long first, long n)
+{
+  TG_RUN *run = (TG_RUN *) arg;
+  long i=0;
+
+  (void) worker;
+  for (i=first; i<first+n; i++)
+    run->fits[i].status = fit_node (run, &run->fits[i]);
+  return 0;
+}
+
+
+/* all coefficient files in parallel, then the residuals */
+static int fit_all (TG_RUN *run, TABLEGEN_STATS *st)
+{
+  const TABLEGEN_SPEC *spec = run->spec;
+  char path[FILENAME_MAX+32];
+  TASKPOOL_JOB job;
+  TG_TEXT text;
+  int i=0, l=0, status=0;
+
+  memset (&text, 0, sizeof(TG_TEXT));
+  if ((status = enumerate_fits (run)) != 0)
+    return status;
+
+  job.init = NULL;
+  job.run  = fit_task;
+  job.fini = NULL;
+  job.arg  = run;
+  if ((status = taskpool_run (NULL, &job, run->n_fits, 1, taskpool_threads (spec->max_jobs),
+			      TASKPOOL_STEAL, NULL)) != 0)
+    return status;
+
+  status = text_printf (&text, "# coefficient file, wavelength [nm], rms and largest residual\n");
+  for (i=0; i<run->n_fits && status==0; i++)  {
+    if (run->fits[i].status != 0)  {
+      fprintf (stderr, "Error, cannot fit %s\n", run->fits[i].name);
+      status = -1;
+      break;
+    }
+    st->fitted++;
+    for (l=0; l<run->n_reflectivity_lambda && status==0; l++)  {
+      if (run->fits[i].max[l] > st->max_residual)
+	st->max_residual = run->fits[i].max[l];
+      status = text_printf (&text, "%s %6.2f %10.3e %10.3e\n", run->fits[i].name,
+			    run->reflectivity_lambda[l], run->fits[i].rms[l], run->fits[i].max[l]);
+    }
+  }
+
+  snprintf (path, sizeof(path), "%s/" TABLEGEN_RESIDUALS, spec->output);
+  if (status == 0)
+    status = write_file (path, text.data, text.size);
+  free (text.data);
+  return status;
+}
+
+
+static void free_run (TG_RUN *run)
+{
+  int i=0;
+
+  for (i=0; i<run->n_fits; i++)
+    free (run->fits[i].rms);
+  free (run->fits);
+  free (run->lambda);
+  free (run->reflectivity_lambda);
+  free (run->betas);
+  free (run->ozones);
+  free (run->coeff_sza);
+  free (run->wc_file);
+  free (run->wc_hash);
+  free (run->jobs);
+  free (run->todo);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegen_spec_init                                                    */
+/* Description:                                                                    */
+/*  Set the defaults of produce_cloud_tables.pl, but with the sza range of the     */
+/*  shipped tables: sza 0..93 by 3, ozone 100..600 by 20 DU, altitudes 0, 3 and   */
+/*  6 km, 290..405 nm by 0.5 nm, reflectivities by 10 nm, the cloud levels of the  */
+/*  engine, uvspec as solver.                                                      */
+/***********************************************************************************/
+
+void tablegen_spec_init (TABLEGEN_SPEC *spec)
+{
+  memset (spec, 0, sizeof(TABLEGEN_SPEC));
+
+  spec->solver            = "uvspec";
+  spec->lambda_start      = 290.0;
+  spec->lambda_end        = 405.0;
+  spec->lambda_step       = 0.5;
+  spec->reflectivity_step = 10.0;
+  spec->sza_start         = 0.0;
+  spec->sza_end           = 93.0;
+  spec->sza_step          = DELTA_SZA;
+  spec->ozone_start       = 100.0;
+  spec->ozone_end         = 600.0;
+  spec->ozone_step        = DELTA_O3;
+  spec->alt_low           = 0.0;
+  spec->alt_top           = 2 * DELTA_ALT;
+  spec->alpha             = 1.3;
+  spec->beta              = 0.02;
+  spec->albedo            = 0.0;
+  spec->pack_kind         = PACK_LOG16;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegen_run                                                          */
+/* Description:                                                                    */
+/*  Run the jobs of spec whose inputs changed since the last run, or all of them  */
+/*  with spec->force, write their tables and, if there is no failed job, the pack. */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  const TABLEGEN_SPEC *spec:  Solver, grids and output.                          */
+/*  TABLEGEN_STATS *stats:      Statistics, set by function, may be NULL.          */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., 1 if jobs failed, <0 if error.                                     */
+/***********************************************************************************/
+
+int tablegen_run (const TABLEGEN_SPEC *spec, TABLEGEN_STATS *stats)
+{
+  TG_RUN run;
+  TG_TEXT deck;
+  TG_ENTRY *entries=NULL, *entry=NULL;
+  TABLEGEN_STATS st;
+  TASKPOOL_JOB job;
+  struct stat sb;
+  char manifest[FILENAME_MAX+32], path[FILENAME_MAX+TG_NAME+8];
+  long i=0, n_todo=0;
+  int n_entries=0, status=0;
+  double t0=now();
+
+  memset (&run, 0, sizeof(TG_RUN));
+  memset (&deck, 0, sizeof(TG_TEXT));
+  memset (&st, 0, sizeof(TABLEGEN_STATS));
+
+  if (spec == NULL || spec->solver == NULL || spec->atmosphere == NULL || spec->output == NULL ||
+      spec->alt_top < spec->alt_low || spec->n_clouds < 0)
+    return -1;
+
+  run.spec = spec;
+  pthread_mutex_init (&run.lock, NULL);
+
+  if ((status = setup (&run)) != 0 || (status = prepare (&run)) != 0 ||
+      (status = enumerate (&run)) != 0)
+    goto cleanup;
+
+  snprintf (manifest, sizeof(manifest), "%s/" TABLEGEN_MANIFEST, spec->output);
+  if ((n_entries = read_manifest (manifest, &entries)) < 0)  {
+    status = n_entries;
+    goto cleanup;
+  }
+
+  /* the jobs whose inputs changed */
+  for (i=0; i<run.n_jobs; i++)  {
+    deck.size = 0;
+    if ((status = make_deck (&run, &run.jobs[i], &deck)) != 0)
+      goto cleanup;
+    run.jobs[i].hash = job_hash (&run, &run.jobs[i], &deck);
+
+    snprintf (path, sizeof(path), "%s/%s", spec->output, run.jobs[i].name);
+    if ((entry = find_entry (entries, n_entries, run.jobs[i].name)) != NULL)
+      entry->used = 1;
+    if (!spec->force && entry != NULL && entry->hash == run.jobs[i].hash &&
+	stat (path, &sb) == 0 && S_ISREG (sb.st_mode))
+      run.jobs[i].status = 1;
+    else
+      run.todo[n_todo++] = i;
+  }
+
+  if ((run.manifest = fopen (manifest, "a")) == NULL)  {
+    status = -1;
+    goto cleanup;
+  }
+
+  job.init = NULL;
+  job.run  = tablegen_task;
+  job.fini = NULL;
+  job.arg  = &run;
+
+  /* one job per task: the workers wait for their solvers, */
+  /* so the number of threads bounds the solvers at a time  */
+  if (n_todo > 0)
+    status = taskpool_run (NULL, &job, n_todo, 1, taskpool_threads (spec->max_jobs),
+			   TASKPOOL_STEAL, NULL);
+  fclose (run.manifest);
+  run.manifest = NULL;
+  if (status != 0)
+    goto cleanup;
+
+  for (i=0; i<run.n_jobs; i++)  {
+    if (run.jobs[i].status == 1)
+      st.skipped++;
+    else  {
+      st.run++;
+      st.solver_seconds += run.jobs[i].seconds;
+      if (run.jobs[i].status < 0)
+	st.failed++;
+    }
+  }
+
+  /* one line per table again */
+  if ((status = write_manifest (manifest, entries, n_entries, run.jobs, run.n_jobs)) != 0)
+    goto cleanup;
+
+  if (st.failed > 0)  {
+    status = 1;
+    goto cleanup;
+  }
+
+  if (spec->coefficients && (status = fit_all (&run, &st)) != 0)
+    goto cleanup;
+
+  if (spec->pack != NULL)
+    status = pack_build (spec->output, spec->pack, spec->pack_kind, 0.0, NULL);
+
+ cleanup:
+  st.jobs    = run.n_jobs;
+  st.seconds = now() - t0;
+  if (stats != NULL)
+    *stats = st;
+
+  if (run.manifest != NULL)
+    fclose (run.manifest);
+  pthread_mutex_destroy (&run.lock);
+  free (entries);
+  free (deck.data);
+  free_run (&run);
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegen_fit                                                          */
+/* Description:                                                                    */
+/*  Fit the coefficient files of spec from the samples of an earlier tablegen_run  */
+/*  with coefficients, without running the solver.                                 */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  const TABLEGEN_SPEC *spec:  Grids, sample values and output.                   */
+/*  TABLEGEN_STATS *stats:      Statistics, set by function, may be NULL.          */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error, e.g. a sample is missing.                             */
+/***********************************************************************************/
+
+int tablegen_fit (const TABLEGEN_SPEC *spec, TABLEGEN_STATS *stats)
+{
+  TABLEGEN_SPEC fit_spec;
+  TABLEGEN_STATS st;
+  TG_RUN run;
+  int status=0;
+  double t0=now();
+
+  memset (&run, 0, sizeof(TG_RUN));
+  memset (&st, 0, sizeof(TABLEGEN_STATS));
+
+  if (spec == NULL || spec->output == NULL || spec->solver == NULL)
+    return -1;
+
+  fit_spec = *spec;
+  fit_spec.coefficients = 1;
+  run.spec = &fit_spec;
+
+  if ((status = setup (&run)) == 0)
+    status = fit_all (&run, &st);
+
+  st.seconds = now() - t0;
+  if (stats != NULL)
+    *stats = st;
+
+  free_run (&run);
+  return status;
+}
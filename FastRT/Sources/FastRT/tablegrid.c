@@ -0,0 +1,683 @@
+/************************************************************************/
+/* tablegrid.c                                                          */
+/*                                                                      */
+/* Grid descriptor of a set of fastrt tables, see tablegrid.h.          */
+/*                                                                      */
+/* The neighbours of a value on an axis are those fastrt_compute()      */
+/* interpolates from: the node at or below it, one before and two       */
+/* after. Neighbours beyond the axis have no table and are left out of  */
+/* the spline, as the nodes without a table file always were; they are  */
+/* spaced as the first or last two nodes. Below a solar zenith angle    */
+/* axis starting at 0 the nodes are mirrored instead, sza -3 being read */
+/* from the table of sza 3.                                             */
+/*                                                                      */
+/* With linear interpolation the neighbours are the two nodes around    */
+/* the value, the first or last two nodes outside the axis, so the      */
+/* tables extrapolate linearly and no neighbour is ever missing.        */
+/*                                                                      */
+/* The span of a range of values are the nodes any value of the range   */
+/* interpolates from. Since the neighbours only move up with the value, */
+/* those are the nodes from the first neighbour of the smallest value   */
+/* to the last of the largest.                                          */
+/*                                                                      */
+/* Without an engine the grid is read once per process and directory of */
+/* the tables, see tablegrid_shared(), and kept until the process ends. */
+/*                                                                      */
+/************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "tablegrid.h"
+#include "fastrt_.h"
+#include "ascii.h"
+
+
+static const char *axis_name[TABLEGRID_AXES] = {
+  "sza", "ozone", "alt", "cloud", "coeffs_sza", "coeffs_lambda"
+};
+
+/* start, start+step, ... end */
+static int set_uniform (TABLE_AXIS *axis, double start, double step, int n)
+{
+  int i=0;
+
+  if ((axis->x = (double *) calloc (n, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  for (i=0; i<n; i++)
+    axis->x[i] = start + i * step;
+  axis->n = n;
+  return 0;
+}
+
+
+/* the grid of the original tables */
+static int set_default (TABLE_GRID *grid, int axis)
+{
+  const double *levels=NULL;
+  int n=0;
+
+  switch (axis)  {
+  case TABLEGRID_SZA:       return set_uniform (&grid->axis[axis], 0.0, 3.0, 32);
+  case TABLEGRID_OZONE:     return set_uniform (&grid->axis[axis], 100.0, 20.0, 26);
+  case TABLEGRID_ALT:       return set_uniform (&grid->axis[axis], 0.0, 3.0, 3);
+  case TABLEGRID_COEFF_SZA: return set_uniform (&grid->axis[axis], 0.0, 3.0, 31);
+  case TABLEGRID_LAMBDA:    return set_uniform (&grid->axis[axis], 290.0, 10.0, 12);
+  case TABLEGRID_CLOUD:
+    n = fastrt_cloud_levels (&levels);
+    return tablegrid_set (grid, axis, levels, n);
+  }
+  return -1;
+}
+
+
+static int read_points (TABLE_STORE *store, int *points)
+{
+  TABLE_NODE *node=NULL;
+  int status=0;
+
+  *points = TABLEGRID_CUBIC;
+  if ((status = tablestore_get (store, "./" TABLEGRID_DIRECTORY "/points", &node)) != 0)
+    return status;
+
+  if (node->status == 0)  {
+    if (node->rows < 1)
+      status = -1;
+    else
+      *points = (int) node->data[0];
+  }
+  tablestore_release (store, node);
+
+  if (status == 0 && *points != TABLEGRID_CUBIC && *points != TABLEGRID_LINEAR)  {
+    fprintf (stderr, "Error, %d points in ./" TABLEGRID_DIRECTORY "/points, %d or %d expected\n",
+	     *points, TABLEGRID_CUBIC, TABLEGRID_LINEAR);
+    status = -1;
+  }
+  return status;
+}
+
+
+/* Grid/sza_range etc., one row "min max" */
+static int read_range (TABLE_STORE *store, int axis, TABLE_RANGE *range)
+{
+  char filename[FILENAME_MAX]="";
+  TABLE_NODE *node=NULL;
+  int status=0;
+
+  memset (range, 0, sizeof(TABLE_RANGE));
+  sprintf (filename, "./" TABLEGRID_DIRECTORY "/%s_range", axis_name[axis]);
+  if ((status = tablestore_get (store, filename, &node)) != 0)
+    return status;
+
+  if (node->status == 0)  {
+    if (node->rows < 1 || abs (node->columns) < 2 || node->data[0] > node->data[1])  {
+      fprintf (stderr, "Error, %s does not hold one row min max\n", filename);
+      status = -1;
+    }
+    else  {
+      range->set = 1;
+      range->min = node->data[0];
+      range->max = node->data[1];
+    }
+  }
+  tablestore_release (store, node);
+  return status;
+}
+
+
+static int increasing (const TABLE_AXIS *axis)
+{
+  int i=0;
+
+  for (i=1; i<axis->n; i++)
+    if (!(axis->x[i] > axis->x[i-1]))
+      return 0;
+  return (axis->n > 0);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_default                                                     */
+/* Description:                                                                    */
+/*  Set grid to the nodes of the original tables.                                  */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if out of memory.                                               */
+/***********************************************************************************/
+
+int tablegrid_default (TABLE_GRID *grid)
+{
+  int a=0, status=0;
+
+  memset (grid, 0, sizeof(TABLE_GRID));
+  grid->points = TABLEGRID_CUBIC;
+  for (a=0; a<TABLEGRID_AXES && status==0; a++)
+    status = set_default (grid, a);
+
+  if (status != 0)
+    tablegrid_free (grid);
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_read                                                        */
+/* Description:                                                                    */
+/*  Read the grid descriptor of the tables through the store; axes without a       */
+/*  file keep the nodes of the original tables and have no range, and without      */
+/*  Grid/points the tables are interpolated with splines.                          */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  TABLE_STORE *store:  Store, may be NULL.                                       */
+/*  TABLE_GRID *grid:    Grid, set by function; free with tablegrid_free().        */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error, e.g. an axis is not increasing.                       */
+/***********************************************************************************/
+
+int tablegrid_read (TABLE_STORE *store, TABLE_GRID *grid)
+{
+  char filename[FILENAME_MAX]="";
+  TABLE_NODE *node=NULL;
+  TABLE_AXIS *axis=NULL;
+  int a=0, i=0, columns=0, status=0;
+
+  memset (grid, 0, sizeof(TABLE_GRID));
+
+  for (a=0; a<TABLEGRID_AXES && status==0; a++)  {
+    axis = &grid->axis[a];
+    sprintf (filename, "./" TABLEGRID_DIRECTORY "/%s", axis_name[a]);
+    if ((status = tablestore_get (store, filename, &node)) != 0)
+      break;
+
+    if (node->status != 0)
+      status = set_default (grid, a);
+    else if (node->rows < 1)
+      status = -1;
+    else if ((axis->x = (double *) calloc (node->rows, sizeof(double))) == NULL)
+      status = ASCII_NO_MEMORY;
+    else  {
+      columns = abs (node->columns);
+      for (i=0; i<node->rows; i++)
+	axis->x[i] = node->data[(size_t) i * columns];
+      axis->n = node->rows;
+    }
+    tablestore_release (store, node);
+
+    if (status == 0 && !increasing (axis))  {
+      fprintf (stderr, "Error, the nodes of %s are not increasing\n", filename);
+      status = -1;
+    }
+  }
+
+  for (a=0; a<TABLEGRID_AXES && status==0; a++)
+    status = read_range (store, a, &grid->range[a]);
+
+  if (status == 0)
+    status = read_points (store, &grid->points);
+
+  if (status != 0)
+    tablegrid_free (grid);
+  return status;
+}
+
+
+
+/* grids of tablegrid_shared(), by the directory they were read from */
+typedef struct SHARED_GRID {
+  char                root[2*FILENAME_MAX+2];
+  TABLE_GRID          grid;
+  struct SHARED_GRID *next;
+} SHARED_GRID;
+
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static SHARED_GRID    *shared_grids = NULL;
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_shared                                                      */
+/* Description:                                                                    */
+/*  The grid of the tables without a store, as tablegrid_read (NULL, ...): read    */
+/*  on the first call for the directory the tables are found in now, see           */
+/*  ASCII_set_resource_path(), and the same grid on all later calls for it. The    */
+/*  grids are never freed, so that a grid returned stays valid.                    */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The grid, NULL if it cannot be read.                                           */
+/***********************************************************************************/
+
+const TABLE_GRID *tablegrid_shared (void)
+{
+  char filename[FILENAME_MAX]="./" TABLEGRID_DIRECTORY, path[FILENAME_MAX]="";
+  char cwd[FILENAME_MAX]="", root[2*FILENAME_MAX+2]="";
+  SHARED_GRID *g=NULL;
+
+  /* the Grid directory as ascii.c finds it, relative to the working directory */
+  if (swift_package_file_access_shim (filename, path) != 0)
+    snprintf (path, sizeof(path), "%s", filename);
+  if (path[0] != '/' && getcwd (cwd, sizeof(cwd)) == NULL)
+    return NULL;
+  snprintf (root, sizeof(root), "%s%s%s", cwd, cwd[0] != 0 ? "/" : "", path);
+
+  pthread_mutex_lock (&shared_lock);
+  for (g=shared_grids; g!=NULL; g=g->next)
+    if (strcmp (g->root, root) == 0)
+      break;
+
+  if (g == NULL && (g = (SHARED_GRID *) calloc (1, sizeof(SHARED_GRID))) != NULL)  {
+    if (tablegrid_read (NULL, &g->grid) == 0)  {
+      snprintf (g->root, sizeof(g->root), "%s", root);
+      g->next = shared_grids;
+      shared_grids = g;
+    }
+    else  {
+      free (g);
+      g = NULL;
+    }
+  }
+  pthread_mutex_unlock (&shared_lock);
+
+  return (g != NULL ? &g->grid : NULL);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_set                                                         */
+/* Description:                                                                    */
+/*  Set one axis of grid to a copy of the n increasing nodes x.                    */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int tablegrid_set (TABLE_GRID *grid, int axis, const double *x, int n)
+{
+  TABLE_AXIS *a=NULL;
+  double *copy=NULL;
+
+  if (axis < 0 || axis >= TABLEGRID_AXES || n < 1)
+    return -1;
+
+  if ((copy = (double *) calloc (n, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  memcpy (copy, x, n * sizeof(double));
+
+  a = &grid->axis[axis];
+  free (a->x);
+  a->x = copy;
+  a->n = n;
+  return (increasing (a) ? 0 : -1);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_write                                                       */
+/* Description:                                                                    */
+/*  Write the grid descriptor to the Grid directory below root, with the ranges    */
+/*  of the axes which have one.                                                    */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if error.                                                       */
+/***********************************************************************************/
+
+int tablegrid_write (const TABLE_GRID *grid, const char *root)
+{
+  char path[FILENAME_MAX+64]="";
+  FILE *f=NULL;
+  int a=0, i=0, status=0;
+
+  snprintf (path, sizeof(path), "%s/" TABLEGRID_DIRECTORY, root);
+  if (mkdir (path, 0777) != 0 && errno != EEXIST)
+    return -1;
+
+  for (a=0; a<TABLEGRID_AXES && status==0; a++)  {
+    snprintf (path, sizeof(path), "%s/" TABLEGRID_DIRECTORY "/%s", root, axis_name[a]);
+    if ((f = fopen (path, "w")) == NULL)
+      return -1;
+    for (i=0; i<grid->axis[a].n; i++)
+      fprintf (f, "%.10g\n", grid->axis[a].x[i]);
+    if (ferror (f))
+      status = -1;
+    if (fclose (f) != 0)
+      status = -1;
+  }
+
+  for (a=0; a<TABLEGRID_AXES && status==0; a++)  {
+    if (!grid->range[a].set)
+      continue;
+    snprintf (path, sizeof(path), "%s/" TABLEGRID_DIRECTORY "/%s_range", root, axis_name[a]);
+    if ((f = fopen (path, "w")) == NULL)
+      return -1;
+    fprintf (f, "%.10g %.10g\n", grid->range[a].min, grid->range[a].max);
+    if (ferror (f))
+      status = -1;
+    if (fclose (f) != 0)
+      status = -1;
+  }
+
+  if (status == 0)  {
+    snprintf (path, sizeof(path), "%s/" TABLEGRID_DIRECTORY "/points", root);
+    if ((f = fopen (path, "w")) == NULL)
+      return -1;
+    fprintf (f, "%d\n", grid->points);
+    if (ferror (f))
+      status = -1;
+    if (fclose (f) != 0)
+      status = -1;
+  }
+  return status;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_free                                                        */
+/* Description:                                                                    */
+/*  Free the nodes of grid.                                                        */
+/***********************************************************************************/
+
+void tablegrid_free (TABLE_GRID *grid)
+{
+  int a=0;
+
+  for (a=0; a<TABLEGRID_AXES; a++)
+    free (grid->axis[a].x);
+  memset (grid, 0, sizeof(TABLE_GRID));
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_name                                                        */
+/* Description:                                                                    */
+/*  The file name of an axis in the Grid directory.                                */
+/***********************************************************************************/
+
+const char *tablegrid_name (int axis)
+{
+  return (axis >= 0 && axis < TABLEGRID_AXES ? axis_name[axis] : NULL);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_lower                                                       */
+/* Description:                                                                    */
+/*  Index of the largest node not above x.                                         */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The index, -1 if x is below the first node.                                    */
+/***********************************************************************************/
+
+int tablegrid_lower (const TABLE_AXIS *axis, double x)
+{
+  int lo=0, hi=axis->n, mid=0;
+
+  /* axis->x[lo-1] <= x < axis->x[hi] */
+  while (lo < hi)  {
+    mid = (lo + hi) / 2;
+    if (axis->x[mid] <= x)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_nearest                                                     */
+/* Description:                                                                    */
+/*  Index of the node nearest to x, the upper one halfway between two nodes, the   */
+/*  first or last node outside the axis.                                           */
+/***********************************************************************************/
+
+int tablegrid_nearest (const TABLE_AXIS *axis, double x)
+{
+  int k = tablegrid_lower (axis, x);
+
+  if (k < 0)
+    return 0;
+  if (k >= axis->n - 1)
+    return axis->n - 1;
+  return (x >= 0.5 * (axis->x[k] + axis->x[k+1]) ? k+1 : k);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_neighbours                                                  */
+/* Description:                                                                    */
+/*  The points nodes interpolated from at x, see tablegrid.c.                      */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  const TABLE_AXIS *axis:  Axis.                                                 */
+/*  double x:                Value.                                                */
+/*  int mirror:              Mirror the nodes below an axis starting at 0.         */
+/*  int points:              TABLEGRID_CUBIC or TABLEGRID_LINEAR.                  */
+/*  double *nodes:           Nodes, set by function.                               */
+/*  int *index:              Index of the table of every node, -1 if beyond the    */
+/*                           axis, set by function.                                */
+/***********************************************************************************/
+
+void tablegrid_neighbours (const TABLE_AXIS *axis, double x, int mirror, int points,
+			   double *nodes, int *index)
+{
+  int k = tablegrid_lower (axis, x) - 1;
+  int i=0;
+
+  if (points == TABLEGRID_LINEAR)  {
+    k = tablegrid_lower (axis, x);
+    if (k > axis->n - 2)
+      k = axis->n - 2;
+    if (k < 0)
+      k = 0;
+  }
+
+  for (i=0; i<points; i++, k++)  {
+    index[i] = -1;
+    if (k < 0)
+      nodes[i] = axis->x[0] + k * (axis->n > 1 ? axis->x[1] - axis->x[0] : 1.0);
+    else
+      nodes[i] = axis->x[axis->n-1] + (k - axis->n + 1) *
+	(axis->n > 1 ? axis->x[axis->n-1] - axis->x[axis->n-2] : 1.0);
+
+    if (k >= 0 && k < axis->n)  {
+      nodes[i] = axis->x[k];
+      index[i] = k;
+    }
+    else if (mirror && k < 0 && -k < axis->n && axis->x[0] == 0.0)  {
+      nodes[i] = -axis->x[-k];
+      index[i] = -k;
+    }
+  }
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_alt_nodes                                                   */
+/* Description:                                                                    */
+/*  The altitude nodes interpolated from at alt: all nodes, or the                 */
+/*  TABLEGRID_ALT_NODES around alt of a longer axis, the two around alt with       */
+/*  linear interpolation.                                                          */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  const TABLE_GRID *grid:  Grid.                                                 */
+/*  double alt:              Altitude [km].                                        */
+/*  int *first:              Index of the first node, set by function.             */
+/*  int *exact:              Position of the node equal to alt among them, -1 if   */
+/*                           none, set by function.                                */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The number of nodes.                                                           */
+/***********************************************************************************/
+
+int tablegrid_alt_nodes (const TABLE_GRID *grid, double alt, int *first, int *exact)
+{
+  const TABLE_AXIS *axis = &grid->axis[TABLEGRID_ALT];
+  int n = (grid->points == TABLEGRID_LINEAR ? 2 : TABLEGRID_ALT_NODES);
+  int z=0;
+
+  if (n > axis->n)
+    n = axis->n;
+
+  if (grid->points == TABLEGRID_LINEAR)
+    *first = tablegrid_lower (axis, alt);
+  else
+    *first = tablegrid_nearest (axis, alt) - n / 2;
+  if (*first > axis->n - n)
+    *first = axis->n - n;
+  if (*first < 0)
+    *first = 0;
+
+  *exact = -1;
+  for (z=0; z<n; z++)
+    if (axis->x[*first+z] == alt)
+      *exact = z;
+  return n;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_span                                                        */
+/* Description:                                                                    */
+/*  The nodes of an axis interpolated from by the values from min to max, see      */
+/*  tablegrid.c: the neighbours on the sza and ozone axes, the altitude nodes, the */
+/*  nearest nodes on the coefficient sza axis and all nodes of the other axes.     */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  const TABLE_GRID *grid:  Grid.                                                 */
+/*  int axis:                Axis.                                                 */
+/*  double min, max:         Range of the values, min <= max.                      */
+/*  int *first:              Index of the first node, set by function.             */
+/*  int *last:               Index of the last node, set by function.              */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The number of nodes.                                                           */
+/***********************************************************************************/
+
+int tablegrid_span (const TABLE_GRID *grid, int axis, double min, double max,
+		    int *first, int *last)
+{
+  const TABLE_AXIS *a = &grid->axis[axis];
+  double nodes[TABLEGRID_NEIGHBOURS];
+  int index[TABLEGRID_NEIGHBOURS];
+  int i=0, n=0, exact=0;
+
+  *first = 0;
+  *last  = a->n - 1;
+
+  switch (axis)  {
+  case TABLEGRID_SZA:
+  case TABLEGRID_OZONE:
+    /* mirrored nodes are among those of the smallest value anyway */
+    tablegrid_neighbours (a, min, 0, grid->points, nodes, index);
+    for (i=grid->points-1; i>=0; i--)
+      if (index[i] >= 0)
+	*first = index[i];
+    tablegrid_neighbours (a, max, 0, grid->points, nodes, index);
+    for (i=0; i<grid->points; i++)
+      if (index[i] >= 0)
+	*last = index[i];
+    break;
+
+  case TABLEGRID_ALT:
+    /* only one node if the range is a node */
+    n = tablegrid_alt_nodes (grid, min, first, &exact);
+    if (min == max && exact >= 0)  {
+      *first += exact;
+      *last = *first;
+    }
+    else  {
+      n = tablegrid_alt_nodes (grid, max, last, &exact);
+      *last += n - 1;
+    }
+    break;
+
+  case TABLEGRID_COEFF_SZA:
+    *first = tablegrid_nearest (a, min);
+    *last  = tablegrid_nearest (a, max);
+    break;
+  }
+
+  if (*last < *first)
+    *last = *first;
+  return *last - *first + 1;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_in_range                                                    */
+/* Description:                                                                    */
+/*  Whether the tables may be queried at x along axis, see tablegrid.h.            */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  1 if x is in the range of the axis or the axis has none, else 0.               */
+/***********************************************************************************/
+
+int tablegrid_in_range (const TABLE_GRID *grid, int axis, double x)
+{
+  const TABLE_RANGE *range = &grid->range[axis];
+
+  return (!range->set || (x >= range->min && x <= range->max));
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablegrid_cloud_neighbours                                            */
+/* Description:                                                                    */
+/*  The cloud liquid water contents interpolated from at cloudH2O: up to two       */
+/*  levels below it and two above, or only cloudH2O if it is a node.               */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  const TABLE_AXIS *axis:     Cloud axis.                                        */
+/*  double cloudH2O:            Liquid water content [g m-3].                      */
+/*  double *x_cloudH2O:         Levels, set by function.                           */
+/*  int *subscr_cloudH2O_max:   Index of the last level, set by function.          */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if cloudH2O is outside the axis.                                */
+/***********************************************************************************/
+
+int tablegrid_cloud_neighbours (const TABLE_AXIS *axis, double cloudH2O,
+				double *x_cloudH2O, int *subscr_cloudH2O_max)
+{
+  int i=0, j=0, k=0, subscr_cloudH2O=-1;
+
+  x_cloudH2O[0]=x_cloudH2O[1]=x_cloudH2O[2]=x_cloudH2O[3]=0.0;
+
+  if (cloudH2O < axis->x[0] || cloudH2O > axis->x[axis->n-1])
+    return (-1);
+
+  while (axis->x[i] < cloudH2O)
+    i++;
+
+  if (axis->x[i] == cloudH2O)  {
+    x_cloudH2O[0]=cloudH2O;
+    *subscr_cloudH2O_max=0;
+    return 0;
+  }
+
+  for (j=0; j<TABLEGRID_NEIGHBOURS; j++)  {
+    k=i-2+j;
+    if (k >= 0 && k < axis->n)
+      x_cloudH2O[++subscr_cloudH2O]=axis->x[k];
+  }
+  *subscr_cloudH2O_max=subscr_cloudH2O;
+  return 0;
+}
@@ -0,0 +1,702 @@
+/************************************************************************/
+/* tablestore.c                                                         */
+/*                                                                      */
+/* Shared, thread safe cache of the fastrt look-up table files.         */
+/*                                                                      */
+/* Every table file is read and parsed once per store and kept as a     */
+/* contiguous row major array. Spline coefficients and convolved        */
+/* spectra derived from a node are attached to it, so that repeated     */
+/* requests with the same wavelength grid and slit function reuse them. */
+/* Nodes are never evicted; they live as long as the store. The         */
+/* convolved spectra are kept up to max_spectra bytes, beyond which the */
+/* least recently used ones are evicted, so that requests for ever new  */
+/* samplings, e.g. through the daemon, do not grow the store without    */
+/* bound. A spectrum is looked up by the hash of its sampling, which is */
+/* then compared in full; the samplings are copied once per store.      */
+/*                                                                      */
+/* A NULL store is allowed everywhere: tablestore_get() then reads a    */
+/* private node, which tablestore_release() frees again.               */
+/*                                                                      */
+/* With a pack (see pack.h), the tables found in it are decoded from    */
+/* the pack instead of being read from their files; a spectrum of a     */
+/* PACK_PCA entry keeps its coefficients as well, in node->terms.       */
+/*                                                                      */
+/* A trace of the names of the tables read, in the order of the first   */
+/* requests, lays out a pack for that workload, see PACK_ORDER_TRACE.   */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tablestore.h"
+#include "ascii.h"
+#include "spl.h"
+#include "trace.h"
+#include "metrics.h"
+
+
+#define TABLESTORE_BUCKETS 8192
+
+
+static unsigned long name_hash (const char *name)
+{
+  return (unsigned long) tablestore_hash (0, name, strlen(name));
+}
+
+
+/***********************************************************************************/
+/* Function: tablestore_hash                                                       */
+/* Description:                                                                    */
+/*  64 bit FNV-1a hash of size bytes, continuing from hash (0 to start).           */
+/***********************************************************************************/
+
+unsigned long long tablestore_hash (unsigned long long hash, const void *data, size_t size)
+{
+  const unsigned char *p = (const unsigned char *) data;
+  size_t i=0;
+
+  if (hash == 0)
+    hash = 14695981039346656037ULL;
+
+  for (i=0; i<size; i++)  {
+    hash ^= p[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+
+
+static void free_node (TABLE_NODE *node)
+{
+  NODE_SPECTRUM *s=NULL, *next=NULL;
+
+  if (node == NULL)
+    return;
+
+  for (s=node->spectra; s!=NULL; s=next)  {
+    next = s->next;
+    free (s);
+  }
+
+  free (node->a0);
+  free (node->a1);
+  free (node->a2);
+  free (node->a3);
+  matrix_free (&node->table);
+  free (node->name);
+  free (node);
+}
+
+
+
+/* read and parse one table file into node, or decode it from the pack */
+static void read_into (const TABLE_PACK *pack, TABLE_NODE *node, char *filename)
+{
+  int rows=0, max_columns=0, min_columns=0, entry=-1;
+  double t0=0.0;
+
+  t0 = trace_begin ();
+  if (pack != NULL && (entry = pack_find (pack, filename)) >= 0)  {
+    node->status = pack_read (pack, entry, &node->table, &rows, &max_columns);
+    if (node->status == 0)
+      pack_terms (pack, entry, &node->terms);
+    min_columns = max_columns;
+    if (max_columns < 0)  {
+      max_columns = -max_columns;
+      min_columns = 0;
+    }
+  }
+  else
+    node->status = ASCII_file2matrix (filename, &rows, &max_columns, &min_columns, &node->table);
+  trace_end (TRACE_PARSE, t0);
+  if (node->status != 0)
+    return;
+
+  node->data    = node->table.data;
+  node->rows    = rows;
+  node->columns = min_columns;
+
+  /* ragged files keep their maximum width, the caller checks min == max */
+  if (max_columns != min_columns)
+    node->columns = -max_columns;
+}
+
+
+/* a private node, for a NULL store */
+static TABLE_NODE *read_node (char *filename)
+{
+  TABLE_NODE *node=NULL;
+
+  if ((node = (TABLE_NODE *) calloc (1, sizeof(TABLE_NODE))) == NULL)
+    return NULL;
+
+  node->name = strdup (filename);
+  read_into (NULL, node, filename);
+  return node;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_create                                                     */
+/* Description:                                                                    */
+/*  Allocate an empty store.                                                       */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The new store, NULL if out of memory.                                          */
+/***********************************************************************************/
+
+TABLE_STORE *tablestore_create (void)
+{
+  TABLE_STORE *store=NULL;
+
+  if ((store = (TABLE_STORE *) calloc (1, sizeof(TABLE_STORE))) == NULL)
+    return NULL;
+
+  store->n_buckets = TABLESTORE_BUCKETS;
+  if ((store->buckets = (TABLE_NODE **) calloc (store->n_buckets, sizeof(TABLE_NODE *))) == NULL)  {
+    free (store);
+    return NULL;
+  }
+
+  store->max_spectra = TABLESTORE_MAX_SPECTRA;
+  pthread_mutex_init (&store->lock, NULL);
+  pthread_cond_init (&store->loaded, NULL);
+  return store;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_free                                                       */
+/* Description:                                                                    */
+/*  Free the store and all nodes. No other thread may use it any more.            */
+/***********************************************************************************/
+
+void tablestore_free (TABLE_STORE *store)
+{
+  TABLE_NODE *node=NULL, *next=NULL;
+  SAMPLING_COPY *sampling=NULL, *next_sampling=NULL;
+  int i=0;
+
+  if (store == NULL)
+    return;
+
+  for (i=0; i<store->n_buckets; i++)
+    for (node=store->buckets[i]; node!=NULL; node=next)  {
+      next = node->next;
+      free_node (node);
+    }
+  for (sampling=store->samplings; sampling!=NULL; sampling=next_sampling)  {
+    next_sampling = sampling->next;
+    free (sampling);
+  }
+
+  metrics_table_bytes (-(long) store->bytes);
+
+  pthread_cond_destroy (&store->loaded);
+  pthread_mutex_destroy (&store->lock);
+  free (store->buckets);
+  free (store);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_set_pack                                                   */
+/* Description:                                                                    */
+/*  Read the tables of the store from pack where it has them. Set it before the    */
+/*  first lookup; the pack must stay open as long as the store.                   */
+/***********************************************************************************/
+
+void tablestore_set_pack (TABLE_STORE *store, const TABLE_PACK *pack)
+{
+  if (store != NULL)
+    store->pack = pack;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_set_trace                                                  */
+/* Description:                                                                    */
+/*  Write the name of every table the store reads to trace, one per line, in the   */
+/*  order of the first requests; NULL stops the trace. The file is not closed.    */
+/***********************************************************************************/
+
+void tablestore_set_trace (TABLE_STORE *store, FILE *trace)
+{
+  if (store == NULL)
+    return;
+
+  pthread_mutex_lock (&store->lock);
+  store->trace = trace;
+  pthread_mutex_unlock (&store->lock);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_get                                                        */
+/* Description:                                                                    */
+/*  Look up a table file, reading and parsing it on the first request. Files       */
+/*  which cannot be read are cached as well, with node->status set to the error    */
+/*  of ASCII_file2double, so that missing nodes are not searched for again.        */
+/*  The node is owned by the store and must not be modified.                       */
+/*                                                                                 */
+/*  The first thread asking for a file inserts the node before reading it,         */
+/*  without holding the lock; other threads asking for the same file wait for      */
+/*  that node only, while the lookups of all other nodes go on.                    */
+/*                                                                                 */
+/* Parameters:                                                                     */
+/*  TABLE_STORE *store:  Store, may be NULL.                                       */
+/*  char *filename:      Resource file name.                                       */
+/*  TABLE_NODE **node:   The node, set by function; release with                   */
+/*                       tablestore_release().                                     */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if a node was returned (check node->status), <0 if out of memory.          */
+/***********************************************************************************/
+
+int tablestore_get (TABLE_STORE *store, char *filename, TABLE_NODE **node)
+{
+  TABLE_NODE *n=NULL;
+  unsigned long bucket=0;
+  size_t bytes=0;
+
+  if (store == NULL)  {
+    metrics_table_lookup (0);
+    *node = read_node (filename);
+    return (*node == NULL ? ASCII_NO_MEMORY : 0);
+  }
+
+  bucket = name_hash (filename) % store->n_buckets;
+
+  pthread_mutex_lock (&store->lock);
+  for (n=store->buckets[bucket]; n!=NULL; n=n->next)
+    if (strcmp (n->name, filename) == 0)
+      break;
+
+  if (n != NULL)  {
+    store->hits++;
+    if (n->loading)  {
+      store->waits++;
+      while (n->loading)
+	pthread_cond_wait (&store->loaded, &store->lock);
+    }
+    pthread_mutex_unlock (&store->lock);
+
+    metrics_table_lookup (1);
+    *node = n;
+    return 0;
+  }
+
+  /* insert the node being read, so that nobody else reads the file */
+  if ((n = (TABLE_NODE *) calloc (1, sizeof(TABLE_NODE))) == NULL ||
+      (n->name = strdup (filename)) == NULL)  {
+    pthread_mutex_unlock (&store->lock);
+    free (n);
+    return ASCII_NO_MEMORY;
+  }
+  n->loading = 1;
+  n->next = store->buckets[bucket];
+  store->buckets[bucket] = n;
+  store->n_nodes++;
+  store->misses++;
+  if (store->trace != NULL)
+    fprintf (store->trace, "%s\n", filename);
+  pthread_mutex_unlock (&store->lock);
+
+  metrics_table_lookup (0);
+
+  read_into (store->pack, n, filename);
+  if (n->status == 0)
+    bytes = (size_t) n->rows * abs(n->columns) * sizeof(double);
+
+  pthread_mutex_lock (&store->lock);
+  store->bytes += bytes;
+  n->loading = 0;
+  pthread_cond_broadcast (&store->loaded);
+  pthread_mutex_unlock (&store->lock);
+
+  metrics_table_bytes ((long) bytes);
+
+  *node = n;
+  return 0;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_release                                                    */
+/* Description:                                                                    */
+/*  Release a node returned by tablestore_get(); only private nodes (NULL store)   */
+/*  are actually freed.                                                            */
+/***********************************************************************************/
+
+void tablestore_release (TABLE_STORE *store, TABLE_NODE *node)
+{
+  if (store == NULL)
+    free_node (node);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_spline                                                     */
+/* Description:                                                                    */
+/*  Attach the interpolating spline coefficients of column 0 of node against       */
+/*  x (node->rows values) to the node, unless already done.                        */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., else the error of spline_coeffc().                                 */
+/***********************************************************************************/
+
+int tablestore_spline (TABLE_STORE *store, TABLE_NODE *node, double *x, int number)
+{
+  double *a0=NULL, *a1=NULL, *a2=NULL, *a3=NULL, *y=NULL, t0=0.0;
+  int i=0, status=0, columns=abs(node->columns);
+
+  if (store != NULL)  {
+    pthread_mutex_lock (&store->lock);
+    status = (node->a0 != NULL);
+    pthread_mutex_unlock (&store->lock);
+    if (status)
+      return 0;
+  }
+  else if (node->a0 != NULL)
+    return 0;
+
+  if ((y = (double *) calloc (number, sizeof(double))) == NULL)
+    return ASCII_NO_MEMORY;
+  for (i=0; i<number; i++)
+    y[i] = node->data[i*columns];
+
+  t0 = trace_begin ();
+  status = spline_coeffc (x, y, number, &a0, &a1, &a2, &a3);
+  trace_end (TRACE_SPLINE, t0);
+  free (y);
+  if (status != 0)
+    return status;
+
+  if (store != NULL)
+    pthread_mutex_lock (&store->lock);
+
+  if (node->a0 == NULL)  {
+    node->a1 = a1;
+    node->a2 = a2;
+    node->a3 = a3;
+    node->a0 = a0;
+    if (store != NULL)  {
+      store->bytes += 4 * (size_t) number * sizeof(double);
+      metrics_table_bytes (4L * number * sizeof(double));
+    }
+    a0 = a1 = a2 = a3 = NULL;
+  }
+
+  if (store != NULL)
+    pthread_mutex_unlock (&store->lock);
+
+  free (a0);
+  free (a1);
+  free (a2);
+  free (a3);
+  return 0;
+}
+
+
+
+#define SPECTRUM_BYTES(n) \
+  (sizeof(NODE_SPECTRUM) + (size_t) (n) * sizeof(double))
+#define SAMPLING_BYTES(n_lambda, sr_nlambda) \
+  (sizeof(SAMPLING_COPY) + ((size_t) (n_lambda) + 2 * (size_t) (sr_nlambda)) * sizeof(double))
+
+
+static int same_sampling (const TABLE_SAMPLING *a, const TABLE_SAMPLING *b)
+{
+  return (a->hash == b->hash && a->n_lambda == b->n_lambda && a->sr_nlambda == b->sr_nlambda &&
+	  memcmp (a->lambda, b->lambda, a->n_lambda * sizeof(double)) == 0 &&
+	  memcmp (a->sr_lambda, b->sr_lambda, a->sr_nlambda * sizeof(double)) == 0 &&
+	  memcmp (a->sr, b->sr, a->sr_nlambda * sizeof(double)) == 0);
+}
+
+
+/* the copy of sampling in the store, with one more reference; NULL if out */
+/* of memory. The lock is held                                             */
+static SAMPLING_COPY *use_sampling (TABLE_STORE *store, const TABLE_SAMPLING *sampling)
+{
+  SAMPLING_COPY *c=NULL;
+  double *x=NULL;
+  size_t bytes=SAMPLING_BYTES (sampling->n_lambda, sampling->sr_nlambda);
+
+  for (c=store->samplings; c!=NULL; c=c->next)
+    if (same_sampling (&c->sampling, sampling))  {
+      c->refs++;
+      return c;
+    }
+
+  if ((c = (SAMPLING_COPY *) malloc (bytes)) == NULL)
+    return NULL;
+  x = (double *) (c + 1);
+  memcpy (x, sampling->lambda, sampling->n_lambda * sizeof(double));
+  memcpy (x + sampling->n_lambda, sampling->sr_lambda, sampling->sr_nlambda * sizeof(double));
+  memcpy (x + sampling->n_lambda + sampling->sr_nlambda, sampling->sr,
+	  sampling->sr_nlambda * sizeof(double));
+  c->sampling           = *sampling;
+  c->sampling.lambda    = x;
+  c->sampling.sr_lambda = x + sampling->n_lambda;
+  c->sampling.sr        = x + sampling->n_lambda + sampling->sr_nlambda;
+  c->refs = 1;
+  c->next = store->samplings;
+  store->samplings = c;
+
+  store->bytes         += bytes;
+  store->spectra_bytes += bytes;
+  metrics_table_bytes ((long) bytes);
+  return c;
+}
+
+
+/* drop a reference to a sampling copy, freed with the last one */
+static void drop_sampling (TABLE_STORE *store, SAMPLING_COPY *c)
+{
+  SAMPLING_COPY **p=NULL;
+  size_t bytes=SAMPLING_BYTES (c->sampling.n_lambda, c->sampling.sr_nlambda);
+
+  if (--c->refs > 0)
+    return;
+
+  for (p=&store->samplings; *p!=c; p=&(*p)->next)
+    ;
+  *p = c->next;
+  store->bytes         -= bytes;
+  store->spectra_bytes -= bytes;
+  metrics_table_bytes (-(long) bytes);
+  free (c);
+}
+
+
+/* take s out of the list of the least recently used spectra */
+static void lru_remove (TABLE_STORE *store, NODE_SPECTRUM *s)
+{
+  if (s->newer != NULL)
+    s->newer->older = s->older;
+  else
+    store->newest = s->older;
+  if (s->older != NULL)
+    s->older->newer = s->newer;
+  else
+    store->oldest = s->newer;
+  s->newer = s->older = NULL;
+}
+
+
+static void lru_push (TABLE_STORE *store, NODE_SPECTRUM *s)
+{
+  s->older = store->newest;
+  s->newer = NULL;
+  if (store->newest != NULL)
+    store->newest->newer = s;
+  else
+    store->oldest = s;
+  store->newest = s;
+}
+
+
+/* evict the least recently used spectra which are not pinned while the */
+/* store holds more than max_spectra bytes of them. The lock is held    */
+static void evict_spectra (TABLE_STORE *store)
+{
+  NODE_SPECTRUM *s=NULL, *newer=NULL, **p=NULL;
+  size_t bytes=0;
+
+  for (s=store->oldest; s!=NULL && store->spectra_bytes > store->max_spectra; s=newer)  {
+    newer = s->newer;
+    if (s->users > 0)
+      continue;
+
+    for (p=&s->node->spectra; *p!=s; p=&(*p)->next)
+      ;
+    *p = s->next;
+    lru_remove (store, s);
+
+    bytes = SPECTRUM_BYTES (s->n_values);
+    store->bytes         -= bytes;
+    store->spectra_bytes -= bytes;
+    metrics_table_bytes (-(long) bytes);
+    drop_sampling (store, s->sampling);
+    store->evicted++;
+    free (s);
+  }
+}
+
+
+/* the spectrum of node of the kind for sampling, NULL if none. The lock */
+/* is held                                                               */
+static NODE_SPECTRUM *lookup_spectrum (TABLE_NODE *node, const TABLE_SAMPLING *sampling,
+				       int kind, int n_values)
+{
+  NODE_SPECTRUM *s=NULL;
+
+  for (s=node->spectra; s!=NULL; s=s->next)
+    if (s->kind == kind && s->n_values == n_values &&
+	same_sampling (&s->sampling->sampling, sampling))
+      return s;
+  return NULL;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_sampling                                                   */
+/* Description:                                                                    */
+/*  Describe the output wavelengths and the slit function of a request, which the  */
+/*  convolved spectra of the store are kept for. The arrays are not copied.        */
+/***********************************************************************************/
+
+void tablestore_sampling (TABLE_SAMPLING *sampling, const double *lambda, int n_lambda,
+			  const double *sr_lambda, const double *sr, int sr_nlambda)
+{
+  sampling->lambda     = lambda;
+  sampling->sr_lambda  = sr_lambda;
+  sampling->sr         = sr;
+  sampling->n_lambda   = n_lambda;
+  sampling->sr_nlambda = sr_nlambda;
+  sampling->hash = tablestore_hash (0, lambda, n_lambda * sizeof(double));
+  sampling->hash = tablestore_hash (sampling->hash, sr_lambda, sr_nlambda * sizeof(double));
+  sampling->hash = tablestore_hash (sampling->hash, sr, sr_nlambda * sizeof(double));
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_set_max_spectra                                            */
+/* Description:                                                                    */
+/*  Keep at most about bytes of convolved spectra in the store (default            */
+/*  TABLESTORE_MAX_SPECTRA), evicting the least recently used ones beyond; the     */
+/*  spectra pinned by running requests stay until they are unpinned.               */
+/***********************************************************************************/
+
+void tablestore_set_max_spectra (TABLE_STORE *store, size_t bytes)
+{
+  if (store == NULL)
+    return;
+
+  pthread_mutex_lock (&store->lock);
+  store->max_spectra = bytes;
+  evict_spectra (store);
+  pthread_mutex_unlock (&store->lock);
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_find_spectrum                                              */
+/* Description:                                                                    */
+/*  Return the spectrum of the kind of node for sampling (SPECTRUM_VALUES, or a    */
+/*  matrix or basis spectra derived from it), or NULL if it has not been added     */
+/*  yet or was evicted. The spectrum is pinned until tablestore_unpin_spectrum().  */
+/***********************************************************************************/
+
+const double *tablestore_find_spectrum (TABLE_STORE *store, TABLE_NODE *node,
+					const TABLE_SAMPLING *sampling, int kind,
+					int n_values)
+{
+  NODE_SPECTRUM *s=NULL;
+  const double *values=NULL;
+
+  if (store == NULL)
+    return NULL;
+
+  pthread_mutex_lock (&store->lock);
+  if ((s = lookup_spectrum (node, sampling, kind, n_values)) != NULL)  {
+    s->users++;
+    lru_remove (store, s);
+    lru_push (store, s);
+    values = s->values;
+  }
+  pthread_mutex_unlock (&store->lock);
+
+  return values;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_add_spectrum                                               */
+/* Description:                                                                    */
+/*  Attach a copy of a spectrum to node and return the stored copy, pinned as by   */
+/*  tablestore_find_spectrum(); if another thread added the same spectrum          */
+/*  meanwhile, that one is returned. Returns NULL for a NULL store or if out of    */
+/*  memory.                                                                        */
+/***********************************************************************************/
+
+const double *tablestore_add_spectrum (TABLE_STORE *store, TABLE_NODE *node,
+				       const TABLE_SAMPLING *sampling, int kind,
+				       int n_values, const double *values)
+{
+  NODE_SPECTRUM *s=NULL, *fresh=NULL;
+  const double *result=NULL;
+
+  if (store == NULL)
+    return NULL;
+
+  if ((fresh = (NODE_SPECTRUM *) calloc (1, SPECTRUM_BYTES (n_values))) == NULL)
+    return NULL;
+  fresh->values   = (double *) (fresh + 1);
+  fresh->kind     = kind;
+  fresh->n_values = n_values;
+  fresh->node     = node;
+  memcpy (fresh->values, values, n_values * sizeof(double));
+
+  pthread_mutex_lock (&store->lock);
+  if ((s = lookup_spectrum (node, sampling, kind, n_values)) != NULL)
+    lru_remove (store, s);
+  else if ((fresh->sampling = use_sampling (store, sampling)) != NULL)  {
+    fresh->next   = node->spectra;
+    node->spectra = fresh;
+    store->bytes         += SPECTRUM_BYTES (n_values);
+    store->spectra_bytes += SPECTRUM_BYTES (n_values);
+    metrics_table_bytes ((long) SPECTRUM_BYTES (n_values));
+    s     = fresh;
+    fresh = NULL;
+  }
+
+  if (s != NULL)  {
+    s->users++;
+    lru_push (store, s);
+    result = s->values;
+    evict_spectra (store);
+  }
+  pthread_mutex_unlock (&store->lock);
+
+  free (fresh);
+  return result;
+}
+
+
+
+/***********************************************************************************/
+/* Function: tablestore_unpin_spectrum                                             */
+/* Description:                                                                    */
+/*  Unpin a spectrum returned by tablestore_find_spectrum() or                     */
+/*  tablestore_add_spectrum(), which may be evicted from then on. NULL is allowed. */
+/***********************************************************************************/
+
+void tablestore_unpin_spectrum (TABLE_STORE *store, const double *values)
+{
+  NODE_SPECTRUM *s=NULL;
+
+  if (store == NULL || values == NULL)
+    return;
+
+  s = ((NODE_SPECTRUM *) values) - 1;
+  pthread_mutex_lock (&store->lock);
+  if (--s->users == 0 && store->spectra_bytes > store->max_spectra)
+    evict_spectra (store);
+  pthread_mutex_unlock (&store->lock);
+}
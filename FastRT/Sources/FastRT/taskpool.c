@@ -0,0 +1,490 @@
+/************************************************************************/
+/* taskpool.c                                                           */
+/*                                                                      */
+/* Work-stealing pool for the batch functions of the engine, see        */
+/* taskpool.h.                                                          */
+/*                                                                      */
+/* The tasks are never created or queued: a worker owns a range of task */
+/* numbers, so that taking the next task or stealing half of a range is */
+/* a short critical section on the owner's lock. Tasks only move from   */
+/* one range to another, therefore a worker that finds all ranges empty */
+/* can stop; tasks in flight are run by the thief that took them.       */
+/*                                                                      */
+/* The threads of a TASKPOOL wait on a condition variable for the next  */
+/* run, counted by generation; the caller of taskpool_run() is worker 0 */
+/* and waits for the others to finish theirs. One run at a time.        */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "taskpool.h"
+
+
+typedef struct TASKPOOL_RUN {
+  const TASKPOOL_JOB *job;
+  long             n_items;
+  long             chunk;
+  int              n_threads;
+  int              schedule;
+  TASKPOOL_WORKER *workers;
+  size_t           stride;       /* bytes between workers, multiple of TASKPOOL_ALIGN */
+  int              status;       /* first error, stops all workers  */
+  pthread_mutex_t  lock;
+} TASKPOOL_RUN;
+
+struct TASKPOOL {
+  int              n_workers;    /* the caller of taskpool_run() included */
+  TASKPOOL_WORKER *workers;
+  size_t           stride;
+  pthread_t       *threads;      /* of workers 1 .. n_workers-1     */
+  pthread_mutex_t  busy;         /* one run at a time               */
+  pthread_mutex_t  lock;         /* the fields below                */
+  pthread_cond_t   start, done;
+  long             generation;   /* of the current run              */
+  int              active;       /* workers of the current run      */
+  int              running;      /* threads still in it             */
+  int              shutdown;
+};
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static TASKPOOL_WORKER *pool_worker (TASKPOOL *pool, int i)
+{
+  return (TASKPOOL_WORKER *) ((char *) pool->workers + i * pool->stride);
+}
+
+
+static TASKPOOL_WORKER *worker_at (TASKPOOL_RUN *pool, int i)
+{
+  return (TASKPOOL_WORKER *) ((char *) pool->workers + i * pool->stride);
+}
+
+
+static int failed (TASKPOOL_RUN *pool)
+{
+  int status=0;
+
+  pthread_mutex_lock (&pool->lock);
+  status = pool->status;
+  pthread_mutex_unlock (&pool->lock);
+  return status;
+}
+
+
+static void set_failed (TASKPOOL_RUN *pool, int status)
+{
+  pthread_mutex_lock (&pool->lock);
+  if (pool->status == 0)
+    pool->status = status;
+  pthread_mutex_unlock (&pool->lock);
+}
+
+
+/* next task of the own range, front to back */
+static long pop (TASKPOOL_WORKER *w)
+{
+  long task=-1;
+
+  pthread_mutex_lock (&w->lock);
+  if (w->head < w->tail)
+    task = w->head++;
+  pthread_mutex_unlock (&w->lock);
+  return task;
+}
+
+
+/* move the back half of the largest other range to w; 0 if there is none */
+static int steal (TASKPOOL_RUN *pool, TASKPOOL_WORKER *w)
+{
+  TASKPOOL_WORKER *victim=NULL, *v=NULL;
+  long left=0, most=0, first=0, k=0;
+  int i=0;
+
+  for (;;)  {
+    victim = NULL;
+    most   = 0;
+
+    /* the largest range; it may shrink until the victim is locked again */
+    for (i=1; i<pool->n_threads; i++)  {
+      v = worker_at (pool, (w->id + i) % pool->n_threads);
+      pthread_mutex_lock (&v->lock);
+      left = v->tail - v->head;
+      pthread_mutex_unlock (&v->lock);
+      if (left > most)  {
+	most   = left;
+	victim = v;
+      }
+    }
+
+    if (victim == NULL)
+      return 0;
+
+    /* one lock at a time: the stolen tasks are in flight until they are */
+    /* in the own range, and only w runs them                            */
+    pthread_mutex_lock (&victim->lock);
+    left = victim->tail - victim->head;
+    if (left > 0)  {
+      k = (left + 1) / 2;
+      victim->tail -= k;
+      first = victim->tail;
+    }
+    pthread_mutex_unlock (&victim->lock);
+
+    if (left > 0)  {
+      pthread_mutex_lock (&w->lock);
+      w->head = first;
+      w->tail = first + k;
+      pthread_mutex_unlock (&w->lock);
+      w->steals++;
+      return 1;
+    }
+  }
+}
+
+
+static void *worker_main (void *arg)
+{
+  TASKPOOL_WORKER *w = (TASKPOOL_WORKER *) arg;
+  TASKPOOL_RUN *pool = w->pool;
+  const TASKPOOL_JOB *job = pool->job;
+  long task=0, first=0, n=0;
+  double t=0.0;
+  int status=0;
+
+  if (job->init != NULL && (status = job->init (job->arg, w)) != 0)  {
+    set_failed (pool, status);
+    /* give the own range away */
+    pthread_mutex_lock (&w->lock);
+    w->head = w->tail;
+    pthread_mutex_unlock (&w->lock);
+    if (job->fini != NULL)
+      job->fini (job->arg, w);
+    return NULL;
+  }
+
+  for (;;)  {
+    if ((task = pop (w)) < 0)  {
+      if (pool->schedule == TASKPOOL_STATIC || !steal (pool, w))
+	break;
+      continue;
+    }
+
+    if (failed (pool))
+      continue;   /* drain the range */
+
+    first = task * pool->chunk;
+    n     = pool->chunk;
+    if (first + n > pool->n_items)
+      n = pool->n_items - first;
+
+    t = now();
+    status = job->run (job->arg, w, first, n);
+    w->busy += now() - t;
+    w->tasks++;
+
+    if (status != 0)
+      set_failed (pool, status);
+  }
+
+  if (job->fini != NULL)
+    job->fini (job->arg, w);
+
+  return NULL;
+}
+
+
+/* a thread of a pool: the share of each run it takes part in */
+static void *pool_main (void *arg)
+{
+  TASKPOOL_WORKER *w = (TASKPOOL_WORKER *) arg;
+  TASKPOOL *pool = w->owner;
+  long generation=0;
+  int n_threads=0;
+
+  pthread_mutex_lock (&pool->lock);
+  for (;;)  {
+    while (!pool->shutdown && pool->generation == generation)
+      pthread_cond_wait (&pool->start, &pool->lock);
+    if (pool->shutdown)
+      break;
+    generation = pool->generation;
+    n_threads  = pool->active;
+    pthread_mutex_unlock (&pool->lock);
+
+    if (w->id < n_threads)
+      worker_main (w);
+
+    pthread_mutex_lock (&pool->lock);
+    if (w->id < n_threads && --pool->running == 0)
+      pthread_cond_signal (&pool->done);
+  }
+  pthread_mutex_unlock (&pool->lock);
+  return NULL;
+}
+
+
+
+/***********************************************************************************/
+/* Function: taskpool_threads                                                      */
+/* Description:                                                                    */
+/*  Number of workers for a requested number: n_threads if positive, else the      */
+/*  number of online processors.                                                   */
+/***********************************************************************************/
+
+int taskpool_threads (int n_threads)
+{
+  if (n_threads < 1)
+    n_threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  if (n_threads < 1)
+    n_threads = 1;
+  return n_threads;
+}
+
+
+
+/***********************************************************************************/
+/* Function: taskpool_scratch                                                      */
+/* Description:                                                                    */
+/*  Return the scratch arena of a worker, grown to at least size bytes. The arena  */
+/*  is aligned to TASKPOOL_ALIGN, belongs to the worker and keeps its contents    */
+/*  between tasks, and between the runs of a TASKPOOL, except when it grows.      */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The arena, or NULL if out of memory.                                           */
+/***********************************************************************************/
+
+void *taskpool_scratch (TASKPOOL_WORKER *worker, size_t size)
+{
+  void *p=NULL;
+
+  if (size <= worker->scratch_size)
+    return worker->scratch;
+
+  size = (size + TASKPOOL_ALIGN - 1) / TASKPOOL_ALIGN * TASKPOOL_ALIGN;
+  if (posix_memalign (&p, TASKPOOL_ALIGN, size) != 0)
+    return NULL;
+  memset (p, 0, size);
+
+  free (worker->scratch);
+  worker->scratch      = p;
+  worker->scratch_size = size;
+  return p;
+}
+
+
+
+/***********************************************************************************/
+/* Function: taskpool_create                                                       */
+/* Description:                                                                    */
+/*  Start a pool of n_threads workers for taskpool_run(): the calling thread of a  */
+/*  run and n_threads-1 threads, which wait for runs until taskpool_free(). If     */
+/*  not all threads can be started, the pool has fewer workers.                    */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  The pool, or NULL if out of memory.                                            */
+/***********************************************************************************/
+
+TASKPOOL *taskpool_create (int n_threads)
+{
+  TASKPOOL *pool=NULL;
+  TASKPOOL_WORKER *w=NULL;
+  void *mem=NULL;
+  int i=0;
+
+  n_threads = taskpool_threads (n_threads);
+
+  if ((pool = (TASKPOOL *) calloc (1, sizeof(TASKPOOL))) == NULL)
+    return NULL;
+
+  /* workers on separate cache lines */
+  pool->stride = (sizeof(TASKPOOL_WORKER) + TASKPOOL_ALIGN - 1) / TASKPOOL_ALIGN * TASKPOOL_ALIGN;
+  if (posix_memalign (&mem, TASKPOOL_ALIGN, n_threads * pool->stride) != 0)  {
+    free (pool);
+    return NULL;
+  }
+  memset (mem, 0, n_threads * pool->stride);
+  pool->workers = (TASKPOOL_WORKER *) mem;
+
+  if ((pool->threads = (pthread_t *) calloc (n_threads, sizeof(pthread_t))) == NULL)  {
+    free (mem);
+    free (pool);
+    return NULL;
+  }
+
+  pthread_mutex_init (&pool->busy, NULL);
+  pthread_mutex_init (&pool->lock, NULL);
+  pthread_cond_init (&pool->start, NULL);
+  pthread_cond_init (&pool->done, NULL);
+
+  for (i=0; i<n_threads; i++)  {
+    w = pool_worker (pool, i);
+    w->id    = i;
+    w->owner = pool;
+    pthread_mutex_init (&w->lock, NULL);
+  }
+
+  for (pool->n_workers=1; pool->n_workers<n_threads; pool->n_workers++)
+    if (pthread_create (&pool->threads[pool->n_workers], NULL, pool_main,
+			pool_worker (pool, pool->n_workers)) != 0)
+      break;
+
+  /* workers whose thread could not be started */
+  for (i=pool->n_workers; i<n_threads; i++)
+    pthread_mutex_destroy (&pool_worker (pool, i)->lock);
+
+  return pool;
+}
+
+
+
+/***********************************************************************************/
+/* Function: taskpool_free                                                         */
+/* Description:                                                                    */
+/*  Stop the threads of a pool and free it with the scratch of its workers.        */
+/***********************************************************************************/
+
+void taskpool_free (TASKPOOL *pool)
+{
+  TASKPOOL_WORKER *w=NULL;
+  int i=0;
+
+  if (pool == NULL)
+    return;
+
+  pthread_mutex_lock (&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast (&pool->start);
+  pthread_mutex_unlock (&pool->lock);
+
+  for (i=1; i<pool->n_workers; i++)
+    pthread_join (pool->threads[i], NULL);
+
+  for (i=0; i<pool->n_workers; i++)  {
+    w = pool_worker (pool, i);
+    free (w->scratch);
+    pthread_mutex_destroy (&w->lock);
+  }
+
+  pthread_cond_destroy (&pool->start);
+  pthread_cond_destroy (&pool->done);
+  pthread_mutex_destroy (&pool->lock);
+  pthread_mutex_destroy (&pool->busy);
+  free (pool->threads);
+  free (pool->workers);
+  free (pool);
+}
+
+
+
+/***********************************************************************************/
+/* Function: taskpool_run                                                          */
+/* Description:                                                                    */
+/*  Run job->run() for all items in tasks of chunk items on n_threads workers of   */
+/*  a pool and wait for all of them; without a pool, the threads are started for  */
+/*  this call only. Worker i starts with the i-th contiguous share of the tasks.   */
+/*  The calling thread is worker 0.                                                */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if the pool could not be set up, else the first nonzero status  */
+/*  of init() or run(); no new tasks are started after an error.                   */
+/***********************************************************************************/
+
+int taskpool_run (TASKPOOL *pool, const TASKPOOL_JOB *job, long n_items, long chunk,
+		  int n_threads, int schedule, TASKPOOL_STATS *stats)
+{
+  TASKPOOL_RUN run;
+  TASKPOOL_STATS st;
+  TASKPOOL_WORKER *w=NULL;
+  long n_tasks=0;
+  int i=0, status=0;
+  double t0 = now();
+
+  memset (&st, 0, sizeof(TASKPOOL_STATS));
+
+  if (job == NULL || job->run == NULL || n_items < 0 || chunk < 1)
+    return -1;
+
+  n_tasks   = (n_items + chunk - 1) / chunk;
+  n_threads = taskpool_threads (n_threads);
+  if (n_threads > n_tasks)
+    n_threads = (n_tasks > 0 ? (int) n_tasks : 1);
+
+  if (pool == NULL)  {
+    if ((pool = taskpool_create (n_threads)) == NULL)
+      return -1;
+    status = taskpool_run (pool, job, n_items, chunk, n_threads, schedule, stats);
+    taskpool_free (pool);
+    return status;
+  }
+
+  pthread_mutex_lock (&pool->busy);
+
+  if (n_threads > pool->n_workers)
+    n_threads = pool->n_workers;
+
+  memset (&run, 0, sizeof(TASKPOOL_RUN));
+  run.job       = job;
+  run.n_items   = n_items;
+  run.chunk     = chunk;
+  run.n_threads = n_threads;
+  run.schedule  = schedule;
+  run.workers   = pool->workers;
+  run.stride    = pool->stride;
+  pthread_mutex_init (&run.lock, NULL);
+
+  for (i=0; i<n_threads; i++)  {
+    w = worker_at (&run, i);
+    w->user   = NULL;
+    w->pool   = &run;
+    w->head   = n_tasks * i / n_threads;
+    w->tail   = n_tasks * (i+1) / n_threads;
+    w->tasks  = 0;
+    w->steals = 0;
+    w->busy   = 0.0;
+  }
+
+  pthread_mutex_lock (&pool->lock);
+  pool->active  = n_threads;
+  pool->running = n_threads - 1;
+  pool->generation++;
+  pthread_cond_broadcast (&pool->start);
+  pthread_mutex_unlock (&pool->lock);
+
+  worker_main (worker_at (&run, 0));
+
+  pthread_mutex_lock (&pool->lock);
+  while (pool->running > 0)
+    pthread_cond_wait (&pool->done, &pool->lock);
+  pthread_mutex_unlock (&pool->lock);
+
+  st.threads = n_threads;
+  for (i=0; i<n_threads; i++)  {
+    w = worker_at (&run, i);
+    st.tasks  += w->tasks;
+    st.steals += w->steals;
+    st.busy_mean += w->busy / n_threads;
+    if (w->busy > st.busy_max)
+      st.busy_max = w->busy;
+  }
+
+  pthread_mutex_destroy (&run.lock);
+  pthread_mutex_unlock (&pool->busy);
+
+  st.seconds = now() - t0;
+  if (stats != NULL)
+    *stats = st;
+
+  return run.status;
+}
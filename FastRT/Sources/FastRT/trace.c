@@ -0,0 +1,376 @@
+/************************************************************************/
+/* trace.c                                                              */
+/*                                                                      */
+/* Per-stage timers of fastrt_compute(), see trace.h.                   */
+/*                                                                      */
+/* Each thread appends to its own event buffer, so recording takes no   */
+/* lock; the buffers are registered in a list once, when a thread       */
+/* records its first event. When the thread ends, a pthread key         */
+/* destructor copies its events into a shared ring of TRACE_MAX_EVENTS  */
+/* events, the oldest of which are overwritten and counted as dropped,  */
+/* and frees the buffer.                                                */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+
+typedef struct {
+  int    stage;
+  double start;                  /* [s] on the monotonic clock           */
+  double duration;               /* [s]                                  */
+} TRACE_EVENT;
+
+typedef struct TRACE_BUFFER {
+  int    tid;
+  long   n;                      /* events, published with release order */
+  long   dropped;
+  TRACE_EVENT events[TRACE_MAX_EVENTS];
+  struct TRACE_BUFFER *next;
+} TRACE_BUFFER;
+
+/* an event of a thread that has ended */
+typedef struct {
+  int         tid;
+  TRACE_EVENT event;
+} TRACE_RETIRED;
+
+
+static int              trace_on      = 0;
+static pthread_mutex_t  trace_lock    = PTHREAD_MUTEX_INITIALIZER;
+static TRACE_BUFFER    *trace_buffers = NULL;
+static int              trace_threads = 0;
+static TRACE_RETIRED   *trace_ring    = NULL;   /* TRACE_MAX_EVENTS         */
+static long             trace_ring_n  = 0;      /* events since the reset   */
+static long             trace_ring_dropped = 0;
+static pthread_key_t    trace_key;
+static pthread_once_t   trace_once    = PTHREAD_ONCE_INIT;
+
+static __thread TRACE_BUFFER  *trace_local   = NULL;
+static __thread TRACE_SUMMARY  trace_current;
+static __thread TRACE_SUMMARY  trace_last;
+static __thread int            trace_in_call = 0;
+static __thread int            trace_have_last = 0;
+
+static const char *trace_names[TRACE_STAGES] = {
+  "resolve", "parse", "spline", "convolve", "cloud", "aerosol", "reflectance",
+  "interpolate", "call"
+};
+
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* the thread of a buffer has ended: copy its events into the ring, free */
+/* the buffer                                                            */
+static void retire_buffer (void *p)
+{
+  TRACE_BUFFER *buffer=(TRACE_BUFFER *) p, **link=NULL;
+  TRACE_RETIRED *retired=NULL;
+  long i=0, n=0;
+
+  pthread_mutex_lock (&trace_lock);
+  for (link=&trace_buffers; *link!=NULL; link=&(*link)->next)
+    if (*link == buffer)  {
+      *link = buffer->next;
+      break;
+    }
+
+  n = buffer->n;
+  trace_ring_dropped += buffer->dropped;
+  if (n > 0 && trace_ring == NULL)
+    trace_ring = (TRACE_RETIRED *) calloc (TRACE_MAX_EVENTS, sizeof(TRACE_RETIRED));
+  if (trace_ring == NULL)
+    trace_ring_dropped += n;
+  else
+    for (i=0; i<n; i++, trace_ring_n++)  {
+      if (trace_ring_n >= TRACE_MAX_EVENTS)
+	trace_ring_dropped++;
+      retired = &trace_ring[trace_ring_n % TRACE_MAX_EVENTS];
+      retired->tid   = buffer->tid;
+      retired->event = buffer->events[i];
+    }
+  pthread_mutex_unlock (&trace_lock);
+
+  trace_local = NULL;
+  free (buffer);
+}
+
+
+static void create_key (void)
+{
+  pthread_key_create (&trace_key, retire_buffer);
+}
+
+
+static TRACE_BUFFER *local_buffer (void)
+{
+  TRACE_BUFFER *buffer=NULL;
+
+  if (trace_local != NULL)
+    return trace_local;
+
+  pthread_once (&trace_once, create_key);
+
+  if ((buffer = (TRACE_BUFFER *) calloc (1, sizeof(TRACE_BUFFER))) == NULL)
+    return NULL;
+
+  if (pthread_setspecific (trace_key, buffer) != 0)  {
+    free (buffer);
+    return NULL;
+  }
+
+  pthread_mutex_lock (&trace_lock);
+  buffer->tid   = ++trace_threads;
+  buffer->next  = trace_buffers;
+  trace_buffers = buffer;
+  pthread_mutex_unlock (&trace_lock);
+
+  trace_local = buffer;
+  return buffer;
+}
+
+
+
+/***********************************************************************************/
+/* Function: trace_enable                                                          */
+/* Description:                                                                    */
+/*  Switch the timers on (on != 0) or off for all threads.                         */
+/***********************************************************************************/
+
+void trace_enable (int on)
+{
+  __atomic_store_n (&trace_on, (on != 0), __ATOMIC_RELAXED);
+}
+
+
+int trace_enabled (void)
+{
+  return __atomic_load_n (&trace_on, __ATOMIC_RELAXED);
+}
+
+
+
+/***********************************************************************************/
+/* Function: trace_begin, trace_end                                                */
+/* Description:                                                                    */
+/*  Time a stage: t0 = trace_begin(); ...; trace_end (TRACE_..., t0);              */
+/*  trace_begin() returns 0 when the timers are off, and trace_end() then does     */
+/*  nothing, also if the timers were switched on in between.                       */
+/***********************************************************************************/
+
+double trace_begin (void)
+{
+  if (!__atomic_load_n (&trace_on, __ATOMIC_RELAXED))
+    return 0.0;
+  return now();
+}
+
+
+void trace_end (int stage, double t0)
+{
+  TRACE_BUFFER *buffer=NULL;
+  TRACE_EVENT *event=NULL;
+  double duration=0.0;
+
+  if (t0 == 0.0 || stage < 0 || stage >= TRACE_STAGES)
+    return;
+
+  duration = now() - t0;
+
+  if (trace_in_call)  {
+    trace_current.stage[stage] += duration;
+    trace_current.count[stage]++;
+  }
+
+  if ((buffer = local_buffer ()) == NULL)
+    return;
+
+  if (buffer->n >= TRACE_MAX_EVENTS)  {
+    __atomic_fetch_add (&buffer->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  event = &buffer->events[buffer->n];
+  event->stage    = stage;
+  event->start    = t0;
+  event->duration = duration;
+  __atomic_store_n (&buffer->n, buffer->n + 1, __ATOMIC_RELEASE);
+}
+
+
+
+/***********************************************************************************/
+/* Function: trace_call_begin, trace_call_end                                      */
+/* Description:                                                                    */
+/*  Start and finish the summary of a call of this thread. trace_call_begin()      */
+/*  returns t0 for trace_call_end(), 0 if the timers are off.                      */
+/***********************************************************************************/
+
+double trace_call_begin (void)
+{
+  double t0 = trace_begin ();
+
+  if (t0 != 0.0)  {
+    memset (&trace_current, 0, sizeof(TRACE_SUMMARY));
+    trace_in_call = 1;
+  }
+  return t0;
+}
+
+
+void trace_call_end (double t0)
+{
+  if (t0 == 0.0)
+    return;
+
+  trace_end (TRACE_CALL, t0);
+  trace_in_call = 0;
+
+  trace_current.seconds = trace_current.stage[TRACE_CALL];
+  trace_last      = trace_current;
+  trace_have_last = 1;
+}
+
+
+
+/***********************************************************************************/
+/* Function: trace_last_call                                                       */
+/* Description:                                                                    */
+/*  Copy the summary of the last traced fastrt_compute() of the calling thread.    */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., -1 if this thread has not traced a call yet.                       */
+/***********************************************************************************/
+
+int trace_last_call (TRACE_SUMMARY *summary)
+{
+  if (!trace_have_last)
+    return -1;
+
+  *summary = trace_last;
+  return 0;
+}
+
+
+const char *trace_stage_name (int stage)
+{
+  if (stage < 0 || stage >= TRACE_STAGES)
+    return "unknown";
+  return trace_names[stage];
+}
+
+
+
+/***********************************************************************************/
+/* Function: trace_write_chrome                                                    */
+/* Description:                                                                    */
+/*  Write the events of all threads as Chrome trace-event JSON: complete events    */
+/*  ("ph":"X") with microsecond times, one tid per thread, those that have ended   */
+/*  included. May be called while other threads trace; their newer events are      */
+/*  left out.                                                                      */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., -1 if writing failed.                                              */
+/***********************************************************************************/
+
+int trace_write_chrome (FILE *out)
+{
+  TRACE_BUFFER *buffer=NULL;
+  TRACE_EVENT *event=NULL;
+  TRACE_RETIRED *retired=NULL;
+  double epoch=0.0;
+  long i=0, n=0, first_retired=0, dropped=0;
+  int first=1, tid=0;
+
+  pthread_mutex_lock (&trace_lock);
+
+  /* the events of the ring, oldest first */
+  n = (trace_ring_n < TRACE_MAX_EVENTS ? trace_ring_n : TRACE_MAX_EVENTS);
+  first_retired = trace_ring_n - n;
+
+  /* times relative to the first event */
+  for (buffer=trace_buffers; buffer!=NULL; buffer=buffer->next)  {
+    n = __atomic_load_n (&buffer->n, __ATOMIC_ACQUIRE);
+    for (i=0; i<n; i++)
+      if (epoch == 0.0 || buffer->events[i].start < epoch)
+	epoch = buffer->events[i].start;
+  }
+  for (i=first_retired; i<trace_ring_n; i++)  {
+    event = &trace_ring[i % TRACE_MAX_EVENTS].event;
+    if (epoch == 0.0 || event->start < epoch)
+      epoch = event->start;
+  }
+
+  fprintf (out, "{\"traceEvents\":[");
+
+  for (i=first_retired; i<trace_ring_n; i++)  {
+    retired = &trace_ring[i % TRACE_MAX_EVENTS];
+    if (retired->tid != tid)  {
+      tid = retired->tid;
+      fprintf (out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+	       "\"args\":{\"name\":\"fastrt %d\"}}", first ? "" : ",", tid, tid);
+      first = 0;
+    }
+    fprintf (out, ",\n{\"name\":\"%s\",\"cat\":\"fastrt\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+	     "\"ts\":%.3f,\"dur\":%.3f}", trace_names[retired->event.stage], tid,
+	     (retired->event.start - epoch) * 1e6, retired->event.duration * 1e6);
+  }
+  dropped = trace_ring_dropped;
+
+  for (buffer=trace_buffers; buffer!=NULL; buffer=buffer->next)  {
+    n = __atomic_load_n (&buffer->n, __ATOMIC_ACQUIRE);
+    dropped += __atomic_load_n (&buffer->dropped, __ATOMIC_RELAXED);
+
+    fprintf (out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+	     "\"args\":{\"name\":\"fastrt %d\"}}", first ? "" : ",", buffer->tid, buffer->tid);
+    first = 0;
+
+    for (i=0; i<n; i++)  {
+      event = &buffer->events[i];
+      fprintf (out, ",\n{\"name\":\"%s\",\"cat\":\"fastrt\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+	       "\"ts\":%.3f,\"dur\":%.3f}", trace_names[event->stage], buffer->tid,
+	       (event->start - epoch) * 1e6, event->duration * 1e6);
+    }
+  }
+
+  fprintf (out, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%ld}}\n",
+	   dropped);
+
+  pthread_mutex_unlock (&trace_lock);
+
+  return (ferror (out) ? -1 : 0);
+}
+
+
+
+/***********************************************************************************/
+/* Function: trace_reset                                                           */
+/* Description:                                                                    */
+/*  Drop the recorded events of all threads, those that have ended included. Must  */
+/*  not run concurrently with traced calls.                                        */
+/***********************************************************************************/
+
+void trace_reset (void)
+{
+  TRACE_BUFFER *buffer=NULL;
+
+  pthread_mutex_lock (&trace_lock);
+  for (buffer=trace_buffers; buffer!=NULL; buffer=buffer->next)  {
+    __atomic_store_n (&buffer->n, 0, __ATOMIC_RELEASE);
+    __atomic_store_n (&buffer->dropped, 0, __ATOMIC_RELAXED);
+  }
+  trace_ring_n       = 0;
+  trace_ring_dropped = 0;
+  pthread_mutex_unlock (&trace_lock);
+}
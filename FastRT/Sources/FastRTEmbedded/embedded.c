@@ -0,0 +1,28 @@
+/************************************************************************/
+/* embedded.c                                                           */
+/*                                                                      */
+/* The table pack linked into the binary, see fastrt_embedded.h.        */
+/*                                                                      */
+/************************************************************************/
+
+#include "fastrt_embedded.h"
+
+
+
+/***********************************************************************************/
+/* Function: fastrt_engine_open_embedded_pack                                      */
+/* Description:                                                                    */
+/*  Read the tables of the engine from the pack linked into the binary, see        */
+/*  fastrt_engine_open_pack_memory(). Call it before the engine is used.           */
+/*                                                                                 */
+/* Return value:                                                                   */
+/*  0  if o.k., <0 if no pack is linked in, it is not a pack of this version, or   */
+/*  the engine has one already.                                                    */
+/***********************************************************************************/
+
+int fastrt_engine_open_embedded_pack (FASTRT_ENGINE *engine)
+{
+  if (fastrt_pack_size == 0)
+    return -1;
+  return fastrt_engine_open_pack_memory (engine, fastrt_pack_data, fastrt_pack_size);
+}
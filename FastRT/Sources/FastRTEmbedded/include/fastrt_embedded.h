@@ -0,0 +1,43 @@
+/************************************************************************/
+/* fastrt_embedded.h                                                    */
+/*                                                                      */
+/* The table pack linked into the binary: the FastRTEmbedded target     */
+/* holds the bytes of a pack in pack_data.c, written by fastrt-embed,   */
+/* as read-only data, so that an engine needs no file at all and the    */
+/* pages are shared by all processes of the library. As checked in,     */
+/* pack_data.c holds no pack and fastrt_engine_open_embedded_pack()     */
+/* fails; regenerate it with                                            */
+/*                                                                      */
+/*   fastrt-pack Sources/FastRT/Resources fastrt.pack                   */
+/*   fastrt-embed fastrt.pack Sources/FastRTEmbedded/pack_data.c        */
+/*                                                                      */
+/* before building the FastRTEmbedded library.                          */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __fastrt_embedded_h
+#define __fastrt_embedded_h
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "engine.h"
+
+
+extern const unsigned char fastrt_pack_data[];  /* page aligned          */
+extern const size_t        fastrt_pack_size;    /* 0: no pack linked in  */
+
+
+/* prototypes */
+
+int fastrt_engine_open_embedded_pack (FASTRT_ENGINE *engine);
+
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,12 @@
+/* pack_data.c: no pack */
+/* written by fastrt-embed, see fastrt_embedded.h; do not edit */
+
+#include "fastrt_embedded.h"
+
+
+const size_t fastrt_pack_size = 0;
+
+__attribute__ ((aligned (16384)))
+const unsigned char fastrt_pack_data[1] =
+  ""
+  ;
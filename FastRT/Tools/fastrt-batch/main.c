@@ -0,0 +1,275 @@
+/************************************************************************/
+/* fastrt-batch                                                         */
+/*                                                                      */
+/* Many fastrt computations in one process, run as                      */
+/*                                                                      */
+/*   fastrt-batch [options] < requests > results                        */
+/*                                                                      */
+/* Every input line is one request with the options of fastrt, e.g.     */
+/*                                                                      */
+/*   -a 57.5 -o 315 -g 290 -e 400 -s 1 -q 3                             */
+/*                                                                      */
+/* or, with -c, a CSV row whose columns are named by a header line of   */
+/* option letters, e.g. "a,o,z,w"; the column c is the broken cloud     */
+/* flag, set if nonzero, and empty fields are left out. Empty lines and */
+/* lines starting with # are skipped.                                   */
+/*                                                                      */
+/* For every request one line is written: the status, followed by the   */
+/* irradiances (mW/(m^2 nm)) of the wavelengths asked for, if it is 0.  */
+/* All requests share one engine, so that the tables are read once for  */
+/* the whole stream. The lines are read in blocks of -b, computed on    */
+/* -t threads and written in input order after each block.              */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ascii.h"
+#include "FastRT.h"
+#include "taskpool.h"
+
+
+#define BATCH_MAX_LINE     4096
+#define BATCH_MAX_ARGS     64
+#define BATCH_MAX_COLUMNS  32
+#define BATCH_BLOCK        16       /* lines per block and thread with -t > 1 */
+
+
+/* one request of a block */
+typedef struct {
+  char   *options;          /* fastrt options                   */
+  int     status;
+  int     n_lambda;
+  double *doserates;
+} BATCH_ITEM;
+
+typedef struct {
+  FASTRT_ENGINE *engine;
+  BATCH_ITEM    *items;
+} BATCH;
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-batch [-R resources] [-t threads] [-b block] [-c] [-p digits]\n");
+  fprintf (stderr, "  -t   threads, <1 for all processors, default 1\n");
+  fprintf (stderr, "  -b   lines per block, default 1 with one thread, else %d per thread\n",
+	   BATCH_BLOCK);
+  fprintf (stderr, "  -c   CSV input with a header of option letters, CSV output\n");
+  fprintf (stderr, "  -p   significant digits of the output, default 10\n");
+}
+
+
+static int compute (BATCH_ITEM *item, FASTRT_ENGINE *engine)
+{
+  FASTRT_REQUEST req;
+  char *argv[BATCH_MAX_ARGS], *t=NULL, *save=NULL;
+  int argc=0;
+
+  argv[argc++] = "fastrt";
+  for (t=strtok_r (item->options, " \t", &save); t!=NULL && argc<BATCH_MAX_ARGS-1;
+       t=strtok_r (NULL, " \t", &save))
+    argv[argc++] = t;
+  argv[argc] = NULL;
+
+  fastrt_request_init (&req);
+
+  if ((item->status = fastrt_parse_request (argc, argv, &req)) == 0)  {
+    item->n_lambda = req.n_lambda;
+    if ((item->doserates = (double *) calloc (req.n_lambda, sizeof(double))) == NULL)
+      item->status = -1;
+    else
+      item->status = fastrt_compute (engine, &req, item->doserates);
+  }
+
+  fastrt_request_free (&req);
+  return 0;
+}
+
+
+static int run_items (void *arg, TASKPOOL_WORKER *worker, long first, long n)
+{
+  BATCH *batch = (BATCH *) arg;
+  long i=0;
+
+  (void) worker;
+  for (i=first; i<first+n; i++)
+    compute (&batch->items[i], batch->engine);
+  return 0;
+}
+
+
+/* the options of a CSV row, from the option letters of the header */
+static int csv_options (char *row, const char *letters, int n_columns, char *options, size_t size)
+{
+  char *field=row, *end=NULL;
+  int column=0, n=0;
+
+  options[0] = 0;
+  for (column=0; column<n_columns && field!=NULL; column++, field=end)  {
+    if ((end = strchr (field, ',')) != NULL)
+      *end++ = 0;
+    field += strspn (field, " \t");
+    if (field[0] == 0)
+      continue;
+
+    if (letters[column] == 'c')  {
+      if (atof (field) != 0.0)
+	n += snprintf (options + n, size - n, " -c");
+    }
+    else
+      n += snprintf (options + n, size - n, " -%c %s", letters[column], field);
+
+    if ((size_t) n >= size)
+      return -1;
+  }
+  return 0;
+}
+
+
+/* the option letters of a CSV header, e.g. "a,o,z,w" */
+static int csv_header (char *line, char *letters)
+{
+  char *t=NULL;
+  int n=0;
+
+  for (t=strtok (line, ","); t!=NULL; t=strtok (NULL, ","))  {
+    t += strspn (t, " \t-");
+    if (n == BATCH_MAX_COLUMNS || t[0] == 0)
+      return -1;
+    letters[n++] = t[0];
+  }
+  return n;
+}
+
+
+static void write_item (FILE *out, const BATCH_ITEM *item, int csv, int digits)
+{
+  int i=0;
+
+  fprintf (out, "%d", item->status);
+  if (item->status == 0)
+    for (i=0; i<item->n_lambda; i++)
+      fprintf (out, "%c%.*g", csv ? ',' : ' ', digits, item->doserates[i]);
+  fprintf (out, "\n");
+}
+
+
+int main (int argc, char **argv)
+{
+  TASKPOOL_JOB job;
+  TASKPOOL *pool=NULL;
+  BATCH batch;
+  char line[BATCH_MAX_LINE], options[BATCH_MAX_LINE], letters[BATCH_MAX_COLUMNS];
+  long requests=0, failed=0;
+  int n_threads=1, block=0, csv=0, digits=10, n_columns=0, n=0, eof=0, c=0, i=0;
+  int status=0;
+
+  while ((c = getopt (argc, argv, "R:t:b:cp:h")) != -1)  {
+    switch (c)  {
+    case 'R': ASCII_set_resource_path (optarg); break;
+    case 't': n_threads = atoi (optarg);        break;
+    case 'b': block = atoi (optarg);            break;
+    case 'c': csv = 1;                          break;
+    case 'p': digits = atoi (optarg);           break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  n_threads = taskpool_threads (n_threads);
+  if (block < 1)
+    block = (n_threads == 1 ? 1 : BATCH_BLOCK * n_threads);
+
+  if (optind != argc || digits < 1 || digits > 17)  {
+    usage ();
+    return 1;
+  }
+
+  memset (&batch, 0, sizeof(BATCH));
+  batch.items  = (BATCH_ITEM *) calloc (block, sizeof(BATCH_ITEM));
+  batch.engine = fastrt_engine_create ();
+  pool         = taskpool_create (n_threads);
+  if (batch.items == NULL || batch.engine == NULL || pool == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+
+  memset (&job, 0, sizeof(TASKPOOL_JOB));
+  job.run = run_items;
+  job.arg = &batch;
+
+  while (!eof && status == 0)  {
+    /* read a block */
+    for (n=0; n<block; )  {
+      if (fgets (line, sizeof(line), stdin) == NULL)  {
+	eof = 1;
+	break;
+      }
+      line[strcspn (line, "\r\n")] = 0;
+      if (line[strspn (line, " \t")] == 0 || line[0] == '#')
+	continue;
+
+      if (csv && n_columns == 0)  {
+	if ((n_columns = csv_header (line, letters)) <= 0)  {
+	  fprintf (stderr, "Error, bad CSV header\n");
+	  status = 1;
+	  break;
+	}
+	continue;
+      }
+
+      if (csv)  {
+	if (csv_options (line, letters, n_columns, options, sizeof(options)) != 0)  {
+	  fprintf (stderr, "Error, CSV row too long\n");
+	  status = 1;
+	  break;
+	}
+      }
+      else
+	snprintf (options, sizeof(options), "%s", line);
+
+      if ((batch.items[n].options = strdup (options)) == NULL)  {
+	fprintf (stderr, "Error, out of memory\n");
+	status = 1;
+	break;
+      }
+      n++;
+    }
+
+    if (n > 0 && status == 0 &&
+	taskpool_run (pool, &job, n, 1, n_threads, TASKPOOL_STEAL, NULL) != 0)  {
+      fprintf (stderr, "Error, cannot start the threads\n");
+      status = 1;
+    }
+
+    /* write it in input order */
+    for (i=0; i<n; i++)  {
+      if (status == 0)
+	write_item (stdout, &batch.items[i], csv, digits);
+      if (batch.items[i].status != 0)
+	failed++;
+      free (batch.items[i].options);
+      free (batch.items[i].doserates);
+      memset (&batch.items[i], 0, sizeof(BATCH_ITEM));
+    }
+    requests += n;
+    fflush (stdout);
+  }
+
+  if (ferror (stdout))  {
+    fprintf (stderr, "Error writing the results\n");
+    status = 1;
+  }
+
+  fprintf (stderr, "%ld requests, %ld failed\n", requests, failed);
+
+  taskpool_free (pool);
+  fastrt_engine_free (batch.engine);
+  free (batch.items);
+  return status;
+}
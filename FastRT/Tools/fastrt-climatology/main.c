@@ -0,0 +1,125 @@
+/************************************************************************/
+/* fastrt-climatology                                                   */
+/*                                                                      */
+/* Daily erythemal and vitamin D doses for a list of sites, run as      */
+/*                                                                      */
+/*   fastrt-climatology [options] sites output                          */
+/*                                                                      */
+/* The site file has one site per line: latitude, longitude (East       */
+/* positive) and altitude [km]; lines starting with # are skipped.      */
+/* With -k the run can be interrupted and restarted with the same       */
+/* arguments; it continues after the last finished block.               */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ascii.h"
+#include "climatology.h"
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-climatology [-R resources] [-f first_day] [-l last_day]\n");
+  fprintf (stderr, "         [-s sky_mask] [-S step] [-t threads] [-b block] [-n max_items]\n");
+  fprintf (stderr, "         [-k checkpoint] [-c] sites output\n");
+  fprintf (stderr, "  -s   bit mask of the sky conditions 0..3, default 0xf\n");
+  fprintf (stderr, "  -c   CSV output instead of binary\n");
+}
+
+
+static int read_sites (const char *filename, CLIM_SITE **sites)
+{
+  FILE *f=NULL;
+  char line[256];
+  CLIM_SITE site, *tmp=NULL;
+  int n=0, max=0;
+
+  *sites = NULL;
+  if ((f = fopen (filename, "r")) == NULL)
+    return -1;
+
+  while (fgets (line, sizeof(line), f) != NULL)  {
+    if (line[0] == '#')
+      continue;
+    if (sscanf (line, "%lf %lf %lf", &site.latitude, &site.longitude, &site.altitude) != 3)
+      continue;
+
+    if (n == max)  {
+      max = (max == 0 ? 64 : 2*max);
+      if ((tmp = (CLIM_SITE *) realloc (*sites, max * sizeof(CLIM_SITE))) == NULL)  {
+	fclose (f);
+	return -1;
+      }
+      *sites = tmp;
+    }
+    (*sites)[n++] = site;
+  }
+
+  fclose (f);
+  return n;
+}
+
+
+int main (int argc, char **argv)
+{
+  CLIM_SPEC spec;
+  CLIM_STATS stats;
+  CLIM_SITE *sites=NULL;
+  FASTRT_ENGINE *engine=NULL;
+  int c=0, status=0;
+
+  climatology_spec_init (&spec);
+
+  while ((c = getopt (argc, argv, "R:f:l:s:S:t:b:n:k:ch")) != -1)  {
+    switch (c)  {
+    case 'R': ASCII_set_resource_path (optarg);               break;
+    case 'f': spec.first_day = atoi (optarg);                 break;
+    case 'l': spec.last_day  = atoi (optarg);                 break;
+    case 's': spec.sky_mask  = (int) strtol (optarg, NULL, 0); break;
+    case 'S': spec.step      = atoi (optarg);                 break;
+    case 't': spec.n_threads = atoi (optarg);                 break;
+    case 'b': spec.block     = atoi (optarg);                 break;
+    case 'n': spec.max_items = atol (optarg);                 break;
+    case 'k': spec.checkpoint = optarg;                       break;
+    case 'c': spec.format    = CLIM_CSV;                      break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (argc - optind != 2)  {
+    usage ();
+    return 1;
+  }
+
+  if ((spec.n_sites = read_sites (argv[optind], &sites)) <= 0)  {
+    fprintf (stderr, "Error, no sites in %s\n", argv[optind]);
+    return 1;
+  }
+  spec.sites  = sites;
+  spec.output = argv[optind+1];
+
+  if ((engine = fastrt_engine_create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    free (sites);
+    return 1;
+  }
+
+  status = climatology_run (engine, &spec, &stats);
+
+  if (status != 0)
+    fprintf (stderr, "Error %d from climatology_run()\n", status);
+  else
+    fprintf (stderr, "%ld items, %ld records (%ld failed) in %.1f s, %ld resumed, %ld remaining\n",
+	     stats.items, stats.records, stats.failed, stats.seconds, stats.resumed,
+	     stats.remaining);
+
+  fastrt_engine_free (engine);
+  free (sites);
+  return (status != 0 ? 1 : (stats.remaining > 0 ? 2 : 0));
+}
@@ -0,0 +1,112 @@
+/************************************************************************/
+/* fastrt-daemon                                                        */
+/*                                                                      */
+/* Answers dose queries from a warm engine over a Unix domain socket,   */
+/* run as                                                               */
+/*                                                                      */
+/*   fastrt-daemon [options] socket                                     */
+/*                                                                      */
+/* With -p all tables are read on a background thread from the start,  */
+/* so that the first clients do not wait for the files. -s bounds the   */
+/* convolved spectra kept for the wavelength grids of the clients.      */
+/*                                                                      */
+/* The protocol is described in server.h. SIGINT or SIGTERM stop the   */
+/* daemon after the running requests; the counters of the engine are    */
+/* then written to stderr in the Prometheus text format.                */
+/*                                                                      */
+/************************************************************************/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ascii.h"
+#include "metrics.h"
+#include "server.h"
+#include "tablestore.h"
+
+
+static volatile sig_atomic_t stop = 0;
+
+
+static void on_signal (int sig)
+{
+  (void) sig;
+  stop = 1;
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-daemon [-R resources] [-c max_clients] [-s megabytes] [-p] [-m]\n");
+  fprintf (stderr, "         socket\n");
+  fprintf (stderr, "  -s   convolved spectra kept, default %ld MB\n", TABLESTORE_MAX_SPECTRA >> 20);
+  fprintf (stderr, "  -p   preload all tables in the background\n");
+  fprintf (stderr, "  -m   write the runtime counters to stderr on exit\n");
+}
+
+
+int main (int argc, char **argv)
+{
+  SERVER_SPEC spec;
+  SERVER_STATS stats;
+  FASTRT_PRELOAD preload;
+  FASTRT_ENGINE *engine=NULL;
+  struct sigaction sa;
+  long spectra=TABLESTORE_MAX_SPECTRA >> 20;
+  int metrics=0, warm=0, c=0, status=0;
+
+  server_spec_init (&spec);
+
+  while ((c = getopt (argc, argv, "R:c:s:pmh")) != -1)  {
+    switch (c)  {
+    case 'R': ASCII_set_resource_path (optarg);  break;
+    case 'c': spec.max_clients = atoi (optarg);  break;
+    case 's': spectra = atol (optarg);           break;
+    case 'p': warm = 1;                          break;
+    case 'm': metrics = 1;                       break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (argc - optind != 1 || spec.max_clients < 1 || spectra < 0)  {
+    usage ();
+    return 1;
+  }
+  spec.path = argv[optind];
+  spec.stop = &stop;
+
+  memset (&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigaction (SIGINT, &sa, NULL);
+  sigaction (SIGTERM, &sa, NULL);
+  signal (SIGPIPE, SIG_IGN);
+
+  if ((engine = fastrt_engine_create ()) == NULL)  {
+    fprintf (stderr, "Error, out of memory\n");
+    return 1;
+  }
+  tablestore_set_max_spectra (engine->store, (size_t) spectra << 20);
+
+  if (warm)  {
+    fastrt_preload_init (&preload);
+    if (fastrt_engine_preload (engine, &preload) != 0)
+      fprintf (stderr, "Warning, cannot start the preload\n");
+  }
+
+  if ((status = server_run (engine, &spec, &stats)) != 0)
+    fprintf (stderr, "Error, cannot listen on %s\n", spec.path);
+  else
+    fprintf (stderr, "%ld connections (%ld refused), %ld requests (%ld failed)\n",
+	     stats.connections, stats.refused, stats.requests, stats.failed);
+
+  if (metrics)
+    metrics_write_prometheus (stderr);
+
+  fastrt_engine_free (engine);
+  return (status != 0 ? 1 : 0);
+}
@@ -0,0 +1,97 @@
+/************************************************************************/
+/* fastrt-densify                                                       */
+/*                                                                      */
+/* Resamples a table tree onto a finer sza, ozone and altitude grid, on */
+/* which the engine interpolates linearly, run as                       */
+/*                                                                      */
+/*   fastrt-densify [options] resources output                          */
+/*                                                                      */
+/* and reports the size of the dense grid and the largest and rms       */
+/* relative error of the linear interpolation against the splines of   */
+/* the input tables, checked at -n random points per cloud level up to  */
+/* the sza -z, see densify.h. Exits with 1 if the error exceeds -e.     */
+/* With -P the pack is built from the output tree when the check        */
+/* passed, e.g.                                                         */
+/*                                                                      */
+/*   fastrt-densify -P dense.pack Resources Dense                       */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "densify.h"
+#include "pack.h"
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-densify [-s sza_step] [-o ozone_step] [-a alt_step]\n");
+  fprintf (stderr, "         [-n samples] [-z check_sza] [-e max_error] [-j threads]\n");
+  fprintf (stderr, "         [-P pack] [-C]\n");
+  fprintf (stderr, "         resources output\n");
+  fprintf (stderr, "  -s   sza step of the dense grid, default %g degrees\n", DENSIFY_SZA_STEP);
+  fprintf (stderr, "  -o   ozone step, default %g DU\n", DENSIFY_OZONE_STEP);
+  fprintf (stderr, "  -a   altitude step, default %g km, 0: the input altitudes\n",
+	   DENSIFY_ALT_STEP);
+  fprintf (stderr, "  -n   points per cloud level of the check, default %d\n", DENSIFY_SAMPLES);
+  fprintf (stderr, "  -z   largest sza of the check, default %g degrees\n", DENSIFY_CHECK_SZA);
+  fprintf (stderr, "  -e   bound of the relative error, default %g\n", DENSIFY_MAX_ERROR);
+  fprintf (stderr, "  -C   pack the transmittances in a spectral basis\n");
+}
+
+
+int main (int argc, char **argv)
+{
+  DENSIFY_SPEC spec;
+  DENSIFY_STATS stats;
+  int c=0, status=0;
+
+  densify_spec_init (&spec);
+
+  while ((c = getopt (argc, argv, "s:o:a:n:z:e:j:P:Ch")) != -1)  {
+    switch (c)  {
+    case 's': spec.sza_step    = atof (optarg);   break;
+    case 'o': spec.ozone_step  = atof (optarg);   break;
+    case 'a': spec.alt_step    = atof (optarg);   break;
+    case 'n': spec.samples     = atoi (optarg);   break;
+    case 'z': spec.check_sza   = atof (optarg);   break;
+    case 'e': spec.max_error   = atof (optarg);   break;
+    case 'j': spec.max_threads = atoi (optarg);   break;
+    case 'P': spec.pack        = optarg;          break;
+    case 'C': spec.pack_kind   = PACK_PCA;        break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (argc - optind != 2)  {
+    usage ();
+    return 1;
+  }
+  spec.input  = argv[optind];
+  spec.output = argv[optind+1];
+
+  status = densify_run (&spec, &stats);
+
+  printf ("%d x %d x %d sza, ozone and altitude nodes, %ld tables, %ld left out\n",
+	  stats.n_sza, stats.n_ozone, stats.n_alt, stats.tables, stats.skipped);
+  printf ("%ld other files copied or interpolated\n", stats.copied);
+  if (stats.checked > 0)
+    printf ("%ld values checked, largest relative error %.2e, rms %.2e\n", stats.checked,
+	    stats.max_error, stats.rms_error);
+  printf ("%.2f s\n", stats.seconds);
+
+  if (status < 0)  {
+    fprintf (stderr, "Error, cannot densify the tables of %s\n", spec.input);
+    return 1;
+  }
+  if (status > 0)  {
+    fprintf (stderr, "Error, the relative error exceeds %g, use smaller steps\n",
+	     spec.max_error);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+/************************************************************************/
+/* fastrt-embed                                                         */
+/*                                                                      */
+/* Writes a table pack as the C source of the FastRTEmbedded target,    */
+/* run as                                                               */
+/*                                                                      */
+/*   fastrt-embed pack Sources/FastRTEmbedded/pack_data.c               */
+/*                                                                      */
+/* The bytes become a const array, aligned to a page of every target    */
+/* (16 kB on Apple silicon), which the linker puts into the read-only   */
+/* data of the library; see fastrt_embedded.h. The pack is checked with */
+/* pack_open() first. The array is written as string literals, which    */
+/* compilers read much faster than a list of numbers.                   */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pack.h"
+
+
+#define EMBED_ALIGN  16384
+#define EMBED_LINE   32      /* bytes per string literal */
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-embed pack output.c\n");
+}
+
+
+/* the bytes as a string literal; octal escapes have all three digits, */
+/* so that no digit after them is taken into the escape                */
+static void write_line (FILE *f, const unsigned char *p, size_t n)
+{
+  size_t i=0;
+
+  fputs ("  \"", f);
+  for (i=0; i<n; i++)
+    if (p[i] >= 0x20 && p[i] < 0x7f && p[i] != '"' && p[i] != '\\' && p[i] != '?')
+      fputc (p[i], f);
+    else
+      fprintf (f, "\\%03o", p[i]);
+  fputs ("\"\n", f);
+}
+
+
+int main (int argc, char **argv)
+{
+  TABLE_PACK *pack=NULL;
+  FILE *f=NULL;
+  size_t i=0, size=0;
+  int status=0;
+
+  if (argc != 3)  {
+    usage ();
+    return 1;
+  }
+
+  if ((pack = pack_open (argv[1])) == NULL)  {
+    fprintf (stderr, "Error, %s is not a pack of this version\n", argv[1]);
+    return 1;
+  }
+  if ((f = fopen (argv[2], "w")) == NULL)  {
+    fprintf (stderr, "Error, cannot write %s\n", argv[2]);
+    pack_close (pack);
+    return 1;
+  }
+
+  size = pack->size;
+  fprintf (f, "/* pack_data.c: the table pack %s, %lu entries */\n", argv[1],
+	   (unsigned long) pack->header->n_entries);
+  fprintf (f, "/* written by fastrt-embed, see fastrt_embedded.h; do not edit */\n\n");
+  fprintf (f, "#include \"fastrt_embedded.h\"\n\n\n");
+  fprintf (f, "const size_t fastrt_pack_size = %lu;\n\n", (unsigned long) size);
+  fprintf (f, "__attribute__ ((aligned (%d)))\n", EMBED_ALIGN);
+  fprintf (f, "const unsigned char fastrt_pack_data[%lu] =\n", (unsigned long) size);
+  for (i=0; i<size; i+=EMBED_LINE)
+    write_line (f, pack->base + i, size - i < EMBED_LINE ? size - i : EMBED_LINE);
+  fprintf (f, "  ;\n");
+
+  if (ferror (f))
+    status = -1;
+  if (fclose (f) != 0)
+    status = -1;
+  pack_close (pack);
+
+  if (status != 0)  {
+    fprintf (stderr, "Error, cannot write %s\n", argv[2]);
+    return 1;
+  }
+  printf ("%s: %.2f MB in %s\n", argv[1], size / 1048576.0, argv[2]);
+  return 0;
+}
@@ -0,0 +1,257 @@
+/************************************************************************/
+/* fastrt-pack                                                          */
+/*                                                                      */
+/* Builds the compressed table pack of a Resources tree, run as         */
+/*                                                                      */
+/*   fastrt-pack [options] resources pack                               */
+/*                                                                      */
+/* and reports the size of every directory as text and packed, and the  */
+/* largest relative error of its transmittances after decoding, which   */
+/* is at most -e; the pack is then read back and checked against every  */
+/* text table, see check_pack(). With -p the transmittances are stored  */
+/* as coefficients of a spectral basis per directory (PACK_PCA); the    */
+/* number of basis spectra is reported as well, and the terms per       */
+/* spectrum, against the values of the full table, which is what the    */
+/* convolution of a node costs an engine. An engine reads the pack with */
+/* fastrt_engine_open_pack().                                           */
+/*                                                                      */
+/* Equal tables share one payload in the pack; the entries per payload  */
+/* and the bytes not written are reported. With -z, all spectra below   */
+/* the floor share one payload, at the absolute error reported.         */
+/*                                                                      */
+/* -O lays the spectra out by ozone (default), sza, in 4 x 4 tiles of   */
+/* sza and ozone (morton), or in the order of a trace of an engine      */
+/* given with -T, see tablestore_set_trace(), so that a workload reads  */
+/* the pack front to back.                                              */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "pack.h"
+#include "ascii.h"
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+/* mean time to decode an entry of the pack [s] */
+static double decode_time (const char *path)
+{
+  TABLE_PACK *pack=NULL;
+  MATRIX table;
+  double t0=0.0;
+  int i=0, rows=0, columns=0, n=0, n_entries=0;
+
+  if ((pack = pack_open (path)) == NULL)
+    return -1.0;
+
+  n_entries = (int) pack->header->n_entries;
+  t0 = now ();
+  for (i=0; i<n_entries; i++)
+    if (pack_read (pack, i, &table, &rows, &columns) == 0)  {
+      matrix_free (&table);
+      n++;
+    }
+  t0 = now () - t0;
+
+  pack_close (pack);
+  return (n == n_entries && n > 0 ? t0 / n : -1.0);
+}
+
+
+/* values of the pack which are off the text tables: of a spectrum by more */
+/* than max_error, or not exactly at or below PACK_EXACT_FLOOR of its      */
+/* largest value, of any other table not exactly; spectra below the zero   */
+/* floor are left out. The largest relative error in worst, -1 if the pack */
+/* or a table cannot be read                                               */
+static long check_pack (const char *path, const char *resources, double max_error,
+			double zero_floor, double *worst)
+{
+  TABLE_PACK *pack=NULL;
+  const PACK_ENTRY *e=NULL;
+  MATRIX table, text;
+  char name[FILENAME_MAX+256];
+  double peak=0.0, x=0.0, y=0.0, err=0.0;
+  long off=0;
+  int i=0, k=0, n=0, rows=0, columns=0, text_rows=0, max_columns=0, min_columns=0;
+
+  if ((pack = pack_open (path)) == NULL)
+    return -1;
+  ASCII_set_resource_path (resources);
+
+  *worst = 0.0;
+  for (i=0; i<(int) pack->header->n_entries && off>=0; i++)  {
+    e = &pack->entries[i];
+    snprintf (name, sizeof(name), "./%s", pack->names + e->name);
+    if (pack_read (pack, i, &table, &rows, &columns) != 0)  {
+      off = -1;
+      break;
+    }
+    if (ASCII_file2matrix (name, &text_rows, &max_columns, &min_columns, &text) != 0)  {
+      matrix_free (&table);
+      off = -1;
+      break;
+    }
+
+    n = rows * abs (columns);
+    if (text_rows != rows || max_columns != abs (columns))
+      off += n;
+    else  {
+      for (k=0, peak=0.0; k<n; k++)
+	if (isfinite (text.data[k]) && text.data[k] > peak)
+	  peak = text.data[k];
+      for (k=0; k<n && !(e->kind != PACK_RAW && peak < zero_floor); k++)  {
+	x = text.data[k];
+	y = table.data[k];
+	if (e->kind != PACK_RAW && x > PACK_EXACT_FLOOR * peak)
+	  err = fabs (y - x) / x;
+	else
+	  err = (y == x ? 0.0 : INFINITY);
+	if (err > max_error)
+	  off++;
+	if (err > *worst)
+	  *worst = err;
+      }
+    }
+    matrix_free (&table);
+    matrix_free (&text);
+  }
+
+  pack_close (pack);
+  return off;
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-pack [-p] [-e max_error] [-z zero_floor] [-O order]\n");
+  fprintf (stderr, "         [-T trace] resources pack\n");
+  fprintf (stderr, "  -p   store the transmittances in a spectral basis\n");
+  fprintf (stderr, "  -e   relative error of the transmittances, default %g, with -p %g\n",
+	   PACK_MAX_ERROR, PACK_PCA_ERROR);
+  fprintf (stderr, "  -z   transmittances below are stored once, as zero, default none\n");
+  fprintf (stderr, "  -O   order of the spectra: ozone (default), sza, morton or trace\n");
+  fprintf (stderr, "  -T   trace of the tables read by an engine, for -O trace\n");
+}
+
+
+static int read_order (const char *arg)
+{
+  static const char *orders[] = { "ozone", "sza", "morton", "trace" };
+  int i=0;
+
+  for (i=0; i<(int) (sizeof(orders) / sizeof(orders[0])); i++)
+    if (strcmp (arg, orders[i]) == 0)
+      return i;
+  return -1;
+}
+
+
+int main (int argc, char **argv)
+{
+  PACK_SPEC spec;
+  PACK_STATS stats;
+  double max_error=0.0, t=0.0, terms=0.0, worst=0.0;
+  long spectra=0, off=0;
+  int c=0, i=0;
+
+  pack_spec_init (&spec);
+
+  while ((c = getopt (argc, argv, "pe:z:O:T:h")) != -1)  {
+    switch (c)  {
+    case 'p': spec.kind       = PACK_PCA;            break;
+    case 'e': spec.max_error  = atof (optarg);       break;
+    case 'z': spec.zero_floor = atof (optarg);       break;
+    case 'O': spec.order      = read_order (optarg); break;
+    case 'T': spec.trace      = optarg;              break;
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (argc - optind != 2 || spec.max_error < 0.0 || spec.zero_floor < 0.0 || spec.order < 0 ||
+      (spec.order == PACK_ORDER_TRACE) != (spec.trace != NULL))  {
+    usage ();
+    return 1;
+  }
+  if (spec.max_error == 0.0)
+    spec.max_error = (spec.kind == PACK_PCA ? PACK_PCA_ERROR : PACK_MAX_ERROR);
+  max_error = spec.max_error;
+  spec.resources = argv[optind];
+  spec.output    = argv[optind+1];
+
+  if (pack_run (&spec, &stats) != 0)  {
+    fprintf (stderr, "Error, cannot build %s from %s\n", argv[optind+1], argv[optind]);
+    return 1;
+  }
+
+  printf ("%-48s %7s %7s %7s %6s %10s %10s %7s %10s\n", "directory", "files", "spectra",
+	  "shared", "terms", "text [kB]", "pack [kB]", "ratio", "max error");
+  for (i=0; i<stats.n_levels; i++)  {
+    printf ("%-48s %7ld %7ld %7ld %6d %10.1f %10.1f %7.1f %10.2e\n", stats.level[i].name,
+	    stats.level[i].files, stats.level[i].spectra, stats.level[i].shared,
+	    stats.level[i].terms,
+	    stats.level[i].text_bytes / 1024.0, stats.level[i].packed_bytes / 1024.0,
+	    stats.level[i].packed_bytes > 0 ?
+	    (double) stats.level[i].text_bytes / stats.level[i].packed_bytes : 0.0,
+	    stats.level[i].max_error);
+    spectra += stats.level[i].spectra;
+    terms   += (double) stats.level[i].spectra * stats.level[i].terms;
+  }
+  printf ("%-48s %7ld %7s %7ld %6s %10.1f %10.1f %7.1f %10.2e\n", "total", stats.files, "",
+	  stats.shared + stats.zeros + stats.shared_tables, "",
+	  stats.text_bytes / 1024.0, stats.size / 1024.0,
+	  (double) stats.text_bytes / stats.size, stats.max_error);
+  printf ("%ld of %ld transmittances (%.2f%%) kept as they are\n", stats.exceptions,
+	  stats.values, stats.values > 0 ? 100.0 * stats.exceptions / stats.values : 0.0);
+  if (spec.kind == PACK_PCA && spectra > 0)
+    printf ("%.1f terms and exceptions per spectrum instead of %.1f values, %.1f kB as doubles\n",
+	    (terms + stats.exceptions) / spectra, (double) stats.values / spectra,
+	    stats.values * sizeof(double) / 1024.0);
+  printf ("%ld files in %ld payloads (%.2f per payload): %ld spectra and %ld other tables shared,"
+	  " %.1f kB not written\n", stats.files, stats.payloads,
+	  stats.payloads > 0 ? (double) stats.files / stats.payloads : 0.0, stats.shared,
+	  stats.shared_tables, stats.shared_bytes / 1024.0);
+  if (spec.zero_floor > 0.0)
+    printf ("%ld spectra below %g stored as one, largest absolute error %.2e\n", stats.zeros,
+	    spec.zero_floor, stats.zero_error);
+  if (stats.skipped > 0)
+    printf ("%ld files could not be parsed and were left out\n", stats.skipped);
+
+  if ((t = decode_time (argv[optind+1])) < 0.0)  {
+    fprintf (stderr, "Error, cannot read back %s\n", argv[optind+1]);
+    return 1;
+  }
+  printf ("%.2f us to decode an entry\n", t * 1e6);
+
+  /* pack_build() checks every value it encodes, and the pack is read back */
+  /* against the text tables                                               */
+  if (stats.max_error > max_error)  {
+    fprintf (stderr, "Error, largest relative error %g above %g\n", stats.max_error, max_error);
+    return 1;
+  }
+  if ((off = check_pack (argv[optind+1], argv[optind], max_error, spec.zero_floor,
+			 &worst)) != 0)  {
+    if (off < 0)
+      fprintf (stderr, "Error, cannot check %s against %s\n", argv[optind+1], argv[optind]);
+    else
+      fprintf (stderr, "Error, %ld values of %s off the tables, largest relative error %g\n",
+	       off, argv[optind+1], worst);
+    return 1;
+  }
+  printf ("all values read back within %.2e of the tables, exactly at or below %g of"
+	  " the largest of a spectrum\n", worst, PACK_EXACT_FLOOR);
+  return 0;
+}
@@ -0,0 +1,150 @@
+/************************************************************************/
+/* fastrt-subset                                                        */
+/*                                                                      */
+/* Cuts a table tree to ranges of sza, ozone and altitude, run as       */
+/*                                                                      */
+/*   fastrt-subset [options] resources output                           */
+/*                                                                      */
+/* with the ranges given as min,max, e.g. for a coastal site            */
+/*                                                                      */
+/*   fastrt-subset -s 25,90 -o 250,450 -a 0,0 -P site.pack \            */
+/*     Resources Site                                                   */
+/*                                                                      */
+/* or from a site file as that of fastrt-climatology, one site per      */
+/* line: latitude, longitude and altitude [km], with the days -f to -l, */
+/* see subset.h. Reports the ranges and nodes of the subset and the     */
+/* size of its files and pack. The engine refuses requests outside the  */
+/* ranges of a subset.                                                  */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "subset.h"
+#include "pack.h"
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-subset [-s min,max] [-o min,max] [-a min,max]\n");
+  fprintf (stderr, "         [-S sites] [-f first_day] [-l last_day] [-P pack] [-C]\n");
+  fprintf (stderr, "         resources output\n");
+  fprintf (stderr, "  -s   range of solar zenith angles [degrees]\n");
+  fprintf (stderr, "  -o   range of ozone columns [DU]\n");
+  fprintf (stderr, "  -a   range of altitudes [km]\n");
+  fprintf (stderr, "  -S   sza and altitude ranges of the sites of a file, if not given\n");
+  fprintf (stderr, "  -C   pack the transmittances in a spectral basis\n");
+}
+
+
+static int read_range (const char *arg, TABLE_RANGE *range)
+{
+  if (sscanf (arg, "%lf,%lf", &range->min, &range->max) != 2 || range->min > range->max)
+    return -1;
+  range->set = 1;
+  return 0;
+}
+
+
+static int read_sites (const char *filename, CLIM_SITE **sites)
+{
+  FILE *f=NULL;
+  char line[256];
+  CLIM_SITE site, *tmp=NULL;
+  int n=0, max=0;
+
+  *sites = NULL;
+  if ((f = fopen (filename, "r")) == NULL)
+    return -1;
+
+  while (fgets (line, sizeof(line), f) != NULL)  {
+    if (line[0] == '#')
+      continue;
+    if (sscanf (line, "%lf %lf %lf", &site.latitude, &site.longitude, &site.altitude) != 3)
+      continue;
+
+    if (n == max)  {
+      max = (max == 0 ? 64 : 2*max);
+      if ((tmp = (CLIM_SITE *) realloc (*sites, max * sizeof(CLIM_SITE))) == NULL)  {
+	fclose (f);
+	return -1;
+      }
+      *sites = tmp;
+    }
+    (*sites)[n++] = site;
+  }
+
+  fclose (f);
+  return n;
+}
+
+
+int main (int argc, char **argv)
+{
+  SUBSET_SPEC spec;
+  SUBSET_STATS stats;
+  CLIM_SITE *sites=NULL;
+  const char *site_file=NULL;
+  int c=0, a=0, status=0;
+
+  subset_spec_init (&spec);
+
+  while ((c = getopt (argc, argv, "s:o:a:S:f:l:P:Ch")) != -1)  {
+    switch (c)  {
+    case 's': status = read_range (optarg, &spec.range[TABLEGRID_SZA]);   break;
+    case 'o': status = read_range (optarg, &spec.range[TABLEGRID_OZONE]); break;
+    case 'a': status = read_range (optarg, &spec.range[TABLEGRID_ALT]);   break;
+    case 'S': site_file      = optarg;                                     break;
+    case 'f': spec.first_day = atoi (optarg);                              break;
+    case 'l': spec.last_day  = atoi (optarg);                              break;
+    case 'P': spec.pack      = optarg;                                     break;
+    case 'C': spec.pack_kind = PACK_PCA;                                   break;
+    default:
+      usage ();
+      return 1;
+    }
+    if (status != 0)  {
+      fprintf (stderr, "Error, range %s, min,max expected\n", optarg);
+      return 1;
+    }
+  }
+
+  if (argc - optind != 2)  {
+    usage ();
+    return 1;
+  }
+  spec.input  = argv[optind];
+  spec.output = argv[optind+1];
+
+  if (site_file != NULL)  {
+    if ((spec.n_sites = read_sites (site_file, &sites)) <= 0)  {
+      fprintf (stderr, "Error, no sites in %s\n", site_file);
+      return 1;
+    }
+    spec.sites = sites;
+  }
+
+  status = subset_run (&spec, &stats);
+  free (sites);
+
+  if (status != 0)  {
+    fprintf (stderr, "Error, cannot cut the tables of %s\n", spec.input);
+    return 1;
+  }
+
+  for (a=0; a<TABLEGRID_AXES; a++)  {
+    printf ("%-14s %3d of %3d nodes", tablegrid_name (a), stats.nodes[a],
+	    stats.input_nodes[a]);
+    if (stats.range[a].set)
+      printf (", range %g to %g", stats.range[a].min, stats.range[a].max);
+    printf ("\n");
+  }
+  printf ("%ld files kept, %ld left out, %.1f of %.1f MB\n", stats.files, stats.skipped,
+	  stats.bytes / 1048576.0, stats.input_bytes / 1048576.0);
+  if (spec.pack != NULL)
+    printf ("pack %s, %.2f MB\n", spec.pack, stats.pack_size / 1048576.0);
+  printf ("%.2f s\n", stats.seconds);
+  return 0;
+}
@@ -0,0 +1,209 @@
+/************************************************************************/
+/* fastrt-tables                                                        */
+/*                                                                      */
+/* Generates the look-up tables of fastrt with uvspec, or another       */
+/* solver reading uvspec input, run as                                  */
+/*                                                                      */
+/*   fastrt-tables [options] atmosphere output                          */
+/*                                                                      */
+/* The options of the grids are those of produce_cloud_tables.pl. Up    */
+/* to -j solvers run at a time, and a second run only reruns the jobs   */
+/* whose inputs changed, see tablegen.h. With -c the clear sky samples  */
+/* of the coefficient files are run as well and the coefficients are    */
+/* fitted; -n only fits them again from the samples of an earlier run   */
+/* with the same grids. With -P the table pack is built from the output */
+/* tree when all jobs succeeded.                                        */
+/*                                                                      */
+/* fastrt-tables -S is a stand-in for uvspec: it reads a deck on stdin  */
+/* and writes uvspec output of a crude absorbing and scattering         */
+/* atmosphere, to try out a grid without libRadtran, e.g.               */
+/*                                                                      */
+/*   fastrt-tables -U "fastrt-tables -S" afglus.dat Resources           */
+/*                                                                      */
+/************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tablegen.h"
+#include "pack.h"
+
+
+#define MAX_CLOUDS 64
+
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: fastrt-tables [-U solver] [-D data_files_path] [-j jobs]\n");
+  fprintf (stderr, "         [-s sza_start] [-t sza_end] [-u sza_step]\n");
+  fprintf (stderr, "         [-o ozone_start] [-p ozone_end] [-q ozone_step]\n");
+  fprintf (stderr, "         [-w lambda_start] [-x lambda_end] [-y lambda_step] [-f lambdafile]\n");
+  fprintf (stderr, "         [-k alt_low] [-l alt_top] [-a alpha] [-b beta] [-r albedo]\n");
+  fprintf (stderr, "         [-W cloud,cloud,...] [-P pack] [-C] [-c] [-n] [-F] [-v]\n");
+  fprintf (stderr, "         atmosphere output\n");
+  fprintf (stderr, "       fastrt-tables -S < deck > output\n");
+  fprintf (stderr, "  -W   cloud liquid water contents [g m-3], default those of the engine\n");
+  fprintf (stderr, "  -C   pack the transmittances in a spectral basis\n");
+  fprintf (stderr, "  -c   sample and fit the beta and ozone coefficient files\n");
+  fprintf (stderr, "  -n   only fit the coefficient files from the samples\n");
+  fprintf (stderr, "  -F   rerun all jobs\n");
+  fprintf (stderr, "  -S   stand-in solver\n");
+}
+
+
+/* liquid water path of a cloud file [g m-2] */
+static double water_path (const char *filename)
+{
+  FILE *f=NULL;
+  double z=0.0, w=0.0, r=0.0, z_last=0.0, w_last=0.0, path=0.0;
+  int n=0;
+
+  if ((f = fopen (filename, "r")) == NULL)
+    return 0.0;
+  while (fscanf (f, "%lf %lf %lf", &z, &w, &r) == 3)  {
+    if (n++ > 0)
+      path += 0.5 * (w + w_last) * fabs (z_last - z) * 1000.0;
+    z_last = z;
+    w_last = w;
+  }
+  fclose (f);
+  return path;
+}
+
+
+/* uvspec output of a deck on stdin: lambda edir edn eup, every nm */
+static int stub_solver (void)
+{
+  char line[FILENAME_MAX+64], key[64], value[FILENAME_MAX];
+  double ozone=300.0, sza=0.0, zout=0.0, albedo=0.0, start=290.0, end=405.0;
+  double alpha=1.3, beta=0.02, tau_a=0.0;
+  double lambda=0.0, mu=0.0, tau_o3=0.0, tau_r=0.0, tau_c=0.0, scatter=0.0;
+  double edir=0.0, edn=0.0, eup=0.0;
+  int reverse=0;
+
+  while (fgets (line, sizeof(line), stdin) != NULL)  {
+    value[0] = 0;
+    if (sscanf (line, "%63s %4095[^\n]", key, value) < 1)
+      continue;
+    if      (strcmp (key, "ozone_column") == 0) ozone   = atof (value);
+    else if (strcmp (key, "sza") == 0)          sza     = atof (value);
+    else if (strcmp (key, "zout") == 0)         zout    = atof (value);
+    else if (strcmp (key, "albedo") == 0)       albedo  = atof (value);
+    else if (strcmp (key, "reverse") == 0)      reverse = 1;
+    else if (strcmp (key, "wc_file") == 0)      tau_c   = 0.15 * water_path (value);
+    else if (strcmp (key, "wvn") == 0)          sscanf (value, "%lf %lf", &start, &end);
+    else if (strcmp (key, "angstrom") == 0)     sscanf (value, "%lf %lf", &alpha, &beta);
+  }
+  if (reverse)
+    zout = 0.0;
+
+  mu = cos (sza * 3.14159265358979323846 / 180.0);
+  for (lambda=floor (start); lambda<=ceil (end); lambda+=1.0)  {
+    tau_o3  = ozone / 1000.0 * 40.0 * exp (-(lambda - 290.0) / 9.0);
+    tau_r   = 1.2 * pow (lambda / 300.0, -4.0) * exp (-zout / 8.0);
+    tau_a   = beta * pow (lambda / 1000.0, -alpha) * exp (-zout / 2.0);
+    scatter = tau_r + tau_a + tau_c;
+    edir = mu * exp (-(tau_o3 + scatter) / mu);
+    edn  = mu * (1.0 - exp (-scatter / mu)) * exp (-tau_o3 / mu) * 0.7 * (1.0 + albedo);
+    eup  = (reverse ? 3.14159265358979323846 * scatter / (2.0 + scatter) * exp (-0.02 * tau_o3) :
+	    albedo * (edir + edn));
+    printf ("%9.3f %e %e %e %e %e %e\n", lambda, edir, edn, eup, 0.0, 0.0, 0.0);
+  }
+  return 0;
+}
+
+
+static int parse_clouds (char *list, double *clouds)
+{
+  char *p=NULL;
+  int n=0;
+
+  for (p=strtok (list, ","); p!=NULL && n<MAX_CLOUDS; p=strtok (NULL, ","))
+    clouds[n++] = atof (p);
+  return n;
+}
+
+
+int main (int argc, char **argv)
+{
+  TABLEGEN_SPEC spec;
+  TABLEGEN_STATS stats;
+  double clouds[MAX_CLOUDS];
+  int c=0, fit_only=0, status=0;
+
+  tablegen_spec_init (&spec);
+
+  while ((c = getopt (argc, argv, "U:D:j:s:t:u:o:p:q:w:x:y:f:k:l:a:b:r:W:P:CcnFvSh")) != -1)  {
+    switch (c)  {
+    case 'U': spec.solver       = optarg;                       break;
+    case 'D': spec.data_path    = optarg;                       break;
+    case 'j': spec.max_jobs     = atoi (optarg);                break;
+    case 's': spec.sza_start    = atof (optarg);                break;
+    case 't': spec.sza_end      = atof (optarg);                break;
+    case 'u': spec.sza_step     = atof (optarg);                break;
+    case 'o': spec.ozone_start  = atof (optarg);                break;
+    case 'p': spec.ozone_end    = atof (optarg);                break;
+    case 'q': spec.ozone_step   = atof (optarg);                break;
+    case 'w': spec.lambda_start = atof (optarg);                break;
+    case 'x': spec.lambda_end   = atof (optarg);                break;
+    case 'y': spec.lambda_step  = atof (optarg);                break;
+    case 'f': spec.lambdafile   = optarg;                       break;
+    case 'k': spec.alt_low      = atof (optarg);                break;
+    case 'l': spec.alt_top      = atof (optarg);                break;
+    case 'a': spec.alpha        = atof (optarg);                break;
+    case 'b': spec.beta         = atof (optarg);                break;
+    case 'r': spec.albedo       = atof (optarg);                break;
+    case 'W':
+      spec.clouds   = clouds;
+      spec.n_clouds = parse_clouds (optarg, clouds);
+      break;
+    case 'P': spec.pack         = optarg;                       break;
+    case 'C': spec.pack_kind    = PACK_PCA;                     break;
+    case 'c': spec.coefficients = 1;                            break;
+    case 'n': fit_only          = 1;                            break;
+    case 'F': spec.force        = 1;                            break;
+    case 'v': spec.verbose      = 1;                            break;
+    case 'S': return stub_solver ();
+    default:
+      usage ();
+      return 1;
+    }
+  }
+
+  if (argc - optind != 2)  {
+    usage ();
+    return 1;
+  }
+  spec.atmosphere = argv[optind];
+  spec.output     = argv[optind+1];
+
+  if (fit_only)
+    status = tablegen_fit (&spec, &stats);
+  else  {
+    status = tablegen_run (&spec, &stats);
+
+    printf ("%ld jobs, %ld run, %ld skipped, %ld failed\n", stats.jobs, stats.run, stats.skipped,
+	    stats.failed);
+    printf ("%.2f s, %.2f s of solver time", stats.seconds, stats.solver_seconds);
+    if (stats.seconds > 0.0 && stats.run > 0)
+      printf (", %.1f solvers at a time", stats.solver_seconds / stats.seconds);
+    printf ("\n");
+  }
+  if (stats.fitted > 0)
+    printf ("%ld coefficient files, largest residual %.2e, see %s/%s\n", stats.fitted,
+	    stats.max_residual, spec.output, TABLEGEN_RESIDUALS);
+
+  if (status < 0)  {
+    fprintf (stderr, "Error, cannot generate the tables in %s\n", spec.output);
+    return 1;
+  }
+  if (status > 0)  {
+    fprintf (stderr, "Error, %ld jobs failed, their work files are in %s/%s\n", stats.failed,
+	     spec.output, TABLEGEN_WORK);
+    return 1;
+  }
+  return 0;
+}
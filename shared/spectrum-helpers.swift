@@ -195,6 +195,11 @@ class spectrum_helpers {
         var erythemaReached = false
         while (!vitdReached || !erythemaReached)
         {
+            // past sunset the doserates are zero, no need to run the simulation to find out
+            if (!FastRT.is_daylight(Int32(sliceParams.julianday), Int32(sliceParams.seconds_since_midnight), sliceParams.lat, sliceParams.long))
+            {
+                break;
+            }
             let sliceDoseRates = fastrt_doserate(params: sliceParams, silent: true, spectrumDoseData: &spectrumDoseData)
             
             // stop summing if doserates are near-zero